@@ -83,6 +83,7 @@ void c_inverseDynamics(
 
     biorbd::rigidbody::GeneralizedTorque Tau(*model);
     RigidBodyDynamics::InverseDynamics(*model, Q, Qdot, Qddot, Tau);
+    model->invalidateKinematicsCache();
 
     dispatchTauOutput(Tau, tau);
 }
@@ -97,6 +98,7 @@ void c_massMatrix(
     RigidBodyDynamics::Math::MatrixNd Mass(nQ, nQ);
     Mass.setZero();
     RigidBodyDynamics::CompositeRigidBodyAlgorithm(*model, Q, Mass);
+    model->invalidateKinematicsCache();
 
     // Remplir l'output
     for (unsigned int i=0; i<nQ*nQ; ++i)
@@ -24,6 +24,7 @@ void Matlab_ContactGamma( int, mxArray *plhs[],
 
     Eigen::MatrixXd G_tp(Eigen::MatrixXd::Zero(nContacts,model->nbQ()));
     RigidBodyDynamics::CalcConstraintsJacobian(*model, Q, model->getConstraints(), G_tp, true);
+    model->invalidateKinematicsCache(); // RBDL updated the kinematics without the cache
 
     RigidBodyDynamics::Math::VectorNd Gamma = model->getConstraints().gamma;
 
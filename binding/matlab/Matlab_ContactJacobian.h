@@ -23,6 +23,7 @@ void Matlab_ContactJacobian( int, mxArray *plhs[],
     unsigned int nContacts = model->nbContacts();
     Eigen::MatrixXd G_tp(Eigen::MatrixXd::Zero(nContacts,model->nbQ()));
     RigidBodyDynamics::CalcConstraintsJacobian(*model, Q, model->getConstraints(), G_tp, true);
+    model->invalidateKinematicsCache(); // RBDL updated the kinematics without the cache
 
     // Create a matrix for the return argument
     plhs[0] = mxCreateDoubleMatrix( nContacts, nQ, mxREAL);
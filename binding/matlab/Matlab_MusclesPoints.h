@@ -41,7 +41,7 @@ void Matlab_MusclesPoints( int nlhs, mxArray *plhs[],
                 model->UpdateKinematicsCustom(&Q[iQ]);
 
                 // Recueillir tout le chemin musculaire
-                std::vector<biorbd::utils::Vector3d> via(model->muscleGroup(i).muscle(j).musclesPointsInGlobal());
+                const Eigen::Matrix3Xd& via(model->muscleGroup(i).muscle(j).musclesPointsInGlobalInMatrix());
 
                 // Si le nombre de wrap est > 0, c'est qu'il n'y a pas de viapoints et il n'y a qu'UN wrap
                 if (model->muscleGroup(i).muscle(j).pathModifier().nbWraps() > 0){
@@ -65,12 +65,12 @@ void Matlab_MusclesPoints( int nlhs, mxArray *plhs[],
 
 
                 // transférer toutes les valeurs dans une variable temporaire
-                mxArray *tp = mxCreateDoubleMatrix(3,via.size(),mxREAL);
+                mxArray *tp = mxCreateDoubleMatrix(3,static_cast<mwSize>(via.cols()),mxREAL);
                 double *ptrTp = mxGetPr(tp);
-                for (unsigned int k=0; k<via.size(); ++k){
-                    ptrTp[k*3]   = (*(via.begin()+k))[0];
-                    ptrTp[k*3+1] = (*(via.begin()+k))[1];
-                    ptrTp[k*3+2] = (*(via.begin()+k))[2];
+                for (unsigned int k=0; k<via.cols(); ++k){
+                    ptrTp[k*3]   = via(0, k);
+                    ptrTp[k*3+1] = via(1, k);
+                    ptrTp[k*3+2] = via(2, k);
                 }
 
                 mxSetCell(plhs[0],cmp,tp);
@@ -37,6 +37,7 @@ void Matlab_NLeffects( int, mxArray *plhs[],
     for (unsigned int j=0; j<Q.size(); ++j){
         Tau.setZero();
         RigidBodyDynamics::NonlinearEffects(*model, Q[j], QDot[j], Tau);// Inverse Dynamics
+        model->invalidateKinematicsCache(); // RBDL updated the kinematics without the cache
 
         // Remplir l'output
         for (unsigned int i=0; i<nTau; i++){
@@ -81,6 +81,7 @@ void Matlab_forwardDynamics( int, mxArray *plhs[],
         else {
             RigidBodyDynamics::ForwardDynamicsLagrangian(*model, Q[j], QDot[j], Tau[j], QDDot);// Forward dynamics
         }
+        model->invalidateKinematicsCache(); // RBDL updated the kinematics without the cache
 
 
         // Remplir l'output
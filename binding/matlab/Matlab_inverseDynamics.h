@@ -58,6 +58,7 @@ void Matlab_inverseDynamics( int, mxArray *plhs[],
         }
         else
             RigidBodyDynamics::InverseDynamics(*model, Q[j], QDot[j], QDDot[j], Tau);// Inverse Dynamics
+        model->invalidateKinematicsCache(); // RBDL updated the kinematics without the cache
 
 
         // Remplir l'output
@@ -49,6 +49,17 @@ public:
     Model(
             const biorbd::utils::Path& path);
 
+    ///
+    /// \brief Turn a shallow copy of a model into a workspace that can be evaluated in another thread
+    ///
+    /// The model description (segments, meshes, markers, IMUs, actuators and
+    /// muscle characteristics) remains shared with the model it was copied from,
+    /// while the kinematic and muscle caches become owned by this object.
+    /// Typical usage is one workspace per thread:
+    /// biorbd::Model workspace(model); workspace.detachWorkspace();
+    ///
+    void detachWorkspace();
+
 };
 
 }
@@ -176,6 +176,55 @@ public:
             const biorbd::utils::Path& path);
 #endif
 
+    ///
+    /// \brief Read a file of any of the supported formats containing the meshing of a segment
+    /// \param path The path of the file
+    /// \return Returns the mesh
+    ///
+    /// If MODULE_MESH_CACHE is defined, the mesh is loaded from its binary cache when the cache was written
+    /// from the same content of the file (see readMeshFileCache). Otherwise the file is parsed according
+    /// to its extension and the cache is written for the next loads. Only the meshes are cached, the rest
+    /// of the model is always read from the bioMod file
+    ///
+    static biorbd::rigidbody::Mesh readMeshFile(
+            const biorbd::utils::Path& path);
+
+    ///
+    /// \brief Read the binary cache of a mesh file
+    /// \param path The path of the mesh file (the cache is the same path followed by .bioMeshCache)
+    /// \param mesh The mesh (output)
+    /// \return If the cache exists, is of the current version and was written from the current content of the mesh file
+    ///
+    static bool readMeshFileCache(
+            const biorbd::utils::Path& path,
+            biorbd::rigidbody::Mesh& mesh);
+
+    ///
+    /// \brief Write the binary cache of a mesh file
+    /// \param path The path of the mesh file (the cache is the same path followed by .bioMeshCache)
+    /// \param mesh The mesh read from the file
+    /// \return If the cache could be written (the folder may be read-only)
+    ///
+    /// The cache is written to a temporary file of the same folder which is then renamed, so
+    /// processes loading the same mesh concurrently never see a partially written cache
+    ///
+    static bool writeMeshFileCache(
+            const biorbd::utils::Path& path,
+            const biorbd::rigidbody::Mesh& mesh);
+
+protected:
+    ///
+    /// \brief Compute the checksum of the content of a file
+    /// \param path The path of the file
+    /// \param size The size of the file in bytes (output)
+    /// \param checksum The 64 bits FNV-1a hash of the content of the file (output)
+    /// \return If the file could be read
+    ///
+    static bool fileChecksum(
+            const biorbd::utils::String& path,
+            unsigned long long& size,
+            unsigned long long& checksum);
+
 };
 
 }
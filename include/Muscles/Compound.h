@@ -74,6 +74,14 @@ public:
     void DeepCopy(
             const biorbd::muscles::Compound& other);
 
+    ///
+    /// \brief Give a shallow copy of a compound its own force workspace and path modifiers
+    ///
+    /// The path modifiers are copied since the wrapping objects store their last wrap. The name
+    /// remains shared with the compound it was copied from
+    ///
+    virtual void detachWorkspace();
+
     ///
     /// \brief Set the name of a muscle
     /// \param name Name of the muscle
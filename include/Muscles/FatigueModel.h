@@ -79,6 +79,11 @@ public:
     ///
     const biorbd::muscles::FatigueState& fatigueState() const;
 
+    ///
+    /// \brief Give a shallow copy of the fatigue model its own fatigue state
+    ///
+    void detachWorkspace();
+
 
 protected:
     std::shared_ptr<biorbd::muscles::FatigueState> m_fatigueState; ///< The fatigue state
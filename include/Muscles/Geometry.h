@@ -3,11 +3,13 @@
 
 #include <vector>
 #include <memory>
+#include <Eigen/Dense>
 #include "biorbdConfig.h"
 
 namespace biorbd {
 namespace utils {
 class Matrix;
+class String;
 class Vector;
 class Vector3d;
 }
@@ -164,7 +166,16 @@ public:
     ///
     /// Geometry (updateKin) must be computed at least once before calling. Return already computed via points
     ///
-    const std::vector<biorbd::utils::Vector3d>& musclesPointsInGlobal() const;
+    std::vector<biorbd::utils::Vector3d> musclesPointsInGlobal() const;
+
+    ///
+    /// \brief Return the muscles points in the global reference without creating a node for each of them
+    /// \return The muscle points in the global reference (3 x nbPoints)
+    ///
+    /// Geometry (updateKin) must be computed at least once before calling. Return already computed via points.
+    /// The points are plain coordinates, the origin being the first column and the insertion the last one
+    ///
+    const Eigen::Matrix3Xd& musclesPointsInGlobalInMatrix() const;
 
     ///
     /// \brief Return the previously computed muscle length
@@ -186,7 +197,11 @@ public:
 
     ///
     /// \brief Return the previously computed muscle jacobian
-    /// \return The muscle jacobian
+    /// \return The muscle jacobian (3*nbPoints x nbDof)
+    ///
+    /// The points of the path are stacked from the origin to the insertion, each one having a 3 x nbDof block
+    /// of rows. The columns are the degrees of freedom, not the frames as in the matrices of the whole trials
+    /// (e.g. the markers of all frames, which are 3*nbMarkers x nbFrames)
     ///
     const biorbd::utils::Matrix& jacobian() const;
 
@@ -214,7 +229,25 @@ public:
     /// \brief Return the jacobian length of the muscle
     /// \return The jacobian length
     ///
-    const biorbd::utils::Matrix& jacobianLength() const;
+    biorbd::utils::Matrix jacobianLength() const;
+
+    ///
+    /// \brief Write the muscle length jacobian in a row of a matrix shared with other muscles
+    /// \param jacobians The matrix of the muscle length jacobians (nbMuscles x nbDof)
+    /// \param row The row of the muscle in that matrix
+    ///
+    /// The matrix must already have its nbDof columns, it is then never resized by the geometry
+    ///
+    void bindJacobianLength(
+            const std::shared_ptr<biorbd::utils::Matrix>& jacobians,
+            unsigned int row);
+
+    ///
+    /// \brief Write the muscle length jacobian in the same row as another geometry
+    /// \param other The other geometry
+    ///
+    void bindJacobianLength(
+            const biorbd::muscles::Geometry& other);
 
 
 protected:
@@ -286,6 +319,13 @@ protected:
     double velocity(
             const biorbd::rigidbody::GeneralizedCoordinates &Qdot); 
 
+    ///
+    /// \brief Set the number of points in local and in global, reallocating only if it changed
+    /// \param nbPoints The number of points of the muscle path
+    ///
+    void resizePoints(
+            unsigned int nbPoints);
+
     ///
     /// \brief Set the jacobian dimensions
     /// \param model The joint model
@@ -310,21 +350,55 @@ protected:
             const biorbd::rigidbody::GeneralizedCoordinates &Q);
 
     ///
-    /// \brief Compute the muscle length jacobian
+    /// \brief Compute the muscle length jacobian (1 x nbDof) from the jacobian of the points of the path
     ///
     void computeJacobianLength();
 
+    ///
+    /// \brief Return the body id of the parent of a node, looking it up by name only when the parent changed
+    /// \param model The joint model
+    /// \param node The node
+    /// \param id The cached body id (-1 if not resolved yet)
+    /// \param version The parent version of the node the cached id was resolved from
+    /// \return The body id of the parent
+    ///
+    unsigned int parentBodyId(
+            biorbd::rigidbody::Joints &model,
+            const biorbd::utils::Vector3d &node,
+            int &id,
+            unsigned int &version);
+
+    ///
+    /// \brief Resolve the body id of the parent of each path modifier if the parents changed since the last call
+    /// \param model The joint model
+    /// \param pathModifiers The set of path modifiers
+    ///
+    void resolvePathModifiersParentId(
+            biorbd::rigidbody::Joints &model,
+            const biorbd::muscles::PathModifiers &pathModifiers);
+
     // Position des nodes dans le repere local
     std::shared_ptr<biorbd::utils::Vector3d> m_origin; ///< Origin node
     std::shared_ptr<biorbd::utils::Vector3d> m_insertion; ///< Insertion node
 
     std::shared_ptr<biorbd::utils::Vector3d> m_originInGlobal; ///< Position of the origin in the global reference
     std::shared_ptr<biorbd::utils::Vector3d> m_insertionInGlobal; ///< Position of the insertion node in the global reference
-    std::shared_ptr<std::vector<biorbd::utils::Vector3d>> m_pointsInGlobal; ///< Position of all the points in the global reference
-    std::shared_ptr<std::vector<biorbd::utils::Vector3d>> m_pointsInLocal; ///< Position of all the points in local
+    std::shared_ptr<Eigen::Matrix3Xd> m_pointsInGlobal; ///< Position of all the points in the global reference (3 x nbPoints)
+    std::shared_ptr<Eigen::Matrix3Xd> m_pointsInLocal; ///< Position of all the points in the reference of their parent (3 x nbPoints)
+    std::shared_ptr<biorbd::utils::Vector3d> m_originWrap; ///< Point on the wrapping related to the origin
+    std::shared_ptr<biorbd::utils::Vector3d> m_insertionWrap; ///< Point on the wrapping related to the insertion
+    std::shared_ptr<int> m_originParentId; ///< Body id of the parent of the origin (-1 if not resolved yet)
+    std::shared_ptr<int> m_insertionParentId; ///< Body id of the parent of the insertion (-1 if not resolved yet)
+    std::shared_ptr<unsigned int> m_originParentVersion; ///< Parent version of the origin m_originParentId was resolved from
+    std::shared_ptr<unsigned int> m_insertionParentVersion; ///< Parent version of the insertion m_insertionParentId was resolved from
+    std::shared_ptr<std::vector<unsigned int>> m_pathModifiersParentId; ///< Body id of the parent of each path modifier
+    std::shared_ptr<std::vector<unsigned int>> m_pathModifiersParentVersion; ///< Parent version each id of m_pathModifiersParentId was resolved from
+    std::shared_ptr<std::vector<unsigned int>> m_pointsParentId; ///< Body id of the parent of all the points in local
     std::shared_ptr<biorbd::utils::Matrix> m_jacobian; ///<The jacobian matrix
     std::shared_ptr<biorbd::utils::Matrix> m_G; ///< Internal matrix of the jacobian dimension to speed up calculation
-    std::shared_ptr<biorbd::utils::Matrix> m_jacobianLength; ///< The muscle length jacobian
+    std::shared_ptr<biorbd::utils::Matrix> m_jacobianLength; ///< The matrix the muscle length jacobian is written in (its own 1 x nbDof or the one of all the muscles of the model)
+    std::shared_ptr<unsigned int> m_jacobianLengthRow; ///< The row of m_jacobianLength of the muscle
+    std::shared_ptr<bool> m_isJacobianLengthBound; ///< If m_jacobianLength is the matrix of all the muscles of the model (which is then never resized by the geometry)
 
     std::shared_ptr<double> m_length; ///< Muscle length
     std::shared_ptr<double> m_muscleTendonLength; ///< Muscle tendon length
@@ -112,6 +112,12 @@ protected:
     ///
     virtual void setType();
 
+    ///
+    /// \brief Return the derivative of the Force-Length of the contractile element with respect to the activation
+    /// \return The derivative of the Force-Length of the contractile element (which does not depend on activation)
+    ///
+    virtual double FlCEActivationDerivative(const biorbd::muscles::State &);
+
 };
 
 }}
@@ -116,6 +116,11 @@ public:
     ///
     void DeepCopy(const biorbd::muscles::HillThelenTypeFatigable& other);
 
+    ///
+    /// \brief Give a shallow copy of a Hill-Thelen-type fatigable muscle its own workspace
+    ///
+    virtual void detachWorkspace();
+
     ///
     /// \brief Compute the Force-Length of the contractile element
     /// \param EMG EMG data
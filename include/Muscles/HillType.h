@@ -106,6 +106,11 @@ public:
     ///
     void DeepCopy(const biorbd::muscles::HillType& other);
 
+    ///
+    /// \brief Give a shallow copy of a Hill-type muscle its own workspace
+    ///
+    virtual void detachWorkspace();
+
     ///
     /// \brief Return the muscle force vector at origin and insertion
     /// \param emg The EMG data
@@ -168,6 +173,16 @@ public:
     ///
     double damping();
 
+    ///
+    /// \brief Return the derivative of the force with respect to the activation
+    /// \param emg The EMG data
+    /// \return The derivative of the force with respect to the activation
+    ///
+    /// The force must have been computed from the same EMG data beforehand
+    ///
+    virtual double forceActivationDerivative(
+            const biorbd::muscles::State &emg);
+
 protected:
     ///
     /// \brief Set type to Hill
@@ -184,6 +199,13 @@ protected:
     ///
     virtual void computeFlCE(const biorbd::muscles::StateDynamics &EMG); 
 
+    ///
+    /// \brief Return the derivative of the Force-Length of the contractile element with respect to the activation
+    /// \param emg The EMG data
+    /// \return The derivative of the Force-Length of the contractile element
+    ///
+    virtual double FlCEActivationDerivative(const biorbd::muscles::State &emg);
+
     ///
     /// \brief Compute the Force-Velocity of the contractile element
     ///
@@ -133,6 +133,14 @@ public:
             const biorbd::rigidbody::GeneralizedCoordinates& Q,
             const biorbd::muscles::StateDynamics& emg,
             int updateKin = 2);
+
+    ///
+    /// \brief Return the derivative of the force with respect to the activation
+    /// \param emg The EMG data
+    /// \return The derivative of the force with respect to the activation
+    ///
+    virtual double forceActivationDerivative(
+            const biorbd::muscles::State &emg);
 protected:
     ///
     /// \brief Function allowing modification of the way the multiplication is done in computeForce(EMG)
@@ -1,6 +1,7 @@
 #ifndef BIORBD_MUSCLES_H
 #define BIORBD_MUSCLES_H
 
+#include <Eigen/Dense>
 #include "biorbdConfig.h"
 #include "Muscles/Compound.h"
 
@@ -103,6 +104,13 @@ public:
     void DeepCopy(
             const biorbd::muscles::Muscle& other);
 
+    ///
+    /// \brief Give a shallow copy of a muscle its own geometry, state, path modifiers and force workspace
+    ///
+    /// The characteristics remain shared with the muscle it was copied from
+    ///
+    virtual void detachWorkspace();
+
     // Get and set
 
     ///
@@ -200,6 +208,15 @@ public:
     ///
     const biorbd::muscles::Geometry& position() const;
 
+    ///
+    /// \brief Write the muscle length jacobian in a row of a matrix shared with other muscles
+    /// \param jacobians The matrix of the muscle length jacobians (nbMuscles x nbDof)
+    /// \param row The row of the muscle in that matrix
+    ///
+    void bindJacobianLength(
+            const std::shared_ptr<biorbd::utils::Matrix>& jacobians,
+            unsigned int row);
+
     ///
     /// \brief Set the muscle characteristics
     /// \param val New value of the muscle characteristics
@@ -219,7 +236,7 @@ public:
     /// \param Q The generalized coordinates
     /// \return The muscle points in global reference frame
     ///
-    const std::vector<biorbd::utils::Vector3d>& musclesPointsInGlobal(
+    std::vector<biorbd::utils::Vector3d> musclesPointsInGlobal(
             biorbd::rigidbody::Joints &model,
             const biorbd::rigidbody::GeneralizedCoordinates &Q);
 
@@ -227,7 +244,13 @@ public:
     /// \brief Return the previously computed muscle points in global reference frame
     /// \return The muscle points in global reference frame
     ///
-    const std::vector<biorbd::utils::Vector3d>& musclesPointsInGlobal() const;
+    std::vector<biorbd::utils::Vector3d> musclesPointsInGlobal() const;
+
+    ///
+    /// \brief Return the previously computed muscle points in global reference frame without creating a node for each of them
+    /// \return The muscle points in global reference frame (3 x nbPoints)
+    ///
+    const Eigen::Matrix3Xd& musclesPointsInGlobalInMatrix() const;
 
     ///
     /// \brief Set the maximal isometric force
@@ -264,6 +287,16 @@ public:
     double activationDot(
             const biorbd::muscles::StateDynamics &state,
             bool alreadyNormalized = false);
+
+    ///
+    /// \brief Return the derivative of the force with respect to the activation
+    /// \param emg The EMG data
+    /// \return The derivative of the force with respect to the activation
+    ///
+    /// The force must have been computed from the same EMG data beforehand
+    ///
+    virtual double forceActivationDerivative(
+            const biorbd::muscles::State &emg) = 0;
 protected:
     ///
     /// \brief Computer the forces from a specific emg
@@ -63,6 +63,11 @@ public:
     void DeepCopy(
             const biorbd::muscles::MuscleGroup& other);
 
+    ///
+    /// \brief Give a shallow copy of a muscle group its own muscle workspaces
+    ///
+    void detachWorkspace();
+
     ///
     /// \brief To add a muscle to the group
     /// \param name The name of the muscle
@@ -20,6 +20,7 @@ class GeneralizedTorque;
 }
 
 namespace muscles {
+class Muscle;
 class MuscleGroup;
 class StateDynamics;
 class Force;
@@ -59,6 +60,16 @@ public:
     void DeepCopy(
             const biorbd::muscles::Muscles& other);
 
+    ///
+    /// \brief Give a shallow copy of the muscles its own muscle workspaces
+    ///
+    /// The characteristics of the muscles remain shared with the muscles they
+    /// were copied from, while their geometry, state and forces become owned
+    /// by this object. The copy can therefore be evaluated in another thread
+    /// than the original
+    ///
+    void detachWorkspace();
+
     ///
     /// \brief Add a muscle group to the set
     /// \param name The name of the muscle group
@@ -102,25 +113,51 @@ public:
     const biorbd::muscles::MuscleGroup& muscleGroup(
             const biorbd::utils::String& name) const;
 
+    ///
+    /// \brief Return a muscle from its index in the whole set
+    /// \param idx The index of the muscle, the muscles of each group following those of the previous group
+    /// \return The muscle
+    ///
+    biorbd::muscles::Muscle& muscle(
+            unsigned int idx);
+
+    ///
+    /// \brief Return a muscle from its index in the whole set
+    /// \param idx The index of the muscle, the muscles of each group following those of the previous group
+    /// \return The muscle
+    ///
+    const biorbd::muscles::Muscle& muscle(
+            unsigned int idx) const;
+
     ///
     /// \brief Update all the muscles (positions, jacobian, etc.)
     /// \param Q The generalized coordinates
     /// \param updateKin Update kinematics (0: don't update, 1:only muscles, [2: both kinematics and muscles])
+    /// \param nbThreads The number of threads to dispatch the muscles on (0 uses every core)
+    ///
+    /// The kinematics is updated once before the muscles, which only read it and can therefore be updated concurrently.
+    /// The muscle length jacobian of the model is sized before the muscles are dispatched, each of them then only writing its row
     ///
     void updateMuscles(
             const biorbd::rigidbody::GeneralizedCoordinates& Q,
-            bool updateKin); 
+            bool updateKin,
+            unsigned int nbThreads = 1);
 
     ///
     /// \brief Update all the muscles (positions, jacobian, etc.)
     /// \param Q The generalized coordinates
     /// \param QDot The generalized velocities
     /// \param updateKin Update kinematics (0: don't update, 1:only muscles, [2: both kinematics and muscles])
+    /// \param nbThreads The number of threads to dispatch the muscles on (0 uses every core)
+    ///
+    /// The kinematics is updated once before the muscles, which only read it and can therefore be updated concurrently.
+    /// The muscle length jacobian of the model is sized before the muscles are dispatched, each of them then only writing its row
     ///
     void updateMuscles(
             const biorbd::rigidbody::GeneralizedCoordinates& Q,
             const biorbd::rigidbody::GeneralizedCoordinates& QDot,
-            bool updateKin); 
+            bool updateKin,
+            unsigned int nbThreads = 1);
 
     ///
     /// \brief Update by hand all the muscles (positions, jacobian, velocity, etc.)
@@ -201,18 +238,41 @@ public:
             const biorbd::rigidbody::GeneralizedCoordinates* Q = nullptr,
             const biorbd::rigidbody::GeneralizedCoordinates* QDot = nullptr);
 
+    ///
+    /// \brief Compute the jacobian of the muscular joint torque with respect to the muscle activations
+    /// \param emg The dynamic state at which the derivative is computed
+    /// \param updateKin If the kinematics should be update or not
+    /// \param Q The generalized coordinates (not needed if updateKin is false)
+    /// \param QDot The generalized velocities (not needed if updateKin is false)
+    /// \return The jacobian (nbDof x nbMuscles)
+    ///
+    /// As the muscular joint torque is $\text{-J} \times \text{F(a)}$, its jacobian is
+    ///
+    /// i.e. $\text{-J} \times \text{diag(dF/da)}$
+    ///
+    /// where $J$ is the muscle lengths jacobian and $dF/da$ is the derivative of the force of each muscle with respect to its activation
+    ///
+    biorbd::utils::Matrix muscularJointTorqueActivationJacobian(
+            const std::vector<std::shared_ptr<StateDynamics>> &emg,
+            bool updateKin = true,
+            const biorbd::rigidbody::GeneralizedCoordinates* Q = nullptr,
+            const biorbd::rigidbody::GeneralizedCoordinates* QDot = nullptr);
+
     ///
     /// \brief Return the previously computed muscle length jacobian
-    /// \return The muscle length jacobian
+    /// \return The muscle length jacobian (nbMuscles x nbDof)
     ///
-    biorbd::utils::Matrix musclesLengthJacobian();
+    /// Each muscle writes its row in this matrix kept in the model when its geometry is updated,
+    /// so the rows of the muscles that were never updated are zero
+    ///
+    const biorbd::utils::Matrix& musclesLengthJacobian();
 
     ///
     /// \brief Compute and return the muscle length Jacobian
     /// \param Q The generalized coordinates
-    /// \return The muscle length Jacobian
+    /// \return The muscle length Jacobian (nbMuscles x nbDof)
     ///
-    biorbd::utils::Matrix musclesLengthJacobian(
+    const biorbd::utils::Matrix& musclesLengthJacobian(
             const biorbd::rigidbody::GeneralizedCoordinates& Q);
 
     ///
@@ -241,7 +301,27 @@ public:
     ///
     unsigned int nbMuscleTotal() const; 
 protected:
+    ///
+    /// \brief Make sure the muscle length jacobian has the dimension of the model
+    ///
+    void setMusclesLengthJacobianDimension();
+
+    ///
+    /// \brief Return the muscles of all the groups in a single array
+    /// \return The muscles, in the order of their group
+    ///
+    /// The array is built the first time it is needed after a muscle was added
+    ///
+    const std::vector<biorbd::muscles::Muscle*>& allMuscles() const;
+
+    ///
+    /// \brief Build the array of the muscles of all the groups and bind each of them to its row of the muscle length jacobian
+    ///
+    void indexMuscles() const;
+
     std::shared_ptr<std::vector<biorbd::muscles::MuscleGroup>> m_mus; ///< Holder for muscle groups
+    std::shared_ptr<std::vector<biorbd::muscles::Muscle*>> m_allMuscles; ///< The muscles of all the groups, pointing in m_mus
+    std::shared_ptr<biorbd::utils::Matrix> m_musclesLengthJacobian; ///< The muscle length jacobian, each muscle writing its own row
 
 };
 
@@ -0,0 +1,103 @@
+#ifndef BIORBD_MUSCLES_MUSCLES_INTEGRATOR_H
+#define BIORBD_MUSCLES_MUSCLES_INTEGRATOR_H
+
+#include <memory>
+#include <vector>
+#include "biorbdConfig.h"
+#include "RigidBody/Integrator.h"
+
+namespace biorbd {
+class Model;
+
+namespace muscles {
+class Muscle;
+class StateDynamics;
+
+///
+/// \brief Allow for integration of the kinematics driven by the muscles
+///
+/// The integrated state is composed of the generalized coordinates and velocities,
+/// followed by the activation of each muscle and by the active, fatigued and resting
+/// fibers of each muscle with a dynamic fatigue model (in the order of the muscles).
+/// The effectors are the normalized excitations of each muscle, which are assumed
+/// to be constant over all the integration
+///
+/// This integrator is used on its own, the integrator of the model (see integrateKinematics)
+/// being driven by generalized torques. The model is not modified by the integration, the
+/// right-hand side function being evaluated on a workspace of the model, so the fatigue states
+/// are only returned through the integrated states
+///
+class BIORBD_API MusclesIntegrator : public biorbd::rigidbody::Integrator
+{
+public:
+    ///
+    /// \brief Construct an integrator
+    /// \param model The musculoskeletal model (its muscles must already be added)
+    ///
+    MusclesIntegrator(
+            biorbd::Model& model);
+
+    ///
+    /// \brief Destroy the class properly
+    ///
+    virtual ~MusclesIntegrator();
+
+    ///
+    /// \brief Deep copy of integrator
+    /// \return Copy of integrator
+    ///
+    biorbd::muscles::MusclesIntegrator DeepCopy() const;
+
+    ///
+    /// \brief Deep copy of integrator in another object
+    /// \param other Integrator to copy
+    ///
+    void DeepCopy(
+            const biorbd::muscles::MusclesIntegrator& other);
+
+    ///
+    /// \brief Return the number of states that are integrated
+    /// \return The number of states
+    ///
+    virtual unsigned int nbStates() const;
+
+    ///
+    /// \brief Return the number of fatigue states that are integrated
+    /// \return The number of fatigue states (3 per muscle with a dynamic fatigue model)
+    ///
+    unsigned int nbFatigueStates() const;
+
+    ///
+    /// \brief The right-hand side function
+    /// \param x The generalized coordinates, velocities, muscle activations and fatigue states
+    /// \param dxdt The time derivative of x
+    /// \param t The time at which it is performed
+    ///
+    virtual void operator() (
+            const state_type &x,
+            state_type &dxdt,
+            double t);
+
+protected:
+    ///
+    /// \brief Prepare the buffers and the workspace of the model for the current model
+    ///
+    virtual void prepareBuffers();
+
+    biorbd::Model* m_musculoskeletalModel; ///< The musculoskeletal model
+    std::shared_ptr<biorbd::Model> m_workspace; ///< Workspace of the model on which the right-hand side function is evaluated
+    std::shared_ptr<std::vector<std::shared_ptr<biorbd::muscles::StateDynamics>>> m_states; ///< Buffer of the muscle states
+
+    ///
+    /// \brief Return if a muscle has fatigue states to integrate
+    /// \param muscle The muscle
+    /// \return If the muscle has a dynamic fatigue model
+    ///
+    static bool hasFatigueStates(
+            const biorbd::muscles::Muscle& muscle);
+
+};
+
+}}
+
+#endif // BIORBD_MUSCLES_MUSCLES_INTEGRATOR_H
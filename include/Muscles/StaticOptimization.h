@@ -122,13 +122,29 @@ public:
     /// \brief Deep copy of the static optimization
     /// \return A deep copy of the static optimization
     ///
+    /// The problems solved are not copied since they refer to the workspaces of this
+    /// optimization, so the copy must be run before its solution is asked
+    ///
     biorbd::muscles::StaticOptimization DeepCopy() const;
 
     ///
     /// \brief Run the static optimization
     /// \param useLinearizedState If use the algorithm should be run with the linearized approach (faster but less precise)
-    ///
-    void run(bool useLinearizedState = true);
+    /// \param nbThreads The number of threads to dispatch the frames on (0 uses every core)
+    /// \param isLinearSolverThreadSafe If the linear solver Ipopt is set to use (in ipopt.opt) can be run from many threads at once
+    ///
+    /// Each frame is initialized with the solution of the previous one. When
+    /// more than one thread is used, the trial is split into contiguous chunks
+    /// of frames, each chunk being solved in order on its own thread with its own
+    /// workspace of the model, starting from the initial activation guess. This
+    /// is only done if the linear solver is declared thread safe (e.g. one of the
+    /// HSL solvers built for it). Otherwise (MUMPS, the default, is not), a warning
+    /// is displayed and the frames are all solved in order on the calling thread.
+    ///
+    void run(
+            bool useLinearizedState = true,
+            unsigned int nbThreads = 1,
+            bool isLinearSolverThreadSafe = false);
     
     ///
     /// \brief Return the final solution
@@ -152,6 +168,7 @@ protected:
     std::shared_ptr<unsigned int> m_pNormFactor; ///< The p-norm factor
     std::shared_ptr<int> m_verbose; ///<Verbose level
     std::shared_ptr<std::vector<Ipopt::SmartPtr<Ipopt::TNLP>>> m_staticOptimProblem; ///<The static optimization problem
+    std::shared_ptr<std::vector<biorbd::Model>> m_workspaces; ///< The workspaces of the model used by the threads other than the calling one
     std::shared_ptr<bool> m_alreadyRun; ///< If already ran the static optimization
 
 };
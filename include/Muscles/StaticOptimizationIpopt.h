@@ -36,7 +36,7 @@ public:
     /// \param useResidual If use residual torque, if set to false, the optimization will fail if the model is not strong enough
     /// \param pNormFactor The p-norm to perform
     /// \param verbose Level of IPOPT verbose you want
-    /// \param eps The precision to perform the finite diffentiation
+    /// \param eps Deprecated, the constraints jacobian is analytical so it is ignored
     ///
     StaticOptimizationIpopt(
             biorbd::Model &model,
@@ -226,7 +226,6 @@ protected:
     std::shared_ptr<unsigned int> m_nbDof; ///< The number of degrees of freedom
     std::shared_ptr<unsigned int> m_nbTorque; ///< The number of torques to match
     std::shared_ptr<unsigned int> m_nbTorqueResidual; ///< The number of torque residual
-    std::shared_ptr<double> m_eps; ///< Precision of the finite differentiate
     std::shared_ptr<biorbd::utils::Vector> m_activations; ///< The activations
     std::shared_ptr<biorbd::rigidbody::GeneralizedCoordinates> m_Q; ///< The generalized coordinates
     std::shared_ptr<biorbd::rigidbody::GeneralizedCoordinates> m_Qdot; ///< The generalized velocities
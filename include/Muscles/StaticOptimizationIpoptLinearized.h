@@ -29,7 +29,7 @@ public:
     /// \param useResidual If use residual torque, if set to false, the optimization will fail if the model is not strong enough
     /// \param pNormFactor The p-norm to perform
     /// \param verbose Level of IPOPT verbose you want
-    /// \param eps The precision to perform the finite diffentiation
+    /// \param eps Deprecated, the constraints jacobian is analytical so it is ignored
     ///
     StaticOptimizationIpoptLinearized(
             biorbd::Model& model,
@@ -221,6 +221,7 @@ protected:
     std::shared_ptr<double> m_length; ///< Length of the cylinder
     std::shared_ptr<bool> m_isCylinderPositiveSign; ///<orientation of the muscle passing
     std::shared_ptr<biorbd::utils::RotoTrans> m_RTtoParent; ///<RotoTrans matrix with the parent
+    std::shared_ptr<int> m_parentIdx; ///< Index of the parent segment (-1 if not resolved yet)
 
     std::shared_ptr<biorbd::utils::Vector3d> m_p1Wrap; ///< First point of contact with the wrap
     std::shared_ptr<biorbd::utils::Vector3d> m_p2Wrap; ///< Second point of contact with the wrap
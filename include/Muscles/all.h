@@ -22,6 +22,7 @@
 #include "Muscles/MuscleGroup.h"
 #include "Muscles/Muscles.h"
 #include "Muscles/MusclesEnums.h"
+#include "Muscles/MusclesIntegrator.h"
 #include "Muscles/PathModifiers.h"
 #include "Muscles/State.h"
 #include "Muscles/StateDynamics.h"
@@ -218,6 +218,34 @@ public:
             const biorbd::rigidbody::GeneralizedCoordinates &Q,
             bool updateKin = true);
 
+    ///
+    /// \brief Compute the jacobian of all the inertial measurement units (IMU) in a single matrix
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobian of the IMU (9*nbIMUs x nbQdot) (output)
+    /// \param updateKin If the model should be updated
+    ///
+    /// The 9 rows of each IMU are the derivatives of the columns of its rotation matrix, one after the other.
+    /// The matrix is only resized if it does not have the right dimensions
+    ///
+    void IMUJacobian(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            biorbd::utils::Matrix &jacobian,
+            bool updateKin = true);
+
+    ///
+    /// \brief Compute the jacobian of the technical inertial measurement units (IMU) in a single matrix
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobian of the technical IMU (9*nbTechIMUs x nbQdot) (output)
+    /// \param updateKin If the model should be updated
+    ///
+    /// The 9 rows of each IMU are the derivatives of the columns of its rotation matrix, one after the other.
+    /// The matrix is only resized if it does not have the right dimensions
+    ///
+    void TechnicalIMUJacobian(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            biorbd::utils::Matrix &jacobian,
+            bool updateKin = true);
+
 protected:
 
     ///
@@ -231,6 +259,19 @@ protected:
             bool updateKin,
             bool lookForTechnical);
 
+    ///
+    /// \brief Compute the jacobian of the inertial measurement units (IMU) in a single matrix
+    /// \param Q The generalized coordinates
+    /// \param lookForTechnical If true, only computes for the technical IMU
+    /// \param jacobian The jacobian of the IMU (output)
+    /// \param updateKin If the model should be updated
+    ///
+    void IMUJacobianOfOneFrame(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            bool lookForTechnical,
+            biorbd::utils::Matrix &jacobian,
+            bool updateKin);
+
     std::shared_ptr<std::vector<biorbd::rigidbody::IMU>> m_IMUs; ///< All the inertial Measurement Units
 
 };
@@ -5,6 +5,7 @@
 #include <vector>
 #include <rbdl/Model.h>
 #include "biorbdConfig.h"
+#include "RigidBody/RigidBodyEnums.h"
 
 // The type of container used to hold the state vector
 typedef std::vector< double > state_type;
@@ -12,6 +13,7 @@ typedef std::vector< double > state_type;
 namespace biorbd {
 namespace utils {
 class Vector;
+class Matrix;
 }
 
 namespace rigidbody {
@@ -48,19 +50,76 @@ public:
     void DeepCopy(const biorbd::rigidbody::Integrator& other);
 
     ///
-    /// \brief Perform the integration from t0 to tend using a RK4
-    /// \param Q_Qdot Vector containing the initial generalized coordinates and velocities
+    /// \brief Set the stepper used by the integration
+    /// \param stepper The stepper
+    /// \param absTolerance The absolute error tolerance of the adaptive steppers
+    /// \param relTolerance The relative error tolerance of the adaptive steppers
+    ///
+    /// The adaptive steppers (RUNGE_KUTTA_DOPRI5 and RUNGE_KUTTA_CASH_KARP54) use the time step
+    /// as the initial guess only, and store the states at each accepted step
+    ///
+    void setStepper(
+            biorbd::rigidbody::INTEGRATOR_STEPPER stepper,
+            double absTolerance = 1e-6,
+            double relTolerance = 1e-6);
+
+    ///
+    /// \brief Return the stepper used by the integration
+    /// \return The stepper
+    ///
+    biorbd::rigidbody::INTEGRATOR_STEPPER stepper() const;
+
+    ///
+    /// \brief Return the absolute error tolerance of the adaptive steppers
+    /// \return The absolute error tolerance
+    ///
+    double absTolerance() const;
+
+    ///
+    /// \brief Return the relative error tolerance of the adaptive steppers
+    /// \return The relative error tolerance
+    ///
+    double relTolerance() const;
+
+    ///
+    /// \brief Perform the integration from t0 to tend using the selected stepper (RK4 by default)
+    /// \param Q_Qdot Vector containing the initial states (generalized coordinates and velocities, followed by the states added by the derived integrators)
     /// \param u Effectors to be used in the forward dynamics, it is assumed to be constant over all the integration
     /// \param t0 The initial time
     /// \param tend The final integration time
     /// \param timeStep Time step of the integration
+    /// \param storageDecimation Store the state every storageDecimation steps (0 only stores the final state)
+    ///
+    /// The final state is always stored, so memory stays bounded on long integrations if the states are decimated
     ///
     void integrate(
             const biorbd::utils::Vector& Q_Qdot,
             const biorbd::utils::Vector& u,
             double t0,
             double tend,
-            double timeStep);
+            double timeStep,
+            unsigned int storageDecimation = 1);
+
+    ///
+    /// \brief Integrate successive intervals, the effectors being constant over each of them
+    /// \param allU The effectors of every interval (nbQdot x nbIntervals at least)
+    /// \param firstU The column of the effectors of the first interval in allU
+    /// \param nbIntervals The number of intervals to integrate
+    /// \param timeStep The duration of each interval
+    /// \param allStates The states, the initial state being read from the column firstState (nbStates x firstState+nbIntervals+1 at least)
+    /// \param firstState The column of the initial state in allStates
+    ///
+    /// The state and the stepper are kept from one interval to another, the adaptive steppers carrying their
+    /// step size over, and the state at the end of each interval is written in the next column of allStates.
+    /// Nothing is stored in the integrator (see getX)
+    ///
+    void integrate(
+            const biorbd::utils::Matrix& allU,
+            unsigned int firstU,
+            unsigned int nbIntervals,
+            double timeStep,
+            biorbd::utils::Matrix& allStates,
+            unsigned int firstState);
 
     ///
     /// \brief The right-hand side function
@@ -73,6 +132,12 @@ public:
             state_type &dxdt,
             double t );
 
+    ///
+    /// \brief Return the number of states that are integrated
+    /// \return The number of states
+    ///
+    virtual unsigned int nbStates() const;
+
     ///
     /// \brief Return the Q and Qdot of an already performed integration at a given index
     /// \param idx The index of the step
@@ -94,8 +159,8 @@ public:
     void showAll();
 
     ///
-    /// \brief Return the number of steps performed
-    /// \return The number of steps
+    /// \brief Return the number of steps stored
+    /// \return The number of steps stored
     ///
     unsigned int steps() const;
 
@@ -109,6 +174,38 @@ protected:
     std::shared_ptr<std::vector<state_type>> m_x_vec; ///< Vector of x
     std::shared_ptr<std::vector<double>> m_times; ///< Vector of time
     std::shared_ptr<biorbd::utils::Vector> m_u; ///< Effectors
+    std::shared_ptr<unsigned int> m_storageDecimation; ///< Number of steps between two stored states (0 to only store the final state)
+    std::shared_ptr<biorbd::rigidbody::INTEGRATOR_STEPPER> m_stepper; ///< The stepper
+    std::shared_ptr<double> m_absTolerance; ///< Absolute error tolerance of the adaptive steppers
+    std::shared_ptr<double> m_relTolerance; ///< Relative error tolerance of the adaptive steppers
+
+    // Buffers of the right-hand side function so it does not allocate
+    std::shared_ptr<biorbd::rigidbody::GeneralizedCoordinates> m_Q; ///< Generalized coordinates buffer
+    std::shared_ptr<biorbd::rigidbody::GeneralizedCoordinates> m_Qdot; ///< Generalized velocities buffer
+    std::shared_ptr<biorbd::rigidbody::GeneralizedCoordinates> m_Qddot; ///< Generalized accelerations buffer
+
+    ///
+    /// \brief Prepare the buffers of the right-hand side function for the current model
+    ///
+    virtual void prepareBuffers();
+
+    ///
+    /// \brief Write the time derivative of the generalized coordinates from the velocities in the buffers
+    /// \param dxdt The time derivative of the state, whose first nbQ elements are written
+    ///
+    /// The velocities of the rotations expressed as quaternions are mapped to the rate of the components of the quaternion
+    ///
+    void coordinatesDerivative(
+            state_type &dxdt);
+
+    ///
+    /// \brief Move the generalized coordinates of a state for a time step with the velocities of that state
+    /// \param x The state
+    /// \param timeStep Time step (dt)
+    ///
+    void integrateCoordinates(
+            state_type &x,
+            double timeStep);
 
     ///
     /// \brief Launch integration
@@ -123,33 +220,58 @@ protected:
             double tend,
             double timeStep);
 
+    ///
+    /// \brief Integrate using a semi-implicit (symplectic) Euler
+    /// \param x Initial state
+    /// \param t0 Start time
+    /// \param tend End time
+    /// \param timeStep Time step (dt)
+    /// \return The number of steps performed
+    ///
+    /// The generalized velocities are updated first and the generalized coordinates
+    /// are then updated from the new velocities. The remaining states are updated
+    /// using an explicit Euler
+    ///
+    unsigned int integrateSymplecticEuler(
+            state_type& x,
+            double t0,
+            double tend,
+            double timeStep);
+
     ///
     /// \brief Structure containing the states and time
     ///
     struct push_back_state_and_time{
         std::vector< state_type >& m_states; ///< The states
         std::vector< double >& m_times; ///< The times
+        unsigned int m_decimation; ///< Number of steps between two stored states (0 to store none)
+        unsigned int m_count; ///< Number of steps observed so far
 
         ///
         /// \brief Store the states and times
         /// \param states A vector containing the states
         /// \param times A vector containing the times
+        /// \param decimation Number of steps between two stored states (0 to store none)
         ///
         push_back_state_and_time(
                 std::vector< state_type > &states ,
-                std::vector< double > &times )
-        : m_states( states ) , m_times( times ) { }
+                std::vector< double > &times,
+                unsigned int decimation = 1)
+        : m_states( states ) , m_times( times ), m_decimation( decimation ), m_count( 0 ) { }
 
         ///
-        /// \brief Append a state to the states
+        /// \brief Append a state to the states if it falls on the decimation
         /// \param x The state to append
         /// \param t The time
         ///
         void operator()(
                 const state_type &x ,
                 double t ){
-            m_states.push_back( x );
-            m_times.push_back( t );
+            if (m_decimation != 0 && m_count % m_decimation == 0){
+                m_states.push_back( x );
+                m_times.push_back( t );
+            }
+            ++m_count;
         }
     };
 
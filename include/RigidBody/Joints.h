@@ -2,9 +2,11 @@
 #define BIORBD_RIGIDBODY_JOINTS_H
 
 #include <memory>
+#include <functional>
 #include <rbdl/Model.h>
 #include <rbdl/Constraints.h>
 #include "biorbdConfig.h"
+#include "RigidBody/RigidBodyEnums.h"
 
 namespace biorbd {
 namespace utils {
@@ -61,6 +63,30 @@ public:
     void DeepCopy(
             const biorbd::rigidbody::Joints& other);
 
+    ///
+    /// \brief Give a shallow copy of the joints its own kinematic workspace
+    ///
+    /// The segments (and the rest of the model description) remain shared with
+    /// the joints it was copied from, while the kinematic cache and the integrator
+    /// become owned by this object. The copy can therefore be evaluated in another
+    /// thread than the original
+    ///
+    void detachWorkspace();
+
+    ///
+    /// \brief Update the kinematics for each frame of a trial and call a function on it
+    /// \param allQ The generalized coordinates (nbQ x nbFrames)
+    /// \param f The function to call as f(model, Q, frame), model being the joints (or one of its workspaces) which kinematics is updated at Q
+    /// \param nbThreads The number of threads to dispatch the frames on (0 uses every core)
+    ///
+    /// The frames are split in contiguous chunks, the first one being computed by this model and every other by its own workspace.
+    /// Apart from the creation of the workspaces, no allocation is done by this function
+    ///
+    void forEachFrame(
+            const biorbd::utils::Matrix &allQ,
+            const std::function<void(biorbd::rigidbody::Joints&, const RigidBodyDynamics::Math::VectorNd&, unsigned int)>& f,
+            unsigned int nbThreads = 1);
+
     /// 
     /// \brief Add a segment to the model
     /// \param segmentName Name of the segment
@@ -184,6 +210,23 @@ public:
     ///
     bool isRootActuated() const;
 
+    ///
+    /// \brief Set if the degrees of freedom of a segment are merged into a single joint when possible
+    /// \param mergeDofs If the degrees of freedom are merged
+    ///
+    /// Instead of a massless body per degree of freedom, the translations in the XYZ order and the rotations in
+    /// the XYZ, ZYX or YXZ Cardan sequences are each added as a single multi-DoF joint. The generalized coordinates
+    /// are not affected. It only applies to the segments that are added afterward
+    ///
+    void setMergeDofs(
+            bool mergeDofs);
+
+    ///
+    /// \brief Return if the degrees of freedom of a segment are merged into a single joint when possible
+    /// \return If the degrees of freedom are merged
+    ///
+    bool mergeDofs() const;
+
     ///
     /// \brief Set if the model to include external forces or not
     /// \param hasExternalForces If the model to include external forces or not
@@ -249,13 +292,65 @@ public:
             const biorbd::rigidbody::GeneralizedCoordinates *Qddot = nullptr);
 
     ///
-    /// \brief Evaluate the integration of the kinematics using a RK4 algorithm
+    /// \brief Set if the kinematics are only updated when the generalized coordinates, velocities or accelerations change
+    /// \param useCache If the kinematics cache is used
+    ///
+    /// When used, UpdateKinematicsCustom (and therefore every method called with updateKin=true) does nothing if
+    /// the requested states are the ones the kinematics were last updated with. Calling updateKin=false still skips
+    /// the update altogether. The RBDL functions called directly on the model bypass the cache, invalidateKinematicsCache
+    /// must therefore be called after them
+    ///
+    void setUseKinematicsCache(
+            bool useCache);
+
+    ///
+    /// \brief Return if the kinematics cache is used
+    /// \return If the kinematics cache is used
+    ///
+    bool useKinematicsCache() const;
+
+    ///
+    /// \brief Force the next kinematics update to be computed
+    ///
+    void invalidateKinematicsCache();
+
+    ///
+    /// \brief Return the number of kinematics updates that were skipped thanks to the cache
+    /// \return The number of cache hits
+    ///
+    unsigned int nbKinematicsCacheHits() const;
+
+    ///
+    /// \brief Return the number of kinematics updates that were actually computed while the cache is used
+    /// \return The number of cache misses
+    ///
+    unsigned int nbKinematicsCacheMisses() const;
+
+    ///
+    /// \brief Reset the cache hits and misses counters
+    ///
+    void resetKinematicsCacheCounters();
+
+    ///
+    /// \brief Set the stepper used to integrate the kinematics
+    /// \param stepper The stepper (RUNGE_KUTTA_4 by default)
+    /// \param absTolerance The absolute error tolerance of the adaptive steppers
+    /// \param relTolerance The relative error tolerance of the adaptive steppers
+    ///
+    void setIntegrationStepper(
+            biorbd::rigidbody::INTEGRATOR_STEPPER stepper,
+            double absTolerance = 1e-6,
+            double relTolerance = 1e-6);
+
+    ///
+    /// \brief Evaluate the integration of the kinematics using the stepper set by setIntegrationStepper
     /// \param Q The generalized coordinates
     /// \param QDot The generalized velocities
     /// \param torque The effectors assumed to be constant during the integration
     /// \param t0 Start time
     /// \param tend End time
-    /// \param timeStep The time step (dt)
+    /// \param timeStep The time step (dt), which is only the initial guess of the adaptive steppers
+    /// \param storageDecimation Store the kinematics every storageDecimation steps (0 only stores the final step)
     ///
     void integrateKinematics(
             const biorbd::rigidbody::GeneralizedCoordinates& Q,
@@ -263,7 +358,8 @@ public:
             const biorbd::rigidbody::GeneralizedTorque& torque,
             double t0,
             double tend,
-            double timeStep);
+            double timeStep,
+            unsigned int storageDecimation = 1);
 
     ///
     /// \brief Get the integrated kinematics after having computed it
@@ -277,10 +373,30 @@ public:
             biorbd::rigidbody::GeneralizedCoordinates& QDot);
 
     ///
-    /// \brief Return the number of iteration steps
-    /// \return The number of iteration steps
+    /// \brief Return the number of iteration steps stored
+    /// \return The number of iteration steps stored
     ///
     unsigned int nbInterationStep() const;
+
+    ///
+    /// \brief Integrate the kinematics of a batch of independent simulations in parallel
+    /// \param allQ_Qdot The initial generalized coordinates and velocities of each simulation ((nbQ + nbQdot) x nbSimulations)
+    /// \param allTorque The effectors of each simulation, held constant during each time step (nbQdot x (nbSteps * nbSimulations))
+    /// \param timeStep The time step (dt)
+    /// \param allStates The generalized coordinates and velocities of each simulation at each step ((nbQ + nbQdot) x ((nbSteps + 1) * nbSimulations)) (output)
+    /// \param nbThreads The number of threads to dispatch the simulations on (0 uses every core)
+    ///
+    /// The simulation i uses the columns [i*nbSteps, (i+1)*nbSteps) of allTorque and fills the columns
+    /// [i*(nbSteps+1), (i+1)*(nbSteps+1)) of allStates, starting with its initial state.
+    /// Each thread integrates with its own workspace and the stepper set by setIntegrationStepper,
+    /// taking the next simulation as soon as it is done. The integration stored in this model is left untouched
+    ///
+    void integrateKinematics(
+            const biorbd::utils::Matrix& allQ_Qdot,
+            const biorbd::utils::Matrix& allTorque,
+            double timeStep,
+            biorbd::utils::Matrix& allStates,
+            unsigned int nbThreads = 1);
     // -------------------------- //
 
 
@@ -302,6 +418,19 @@ public:
     ///
     std::vector<biorbd::utils::RotoTrans> allGlobalJCS() const;
 
+    ///
+    /// \brief Compute the joint coordinate system (JCS) in global reference frame for all the frames of a trial
+    /// \param allQ The generalized coordinates (nbQ x nbFrames)
+    /// \param allJCS The JCS (4*nbSegment x 4*nbFrames), the 4x4 block (i, j) being the segment i at frame j
+    /// \param nbThreads The number of threads to dispatch the frames on (0 uses every core)
+    ///
+    /// The output matrix is only resized if it does not have the right dimensions, so it can be reused from one trial to another
+    ///
+    void allGlobalJCS(
+            const biorbd::utils::Matrix &allQ,
+            biorbd::utils::Matrix &allJCS,
+            unsigned int nbThreads = 1);
+
     ///
     /// \brief Return the joint coordinate system (JCS) for the segment in global reference frame at a given Q
     /// \param Q The generalized coordinates
@@ -481,6 +610,20 @@ public:
             const biorbd::rigidbody::GeneralizedCoordinates &Q,
             bool updateKin=true);
 
+    ///
+    /// \brief Compute the position of the center of mass of each segment without creating a node for each of them
+    /// \param Q The generalized coordinates
+    /// \param CoM The position of the center of mass of each segment (3 x nbSegment)
+    /// \param updateKin If the kinematics of the model should be computed
+    ///
+    /// Each column is a segment, while CoMbySegmentAllFrames stacks the segments of a frame in a column (3*nbSegment x nbFrames).
+    /// The output matrix is only resized if it does not have the right dimensions, so it can be reused from one call to another
+    ///
+    void CoMbySegment(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            Eigen::Matrix3Xd &CoM,
+            bool updateKin=true);
+
     ///
     /// \brief Return the position of the center of mass of segment idx
     /// \param Q The generalized coordinates
@@ -493,6 +636,32 @@ public:
             const unsigned int idx,
             bool updateKin=true);
 
+    ///
+    /// \brief Compute the position of the center of mass for all the frames of a trial
+    /// \param allQ The generalized coordinates (nbQ x nbFrames)
+    /// \param allCoM The position of the center of mass (3 x nbFrames)
+    /// \param nbThreads The number of threads to dispatch the frames on (0 uses every core)
+    ///
+    /// The output matrix is only resized if it does not have the right dimensions, so it can be reused from one trial to another
+    ///
+    void CoM(
+            const biorbd::utils::Matrix &allQ,
+            biorbd::utils::Matrix &allCoM,
+            unsigned int nbThreads = 1);
+
+    ///
+    /// \brief Compute the position of the center of mass of each segment for all the frames of a trial
+    /// \param allQ The generalized coordinates (nbQ x nbFrames)
+    /// \param allCoM The position of the center of mass of each segment (3*nbSegment x nbFrames)
+    /// \param nbThreads The number of threads to dispatch the frames on (0 uses every core)
+    ///
+    /// The output matrix is only resized if it does not have the right dimensions, so it can be reused from one trial to another
+    ///
+    void CoMbySegmentAllFrames(
+            const biorbd::utils::Matrix &allQ,
+            biorbd::utils::Matrix &allCoM,
+            unsigned int nbThreads = 1);
+
     ///
     /// \brief Return the velocity of the center of mass 
     /// \param Q The generalized coordinates
@@ -578,6 +747,47 @@ public:
     ///
     biorbd::utils::Matrix CoMJacobian(
             const biorbd::rigidbody::GeneralizedCoordinates &Q); 
+
+    ///
+    /// \brief Compute the position, velocity, acceleration and jacobian of the center of mass in a single sweep
+    /// \param Q The generalized coordinates
+    /// \param Qdot The generalized velocities (only needed if updateKin is true and comDot or comDdot is requested)
+    /// \param Qddot The generalized accelerations (only needed if updateKin is true and comDdot is requested)
+    /// \param com The position of the center of mass (output)
+    /// \param comDot The velocity of the center of mass (output, not computed if nullptr)
+    /// \param comDdot The acceleration of the center of mass (output, not computed if nullptr)
+    /// \param jacobian The jacobian of the center of mass (3 x nbDof) (output, not computed if nullptr)
+    /// \param updateKin If the kinematics of the model should be computed
+    ///
+    /// Everything is computed from the body transformations, velocities and accelerations cached by the kinematics.
+    /// The jacobian is obtained from the mass of the subtree of each joint, which avoids computing a point jacobian per segment.
+    /// The jacobian is only resized if it does not have the right dimensions, so it can be reused from one call to another
+    ///
+    void CoMKinematics(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            const biorbd::rigidbody::GeneralizedCoordinates *Qdot,
+            const biorbd::rigidbody::GeneralizedCoordinates *Qddot,
+            biorbd::utils::Vector3d &com,
+            biorbd::utils::Vector3d *comDot = nullptr,
+            biorbd::utils::Vector3d *comDdot = nullptr,
+            biorbd::utils::Matrix *jacobian = nullptr,
+            bool updateKin = true);
+
+    ///
+    /// \brief Return the motion of a degree of freedom of a joint for a unit velocity, in the global reference frame
+    /// \param bodyId The RBDL id of the body the joint moves
+    /// \param dof The index of the degree of freedom in the joint
+    /// \param omega The angular velocity of the body (output)
+    /// \param velocity The velocity of the point of the body that coincides with the origin of the global reference frame (output)
+    ///
+    /// This function assumes kinematics has been already updated. The velocity of a point p moved by the joint is
+    /// velocity + omega x p, which gives the columns of a jacobian without computing it for the whole model
+    ///
+    void jointMotionInGlobal(
+            unsigned int bodyId,
+            unsigned int dof,
+            RigidBodyDynamics::Math::Vector3d &omega,
+            RigidBodyDynamics::Math::Vector3d &velocity) const;
     // ------------------------ //
 
 
@@ -615,6 +825,22 @@ public:
             bool updateKin = true
             );
 
+    ///
+    /// \brief Compute all the vertices of the mesh points in a matrix per segment
+    /// \param Q The generalized coordinates
+    /// \param points The vertices of each segment in the global reference frame (3 x nbVertex of the segment) (output)
+    /// \param updateKin If the kinematics of the model should be computed
+    /// \param nbThreads The number of threads to dispatch the segments on (0 uses every core)
+    ///
+    /// The vertices of a segment are transformed at once from their contiguous matrix (see Mesh::pointsInMatrix).
+    /// The matrices are only resized if they do not have the right dimensions
+    ///
+    void meshPointsInMatrix(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            std::vector<biorbd::utils::Matrix> &points,
+            bool updateKin = true,
+            unsigned int nbThreads = 1);
+
     ///
     /// \brief Return the mesh faces for all the segments
     /// \return The mesh faces for all the segments
@@ -726,6 +952,23 @@ public:
             RigidBodyDynamics::Math::MatrixNd &G,
             bool updateKin);
 
+    ///
+    /// \brief Fill the jacobian of a rotation matrix attached to a body in a block of 9 rows of a matrix
+    /// \param bodyId The RBDL id of the body the rotation matrix is attached to
+    /// \param rotation The rotation matrix in the reference frame of the body
+    /// \param G The matrix to fill (nbQdot columns)
+    /// \param firstRow The first of the 9 rows to fill
+    ///
+    /// This function assumes kinematics has been already updated. The rows are the derivatives of the columns
+    /// of the rotation matrix expressed in the global reference frame. Only the columns of the degrees of freedom
+    /// between the root and the body are written, the other ones are left untouched
+    ///
+    void rotationJacobianInGlobal(
+            unsigned int bodyId,
+            const RigidBodyDynamics::Math::Matrix3d &rotation,
+            RigidBodyDynamics::Math::MatrixNd &G,
+            unsigned int firstRow) const;
+
     ///
     /// \brief Compute the forward dynamics using the contact lagrangian algorithm
     /// \param Q The generalized coordinates
@@ -743,6 +986,26 @@ public:
             RigidBodyDynamics::ConstraintSet &CS,
             RigidBodyDynamics::Math::VectorNd &QDDot);
 
+    ///
+    /// \brief Compute the forward dynamics using the range-space contact algorithm
+    /// \param Q The generalized coordinates
+    /// \param Qdot The generalized velocities
+    /// \param torque The generalized torque
+    /// \param CS The constraint set (output)
+    /// \param QDDot The generalized acceleration (output)
+    ///
+    /// Instead of solving the whole (nbDof + nbContacts) system, the mass matrix is Cholesky factorized
+    /// and only the contact Schur complement (nbContacts x nbContacts) is solved. The buffers of the
+    /// constraint set are reused, CS.H being left as the mass matrix. The forces that
+    /// compensates for the contacts are stored in the constraint set variable
+    ///
+    void ForwardDynamicsContactsRangeSpace (
+            const RigidBodyDynamics::Math::VectorNd &Q,
+            const RigidBodyDynamics::Math::VectorNd &QDot,
+            const RigidBodyDynamics::Math::VectorNd &torque,
+            RigidBodyDynamics::ConstraintSet &CS,
+            RigidBodyDynamics::Math::VectorNd &QDDot);
+
     ///
     /// \brief Return the derivate of Q in function of Qdot (if not Quaternion, Qdot is directly returned)
     /// \param Q The generalized coordinates
@@ -767,8 +1030,17 @@ protected:
     std::shared_ptr<unsigned int> m_nRotAQuat; ///< The number of segments per quaternion
     std::shared_ptr<bool> m_isRootActuated; ///< If the root segment is controled or not
     std::shared_ptr<bool> m_hasExternalForces; ///< If the model includes external force
+    std::shared_ptr<bool> m_mergeDofs; ///< If the degrees of freedom of a segment are merged into a single joint when possible
     std::shared_ptr<bool> m_isKinematicsComputed; ///< If the kinematics are computed
     std::shared_ptr<double> m_totalMass; ///< Mass of all the bodies combined
+    std::shared_ptr<biorbd::utils::Matrix> m_subtreeCoM; ///< Mass weighted position (rows 0 to 2) and mass (row 3) of the subtree of each body, used by the CoM jacobian
+    std::shared_ptr<biorbd::utils::Matrix> m_contactPointJacobian; ///< Jacobian of a contact point (3 x nbDof), kept from one computation of the contacts system to another
+    std::shared_ptr<biorbd::utils::Matrix> m_massMatrixFactor; ///< Cholesky factor of the mass matrix (nbDof x nbDof) of the range-space contact solver, kept from one call to another
+    std::shared_ptr<bool> m_useKinematicsCache; ///< If the kinematics are only updated when the states change
+    std::shared_ptr<std::vector<biorbd::rigidbody::GeneralizedCoordinates>> m_kinematicsCache; ///< The Q, Qdot and Qddot the kinematics were last updated with
+    std::shared_ptr<std::vector<bool>> m_isKinematicsCacheValid; ///< If the cached Q, Qdot and Qddot are reflected by the kinematics
+    std::shared_ptr<unsigned int> m_nbKinematicsCacheHits; ///< The number of skipped kinematics updates
+    std::shared_ptr<unsigned int> m_nbKinematicsCacheMisses; ///< The number of computed kinematics updates while the cache is used
 
     ///
     /// \brief Calculate the joint coordinate system (JCS) in global reference frame of a specified segment
@@ -802,6 +1074,17 @@ protected:
             const std::vector<biorbd::utils::RotoTrans> &RT,
             unsigned int idx) const;
 
+    ///
+    /// \brief Compute the terms of the contact dynamics into the constraint set
+    /// \param Q The generalized coordinates
+    /// \param Qdot The generalized velocities
+    /// \param CS The constraint set in which the mass matrix (H), the nonlinear effects (C), the contact jacobian (G) and the contact accelerations (gamma) are stored (output)
+    ///
+    void computeContactsSystem(
+            const RigidBodyDynamics::Math::VectorNd &Q,
+            const RigidBodyDynamics::Math::VectorNd &QDot,
+            RigidBodyDynamics::ConstraintSet &CS);
+
 };
 
 }}
@@ -33,11 +33,19 @@ public:
         /// \param frequency The acquisition frequency express in Hertz
         /// \param noiseFactor The noise factor (on measurement matrix)
         /// \param errorFactor The error factor (on prediction matrix
+        /// \param initMaxIterations The maximal number of iterations of the fit done on the first frame
+        /// \param initTolerance The tolerance on the step of the fit done on the first frame
+        /// \param initFilterIterations The number of iterations of the filter done on the first frame once it is fitted
+        ///
+        /// The initialization parameters are only used by the reconstructions that fit their first frame (see KalmanReconsMarkers)
         /// 
         KalmanParam(
                 double frequency = 100,
                 double noiseFactor = 1e-10,
-                double errorFactor = 1e-5);
+                double errorFactor = 1e-5,
+                unsigned int initMaxIterations = 50,
+                double initTolerance = 1e-10,
+                unsigned int initFilterIterations = 10);
 
         ///
         /// \brief Return the acquisition frequency
@@ -54,10 +62,28 @@ public:
         ///
         double errorFactor() const;
 
+        ///
+        /// \brief Return the maximal number of iterations of the fit done on the first frame
+        ///
+        unsigned int initMaxIterations() const;
+
+        ///
+        /// \brief Return the tolerance on the step of the fit done on the first frame
+        ///
+        double initTolerance() const;
+
+        ///
+        /// \brief Return the number of iterations of the filter done on the first frame once it is fitted
+        ///
+        unsigned int initFilterIterations() const;
+
     private:
             double m_acquisitionFrequency; ///< The acquisition frequency
             double m_noiseFactor; ///< The noise factor
             double m_errorFactor; ///< The error factor
+            unsigned int m_initMaxIterations; ///< The maximal number of iterations of the initial fit
+            double m_initTolerance; ///< The tolerance on the step of the initial fit
+            unsigned int m_initFilterIterations; ///< The number of iterations of the filter on the first frame
     };
 
     // Constructor 
@@ -173,29 +199,37 @@ protected:
     biorbd::rigidbody::GeneralizedCoordinates initState(
             const unsigned int nbQ);
 
+    ///
+    /// \brief Compute the predicted state (m_xkm) from the previous estimated state
+    ///
+    /// The evolution matrix is made of scaled identity blocks (one per pair of derivative orders),
+    /// so the prediction is computed block by block instead of with the full matrix product
+    ///
+    void predictState();
+
     ///
     /// \brief Compute an iteration of the Kalman filter
     /// \param measure The vector actual measurement to track
     /// \param projectedMeasure The projected measurement from the update step of the filter
-    /// \param Hessian The hessian matrix
+    /// \param Hessian The hessian matrix (nbMeasure x 3*nbDof), only its columns of the generalized coordinates are used
     /// \param occlusion The vector where occlusionsoccurs
     ///
+    /// The occluded measurements are removed from the correction instead of being zeroed.
+    /// The innovation covariance is factorized by Cholesky in place. All the intermediate
+    /// matrices are kept from one iteration to another, so nothing is allocated as long as the number
+    /// of occlusions does not change
+    ///
     void iteration(
-            biorbd::utils::Vector measure,
+            const biorbd::utils::Vector &measure,
             const biorbd::utils::Vector &projectedMeasure,
             const biorbd::utils::Matrix &Hessian,
             const std::vector<unsigned int> &occlusion = std::vector<unsigned int>());
 
     ///
-    /// \brief Manage the occlusion during the iteration
-    /// \param InvTp The inverse of the Tp matrix
-    /// \param measure The vector actual measurement to track
-    /// \param occlusion The vector where occlusions occurs
+    /// \brief Return the number of measurements of a sensor, which are removed together when it is occluded
+    /// \return The number of measurements per sensor
     ///
-    virtual void manageOcclusionDuringIteration(
-            biorbd::utils::Matrix &InvTp,
-            biorbd::utils::Vector &measure,
-            const std::vector<unsigned int> &occlusion);
+    virtual unsigned int nbMeasurementsPerSensor() const;
 
     // Variables attributes
     std::shared_ptr<KalmanParam> m_params; ///< The parameters of the Kalman filter
@@ -210,6 +244,17 @@ protected:
     std::shared_ptr<biorbd::utils::Matrix> m_R; ///< Matrix of the noise on the measurements
     std::shared_ptr<biorbd::utils::Matrix> m_Pp; ///< Covariance matrix
 
+    // Buffers of the iteration
+    std::shared_ptr<biorbd::utils::Vector> m_xkm; ///< Predicted state
+    std::shared_ptr<biorbd::utils::Matrix> m_Pkm; ///< Predicted covariance matrix
+    std::shared_ptr<biorbd::utils::Matrix> m_APp; ///< Product of the evolution and the covariance matrices
+    std::shared_ptr<biorbd::utils::Matrix> m_Hvisible; ///< Hessian of the visible measurements with respect to the generalized coordinates
+    std::shared_ptr<biorbd::utils::Matrix> m_HPkm; ///< Product of the visible hessian and the predicted covariance, then its Cholesky solve
+    std::shared_ptr<biorbd::utils::Matrix> m_S; ///< Innovation covariance of the visible measurements, then its Cholesky factor
+    std::shared_ptr<biorbd::utils::Vector> m_innovation; ///< Innovation of the visible measurements
+    std::shared_ptr<std::vector<bool>> m_isOccluded; ///< If each measurement is occluded
+    std::shared_ptr<std::vector<unsigned int>> m_visibleMeasures; ///< The indices of the visible measurements
+
 };
 
 }}
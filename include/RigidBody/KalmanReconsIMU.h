@@ -96,18 +96,16 @@ protected:
     virtual void initialize();
 
     ///
-    /// \brief Manage the occlusion during the iteration
-    /// \param InvTp The inverse of the Tp matrix
-    /// \param measure The vector actual measurement to track
-    /// \param occlusion The vector where occlusions occurs
+    /// \brief Return the number of measurements of a sensor, which are removed together when it is occluded
+    /// \return The number of measurements per sensor (9 for the rotation matrix of an IMU)
     ///
-    virtual void manageOcclusionDuringIteration(
-            biorbd::utils::Matrix &InvTp,
-            biorbd::utils::Vector &measure,
-            const std::vector<unsigned int> &occlusion);
+    virtual unsigned int nbMeasurementsPerSensor() const;
 
     std::shared_ptr<biorbd::utils::Matrix> m_PpInitial; ///< Initial covariance matrix
     std::shared_ptr<bool> m_firstIteration; ///< If first iteration was done
+    std::shared_ptr<biorbd::utils::Matrix> m_IMUJacobian; ///< Buffer of the jacobian of the technical IMU
+    std::shared_ptr<biorbd::utils::Matrix> m_H; ///< Buffer of the jacobian of the measurements with respect to the states
+    std::shared_ptr<biorbd::utils::Vector> m_zest; ///< Buffer of the projected measurements
 };
 
 }}
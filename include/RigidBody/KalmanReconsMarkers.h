@@ -1,6 +1,7 @@
 #ifndef BIORBD_RIGIDBODY_KALMAN_RECONS_MARKERS_HPP
 #define BIORBD_RIGIDBODY_KALMAN_RECONS_MARKERS_HPP
 
+#include <Eigen/Dense>
 #include "biorbdConfig.h"
 #include "RigidBody/KalmanRecons.h"
 
@@ -101,12 +102,46 @@ public:
     ///
     virtual void reconstructFrame();
 
+    ///
+    /// \brief Reconstruct the kinematics of several trials, each trial being reconstructed on its own thread
+    /// \param model The joint model
+    /// \param trials The observed technical markers of each trial (3*nbTechnicalMarkers x nbFrames), each column being a column-major frame
+    /// \param allQ The generalized coordinates of each trial (nbQ x nbFrames) (output)
+    /// \param allQdot The generalized velocities of each trial (nbQdot x nbFrames) (output)
+    /// \param allQddot The generalized accelerations of each trial (nbQddot x nbFrames) (output)
+    /// \param durations The time spent to reconstruct each trial in seconds (output)
+    /// \param params The Kalman filter parameters
+    /// \param removeAxes If the algo should ignore or not the removeAxis defined in the bioMod file
+    /// \param nbThreads The number of threads to dispatch the trials on (0 uses every core)
+    ///
+    /// Each trial is reconstructed by its own filter, as if it was reconstructed on its own frame by frame.
+    /// The trials are handed to the threads as they become available, each thread working on its own
+    /// workspace of the model (see biorbd::Model::detachWorkspace). The output matrices are only resized
+    /// if they do not have the right dimensions
+    ///
+    static void reconstructTrials(
+            biorbd::Model &model,
+            const std::vector<biorbd::utils::Matrix> &trials,
+            std::vector<biorbd::utils::Matrix> &allQ,
+            std::vector<biorbd::utils::Matrix> &allQdot,
+            std::vector<biorbd::utils::Matrix> &allQddot,
+            std::vector<double> &durations,
+            biorbd::rigidbody::KalmanRecons::KalmanParam params = biorbd::rigidbody::KalmanRecons::KalmanParam(),
+            bool removeAxes=true,
+            unsigned int nbThreads = 1);
+
     ///
     /// \brief Return if the first iteration was done
     /// \return If the first iteration was done
     ///
     bool first();
 
+    ///
+    /// \brief Return the number of iterations the fit of the first frame took
+    /// \return The number of iterations of the fit of the first frame (0 if it was not done yet)
+    ///
+    unsigned int nbInitializationIterations() const;
+
 protected:
     ///
     /// \brief Initialization of the filter
@@ -114,18 +149,32 @@ protected:
     virtual void initialize();
 
     ///
-    /// \brief Manage the occlusion during the iteration
-    /// \param InvTp The inverse of the Tp matrix
-    /// \param measure The vector actual measurement to track
-    /// \param occlusion The vector where occlusions occurs
+    /// \brief Fit the generalized coordinates of the state to the technical markers of the first frame
+    /// \param model The joint model
+    /// \param Tobs The observed markers in a column-major vector
+    /// \param removeAxes If the algo should ignore or not the removeAxis defined in the bioMod file
+    ///
+    /// The fit is the inverse kinematics of the visible markers (see Markers::inverseKinematics), starting from the
+    /// generalized coordinates of the state (see setInitState). It stops when the step is smaller
+    /// than the tolerance or after the maximal number of iterations (see KalmanParam)
+    ///
+    void fitFirstFrame(
+            biorbd::Model &model,
+            const biorbd::utils::Vector &Tobs,
+            bool removeAxes);
+
+    ///
+    /// \brief Return the number of measurements of a sensor, which are removed together when it is occluded
+    /// \return The number of measurements per sensor (3 for the x, y and z of a marker)
     ///
-    virtual void manageOcclusionDuringIteration(
-            biorbd::utils::Matrix& InvTp,
-            biorbd::utils::Vector &measure,
-            const std::vector<unsigned int> &occlusion);
+    virtual unsigned int nbMeasurementsPerSensor() const;
 
-    std::shared_ptr<biorbd::utils::Matrix> m_PpInitial; ///< Initial covariance matrix
     std::shared_ptr<bool> m_firstIteration; ///< If first iteration was done
+    std::shared_ptr<unsigned int> m_nbInitializationIterations; ///< Number of iterations of the fit of the first frame
+    std::shared_ptr<Eigen::Matrix3Xd> m_projectedMarkers; ///< Buffer of the projected technical markers (3 x nbTechnicalMarkers)
+    std::shared_ptr<biorbd::utils::Matrix> m_markersJacobian; ///< Buffer of the jacobian of the technical markers
+    std::shared_ptr<biorbd::utils::Matrix> m_H; ///< Buffer of the jacobian of the measurements with respect to the states
+    std::shared_ptr<biorbd::utils::Vector> m_zest; ///< Buffer of the projected measurements
 };
 
 }}
@@ -3,16 +3,19 @@
 
 #include <memory>
 #include <vector>
+#include <Eigen/Dense>
 #include "biorbdConfig.h"
 
 namespace biorbd {
 namespace utils {
 class String;
 class Matrix;
+class Vector;
 }
 
 namespace rigidbody {
 class GeneralizedCoordinates;
+class Joints;
 class NodeSegment;
 
 ///
@@ -21,6 +24,79 @@ class NodeSegment;
 class BIORBD_API Markers
 {
 public:
+    ///
+    /// \brief Parameters of the inverse kinematics
+    ///
+    class BIORBD_API InverseKinematicsParam{
+    public:
+        ///
+        /// \brief Set the parameters of the inverse kinematics
+        /// \param maxIterations The maximal number of iterations per frame
+        /// \param tolerance The tolerance on the step (and on the gradient) to stop the iterations
+        /// \param removeAxis If there are axis to remove from the position variables
+        ///
+        InverseKinematicsParam(
+                unsigned int maxIterations = 100,
+                double tolerance = 1e-10,
+                bool removeAxis = true);
+
+        ///
+        /// \brief Set the weight of each technical marker in the least squares
+        /// \param weights The weights (nbTechnicalMarkers), an empty vector weighting each marker by 1
+        ///
+        void setWeights(
+                const std::vector<double>& weights);
+
+        ///
+        /// \brief Set the bounds of the generalized coordinates
+        /// \param lowerBounds The lower bounds (nbQ)
+        /// \param upperBounds The upper bounds (nbQ)
+        ///
+        /// Empty vectors leave the generalized coordinates unbounded
+        ///
+        void setBounds(
+                const std::vector<double>& lowerBounds,
+                const std::vector<double>& upperBounds);
+
+        ///
+        /// \brief Return the maximal number of iterations per frame
+        ///
+        unsigned int maxIterations() const;
+
+        ///
+        /// \brief Return the tolerance on the step (and on the gradient)
+        ///
+        double tolerance() const;
+
+        ///
+        /// \brief Return if there are axis to remove from the position variables
+        ///
+        bool removeAxis() const;
+
+        ///
+        /// \brief Return the weight of each technical marker (empty if they all weight 1)
+        ///
+        const std::vector<double>& weights() const;
+
+        ///
+        /// \brief Return the lower bounds of the generalized coordinates (empty if unbounded)
+        ///
+        const std::vector<double>& lowerBounds() const;
+
+        ///
+        /// \brief Return the upper bounds of the generalized coordinates (empty if unbounded)
+        ///
+        const std::vector<double>& upperBounds() const;
+
+    private:
+        unsigned int m_maxIterations; ///< The maximal number of iterations per frame
+        double m_tolerance; ///< The tolerance on the step
+        bool m_removeAxis; ///< If there are axis to remove from the position variables
+        std::vector<double> m_weights; ///< The weight of each technical marker
+        std::vector<double> m_lowerBounds; ///< The lower bounds of the generalized coordinates
+        std::vector<double> m_upperBounds; ///< The upper bounds of the generalized coordinates
+    };
+
     ///
     /// \brief Construct a marker set
     ///
@@ -161,6 +237,37 @@ public:
     std::vector<biorbd::rigidbody::NodeSegment> markers(
             bool removeAxis=true); 
 
+    ///
+    /// \brief Compute all the markers at a given Q in the global reference frame without creating a node for each of them
+    /// \param Q The generalized coordinates
+    /// \param markers The markers (3 x nbMarkers)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param updateKin If the model should be updated
+    ///
+    /// Each column is a marker, while markersAllFrames stacks the markers of a frame in a column (3*nbMarkers x nbFrames).
+    /// The output matrix is only resized if it does not have the right dimensions, so it can be reused from one call to another
+    ///
+    void markers(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            Eigen::Matrix3Xd &markers,
+            bool removeAxis=true,
+            bool updateKin = true);
+
+    ///
+    /// \brief Compute all the markers in the global reference frame for all the frames of a trial
+    /// \param allQ The generalized coordinates (nbQ x nbFrames)
+    /// \param allMarkers The markers (3*nbMarkers x nbFrames)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param nbThreads The number of threads to dispatch the frames on (0 uses every core)
+    ///
+    /// The output matrix is only resized if it does not have the right dimensions, so it can be reused from one trial to another
+    ///
+    void markersAllFrames(
+            const biorbd::utils::Matrix &allQ,
+            biorbd::utils::Matrix &allMarkers,
+            bool removeAxis=true,
+            unsigned int nbThreads = 1);
+
     ///
     /// \brief Return the velocity of a marker
     /// \param Q The generalized coordinates
@@ -212,6 +319,37 @@ public:
     std::vector<biorbd::rigidbody::NodeSegment> technicalMarkers(
             bool removeAxis=true);
 
+    ///
+    /// \brief Compute the technical markers at a given Q in the global reference frame without creating a node for each of them
+    /// \param Q The generalized coordinates
+    /// \param markers The technical markers (3 x nbTechnicalMarkers)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param updateKin If the model should be updated
+    ///
+    /// Each column is a marker, while technicalMarkersAllFrames stacks the markers of a frame in a column (3*nbTechnicalMarkers x nbFrames).
+    /// The output matrix is only resized if it does not have the right dimensions, so it can be reused from one call to another
+    ///
+    void technicalMarkers(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            Eigen::Matrix3Xd &markers,
+            bool removeAxis=true,
+            bool updateKin = true);
+
+    ///
+    /// \brief Compute the technical markers in the global reference frame for all the frames of a trial
+    /// \param allQ The generalized coordinates (nbQ x nbFrames)
+    /// \param allMarkers The technical markers (3*nbTechnicalMarkers x nbFrames)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param nbThreads The number of threads to dispatch the frames on (0 uses every core)
+    ///
+    /// The output matrix is only resized if it does not have the right dimensions, so it can be reused from one trial to another
+    ///
+    void technicalMarkersAllFrames(
+            const biorbd::utils::Matrix &allQ,
+            biorbd::utils::Matrix &allMarkers,
+            bool removeAxis=true,
+            unsigned int nbThreads = 1);
+
     ///
     /// \brief Return all the anatomical markers at a given Q in the global reference frame
     /// \param Q The generalized coordinates
@@ -303,6 +441,50 @@ public:
             bool removeAxis=true,
             bool updateKin = true);
 
+    ///
+    /// \brief Compute the jacobian of all the markers in a single matrix
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobian of the markers (3*nbMarkers x nbQdot), the rows of a marker following each other
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param updateKin If the model should be updated
+    ///
+    /// The matrix is only resized if it does not have the right dimensions. Only the columns of the degrees of freedom
+    /// between the root and the parent of each marker are filled (see markersJacobianSparsity)
+    ///
+    void markersJacobian(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            biorbd::utils::Matrix &jacobian,
+            bool removeAxis=true,
+            bool updateKin = true);
+
+    ///
+    /// \brief Compute the jacobian of the technical markers in a single matrix
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobian of the technical markers (3*nbTechnicalMarkers x nbQdot)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param updateKin If the model should be updated
+    ///
+    /// The matrix is only resized if it does not have the right dimensions. Only the columns of the degrees of freedom
+    /// between the root and the parent of each marker are filled (see technicalMarkersJacobianSparsity)
+    ///
+    void technicalMarkersJacobian(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            biorbd::utils::Matrix &jacobian,
+            bool removeAxis=true,
+            bool updateKin = true);
+
+    ///
+    /// \brief Return the columns of the jacobian of each marker that can be non-zero
+    /// \return The indices of the degrees of freedom that move each marker, in ascending order
+    ///
+    std::vector<std::vector<unsigned int>> markersJacobianSparsity();
+
+    ///
+    /// \brief Return the columns of the jacobian of each technical marker that can be non-zero
+    /// \return The indices of the degrees of freedom that move each technical marker, in ascending order
+    ///
+    std::vector<std::vector<unsigned int>> technicalMarkersJacobianSparsity();
+
     ///
     /// \brief Return the jacobian of a chosen marker
     /// \param Q The generalized coordinates of the model
@@ -324,6 +506,9 @@ public:
     /// \param Qinit The initial guess for the generalized coordinates
     /// \param Q The generalized coordinates that tracks the markers
     /// \param removeAxes If the markers should be projected on the axes
+    /// \return If the step or the gradient got under the tolerance, a stalled solver being reported as not converged
+    ///
+    /// The markers are the technical markers, they are tracked with inverseKinematics(markers, Q, residual, params)
     ///
     bool inverseKinematics(
             const std::vector<biorbd::rigidbody::NodeSegment>& markers,
@@ -331,7 +516,88 @@ public:
             biorbd::rigidbody::GeneralizedCoordinates &Q,
             bool removeAxes=true);
 
+    ///
+    /// \brief Performs an inverse kinematics on the technical markers of one frame
+    /// \param markers The technical markers to track in a column-major vector (3*nbTechnicalMarkers), the occluded ones being set to zero
+    /// \param Q The generalized coordinates, the initial guess on input and the solution on output
+    /// \param residual The root mean square distance between the visible markers and the model (output)
+    /// \param params The parameters of the inverse kinematics
+    /// \return The number of iterations
+    ///
+    /// The weighted squared distances of the visible markers are minimized by a Levenberg-Marquardt algorithm,
+    /// using the jacobian of the technical markers. If bounds are set, each step is projected on them.
+    /// The model must not have quaternions (nbQ == nbDof)
+    ///
+    unsigned int inverseKinematics(
+            const biorbd::utils::Vector& markers,
+            biorbd::rigidbody::GeneralizedCoordinates &Q,
+            double &residual,
+            const biorbd::rigidbody::Markers::InverseKinematicsParam& params = biorbd::rigidbody::Markers::InverseKinematicsParam());
+
+    ///
+    /// \brief Performs an inverse kinematics on the technical markers for all the frames of a trial
+    /// \param allMarkers The technical markers to track (3*nbTechnicalMarkers x nbFrames), the occluded ones being set to zero
+    /// \param Qinit The initial guess of the first frame of each chunk
+    /// \param allQ The generalized coordinates (nbQ x nbFrames) (output)
+    /// \param residuals The root mean square distance between the visible markers and the model for each frame (output)
+    /// \param nbIterations The number of iterations of each frame (output)
+    /// \param params The parameters of the inverse kinematics
+    /// \param nbThreads The number of threads to dispatch the frames on (0 uses every core)
+    ///
+    /// The trial is split into contiguous chunks of frames, one per thread. Each frame starts from the
+    /// solution of the previous frame of its chunk. The output matrix is only resized if it does not have
+    /// the right dimensions
+    ///
+    void inverseKinematics(
+            const biorbd::utils::Matrix& allMarkers,
+            const biorbd::rigidbody::GeneralizedCoordinates& Qinit,
+            biorbd::utils::Matrix &allQ,
+            std::vector<double> &residuals,
+            std::vector<unsigned int> &nbIterations,
+            const biorbd::rigidbody::Markers::InverseKinematicsParam& params = biorbd::rigidbody::Markers::InverseKinematicsParam(),
+            unsigned int nbThreads = 1);
+
 protected:
+    ///
+    /// \brief Return the body id of the parent of a marker
+    /// \param node The marker
+    /// \return The body id of the parent
+    ///
+    /// The id resolved when the marker was added is used, the name of the parent is only looked up if it is missing
+    ///
+    unsigned int parentBodyId(
+            const biorbd::rigidbody::NodeSegment& node);
+
+    ///
+    /// \brief Compute the markers in the global reference frame for one frame
+    /// \param Q The generalized coordinates
+    /// \param lookForTechnical If only the technical markers should be computed
+    /// \param markers The markers (3 x number of markers)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param updateKin If the model should be updated
+    ///
+    void markersOfOneFrame(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            bool lookForTechnical,
+            Eigen::Matrix3Xd &markers,
+            bool removeAxis,
+            bool updateKin);
+
+    ///
+    /// \brief Compute a subset of the markers in the global reference frame for all the frames of a trial
+    /// \param allQ The generalized coordinates (nbQ x nbFrames)
+    /// \param idx The indices of the markers to compute
+    /// \param allMarkers The markers (3*idx.size() x nbFrames)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param nbThreads The number of threads to dispatch the frames on (0 uses every core)
+    ///
+    void markersOfAllFrames(
+            const biorbd::utils::Matrix &allQ,
+            const std::vector<unsigned int>& idx,
+            biorbd::utils::Matrix &allMarkers,
+            bool removeAxis,
+            unsigned int nbThreads);
+
     ///
     /// \brief Compute the jacobian of the markers
     /// \param Q The generalized coordinates
@@ -346,6 +612,66 @@ protected:
             bool updateKin,
             bool lookForTechnical); // Retourne la jacobienne des markers
 
+    ///
+    /// \brief Compute the jacobian of the markers in a single matrix
+    /// \param Q The generalized coordinates
+    /// \param lookForTechnical If only the technical markers should be computed
+    /// \param jacobian The jacobian of the markers (3*number of markers x nbQdot)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param updateKin If the model should be updated
+    ///
+    void markersJacobianOfOneFrame(
+            const biorbd::rigidbody::GeneralizedCoordinates &Q,
+            bool lookForTechnical,
+            biorbd::utils::Matrix &jacobian,
+            bool removeAxis,
+            bool updateKin);
+
+    ///
+    /// \brief Return the columns of the jacobian of the markers that can be non-zero
+    /// \param lookForTechnical If only the technical markers should be considered
+    /// \return The indices of the degrees of freedom that move each marker, in ascending order
+    ///
+    std::vector<std::vector<unsigned int>> markersJacobianSparsity(
+            bool lookForTechnical);
+
+    ///
+    /// \brief Express the technical markers in the movable body they are attached to
+    /// \param bodyId The RBDL id of the movable body of each technical marker (output)
+    /// \param local The position of each technical marker in its movable body (3 x nbTechnicalMarkers) (output)
+    /// \param removeAxis If there are axis to remove from the position variables
+    ///
+    void technicalMarkersInMovableBodies(
+            std::vector<unsigned int>& bodyId,
+            biorbd::utils::Matrix& local,
+            bool removeAxis);
+
+    ///
+    /// \brief Performs an inverse kinematics on one frame
+    /// \param model The joint model to work on (possibly a workspace of this model)
+    /// \param bodyId The RBDL id of the movable body of each technical marker (see technicalMarkersInMovableBodies)
+    /// \param local The position of each technical marker in its movable body (see technicalMarkersInMovableBodies)
+    /// \param markers The technical markers to track in a column-major vector
+    /// \param params The parameters of the inverse kinematics
+    /// \param Q The generalized coordinates, the initial guess on input and the solution on output
+    /// \param residual The root mean square distance between the visible markers and the model (output)
+    /// \param isConverged If the step or the gradient got under the tolerance (output)
+    /// \param jacobian Buffer of the weighted jacobian of the markers
+    /// \param error Buffer of the weighted distances between the markers and the model
+    /// \return The number of iterations
+    ///
+    static unsigned int inverseKinematicsOfOneFrame(
+            biorbd::rigidbody::Joints& model,
+            const std::vector<unsigned int>& bodyId,
+            const biorbd::utils::Matrix& local,
+            const biorbd::utils::Vector& markers,
+            const biorbd::rigidbody::Markers::InverseKinematicsParam& params,
+            biorbd::rigidbody::GeneralizedCoordinates &Q,
+            double &residual,
+            bool &isConverged,
+            biorbd::utils::Matrix &jacobian,
+            biorbd::utils::Vector &error);
+
     std::shared_ptr<std::vector<biorbd::rigidbody::NodeSegment>> m_marks; ///< The markers
 
 };
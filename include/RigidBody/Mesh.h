@@ -9,6 +9,7 @@
 namespace biorbd {
 namespace utils {
 class Vector3d;
+class Matrix;
 class Path;
 }
 
@@ -76,6 +77,15 @@ public:
     ///
     unsigned int nbVertex() const;
 
+    ///
+    /// \brief Return all the vertices in a single matrix
+    /// \return The vertices (3 x nbVertex), each column being a vertex
+    ///
+    /// The matrix is built the first time it is asked and after points were added, so the vertices can
+    /// be transformed all at once
+    ///
+    const biorbd::utils::Matrix& pointsInMatrix() const;
+
     ///
     /// \brief Add a face patch to the mesh
     /// \param face The face patch to add
@@ -124,6 +134,7 @@ public:
 
 protected:
     std::shared_ptr<std::vector<biorbd::utils::Vector3d>> m_vertex; ///< The vertex
+    std::shared_ptr<biorbd::utils::Matrix> m_vertexInMatrix; ///< The vertex in a contiguous matrix (3 x nbVertex)
     std::shared_ptr<std::vector<biorbd::rigidbody::MeshFace>> m_faces; ///< The faces
     std::shared_ptr<biorbd::utils::Path> m_pathFile; ///< The path to the mesh file
 };
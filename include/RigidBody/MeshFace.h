@@ -44,6 +44,12 @@ public:
     ///
     int &operator() (int idx);
 
+    ///
+    /// \brief Allows to get using ()
+    /// \param idx The index in the vector
+    ///
+    int operator() (int idx) const;
+
     ///
     /// \brief set the MeshFace from a new point
     /// \param pts The new point to copy
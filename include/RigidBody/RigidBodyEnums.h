@@ -4,6 +4,34 @@
 namespace biorbd {
 namespace rigidbody {
 
+///
+/// \brief The available steppers of the integrator
+///
+enum INTEGRATOR_STEPPER {
+    RUNGE_KUTTA_4,
+    RUNGE_KUTTA_DOPRI5,
+    RUNGE_KUTTA_CASH_KARP54,
+    SYMPLECTIC_EULER
+};
+
+///
+/// \brief INTEGRATOR_STEPPER_toStr returns the stepper name in a string format
+/// \param stepper The stepper to convert to string
+/// \return The name of the stepper
+///
+inline const char* INTEGRATOR_STEPPER_toStr(
+        biorbd::rigidbody::INTEGRATOR_STEPPER stepper)
+{
+    switch (stepper)
+    {
+    case RUNGE_KUTTA_4: return "RungeKutta4";
+    case RUNGE_KUTTA_DOPRI5: return "RungeKuttaDopri5";
+    case RUNGE_KUTTA_CASH_KARP54: return "RungeKuttaCashKarp54";
+    case SYMPLECTIC_EULER: return "SymplecticEuler";
+    default: return "NoStepper";
+    }
+}
+
 }}
 
 #endif // BIORBD_RIGIDBODY_ENUMS_H
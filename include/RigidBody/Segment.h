@@ -292,8 +292,16 @@ protected:
 
     ///
     /// \brief Determine the rotation axis in relation to the requested sequence
+    /// \param mergeDofs If the translations and the rotations are each merged into a single joint when possible
     ///
-    virtual void setJointAxis();
+    virtual void setJointAxis(
+            bool mergeDofs);
+
+    ///
+    /// \brief Return the RBDL joint type equivalent to the rotation sequence
+    /// \return The joint type (JointTypeUndefined if there is no equivalent)
+    ///
+    RigidBodyDynamics::JointType cardanJointType() const;
 
     std::shared_ptr<std::vector<unsigned int>> m_dofPosition;  ///< Position in the x, y, and z sequence
 
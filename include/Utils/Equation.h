@@ -39,22 +39,78 @@ public:
     Equation(const std::basic_string<char> &string);
 
     ///
-    /// \brief Split equation into smaller parts, down to number or math symbols
-    /// \param wholeEq The whole equation to split
-    /// \param variables The set of variables in the equation
-    /// \return The split equation
+    /// \brief Operation of a compiled equation, applied on a stack of values
     ///
-    static std::vector<biorbd::utils::Equation> splitIntoEquation(
-            biorbd::utils::Equation wholeEq,
-            const std::map<biorbd::utils::Equation, double>& variables);
+    struct Operation {
+        ///
+        /// \brief The type of the operation
+        ///
+        enum Type {
+            VALUE, ///< Push a constant value
+            VARIABLE, ///< Push the value of a variable
+            ADD, ///< Pop two values and push their sum
+            SUBTRACT, ///< Pop two values and push their difference
+            MULTIPLY, ///< Pop two values and push their product
+            DIVIDE, ///< Pop two values and push their ratio
+            NEGATE ///< Pop a value and push its opposite
+        };
+        Type type; ///< The type of the operation
+        double value; ///< The value pushed by a VALUE operation
+        unsigned int variable; ///< The index of the name of the variable pushed by a VARIABLE operation
+    };
 
     ///
-    /// \brief Evaluate and return an equation
-    /// \param wholeEq The already split equation to evaluate
+    /// \brief Read the equation as a plain number
+    /// \param value The number (output)
+    /// \return If the whole equation is a number
+    ///
+    bool isNumber(
+            double& value) const;
+
+    ///
+    /// \brief Read a number at the start of a string, the decimal separator being a dot whatever the locale
+    /// \param start The start of the number
+    /// \param value The number (output)
+    /// \return The position after the number, start if it does not begin with a number
+    ///
+    /// Only decimal numbers are read: a sign, digits with an optional dot and an optional exponent
+    ///
+    static const char* readNumber(
+            const char* start,
+            double& value);
+
+    ///
+    /// \brief Compile the equation into operations that can be evaluated without parsing it again
+    /// \param operations The operations in reverse polish order (output)
+    /// \param variableNames The names of the variables, indexed by the VARIABLE operations (output)
+    ///
+    /// The supported symbols are, in the order of operation:
+    ///
+    /// \begin{itemize}
+    /// \item "(" and ")" -- Parentheses
+    /// \item "-" and "+" -- Sign of a value
+    /// \item "*" and "/" -- Multiplication and division
+    /// \item "+" and "-" -- Addition and subtraction
+    /// \end{itemize}
+    ///
+    /// The values are numbers (1e2 being 1x10^2), the constant pi and the variables (which start with a $).
+    /// An error is raised if the equation cannot be parsed
+    ///
+    void compile(
+            std::vector<Operation>& operations,
+            std::vector<biorbd::utils::Equation>& variableNames) const;
+
+    ///
+    /// \brief Evaluate a compiled equation
+    /// \param operations The operations of the equation (see compile)
+    /// \param variableNames The names of the variables used by the operations
+    /// \param variables The values of the variables
     /// \return The evaluated equation
     ///
-    static double evaluateEquation(
-            std::vector<biorbd::utils::Equation> wholeEq);
+    static double evaluate(
+            const std::vector<Operation>& operations,
+            const std::vector<biorbd::utils::Equation>& variableNames,
+            const std::map<biorbd::utils::Equation, double>& variables);
 
     ///
     /// \brief Evaluate and return an equation
@@ -62,7 +118,7 @@ public:
     /// \return The evaluated equation
     ///
     static double evaluateEquation(
-            biorbd::utils::Equation wholeEq);
+            const biorbd::utils::Equation& wholeEq);
 
     ///
     /// \brief Evaluate and return an equation
@@ -70,59 +126,41 @@ public:
     /// \param variables The variables in the equation
     /// \return The evaluated equation
     ///
+    /// Plain numbers are read directly, other equations are compiled then evaluated
+    ///
     static double evaluateEquation(
-            biorbd::utils::Equation wholeEq,
+            const biorbd::utils::Equation& wholeEq,
             const std::map<biorbd::utils::Equation, double>& variables);
 
+protected:
     ///
-    /// \brief Replace constants in the split equation by a number
-    /// \param eq The split equation
-    ///
-    /// The supported constants are:
-    ///
-    /// \begin{itemize}
-    /// \item pi -- that evaluates to M_PI, that is $3.14159265358979323846$ on UNIX
-    /// \end{itemize}
+    /// \brief Compile the operations of a sum or a product, starting at a position of the equation
+    /// \param pos The position in the equation (moved after the expression)
+    /// \param minPrecedence The lowest precedence of the operators that are part of the expression
+    /// \param operations The operations (output)
+    /// \param variableNames The names of the variables (output)
     ///
-    static void replaceCste(
-            std::vector<biorbd::utils::Equation> &eq);
+    void compileExpression(
+            size_t& pos,
+            unsigned int minPrecedence,
+            std::vector<Operation>& operations,
+            std::vector<biorbd::utils::Equation>& variableNames) const;
 
     ///
-    /// \brief Replace the varirables in the equation by their values
-    /// \param eq The equation to replace the variables
-    /// \param variables The variable set
+    /// \brief Compile a signed value, a variable or an expression in parentheses, starting at a position of the equation
+    /// \param pos The position in the equation (moved after the operand)
+    /// \param operations The operations (output)
+    /// \param variableNames The names of the variables (output)
     ///
-    static void replaceVar(
-            biorbd::utils::Equation &eq,
-            const std::map<biorbd::utils::Equation, double>& variables);
-
-protected:
-    ///
-    /// \brief Resolve the equation
-    /// \param eq The equation to resolve
-    /// \param math The mathematical symbol that is being evaluated now
-    /// 
-    static double evaluateEquation(
-            std::vector<biorbd::utils::Equation> eq,
-            unsigned int math);
+    void compileOperand(
+            size_t& pos,
+            std::vector<Operation>& operations,
+            std::vector<biorbd::utils::Equation>& variableNames) const;
 
     ///
-    /// \brief Prepare the mathematical symbols
-    /// \return The math symbols in an order that respect the order of operation
-    ///
-    /// The supported symbols are:
-    ///
-    /// \begin{itemize}
-    /// \item "(" -- Open a parenthese
-    /// \item ")" -- Close a parenthese
-    /// \item "e" -- value of the format 1e2 (i.e. 1x10^2)
-    /// \item "/" -- Division
-    /// \item "*" -- Multiplication
-    /// \item "+" -- Addition
-    /// \item "-" -- Subtraction, or negative number if it starts the equation
-    /// \end{itemize}
+    /// \brief Raise an error saying the equation cannot be parsed
     ///
-    static std::vector<biorbd::utils::Equation> prepareMathSymbols();
+    void raiseParsingError() const;
 };
 
 }}
@@ -77,6 +77,15 @@ public:
     void setParent(
             const biorbd::utils::String &name);
 
+    ///
+    /// \brief Return the number of times the parent of the node was changed
+    /// \return The version of the parent
+    ///
+    /// Shallow copies share it with the parent name, so whatever looked up the parent
+    /// can tell with a single comparison whether it needs to look it up again
+    ///
+    unsigned int parentVersion() const;
+
     ///
     /// \brief Return the type of node
     ///
@@ -90,6 +99,7 @@ protected:
 
     std::shared_ptr<biorbd::utils::String> m_name; ///< The name of the node
     std::shared_ptr<biorbd::utils::String> m_parentName; ///< The parent name of the node
+    std::shared_ptr<unsigned int> m_parentVersion; ///< Incremented each time the parent name changes
     std::shared_ptr<biorbd::utils::NODE_TYPE> m_typeOfNode;///< The type of the node
 
 };
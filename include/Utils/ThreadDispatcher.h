@@ -0,0 +1,89 @@
+#ifndef BIORBD_UTILS_THREAD_DISPATCHER_H
+#define BIORBD_UTILS_THREAD_DISPATCHER_H
+
+#include <functional>
+#include "biorbdConfig.h"
+
+namespace biorbd {
+namespace utils {
+
+///
+/// \brief Dispatch a range of independent tasks on a set of threads
+///
+/// The range of tasks is split into contiguous chunks, one per thread. The
+/// first chunk is run by the calling thread. The other threads are launched at
+/// each call and joined before it returns, nothing is kept alive in between.
+/// Each thread must therefore own the objects it writes to (see biorbd::Model::detachWorkspace)
+///
+class BIORBD_API ThreadDispatcher
+{
+public:
+    ///
+    /// \brief Construct a thread dispatcher
+    /// \param nbThreads The number of threads to use (0 uses the number of concurrent threads supported by the machine)
+    ///
+    ThreadDispatcher(
+            unsigned int nbThreads = 0);
+
+    ///
+    /// \brief Set the number of threads
+    /// \param nbThreads The number of threads to use (0 uses the number of concurrent threads supported by the machine)
+    ///
+    void setNbThreads(
+            unsigned int nbThreads);
+
+    ///
+    /// \brief Return the number of threads
+    /// \return The number of threads
+    ///
+    unsigned int nbThreads() const;
+
+    ///
+    /// \brief Return the number of chunks a range of tasks is split into
+    /// \param nbTasks The number of tasks
+    /// \return The number of chunks (which is also the number of threads actually launched)
+    ///
+    unsigned int nbChunks(
+            unsigned int nbTasks) const;
+
+    ///
+    /// \brief Run a range of tasks and wait for all of them to be completed
+    /// \param nbTasks The number of tasks
+    /// \param task The function to call for each chunk as task(chunkIdx, firstTask, lastTask) with lastTask excluded
+    ///
+    /// If a task throws, the first exception is rethrown once every thread is joined
+    ///
+    void run(
+            unsigned int nbTasks,
+            const std::function<void(unsigned int, unsigned int, unsigned int)>& task) const;
+
+    ///
+    /// \brief Run a range of tasks of uneven cost and wait for all of them to be completed
+    /// \param nbTasks The number of tasks
+    /// \param task The function to call for each task as task(threadIdx, taskIdx)
+    ///
+    /// Instead of being split beforehand, the tasks are handed one at a time to the
+    /// first thread available. The thread 0 is the calling thread. If a task throws,
+    /// the first exception is rethrown once every thread is joined
+    ///
+    void runDynamic(
+            unsigned int nbTasks,
+            const std::function<void(unsigned int, unsigned int)>& task) const;
+
+protected:
+    unsigned int m_nbThreads; ///< The number of threads
+
+    ///
+    /// \brief Call a job on each thread and wait for all of them to be completed
+    /// \param nThreads The number of threads
+    /// \param job The function to call as job(threadIdx), job(0) being called by the calling thread
+    ///
+    void dispatch(
+            unsigned int nThreads,
+            const std::function<void(unsigned int)>& job) const;
+
+};
+
+}}
+
+#endif // BIORBD_UTILS_THREAD_DISPATCHER_H
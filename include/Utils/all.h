@@ -13,6 +13,7 @@
 #include "Utils/RotoTrans.h"
 #include "Utils/RotoTransNode.h"
 #include "Utils/String.h"
+#include "Utils/ThreadDispatcher.h"
 #include "Utils/Timer.h"
 #include "Utils/UtilsEnum.h"
 #include "Utils/Vector.h"
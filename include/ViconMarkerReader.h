@@ -0,0 +1,138 @@
+#ifndef BIORBD_VICON_MARKER_READER_H
+#define BIORBD_VICON_MARKER_READER_H
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <iostream>
+#include "biorbdConfig.h"
+
+namespace biorbd {
+namespace utils {
+class Matrix;
+class Path;
+class String;
+}
+
+///
+/// \brief Reader of a Vicon ASCII marker file (CSV formated) that streams the frames by blocks
+///
+/// The frames are read as they are needed, so the whole file never has to be loaded. Each frame is
+/// a column of 3*nbMarkers rows (x, y and z of each marker in meters), which is the layout of the
+/// observed markers of KalmanReconsMarkers::reconstructFrame when the markers asked are the technical
+/// markers of the model. Markers that are occluded or that are not in the file are set to zero
+///
+class BIORBD_API ViconMarkerReader
+{
+public:
+    ///
+    /// \brief Open a Vicon ASCII marker file and read its header
+    /// \param path The path of the file
+    ///
+    /// All the markers of the file are read, in the order of the file
+    ///
+    ViconMarkerReader(
+            const biorbd::utils::Path& path);
+
+    ///
+    /// \brief Open a Vicon ASCII marker file and read its header
+    /// \param path The path of the file
+    /// \param markOrder The markers to read, in the order of the rows of the frames
+    ///
+    ViconMarkerReader(
+            const biorbd::utils::Path& path,
+            const std::vector<biorbd::utils::String>& markOrder);
+
+    ///
+    /// \brief Return the names of the markers in the file
+    /// \return The names of the markers in the file, in the order of the file
+    ///
+    const std::vector<biorbd::utils::String>& markersInFile() const;
+
+    ///
+    /// \brief Return the number of markers read in each frame
+    /// \return The number of markers read in each frame
+    ///
+    unsigned int nbMarkers() const;
+
+    ///
+    /// \brief Return the number of frames in the file
+    /// \return The number of frames in the file
+    ///
+    /// The first call scans the file once to index the position of each frame
+    ///
+    unsigned int nbFrames();
+
+    ///
+    /// \brief Return the index of the next frame to be read
+    /// \return The index of the next frame to be read
+    ///
+    unsigned int currentFrame() const;
+
+    ///
+    /// \brief Move to a frame, so it is the next one to be read
+    /// \param frame The index of the frame
+    ///
+    void seekFrame(
+            unsigned int frame);
+
+    ///
+    /// \brief Read the next frames
+    /// \param frames The frames read (3*nbMarkers x nbFramesToRead) (output)
+    /// \param nbFramesToRead The number of frames to read
+    /// \return The number of frames read, which is less than asked at the end of the file
+    ///
+    /// The matrix is only resized if it does not have the right dimensions, the columns
+    /// after the frames read are left untouched
+    ///
+    unsigned int readFrames(
+            biorbd::utils::Matrix& frames,
+            unsigned int nbFramesToRead);
+
+    ///
+    /// \brief Read the remaining frames by blocks
+    /// \param blockSize The number of frames of each block
+    /// \param f The function called for each block with the frames (3*nbMarkers x blockSize), the index of the first frame of the block and the number of frames read in the block
+    ///
+    /// The same matrix is reused for every block
+    ///
+    void forEachBlock(
+            unsigned int blockSize,
+            const std::function<void(const biorbd::utils::Matrix&, unsigned int, unsigned int)>& f);
+
+protected:
+    ///
+    /// \brief Read the header of the file
+    /// \param markOrder The markers to read (all the markers of the file if empty)
+    ///
+    void readHeader(
+            const std::vector<biorbd::utils::String>& markOrder);
+
+    ///
+    /// \brief Read the next line that is not empty
+    /// \return If a line was read
+    ///
+    bool readLine();
+
+    ///
+    /// \brief Parse the line that was read as a frame
+    /// \param frames The matrix to fill
+    /// \param col The column of the frame in the matrix
+    ///
+    void parseLine(
+            biorbd::utils::Matrix& frames,
+            unsigned int col) const;
+
+    std::shared_ptr<std::ifstream> m_file; ///< The file
+    std::shared_ptr<std::string> m_line; ///< Buffer of the line being read
+    std::shared_ptr<std::vector<biorbd::utils::String>> m_markersInFile; ///< The names of the markers in the file
+    std::shared_ptr<std::vector<int>> m_rowOfField; ///< The row of the frame filled by each field of a line (-1 if the field is not read)
+    std::shared_ptr<unsigned int> m_nbMarkers; ///< The number of markers read in each frame
+    std::shared_ptr<std::vector<std::streampos>> m_framePositions; ///< The position of each frame in the file (empty until indexed)
+    std::shared_ptr<std::streampos> m_firstFramePosition; ///< The position of the first frame in the file
+    std::shared_ptr<unsigned int> m_currentFrame; ///< The index of the next frame to be read
+};
+
+}
+
+#endif // BIORBD_VICON_MARKER_READER_H
@@ -7,6 +7,7 @@
 #include "BiorbdModel.h"
 #include "ModelReader.h"
 #include "ModelWriter.h"
+#include "ViconMarkerReader.h"
 
 #include "Utils/all.h"
 #include "RigidBody/all.h"
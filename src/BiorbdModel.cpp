@@ -21,3 +21,11 @@ biorbd::Model::Model(const biorbd::utils::Path &path)
 {
     biorbd::Reader::readModelFile(path, this);
 }
+
+void biorbd::Model::detachWorkspace()
+{
+    biorbd::rigidbody::Joints::detachWorkspace();
+#ifdef MODULE_MUSCLES
+    biorbd::muscles::Muscles::detachWorkspace();
+#endif
+}
@@ -2,13 +2,26 @@
 #include "ModelReader.h"
 
 #include <limits.h>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <chrono>
 #include <boost/lexical_cast.hpp>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "BiorbdModel.h"
+#include "ViconMarkerReader.h"
 #include "Utils/Error.h"
 #include "Utils/IfStream.h"
 #include "Utils/String.h"
 #include "Utils/Equation.h"
+#include "Utils/Matrix.h"
 #include "Utils/Vector.h"
 #include "Utils/Vector3d.h"
 #include "Utils/Rotation.h"
@@ -201,18 +214,7 @@ void biorbd::Reader::readModelFile(
                         biorbd::utils::String filePathInString;
                         file.read(filePathInString);
                         biorbd::utils::Path filePath(filePathInString);
-                        if (!filePath.extension().compare("bioMesh"))
-                            mesh = readMeshFileBiorbdSegments(path.folder() + filePath.relativePath());
-                        else if (!filePath.extension().compare("ply"))
-                            mesh = readMeshFilePly(path.folder() + filePath.relativePath());
-                        else if (!filePath.extension().compare("obj"))
-                            mesh = readMeshFileObj(path.folder() + filePath.relativePath());
-#ifdef MODULE_VTP_FILES_READER
-                        else if (!filePath.extension().compare("vtp"))
-                            mesh = readMeshFileVtp(path.folder() + filePath.relativePath());
-#endif
-                        else
-                            biorbd::utils::Error::raise(filePath.extension() + " is an unrecognized mesh file");
+                        mesh = readMeshFile(path.folder() + filePath.relativePath());
                     }
                 }
                 RigidBodyDynamics::Math::SpatialTransform RT(RT_R, RT_T);
@@ -224,6 +226,11 @@ void biorbd::Reader::readModelFile(
                 file.read(rootActuated);
                 model->setIsRootActuated(rootActuated);
             }
+            else if (!main_tag.tolower().compare("merge_dofs")){
+                bool mergeDofs = false;
+                file.read(mergeDofs);
+                model->setMergeDofs(mergeDofs);
+            }
             else if (!main_tag.tolower().compare("external_forces")){
                 bool externalF = false;
                 file.read(externalF);
@@ -1234,144 +1241,33 @@ std::vector<std::vector<biorbd::utils::Vector3d>>
 biorbd::Reader::readViconMarkerFile(const biorbd::utils::Path& path,
     std::vector<biorbd::utils::String>& markOrder,
     int nFramesToGet) {
-    // Read file
-#ifdef _WIN32
-    biorbd::utils::IfStream file(
-                biorbd::utils::Path::toWindowsFormat(
-                    path.absolutePath()).c_str(), std::ios::in);
-#else
-    biorbd::utils::IfStream file(
-                path.absolutePath().c_str(), std::ios::in);
-#endif
-    biorbd::utils::String t;
-
-
-    // Get the acquisition frequency
-    // frequency = atoi(findImportantParameter(file, "trajectories").c_str());
-
-    // Get the order of the markers in the file
-    for (unsigned int i=0; i<3; ++i) // skip the header
-        file.read(t);
-    size_t idx_tp = 0;
-    std::vector<unsigned int> idx_init;
-    std::vector<unsigned int> idx_end;
-    // Find the separators (: et ,)
-    while (idx_tp < t.length()) {
-        idx_tp = t.find(":", idx_tp+1);
-        idx_init.push_back(static_cast<unsigned int>(idx_tp));
-        idx_end.push_back(static_cast<unsigned int>(t.find(",", idx_tp+1)));
-    }
-    // Keep the names between the separators
-    std::vector<biorbd::utils::String> MarkersInFile;
-    for (unsigned int i=0; i<idx_init.size()-1; ++i){
-        biorbd::utils::String tp;
-        for (unsigned int j=*(idx_init.begin()+i)+1; j<*(idx_end.begin()+i); ++j)
-            tp.push_back(t.at(j));
-        MarkersInFile.push_back(tp);
-    }
-
-
-    // Compare with the given order
-    int *ordre;
-    ordre = new int[3*MarkersInFile.size()];
-    for (int i=0; i<static_cast<int>(3*MarkersInFile.size()); ++i)
-        ordre[i] = -1;
-    for (int i=0; i<static_cast<int>(markOrder.size()); ++i){
-        unsigned int cmp=0;
-        biorbd::utils::String m1 = (*(markOrder.begin()+i));
-        while (1){
-            biorbd::utils::String m2 = (*(MarkersInFile.begin()+cmp));
-            if (!m1.compare(m2)){
-                ordre[3*cmp] = 3*i;
-                ordre[3*cmp+1] = 3*i+1;
-                ordre[3*cmp+2] = 3*i+2;
-                break;
-            }
-            else
-                ++cmp;
-//            biorbd::utils::Error::check(cmp<MarkersInFile.size(), "The requested marker was not found in the file!");
-            // Le marqueur demandé n'a pas été trouvé dans le fichier!
-            if (cmp>=MarkersInFile.size())
-                break;
-        }
-    }
-
-    // Go to the data
-    for (unsigned int i=0; i<4; ++i) // skip the header
-        file.read(t);
+    biorbd::ViconMarkerReader reader(path, markOrder);
 
-    // Find the total number of frames
+    // Find the frames to skip between two frames read
     unsigned int jumps(1);
-    unsigned int nbFrames(0);
     if (nFramesToGet != -1){ // If it's all of them, the jumps are 1
-        while(!file.eof()){
-            file.read(t); // Get a line
-            nbFrames++;
-        }
-        file.close();
-#ifdef _WIN32
-    biorbd::utils::IfStream file(
-                biorbd::utils::Path::toWindowsFormat(
-                    path.absolutePath()).c_str(), std::ios::in);
-#else
-    biorbd::utils::IfStream file(
-                path.absolutePath().c_str(), std::ios::in);
-#endif
-        // Skip the header
-        for (unsigned int i=0; i<7; ++i)
-            file.read(t);
         biorbd::utils::Error::check(nFramesToGet!=0 && nFramesToGet!=1
-                && static_cast<unsigned int>(nFramesToGet)<=nbFrames,
+                && static_cast<unsigned int>(nFramesToGet)<=reader.nbFrames(),
                                     "nNode should not be 0, 1 or greater "
                                     "than number of frame");
-        jumps = nbFrames/static_cast<unsigned int>(nFramesToGet)+1;
+        jumps = reader.nbFrames()/static_cast<unsigned int>(nFramesToGet)+1;
     }
 
-
     std::vector<std::vector<biorbd::utils::Vector3d>> data;
-    // now we'll use a stringstream to separate the fields out of the line (comma separated)
-    unsigned int cmpFrames(1);
-    while(!file.eof()){
-        biorbd::utils::Vector data_tp = biorbd::utils::Vector(static_cast<unsigned int>(3*markOrder.size())).setZero();
-        std::stringstream ss( t );
-        biorbd::utils::String field;
-        unsigned int cmp = 0;
-        while (getline( ss, field, ',' )){
-            // for each field we wish to convert it to a double
-            // (since we require that the CSV contains nothing but floating-point values)
-            std::stringstream fs( field );
-            double f = 0.0;  // (default value is 0.0)
-            fs >> f;
-            if (cmp>1 && cmp<3*MarkersInFile.size()+2){ // Retirer les timespans et ne pas dépasser
-                int idx = ordre[cmp-2];
-                if (idx>=0)
-                    data_tp(static_cast<unsigned int>(idx)) = f;
-            }
-            ++cmp;
-        }
+    biorbd::utils::Matrix frame;
+    while (reader.readFrames(frame, 1)){
         // Once the markers are in order, separate them
-        std::vector<biorbd::utils::Vector3d> data_tp2;
-        for (unsigned int i=0; i<static_cast<unsigned int>(data_tp.size())/3; ++i){
-            biorbd::utils::Vector3d node(data_tp.block(3*i, 0, 3, 1)/1000);
-            data_tp2.push_back(node);
-        }
-        // Stock the marker vector a that time t
-        data.push_back(data_tp2); // Put back to meters
-        for (unsigned int i=0; i<jumps; ++i){
-            if (cmpFrames != nbFrames){
-                file.read(t); // Get the line
-                cmpFrames++;
-            }
-            else{
-                file.read(t);
+        std::vector<biorbd::utils::Vector3d> data_tp;
+        for (unsigned int i=0; i<reader.nbMarkers(); ++i)
+            data_tp.push_back(biorbd::utils::Vector3d(frame.block(3*i, 0, 3, 1)));
+        data.push_back(data_tp);
+
+        if (jumps != 1){
+            if (reader.currentFrame() - 1 + jumps >= reader.nbFrames())
                 break;
-            }
+            reader.seekFrame(reader.currentFrame() - 1 + jumps);
         }
     }
-
-    // Close file
-    file.close();
-
     return data;
 }
 
@@ -1657,44 +1553,180 @@ biorbd::rigidbody::Mesh biorbd::Reader::readMeshFileVtp(
 std::vector<std::vector<biorbd::utils::Vector3d>>
 biorbd::Reader::readViconMarkerFile(const biorbd::utils::Path &path,
         int nFramesToGet){
-    // Read file
+    // Read all the markers, in the order of the file
+    std::vector<biorbd::utils::String> MarkersInFile(biorbd::ViconMarkerReader(path).markersInFile());
+    return readViconMarkerFile(path, MarkersInFile, nFramesToGet);
+}
+
+biorbd::rigidbody::Mesh biorbd::Reader::readMeshFile(
+        const biorbd::utils::Path &path)
+{
+    biorbd::rigidbody::Mesh mesh;
+#ifdef MODULE_MESH_CACHE
+    if (readMeshFileCache(path, mesh))
+        return mesh;
+#endif
+
+    if (!path.extension().compare("bioMesh"))
+        mesh = readMeshFileBiorbdSegments(path);
+    else if (!path.extension().compare("ply"))
+        mesh = readMeshFilePly(path);
+    else if (!path.extension().compare("obj"))
+        mesh = readMeshFileObj(path);
+#ifdef MODULE_VTP_FILES_READER
+    else if (!path.extension().compare("vtp"))
+        mesh = readMeshFileVtp(path);
+#endif
+    else
+        biorbd::utils::Error::raise(path.extension() + " is an unrecognized mesh file");
+
+#ifdef MODULE_MESH_CACHE
+    writeMeshFileCache(path, mesh);
+#endif
+    return mesh;
+}
+
+// Header of the cache files, the version must be increased each time the layout changes
+static const char meshCacheTag[16] = "biorbdMeshCache";
+static const unsigned int meshCacheVersion(1);
+static const unsigned int meshCacheEndianness(0x01020304);
+
+bool biorbd::Reader::readMeshFileCache(
+        const biorbd::utils::Path &path,
+        biorbd::rigidbody::Mesh &mesh)
+{
 #ifdef _WIN32
-    biorbd::utils::IfStream file(
-                biorbd::utils::Path::toWindowsFormat(
-                    path.absolutePath()).c_str(), std::ios::in);
+    biorbd::utils::String filepath( biorbd::utils::Path::toWindowsFormat(
+                    path.absolutePath()).c_str());
 #else
-    biorbd::utils::IfStream file(
-                path.absolutePath().c_str(), std::ios::in);
+    biorbd::utils::String filepath( path.absolutePath().c_str() );
 #endif
-    biorbd::utils::String t;
-
-
-    // Get the acquisition frequency
-    // frequency = atoi(findImportantParameter(file, "trajectories").c_str());
-
-    // Get the order of the markers in the file
-    for (unsigned int i=0; i<3; ++i) // skip the header
-        file.read(t);
-    size_t idx_tp = 0;
-    std::vector<unsigned int> idx_init;
-    std::vector<unsigned int> idx_end;
-    // Find the separators (: et ,)
-    while (idx_tp < t.length()) {
-        idx_tp = t.find(":", idx_tp+1);
-        idx_init.push_back(static_cast<unsigned int>(idx_tp));
-        idx_end.push_back(static_cast<unsigned int>(t.find(",", idx_tp+1)));
-    }
-    // Keep the names between the separators
-    std::vector<biorbd::utils::String> MarkersInFile;
-    for (unsigned int i=0; i<idx_init.size()-1; ++i){
-        biorbd::utils::String tp;
-        for (unsigned int j=*(idx_init.begin()+i)+1; j<*(idx_end.begin()+i); ++j)
-            tp.push_back(t.at(j));
-        MarkersInFile.push_back(tp);
-    }
+    std::ifstream file(filepath + ".bioMeshCache", std::ios::in | std::ios::binary);
+    if (!file)
+        return false;
+
+    // The cache must be of the current version and written from the current content of the mesh file
+    char tag[16];
+    unsigned int version, endianness, nVertex, nFaces;
+    unsigned long long size, checksum, currentSize, currentChecksum;
+    file.read(tag, sizeof(tag));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&endianness), sizeof(endianness));
+    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+    file.read(reinterpret_cast<char*>(&checksum), sizeof(checksum));
+    file.read(reinterpret_cast<char*>(&nVertex), sizeof(nVertex));
+    file.read(reinterpret_cast<char*>(&nFaces), sizeof(nFaces));
+    if (!file || std::string(tag, sizeof(tag)) != std::string(meshCacheTag, sizeof(meshCacheTag))
+            || version != meshCacheVersion || endianness != meshCacheEndianness)
+        return false;
+    if (!fileChecksum(filepath, currentSize, currentChecksum) || size != currentSize || checksum != currentChecksum)
+        return false;
+
+    // The vertices and the faces are stored contiguously, so they are read at once
+    std::vector<double> vertex(3*nVertex);
+    std::vector<int> faces(3*nFaces);
+    file.read(reinterpret_cast<char*>(vertex.data()), static_cast<std::streamsize>(vertex.size()*sizeof(double)));
+    file.read(reinterpret_cast<char*>(faces.data()), static_cast<std::streamsize>(faces.size()*sizeof(int)));
+    if (!file)
+        return false;
+
+    mesh = biorbd::rigidbody::Mesh();
+    mesh.setPath(path);
+    for (unsigned int i=0; i<nVertex; ++i)
+        mesh.addPoint(biorbd::utils::Vector3d(vertex[3*i], vertex[3*i+1], vertex[3*i+2]));
+    for (unsigned int i=0; i<nFaces; ++i)
+        mesh.addFace(Eigen::Vector3i(faces[3*i], faces[3*i+1], faces[3*i+2]));
+    return true;
+}
 
-    // Close file
+bool biorbd::Reader::writeMeshFileCache(
+        const biorbd::utils::Path &path,
+        const biorbd::rigidbody::Mesh &mesh)
+{
+#ifdef _WIN32
+    biorbd::utils::String filepath( biorbd::utils::Path::toWindowsFormat(
+                    path.absolutePath()).c_str());
+#else
+    biorbd::utils::String filepath( path.absolutePath().c_str() );
+#endif
+    unsigned long long size, checksum;
+    if (!fileChecksum(filepath, size, checksum))
+        return false;
+
+    // The cache is written in a file of its own, then moved over the previous one, so other processes
+    // loading the same mesh never read nor write a partial cache
+    static std::atomic<unsigned int> nbCacheWritten(0);
+    std::ostringstream tmpName;
+#ifdef _WIN32
+    tmpName << filepath << ".bioMeshCache." << _getpid();
+#else
+    tmpName << filepath << ".bioMeshCache." << getpid();
+#endif
+    tmpName << "." << std::hash<std::thread::id>()(std::this_thread::get_id())
+            << "." << nbCacheWritten++
+            << "." << std::chrono::steady_clock::now().time_since_epoch().count();
+    biorbd::utils::String tmpPath(tmpName.str());
+    std::ofstream file(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    unsigned int nVertex(mesh.nbVertex());
+    unsigned int nFaces(static_cast<unsigned int>(mesh.faces().size()));
+    file.write(meshCacheTag, sizeof(meshCacheTag));
+    file.write(reinterpret_cast<const char*>(&meshCacheVersion), sizeof(meshCacheVersion));
+    file.write(reinterpret_cast<const char*>(&meshCacheEndianness), sizeof(meshCacheEndianness));
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    file.write(reinterpret_cast<const char*>(&nVertex), sizeof(nVertex));
+    file.write(reinterpret_cast<const char*>(&nFaces), sizeof(nFaces));
+
+    // The vertices are already contiguous (x, y, z of each vertex)
+    file.write(reinterpret_cast<const char*>(mesh.pointsInMatrix().data()),
+               static_cast<std::streamsize>(3*nVertex*sizeof(double)));
+    std::vector<int> faces;
+    faces.reserve(3*nFaces);
+    for (const biorbd::rigidbody::MeshFace& face : mesh.faces())
+        for (int i=0; i<3; ++i)
+            faces.push_back(face(i));
+    file.write(reinterpret_cast<const char*>(faces.data()), static_cast<std::streamsize>(faces.size()*sizeof(int)));
     file.close();
+    if (!file){
+        std::remove(tmpPath.c_str());
+        return false;
+    }
 
-    return readViconMarkerFile(path, MarkersInFile, nFramesToGet);
+    biorbd::utils::String cachePath(filepath + ".bioMeshCache");
+#ifdef _WIN32
+    // Windows does not replace an existing file when renaming
+    std::remove(cachePath.c_str());
+#endif
+    if (std::rename(tmpPath.c_str(), cachePath.c_str()) != 0){
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool biorbd::Reader::fileChecksum(
+        const biorbd::utils::String &path,
+        unsigned long long &size,
+        unsigned long long &checksum)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file)
+        return false;
+
+    size = 0;
+    checksum = 14695981039346656037ULL;
+    std::vector<char> buffer(1 << 16);
+    while (file){
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        std::streamsize nRead(file.gcount());
+        for (std::streamsize i=0; i<nRead; ++i){
+            checksum ^= static_cast<unsigned char>(buffer[static_cast<size_t>(i)]);
+            checksum *= 1099511628211ULL;
+        }
+        size += static_cast<unsigned long long>(nRead);
+    }
+    return true;
 }
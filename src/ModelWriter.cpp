@@ -35,6 +35,7 @@ void biorbd::Writer::writeModel(biorbd::Model & model,
     biorbdModelFile << com << " General informations" << std::endl;
     biorbdModelFile << "root_actuated" << sep << model.isRootActuated() << std::endl;
     biorbdModelFile << "external_forces" << sep << model.hasExternalForces() << std::endl;
+    biorbdModelFile << "merge_dofs" << sep << model.mergeDofs() << std::endl;
     biorbdModelFile << std::endl;
 
     // Information on the segments
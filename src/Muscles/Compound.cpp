@@ -86,6 +86,15 @@ void biorbd::muscles::Compound::DeepCopy(const biorbd::muscles::Compound &other)
 
 }
 
+void biorbd::muscles::Compound::detachWorkspace()
+{
+    // The wrapping objects keep the state of their last wrap, so each workspace needs its own
+    m_pathChanger = std::make_shared<biorbd::muscles::PathModifiers>(m_pathChanger->DeepCopy());
+    m_force = std::make_shared<std::vector<std::shared_ptr<biorbd::muscles::Force>>>(2);
+    (*m_force)[0] = std::make_shared<biorbd::muscles::ForceFromOrigin>();
+    (*m_force)[1] = std::make_shared<biorbd::muscles::ForceFromInsertion>();
+}
+
 const biorbd::utils::String &biorbd::muscles::Compound::name() const
 {
     return *m_name;
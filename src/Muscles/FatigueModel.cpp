@@ -40,6 +40,15 @@ void biorbd::muscles::FatigueModel::DeepCopy(const biorbd::muscles::FatigueModel
     *m_fatigueState = other.m_fatigueState->DeepCopy();
 }
 
+void biorbd::muscles::FatigueModel::detachWorkspace()
+{
+    if (m_fatigueState->getType() == biorbd::muscles::STATE_FATIGUE_TYPE::DYNAMIC_XIA)
+        m_fatigueState = std::make_shared<biorbd::muscles::FatigueDynamicStateXia>(
+                    std::static_pointer_cast<biorbd::muscles::FatigueDynamicStateXia>(m_fatigueState)->DeepCopy());
+    else
+        m_fatigueState = std::make_shared<biorbd::muscles::FatigueState>(m_fatigueState->DeepCopy());
+}
+
 void biorbd::muscles::FatigueModel::setFatigueState(double active, double fatigued, double resting)
 {
     m_fatigueState->setState(active, fatigued, resting);
@@ -35,8 +35,8 @@ void biorbd::muscles::ForceFromInsertion::setForceFromMuscleGeometry(
         double norm)
 {
     // Trouver le vecteur directeur
-    const std::vector<biorbd::utils::Vector3d>& tp_via = geo.musclesPointsInGlobal();
-    *this = tp_via[tp_via.size()-2] - tp_via[tp_via.size()-1];
+    const Eigen::Matrix3Xd& tp_via = geo.musclesPointsInGlobalInMatrix();
+    *this = tp_via.col(tp_via.cols()-2) - tp_via.col(tp_via.cols()-1);
     *this /= this->norm();
     *this *= norm;
 }
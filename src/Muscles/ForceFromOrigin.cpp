@@ -36,8 +36,8 @@ void biorbd::muscles::ForceFromOrigin::setForceFromMuscleGeometry(
         double norm)
 {
     //Find the direction vector
-    const std::vector<biorbd::utils::Vector3d>& tp_via = geo.musclesPointsInGlobal();
-    *this = tp_via[1] - tp_via[0];
+    const Eigen::Matrix3Xd& tp_via = geo.musclesPointsInGlobalInMatrix();
+    *this = tp_via.col(1) - tp_via.col(0);
     *this /= this->norm();
     *this *= norm;
 }
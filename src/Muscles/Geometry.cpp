@@ -4,6 +4,8 @@
 #include <rbdl/Model.h>
 #include <rbdl/Kinematics.h>
 #include "Utils/Error.h"
+#include "Utils/String.h"
+#include "Utils/Vector3d.h"
 #include "Utils/Matrix.h"
 #include "Utils/RotoTrans.h"
 #include "RigidBody/Joints.h"
@@ -19,11 +21,22 @@ biorbd::muscles::Geometry::Geometry() :
     m_insertion(std::make_shared<biorbd::utils::Vector3d>()),
     m_originInGlobal(std::make_shared<biorbd::utils::Vector3d>(biorbd::utils::Vector3d::Zero())),
     m_insertionInGlobal(std::make_shared<biorbd::utils::Vector3d>(biorbd::utils::Vector3d::Zero())),
-    m_pointsInGlobal(std::make_shared<std::vector<biorbd::utils::Vector3d>>()),
-    m_pointsInLocal(std::make_shared<std::vector<biorbd::utils::Vector3d>>()),
+    m_pointsInGlobal(std::make_shared<Eigen::Matrix3Xd>()),
+    m_pointsInLocal(std::make_shared<Eigen::Matrix3Xd>()),
+    m_originWrap(std::make_shared<biorbd::utils::Vector3d>(biorbd::utils::Vector3d::Zero())),
+    m_insertionWrap(std::make_shared<biorbd::utils::Vector3d>(biorbd::utils::Vector3d::Zero())),
+    m_originParentId(std::make_shared<int>(-1)),
+    m_insertionParentId(std::make_shared<int>(-1)),
+    m_originParentVersion(std::make_shared<unsigned int>(0)),
+    m_insertionParentVersion(std::make_shared<unsigned int>(0)),
+    m_pathModifiersParentId(std::make_shared<std::vector<unsigned int>>()),
+    m_pathModifiersParentVersion(std::make_shared<std::vector<unsigned int>>()),
+    m_pointsParentId(std::make_shared<std::vector<unsigned int>>()),
     m_jacobian(std::make_shared<biorbd::utils::Matrix>()),
     m_G(std::make_shared<biorbd::utils::Matrix>()),
-    m_jacobianLength(std::make_shared<biorbd::utils::Matrix>()),
+    m_jacobianLength(std::make_shared<biorbd::utils::Matrix>(1, 0)),
+    m_jacobianLengthRow(std::make_shared<unsigned int>(0)),
+    m_isJacobianLengthBound(std::make_shared<bool>(false)),
     m_length(std::make_shared<double>(0)),
     m_muscleTendonLength(std::make_shared<double>(0)),
     m_velocity(std::make_shared<double>(0)),
@@ -41,11 +54,22 @@ biorbd::muscles::Geometry::Geometry(
     m_insertion(std::make_shared<biorbd::utils::Vector3d>(insertion)),
     m_originInGlobal(std::make_shared<biorbd::utils::Vector3d>(biorbd::utils::Vector3d::Zero())),
     m_insertionInGlobal(std::make_shared<biorbd::utils::Vector3d>(biorbd::utils::Vector3d::Zero())),
-    m_pointsInGlobal(std::make_shared<std::vector<biorbd::utils::Vector3d>>()),
-    m_pointsInLocal(std::make_shared<std::vector<biorbd::utils::Vector3d>>()),
+    m_pointsInGlobal(std::make_shared<Eigen::Matrix3Xd>()),
+    m_pointsInLocal(std::make_shared<Eigen::Matrix3Xd>()),
+    m_originWrap(std::make_shared<biorbd::utils::Vector3d>(biorbd::utils::Vector3d::Zero())),
+    m_insertionWrap(std::make_shared<biorbd::utils::Vector3d>(biorbd::utils::Vector3d::Zero())),
+    m_originParentId(std::make_shared<int>(-1)),
+    m_insertionParentId(std::make_shared<int>(-1)),
+    m_originParentVersion(std::make_shared<unsigned int>(0)),
+    m_insertionParentVersion(std::make_shared<unsigned int>(0)),
+    m_pathModifiersParentId(std::make_shared<std::vector<unsigned int>>()),
+    m_pathModifiersParentVersion(std::make_shared<std::vector<unsigned int>>()),
+    m_pointsParentId(std::make_shared<std::vector<unsigned int>>()),
     m_jacobian(std::make_shared<biorbd::utils::Matrix>()),
     m_G(std::make_shared<biorbd::utils::Matrix>()),
-    m_jacobianLength(std::make_shared<biorbd::utils::Matrix>()),
+    m_jacobianLength(std::make_shared<biorbd::utils::Matrix>(1, 0)),
+    m_jacobianLengthRow(std::make_shared<unsigned int>(0)),
+    m_isJacobianLengthBound(std::make_shared<bool>(false)),
     m_length(std::make_shared<double>(0)),
     m_muscleTendonLength(std::make_shared<double>(0)),
     m_velocity(std::make_shared<double>(0)),
@@ -69,15 +93,23 @@ void biorbd::muscles::Geometry::DeepCopy(const biorbd::muscles::Geometry &other)
     *m_insertion = other.m_insertion->DeepCopy();
     *m_originInGlobal = other.m_originInGlobal->DeepCopy();
     *m_insertionInGlobal = other.m_insertionInGlobal->DeepCopy();
-    m_pointsInGlobal->resize(other.m_pointsInGlobal->size());
-    for (unsigned int i=0; i<other.m_pointsInGlobal->size(); ++i)
-        (*m_pointsInGlobal)[i] = (*other.m_pointsInGlobal)[i].DeepCopy();
-    m_pointsInLocal->resize(other.m_pointsInLocal->size());
-    for (unsigned int i=0; i<other.m_pointsInLocal->size(); ++i)
-        (*m_pointsInLocal)[i] = (*other.m_pointsInLocal)[i].DeepCopy();
+    *m_pointsInGlobal = *other.m_pointsInGlobal;
+    *m_pointsInLocal = *other.m_pointsInLocal;
+    *m_originWrap = other.m_originWrap->DeepCopy();
+    *m_insertionWrap = other.m_insertionWrap->DeepCopy();
+    *m_originParentId = *other.m_originParentId;
+    *m_insertionParentId = *other.m_insertionParentId;
+    *m_originParentVersion = m_origin->parentVersion();
+    *m_insertionParentVersion = m_insertion->parentVersion();
+    *m_pathModifiersParentId = *other.m_pathModifiersParentId;
+    *m_pathModifiersParentVersion = *other.m_pathModifiersParentVersion;
+    *m_pointsParentId = *other.m_pointsParentId;
     *m_jacobian = *other.m_jacobian;
     *m_G = *other.m_G;
-    *m_jacobianLength = *other.m_jacobianLength;
+    // The copy writes its muscle length jacobian in its own matrix
+    m_jacobianLength = std::make_shared<biorbd::utils::Matrix>(other.m_jacobianLength->row(*other.m_jacobianLengthRow));
+    m_jacobianLengthRow = std::make_shared<unsigned int>(0);
+    m_isJacobianLengthBound = std::make_shared<bool>(false);
     *m_length = *other.m_length;
     *m_muscleTendonLength = *other.m_muscleTendonLength;
     *m_velocity = *other.m_velocity;
@@ -179,6 +211,7 @@ void biorbd::muscles::Geometry::setOrigin(
         const utils::Vector3d &position)
 {
     *m_origin = position;
+    *m_originParentId = -1;
 }
 const biorbd::utils::Vector3d& biorbd::muscles::Geometry::originInLocal() const
 {
@@ -189,6 +222,7 @@ void biorbd::muscles::Geometry::setInsertionInLocal(
         const utils::Vector3d &position)
 {
     *m_insertion = position;
+    *m_insertionParentId = -1;
 }
 const biorbd::utils::Vector3d &biorbd::muscles::Geometry::insertionInLocal() const
 {
@@ -206,9 +240,28 @@ const biorbd::utils::Vector3d &biorbd::muscles::Geometry::insertionInGlobal() co
     biorbd::utils::Error::check(*m_isGeometryComputed, "Geometry must be computed at least once before calling insertionInGlobal()");
     return *m_insertionInGlobal;
 }
-const std::vector<biorbd::utils::Vector3d> &biorbd::muscles::Geometry::musclesPointsInGlobal() const
+std::vector<biorbd::utils::Vector3d> biorbd::muscles::Geometry::musclesPointsInGlobal() const
 {
     biorbd::utils::Error::check(*m_isGeometryComputed, "Geometry must be computed at least once before calling musclesPointsInGlobal()");
+
+    // The origin and the insertion keep their name, the points in between are plain coordinates
+    unsigned int nbPoints(static_cast<unsigned int>(m_pointsInGlobal->cols()));
+    std::vector<biorbd::utils::Vector3d> points;
+    points.reserve(nbPoints);
+    for (unsigned int i=0; i<nbPoints; ++i){
+        if (i == 0)
+            points.push_back(biorbd::utils::Vector3d(m_pointsInGlobal->col(i), m_origin->name(), m_origin->parent()));
+        else if (i == nbPoints-1)
+            points.push_back(biorbd::utils::Vector3d(m_pointsInGlobal->col(i), m_insertion->name(), m_insertion->parent()));
+        else
+            points.push_back(biorbd::utils::Vector3d(m_pointsInGlobal->col(i)));
+    }
+    return points;
+}
+
+const Eigen::Matrix3Xd &biorbd::muscles::Geometry::musclesPointsInGlobalInMatrix() const
+{
+    biorbd::utils::Error::check(*m_isGeometryComputed, "Geometry must be computed at least once before calling musclesPointsInGlobalInMatrix()");
     return *m_pointsInGlobal;
 }
 
@@ -251,10 +304,30 @@ biorbd::utils::Matrix biorbd::muscles::Geometry::jacobian(unsigned int idxViaPoi
     return m_jacobian->block(3*idxViaPoint,0,3,m_jacobian->cols());
 }
 
-const biorbd::utils::Matrix &biorbd::muscles::Geometry::jacobianLength() const
+biorbd::utils::Matrix biorbd::muscles::Geometry::jacobianLength() const
 {
     biorbd::utils::Error::check(*m_isGeometryComputed, "Geometry must be computed before calling jacobianLength()");
-    return *m_jacobianLength;
+    return m_jacobianLength->row(*m_jacobianLengthRow);
+}
+
+void biorbd::muscles::Geometry::bindJacobianLength(
+        const std::shared_ptr<biorbd::utils::Matrix> &jacobians,
+        unsigned int row)
+{
+    biorbd::utils::Error::check(row < static_cast<unsigned int>(jacobians->rows()), "Row of the muscle length jacobian is out of the matrix");
+    // New pointers, so the geometries this one was copied from keep their own row
+    m_jacobianLength = jacobians;
+    m_jacobianLengthRow = std::make_shared<unsigned int>(row);
+    m_isJacobianLengthBound = std::make_shared<bool>(true);
+}
+
+void biorbd::muscles::Geometry::bindJacobianLength(
+        const biorbd::muscles::Geometry &other)
+{
+    // The other geometry may write in its own matrix, which it then resizes itself
+    m_jacobianLength = other.m_jacobianLength;
+    m_jacobianLengthRow = std::make_shared<unsigned int>(*other.m_jacobianLengthRow);
+    m_isJacobianLengthBound = std::make_shared<bool>(*other.m_isJacobianLengthBound);
 }
 
 // --------------------------------------- //
@@ -283,7 +356,7 @@ const biorbd::utils::Vector3d &biorbd::muscles::Geometry::originInGlobal(
         const biorbd::rigidbody::GeneralizedCoordinates &Q)
 {
     // Return the position of the marker in function of the given position
-    m_originInGlobal->block(0,0,3,1) = RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, model.GetBodyId(m_origin->parent().c_str()), *m_origin,false);
+    m_originInGlobal->block(0,0,3,1) = RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, parentBodyId(model, *m_origin, *m_originParentId, *m_originParentVersion), *m_origin,false);
     return *m_originInGlobal;
 }
 
@@ -292,15 +365,18 @@ const biorbd::utils::Vector3d &biorbd::muscles::Geometry::insertionInGlobal(
         const biorbd::rigidbody::GeneralizedCoordinates &Q)
 {
     // Return the position of the marker in function of the given position
-    m_insertionInGlobal->block(0,0,3,1) = RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, model.GetBodyId(m_insertion->parent().c_str()), *m_insertion,false);
+    m_insertionInGlobal->block(0,0,3,1) = RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, parentBodyId(model, *m_insertion, *m_insertionParentId, *m_insertionParentVersion), *m_insertion,false);
     return *m_insertionInGlobal;
 }
 
 void biorbd::muscles::Geometry::setMusclesPointsInGlobal(std::vector<utils::Vector3d> &ptsInGlobal)
 {
     biorbd::utils::Error::check(ptsInGlobal.size() >= 2, "ptsInGlobal must at least have an origin and an insertion");
-    m_pointsInLocal->clear(); // In this mode, we don't need the local, because the Jacobian of the points has to be given as well
-    *m_pointsInGlobal = ptsInGlobal;
+    m_pointsParentId->clear(); // In this mode, we don't need the local, because the Jacobian of the points has to be given as well
+    if (static_cast<unsigned int>(m_pointsInGlobal->cols()) != ptsInGlobal.size())
+        m_pointsInGlobal->resize(3, static_cast<long>(ptsInGlobal.size()));
+    for (unsigned int i=0; i<ptsInGlobal.size(); ++i)
+        m_pointsInGlobal->col(i) = ptsInGlobal[i];
 }
 
 void biorbd::muscles::Geometry::setMusclesPointsInGlobal(
@@ -308,67 +384,74 @@ void biorbd::muscles::Geometry::setMusclesPointsInGlobal(
         const biorbd::rigidbody::GeneralizedCoordinates &Q,
         biorbd::muscles::PathModifiers *pathModifiers)
 {
-    // Output varible (reset to zero)
-    m_pointsInLocal->clear();
-    m_pointsInGlobal->clear();
+    // The points are plain coordinates overwritten in place, so no node is created at each update
+    m_pointsParentId->clear();
+
+    if (pathModifiers != nullptr)
+        resolvePathModifiersParentId(model, *pathModifiers);
 
     // Do not apply on wrapping objects
-    if (pathModifiers->nbWraps()!=0){
+    if (pathModifiers != nullptr && pathModifiers->nbWraps()!=0){
         // CHECK TO MODIFY BEFOR GOING FORWARD WITH PROJECTS
         biorbd::utils::Error::check(pathModifiers->nbVia() == 0, "Cannot mix wrapping and via points yet") ;
         biorbd::utils::Error::check(pathModifiers->nbWraps() < 2, "Cannot compute more than one wrapping yet");
 
         // Get the matrix of Rt of the wrap
         biorbd::muscles::WrappingObject& w = static_cast<biorbd::muscles::WrappingObject&>(pathModifiers->object(0));
-        const biorbd::utils::RotoTrans& RT = w.RT(model,Q);
+        const biorbd::utils::RotoTrans& RT = w.RT(model,Q,false); // The kinematics is already up to date
 
         // Alias
         const biorbd::utils::Vector3d& po_mus = originInGlobal(model, Q);  // Origin on bone
         const biorbd::utils::Vector3d& pi_mus = insertionInGlobal(model,Q); // Insertion on bone
 
-        biorbd::utils::Vector3d pi_wrap(0, 0, 0); // point on the wrapping related to insertion
-        biorbd::utils::Vector3d po_wrap(0, 0, 0); // point on the wrapping related to origin
-
-        w.wrapPoints(RT,po_mus,pi_mus,po_wrap, pi_wrap);
+        w.wrapPoints(RT,po_mus,pi_mus,*m_originWrap, *m_insertionWrap);
 
         // Store the points in local
         biorbd::utils::Error::warning(0, "Attention le push_back de m_pointsInLocal n'a pas été validé");
-        m_pointsInLocal->push_back(originInLocal());
-        m_pointsInLocal->push_back(
-                    biorbd::utils::Vector3d(RigidBodyDynamics::CalcBodyToBaseCoordinates(
-                                              model, Q, model.GetBodyId(w.parent().c_str()),po_wrap, false),
-                                          "wrap_o", w.parent()));
-        m_pointsInLocal->push_back(
-                    biorbd::utils::Vector3d(RigidBodyDynamics::CalcBodyToBaseCoordinates(
-                                              model, Q, model.GetBodyId(w.parent().c_str()),pi_wrap, false),
-                                          "wrap_i", w.parent()));
-        m_pointsInLocal->push_back(insertionInLocal());
+        unsigned int wrapParentId((*m_pathModifiersParentId)[0]);
+        resizePoints(4);
+        m_pointsInLocal->col(0) = originInLocal();
+        m_pointsInLocal->col(1) = RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, wrapParentId, *m_originWrap, false);
+        m_pointsInLocal->col(2) = RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, wrapParentId, *m_insertionWrap, false);
+        m_pointsInLocal->col(3) = insertionInLocal();
+        m_pointsParentId->push_back(static_cast<unsigned int>(*m_originParentId));
+        m_pointsParentId->push_back(wrapParentId);
+        m_pointsParentId->push_back(wrapParentId);
+        m_pointsParentId->push_back(static_cast<unsigned int>(*m_insertionParentId));
 
         // Store the points in global
-        m_pointsInGlobal->push_back(originInGlobal());
-        m_pointsInGlobal->push_back(po_wrap);
-        m_pointsInGlobal->push_back(pi_wrap);
-        m_pointsInGlobal->push_back(insertionInGlobal());
+        m_pointsInGlobal->col(0) = originInGlobal();
+        m_pointsInGlobal->col(1) = *m_originWrap;
+        m_pointsInGlobal->col(2) = *m_insertionWrap;
+        m_pointsInGlobal->col(3) = insertionInGlobal();
 
     }
 
-    else if (pathModifiers->nbObjects()!=0 && pathModifiers->object(0).typeOfNode() == biorbd::utils::NODE_TYPE::VIA_POINT){
-        m_pointsInLocal->push_back(originInLocal());
-        m_pointsInGlobal->push_back(originInGlobal(model, Q));
-        for (unsigned int i=0; i<pathModifiers->nbObjects(); ++i){
+    else if (pathModifiers != nullptr && pathModifiers->nbObjects()!=0 && pathModifiers->object(0).typeOfNode() == biorbd::utils::NODE_TYPE::VIA_POINT){
+        unsigned int nbVia(pathModifiers->nbObjects());
+        resizePoints(nbVia+2);
+        m_pointsInLocal->col(0) = originInLocal();
+        m_pointsInGlobal->col(0) = originInGlobal(model, Q);
+        m_pointsParentId->push_back(static_cast<unsigned int>(*m_originParentId));
+        for (unsigned int i=0; i<nbVia; ++i){
             const biorbd::muscles::ViaPoint& node(static_cast<biorbd::muscles::ViaPoint&>(pathModifiers->object(i)));
-            m_pointsInLocal->push_back(node);
-            m_pointsInGlobal->push_back(RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, model.GetBodyId(node.parent().c_str()), node, false));
+            m_pointsInLocal->col(i+1) = node;
+            m_pointsInGlobal->col(i+1) = RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, (*m_pathModifiersParentId)[i], node, false);
+            m_pointsParentId->push_back((*m_pathModifiersParentId)[i]);
         }
-        m_pointsInLocal->push_back(insertionInLocal());
-        m_pointsInGlobal->push_back(insertionInGlobal(model,Q));
+        m_pointsInLocal->col(nbVia+1) = insertionInLocal();
+        m_pointsInGlobal->col(nbVia+1) = insertionInGlobal(model,Q);
+        m_pointsParentId->push_back(static_cast<unsigned int>(*m_insertionParentId));
 
     }
-    else if (pathModifiers->nbObjects()==0){
-        m_pointsInLocal->push_back(originInLocal());
-        m_pointsInLocal->push_back(insertionInLocal());
-        m_pointsInGlobal->push_back(originInGlobal(model, Q));
-        m_pointsInGlobal->push_back(insertionInGlobal(model,Q));
+    else if (pathModifiers == nullptr || pathModifiers->nbObjects()==0){
+        resizePoints(2);
+        m_pointsInLocal->col(0) = originInLocal();
+        m_pointsInLocal->col(1) = insertionInLocal();
+        m_pointsInGlobal->col(0) = originInGlobal(model, Q);
+        m_pointsInGlobal->col(1) = insertionInGlobal(model,Q);
+        m_pointsParentId->push_back(static_cast<unsigned int>(*m_originParentId));
+        m_pointsParentId->push_back(static_cast<unsigned int>(*m_insertionParentId));
     }
     else
         biorbd::utils::Error::raise("Length for this type of object was not implemented");
@@ -377,6 +460,15 @@ void biorbd::muscles::Geometry::setMusclesPointsInGlobal(
     setJacobianDimension(model);
 }
 
+void biorbd::muscles::Geometry::resizePoints(unsigned int nbPoints)
+{
+    // Only reallocate if the number of points changed
+    if (static_cast<unsigned int>(m_pointsInGlobal->cols()) != nbPoints)
+        m_pointsInGlobal->resize(3, nbPoints);
+    if (static_cast<unsigned int>(m_pointsInLocal->cols()) != nbPoints)
+        m_pointsInLocal->resize(3, nbPoints);
+}
+
 double biorbd::muscles::Geometry::length(
         const biorbd::muscles::Characteristics *characteristics,
         biorbd::muscles::PathModifiers *pathModifiers)
@@ -389,18 +481,16 @@ double biorbd::muscles::Geometry::length(
         biorbd::utils::Error::check(pathModifiers->nbVia() == 0, "Cannot mix wrapping and via points yet" ) ;
         biorbd::utils::Error::check(pathModifiers->nbWraps() < 2, "Cannot compute more than one wrapping yet");
 
-        biorbd::utils::Vector3d pi_wrap(0, 0, 0); // point on the wrapping related to insertion
-        biorbd::utils::Vector3d po_wrap(0, 0, 0); // point on the wrapping related to origin
         double lengthWrap(0);
-        static_cast<biorbd::muscles::WrappingObject&>(pathModifiers->object(0)).wrapPoints(po_wrap, pi_wrap, &lengthWrap);
-        *m_muscleTendonLength = ((*m_pointsInGlobal)[0] - pi_wrap).norm()   + // length before the wrap
+        static_cast<biorbd::muscles::WrappingObject&>(pathModifiers->object(0)).wrapPoints(*m_originWrap, *m_insertionWrap, &lengthWrap);
+        *m_muscleTendonLength = (m_pointsInGlobal->col(0) - *m_originWrap).norm()   + // length before the wrap
                     lengthWrap                 + // length on the wrap
-                    (*m_pointsInGlobal->end() - po_wrap).norm();   // length after the wrap
+                    (m_pointsInGlobal->col(m_pointsInGlobal->cols()-1) - *m_insertionWrap).norm();   // length after the wrap
 
     }
     else{
-        for (unsigned int i=0; i<m_pointsInGlobal->size()-1; ++i)
-            *m_muscleTendonLength += ((*m_pointsInGlobal)[i+1] - (*m_pointsInGlobal)[i]).norm();
+        for (unsigned int i=0; i<static_cast<unsigned int>(m_pointsInGlobal->cols())-1; ++i)
+            *m_muscleTendonLength += (m_pointsInGlobal->col(i+1) - m_pointsInGlobal->col(i)).norm();
     }
 
     *m_length = (*m_muscleTendonLength - characteristics->tendonSlackLength())/cos(characteristics->pennationAngle());
@@ -411,19 +501,25 @@ double biorbd::muscles::Geometry::length(
 double biorbd::muscles::Geometry::velocity(const biorbd::rigidbody::GeneralizedCoordinates &Qdot)
 {
     // Compute the velocity of the muscular elongation
-    *m_velocity = (jacobianLength()*Qdot)[0];
+    *m_velocity = m_jacobianLength->row(*m_jacobianLengthRow).dot(Qdot);
     return *m_velocity;
 }
 
 void biorbd::muscles::Geometry::setJacobianDimension(biorbd::rigidbody::Joints &model)
 {
-    *m_jacobian = biorbd::utils::Matrix::Zero(static_cast<unsigned int>(m_pointsInLocal->size()*3), model.dof_count);
-    *m_G = biorbd::utils::Matrix::Zero(3, model.dof_count);
+    // Only reallocate if the number of points or of dof changed
+    unsigned int nbRows(static_cast<unsigned int>(m_pointsInLocal->cols()*3));
+    if (static_cast<unsigned int>(m_jacobian->rows()) != nbRows || static_cast<unsigned int>(m_jacobian->cols()) != model.dof_count)
+        m_jacobian->resize(nbRows, model.dof_count);
+    m_jacobian->setZero();
+    if (static_cast<unsigned int>(m_G->cols()) != model.dof_count)
+        m_G->resize(3, model.dof_count);
+    m_G->setZero();
 }
 
 void biorbd::muscles::Geometry::jacobian(const biorbd::utils::Matrix &jaco)
 {
-    biorbd::utils::Error::check(jaco.rows()/3 == static_cast<int>(m_pointsInGlobal->size()), "Jacobian is the wrong size");
+    biorbd::utils::Error::check(jaco.rows()/3 == static_cast<int>(m_pointsInGlobal->cols()), "Jacobian is the wrong size");
     *m_jacobian = jaco;
 }
 
@@ -431,20 +527,72 @@ void biorbd::muscles::Geometry::jacobian(
         biorbd::rigidbody::Joints &model,
         const biorbd::rigidbody::GeneralizedCoordinates &Q)
 {
-    for (unsigned int i=0; i<m_pointsInLocal->size(); ++i){
+    RigidBodyDynamics::Math::Vector3d pointInLocal;
+    for (unsigned int i=0; i<static_cast<unsigned int>(m_pointsInLocal->cols()); ++i){
         m_G->setZero();
-        RigidBodyDynamics::CalcPointJacobian(model, Q, model.GetBodyId((*m_pointsInLocal)[i].parent().c_str()), (*m_pointsInLocal)[i], *m_G, false); // False for speed
+        pointInLocal = m_pointsInLocal->col(i);
+        RigidBodyDynamics::CalcPointJacobian(model, Q, (*m_pointsParentId)[i], pointInLocal, *m_G, false); // False for speed
         m_jacobian->block(3*i,0,3,model.dof_count) = *m_G;
     }
 }
 
 void biorbd::muscles::Geometry::computeJacobianLength()
 {
-    *m_jacobianLength = biorbd::utils::Matrix::Zero(1, m_jacobian->cols());
-    const std::vector<biorbd::utils::Vector3d>& p = *m_pointsInGlobal;
-    for (unsigned int i=0; i<p.size()-1 ; ++i){
-        *m_jacobianLength += (( p[i+1] - p[i] ).transpose() * (jacobian(i+1) - jacobian(i)))
-                                            /
-                             ( p[i+1] - p[i] ).norm();
+    // The jacobian is written directly in its row, which may be in the matrix of all the muscles of the model.
+    // That matrix is shared with the other muscles (possibly updated by other threads), so it is sized by the model only
+    long nbDof(m_jacobian->cols());
+    if (*m_isJacobianLengthBound)
+        biorbd::utils::Error::check(m_jacobianLength->cols() == nbDof, "The muscle length jacobian of the model does not have the number of dof");
+    else if (m_jacobianLength->cols() != nbDof){
+        m_jacobianLength->resize(m_jacobianLength->rows(), nbDof);
+        m_jacobianLength->setZero();
+    }
+    Eigen::Ref<Eigen::RowVectorXd, 0, Eigen::InnerStride<>> jacobianLength(m_jacobianLength->row(*m_jacobianLengthRow));
+    jacobianLength.setZero();
+
+    // The jacobian has a 3 x nbDof block per point, the derivative of the length of each part of the
+    // path being the projection of the jacobians of its two ends on its unit direction
+    const Eigen::Matrix3Xd& p = *m_pointsInGlobal;
+    RigidBodyDynamics::Math::Vector3d dp;
+    for (unsigned int i=0; i<static_cast<unsigned int>(p.cols())-1 ; ++i){
+        // Each block is projected on its own, so the difference of the two blocks is never formed
+        dp = p.col(i+1) - p.col(i);
+        dp /= dp.norm();
+        jacobianLength.noalias() += dp.transpose() * m_jacobian->block(3*(i+1), 0, 3, nbDof);
+        jacobianLength.noalias() -= dp.transpose() * m_jacobian->block(3*i, 0, 3, nbDof);
+    }
+}
+
+unsigned int biorbd::muscles::Geometry::parentBodyId(
+        biorbd::rigidbody::Joints &model,
+        const biorbd::utils::Vector3d &node,
+        int &id,
+        unsigned int &version)
+{
+    if (id < 0 || version != node.parentVersion()){
+        id = static_cast<int>(model.GetBodyId(node.parent().c_str()));
+        version = node.parentVersion();
+    }
+    return static_cast<unsigned int>(id);
+}
+
+void biorbd::muscles::Geometry::resolvePathModifiersParentId(
+        biorbd::rigidbody::Joints &model,
+        const biorbd::muscles::PathModifiers &pathModifiers)
+{
+    // The ids are keyed on the version of the parent they were resolved from, so adding
+    // a path modifier or moving it to another segment resolves them again
+    unsigned int nbObjects(pathModifiers.nbObjects());
+    bool isResolved(m_pathModifiersParentVersion->size() == nbObjects);
+    for (unsigned int i=0; isResolved && i<nbObjects; ++i)
+        isResolved = (*m_pathModifiersParentVersion)[i] == pathModifiers.object(i).parentVersion();
+    if (isResolved)
+        return;
+
+    m_pathModifiersParentId->resize(nbObjects);
+    m_pathModifiersParentVersion->resize(nbObjects);
+    for (unsigned int i=0; i<nbObjects; ++i){
+        (*m_pathModifiersParentVersion)[i] = pathModifiers.object(i).parentVersion();
+        (*m_pathModifiersParentId)[i] = model.GetBodyId(pathModifiers.object(i).parent().c_str());
     }
 }
@@ -88,6 +88,12 @@ void biorbd::muscles::HillThelenType::computeFlCE(const biorbd::muscles::StateDy
     *m_FlCE = exp( -pow(((position().length() / characteristics().optimalLength())-1), 2 ) /  *m_cste_FlCE_2 );
 }
 
+double biorbd::muscles::HillThelenType::FlCEActivationDerivative(
+        const biorbd::muscles::State &)
+{
+    return 0;
+}
+
 void biorbd::muscles::HillThelenType::setType()
 {
     *m_type = biorbd::muscles::MUSCLE_TYPE::HILL_THELEN;
@@ -85,6 +85,12 @@ void biorbd::muscles::HillThelenTypeFatigable::DeepCopy(const biorbd::muscles::H
     biorbd::muscles::FatigueModel::DeepCopy(other);
 }
 
+void biorbd::muscles::HillThelenTypeFatigable::detachWorkspace()
+{
+    biorbd::muscles::HillThelenType::detachWorkspace();
+    biorbd::muscles::FatigueModel::detachWorkspace();
+}
+
 void biorbd::muscles::HillThelenTypeFatigable::computeFlCE(const biorbd::muscles::StateDynamics &EMG)
 {
     biorbd::muscles::HillThelenType::computeFlCE(EMG);
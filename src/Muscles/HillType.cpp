@@ -184,6 +184,15 @@ void biorbd::muscles::HillType::DeepCopy(const biorbd::muscles::HillType &other)
     *m_cste_maxShorteningSpeed = *other.m_cste_maxShorteningSpeed;
 }
 
+void biorbd::muscles::HillType::detachWorkspace()
+{
+    biorbd::muscles::Muscle::detachWorkspace();
+    m_damping = std::make_shared<double>(*m_damping);
+    m_FlCE = std::make_shared<double>(*m_FlCE);
+    m_FlPE = std::make_shared<double>(*m_FlPE);
+    m_FvCE = std::make_shared<double>(*m_FvCE);
+}
+
 const std::vector<std::shared_ptr<biorbd::muscles::Force> > &biorbd::muscles::HillType::force(
         const biorbd::muscles::StateDynamics& emg){
     // Compute the forces of each element
@@ -293,6 +302,22 @@ double biorbd::muscles::HillType::getForceFromActivation(
     return characteristics().forceIsoMax() * (emg.activation() * *m_FlCE * *m_FvCE + *m_FlPE + *m_damping);
 }
 
+double biorbd::muscles::HillType::forceActivationDerivative(
+        const biorbd::muscles::State &emg)
+{
+    // Derivative of forceIsoMax * (a * FlCE(a) * FvCE + FlPE + damping)
+    return characteristics().forceIsoMax() * *m_FvCE * (*m_FlCE + emg.activation() * FlCEActivationDerivative(emg));
+}
+
+double biorbd::muscles::HillType::FlCEActivationDerivative(
+        const biorbd::muscles::State &emg)
+{
+    // The optimal length is shifted by the activation
+    double shift(*m_cste_FlCE_1*(1-emg.activation())+1);
+    double normLength(position().length() / m_characteristics->optimalLength() / shift);
+    return *m_FlCE * -2*(normLength-1) / *m_cste_FlCE_2 * normLength * *m_cste_FlCE_1 / shift;
+}
+
 biorbd::muscles::StateDynamics biorbd::muscles::HillType::normalizeEMG(const biorbd::muscles::StateDynamics &emg){
     biorbd::muscles::StateDynamics emg_out(emg);
     emg_out.normalizeExcitation(characteristics().stateMax());
@@ -109,6 +109,12 @@ double biorbd::muscles::IdealizedActuator::getForceFromActivation(
     return characteristics().forceIsoMax() * (emg.activation());
 }
 
+double biorbd::muscles::IdealizedActuator::forceActivationDerivative(
+        const biorbd::muscles::State &)
+{
+    return characteristics().forceIsoMax();
+}
+
 void biorbd::muscles::IdealizedActuator::setType()
 {
     *m_type = biorbd::muscles::MUSCLE_TYPE::IDEALIZED_ACTUATOR;
@@ -2,6 +2,7 @@
 #include "Muscles/Muscle.h"
 
 #include "Utils/Error.h"
+#include "Utils/Vector3d.h"
 #include "RigidBody/Joints.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "Muscles/PathModifiers.h"
@@ -98,11 +99,21 @@ biorbd::muscles::Muscle::~Muscle()
 
 void biorbd::muscles::Muscle::DeepCopy(const biorbd::muscles::Muscle &other)
 {
+    biorbd::muscles::Compound::DeepCopy(other);
+    biorbd::muscles::Geometry previous(*m_position);
     *m_position = other.m_position->DeepCopy();
+    m_position->bindJacobianLength(previous);
     *m_characteristics = other.m_characteristics->DeepCopy();
     *m_state = other.m_state->DeepCopy();
 }
 
+void biorbd::muscles::Muscle::detachWorkspace()
+{
+    biorbd::muscles::Compound::detachWorkspace();
+    m_position = std::make_shared<biorbd::muscles::Geometry>(m_position->DeepCopy());
+    setState(*m_state);
+}
+
 void biorbd::muscles::Muscle::updateOrientations(
         biorbd::rigidbody::Joints& model,
         const biorbd::rigidbody::GeneralizedCoordinates &Q,
@@ -138,12 +149,22 @@ void biorbd::muscles::Muscle::updateOrientations(
 void biorbd::muscles::Muscle::setPosition(
         const biorbd::muscles::Geometry &positions)
 {
+    // The muscle length jacobian keeps being written in the same row
+    biorbd::muscles::Geometry previous(*m_position);
     *m_position = positions;
+    m_position->bindJacobianLength(previous);
 }
 const biorbd::muscles::Geometry &biorbd::muscles::Muscle::position() const {
     return *m_position;
 }
 
+void biorbd::muscles::Muscle::bindJacobianLength(
+        const std::shared_ptr<biorbd::utils::Matrix> &jacobians,
+        unsigned int row)
+{
+    m_position->bindJacobianLength(jacobians, row);
+}
+
 double biorbd::muscles::Muscle::length(
         biorbd::rigidbody::Joints& model,
         const biorbd::rigidbody::GeneralizedCoordinates &Q,
@@ -191,7 +212,7 @@ void biorbd::muscles::Muscle::computeForce(const biorbd::muscles::State &emg)
     (*m_force)[1]->setForceFromMuscleGeometry(*m_position, force); // insertion vers l'avant-dernier point
 }
 
-const std::vector<biorbd::utils::Vector3d>& biorbd::muscles::Muscle::musclesPointsInGlobal(
+std::vector<biorbd::utils::Vector3d> biorbd::muscles::Muscle::musclesPointsInGlobal(
         biorbd::rigidbody::Joints &model,
         const biorbd::rigidbody::GeneralizedCoordinates &Q)
 {
@@ -200,11 +221,16 @@ const std::vector<biorbd::utils::Vector3d>& biorbd::muscles::Muscle::musclesPoin
     return musclesPointsInGlobal();
 }
 
-const std::vector<biorbd::utils::Vector3d> &biorbd::muscles::Muscle::musclesPointsInGlobal() const
+std::vector<biorbd::utils::Vector3d> biorbd::muscles::Muscle::musclesPointsInGlobal() const
 {
     return m_position->musclesPointsInGlobal();
 }
 
+const Eigen::Matrix3Xd &biorbd::muscles::Muscle::musclesPointsInGlobalInMatrix() const
+{
+    return m_position->musclesPointsInGlobalInMatrix();
+}
+
 void biorbd::muscles::Muscle::setForceIsoMax(double forceMax)
 {
     m_characteristics->setForceIsoMax(forceMax);
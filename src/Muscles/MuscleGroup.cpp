@@ -51,25 +51,49 @@ biorbd::muscles::MuscleGroup biorbd::muscles::MuscleGroup::DeepCopy() const
 
 void biorbd::muscles::MuscleGroup::DeepCopy(const biorbd::muscles::MuscleGroup &other)
 {
+    // Each muscle is deep copied, so the copy never writes in the muscles (and their geometry) of the other group
     m_mus->resize(other.m_mus->size());
     for (unsigned int i=0; i<other.m_mus->size(); ++i){
         if ((*other.m_mus)[i]->type() == biorbd::muscles::MUSCLE_TYPE::IDEALIZED_ACTUATOR)
-            (*m_mus)[i] = std::make_shared<biorbd::muscles::IdealizedActuator>((*other.m_mus)[i]);
+            (*m_mus)[i] = std::make_shared<biorbd::muscles::IdealizedActuator>(
+                        std::static_pointer_cast<biorbd::muscles::IdealizedActuator>((*other.m_mus)[i])->DeepCopy());
         else if ((*other.m_mus)[i]->type() == biorbd::muscles::MUSCLE_TYPE::HILL)
-            (*m_mus)[i] = std::make_shared<biorbd::muscles::HillType>((*other.m_mus)[i]);
+            (*m_mus)[i] = std::make_shared<biorbd::muscles::HillType>(
+                        std::static_pointer_cast<biorbd::muscles::HillType>((*other.m_mus)[i])->DeepCopy());
         else if ((*other.m_mus)[i]->type() == biorbd::muscles::MUSCLE_TYPE::HILL_THELEN)
-            (*m_mus)[i] = std::make_shared<biorbd::muscles::HillThelenType>((*other.m_mus)[i]);
+            (*m_mus)[i] = std::make_shared<biorbd::muscles::HillThelenType>(
+                        std::static_pointer_cast<biorbd::muscles::HillThelenType>((*other.m_mus)[i])->DeepCopy());
         else if ((*other.m_mus)[i]->type() == biorbd::muscles::MUSCLE_TYPE::HILL_THELEN_FATIGABLE)
-            (*m_mus)[i] = std::make_shared<biorbd::muscles::HillThelenTypeFatigable>((*other.m_mus)[i]);
+            (*m_mus)[i] = std::make_shared<biorbd::muscles::HillThelenTypeFatigable>(
+                        std::static_pointer_cast<biorbd::muscles::HillThelenTypeFatigable>((*other.m_mus)[i])->DeepCopy());
         else
             biorbd::utils::Error::raise("DeepCopy was not prepared to copy " + biorbd::utils::String(biorbd::muscles::MUSCLE_TYPE_toStr((*other.m_mus)[i]->type())) + " type");
     }
-    *m_mus = *other.m_mus;
     *m_name = *other.m_name;
     *m_originName = *other.m_originName;
     *m_insertName = *other.m_insertName;
 }
 
+void biorbd::muscles::MuscleGroup::detachWorkspace()
+{
+    std::shared_ptr<std::vector<std::shared_ptr<biorbd::muscles::Muscle>>> muscles(
+                std::make_shared<std::vector<std::shared_ptr<biorbd::muscles::Muscle>>>(m_mus->size()));
+    for (unsigned int i=0; i<m_mus->size(); ++i){
+        if ((*m_mus)[i]->type() == biorbd::muscles::MUSCLE_TYPE::IDEALIZED_ACTUATOR)
+            (*muscles)[i] = std::make_shared<biorbd::muscles::IdealizedActuator>((*m_mus)[i]);
+        else if ((*m_mus)[i]->type() == biorbd::muscles::MUSCLE_TYPE::HILL)
+            (*muscles)[i] = std::make_shared<biorbd::muscles::HillType>((*m_mus)[i]);
+        else if ((*m_mus)[i]->type() == biorbd::muscles::MUSCLE_TYPE::HILL_THELEN)
+            (*muscles)[i] = std::make_shared<biorbd::muscles::HillThelenType>((*m_mus)[i]);
+        else if ((*m_mus)[i]->type() == biorbd::muscles::MUSCLE_TYPE::HILL_THELEN_FATIGABLE)
+            (*muscles)[i] = std::make_shared<biorbd::muscles::HillThelenTypeFatigable>((*m_mus)[i]);
+        else
+            biorbd::utils::Error::raise("detachWorkspace was not prepared to copy " + biorbd::utils::String(biorbd::muscles::MUSCLE_TYPE_toStr((*m_mus)[i]->type())) + " type");
+        (*muscles)[i]->detachWorkspace();
+    }
+    m_mus = muscles;
+}
+
 void biorbd::muscles::MuscleGroup::addMuscle(
         const biorbd::utils::String &name,
         biorbd::muscles::MUSCLE_TYPE type,
@@ -3,6 +3,7 @@
 
 #include "Utils/Error.h"
 #include "Utils/Matrix.h"
+#include "Utils/ThreadDispatcher.h"
 #include "RigidBody/Joints.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/GeneralizedTorque.h"
@@ -13,13 +14,17 @@
 #include "Muscles/Force.h"
 
 biorbd::muscles::Muscles::Muscles() :
-    m_mus(std::make_shared<std::vector<biorbd::muscles::MuscleGroup>>())
+    m_mus(std::make_shared<std::vector<biorbd::muscles::MuscleGroup>>()),
+    m_allMuscles(std::make_shared<std::vector<biorbd::muscles::Muscle*>>()),
+    m_musclesLengthJacobian(std::make_shared<biorbd::utils::Matrix>())
 {
 
 }
 
 biorbd::muscles::Muscles::Muscles(const biorbd::muscles::Muscles &other) :
-    m_mus(other.m_mus)
+    m_mus(other.m_mus),
+    m_allMuscles(other.m_allMuscles),
+    m_musclesLengthJacobian(other.m_musclesLengthJacobian)
 {
 
 }
@@ -40,7 +45,19 @@ void biorbd::muscles::Muscles::DeepCopy(const biorbd::muscles::Muscles &other)
 {
     m_mus->resize(other.m_mus->size());
     for (unsigned int i=0; i<other.m_mus->size(); ++i)
-        (*m_mus)[i] = (*other.m_mus)[i];
+        (*m_mus)[i] = (*other.m_mus)[i].DeepCopy();
+    *m_musclesLengthJacobian = *other.m_musclesLengthJacobian;
+    indexMuscles();
+}
+
+void biorbd::muscles::Muscles::detachWorkspace()
+{
+    m_mus = std::make_shared<std::vector<biorbd::muscles::MuscleGroup>>(*m_mus);
+    for (auto& group : *m_mus)
+        group.detachWorkspace();
+    m_allMuscles = std::make_shared<std::vector<biorbd::muscles::Muscle*>>();
+    m_musclesLengthJacobian = std::make_shared<biorbd::utils::Matrix>(*m_musclesLengthJacobian);
+    indexMuscles();
 }
 
 
@@ -78,6 +95,45 @@ const biorbd::muscles::MuscleGroup &biorbd::muscles::Muscles::muscleGroup(const
     return muscleGroup(static_cast<unsigned int>(idx));
 }
 
+biorbd::muscles::Muscle &biorbd::muscles::Muscles::muscle(unsigned int idx)
+{
+    biorbd::utils::Error::check(idx<nbMuscleTotal(), "Idx asked is higher than number of muscles");
+    return *allMuscles()[idx];
+}
+
+const biorbd::muscles::Muscle &biorbd::muscles::Muscles::muscle(unsigned int idx) const
+{
+    biorbd::utils::Error::check(idx<nbMuscleTotal(), "Idx asked is higher than number of muscles");
+    return *allMuscles()[idx];
+}
+
+const std::vector<biorbd::muscles::Muscle*> &biorbd::muscles::Muscles::allMuscles() const
+{
+    if (m_allMuscles->size() != nbMuscleTotal())
+        indexMuscles();
+    return *m_allMuscles;
+}
+
+void biorbd::muscles::Muscles::indexMuscles() const
+{
+    m_allMuscles->clear();
+    for (auto& group : *m_mus)
+        for (unsigned int j=0; j<group.nbMuscles(); ++j)
+            m_allMuscles->push_back(&group.muscle(j));
+
+    // Each muscle writes its length jacobian in its own row of a matrix that is fully sized before being bound
+    // Assuming that this is also a Joints type (via BiorbdModel)
+    const biorbd::rigidbody::Joints &model = dynamic_cast<const biorbd::rigidbody::Joints &>(*this);
+    unsigned int nbMuscles(static_cast<unsigned int>(m_allMuscles->size()));
+    if (static_cast<unsigned int>(m_musclesLengthJacobian->rows()) != nbMuscles
+            || static_cast<unsigned int>(m_musclesLengthJacobian->cols()) != model.dof_count){
+        m_musclesLengthJacobian->resize(nbMuscles, model.dof_count);
+        m_musclesLengthJacobian->setZero();
+    }
+    for (unsigned int i=0; i<nbMuscles; ++i)
+        (*m_allMuscles)[i]->bindJacobianLength(m_musclesLengthJacobian, i);
+}
+
 // From muscle activation (return muscle force)
 biorbd::rigidbody::GeneralizedTorque biorbd::muscles::Muscles::muscularJointTorque(
         const std::vector<std::shared_ptr<biorbd::muscles::StateDynamics>> &emg,
@@ -121,12 +177,33 @@ biorbd::rigidbody::GeneralizedTorque biorbd::muscles::Muscles::muscularJointTorq
     if (updateKin)
         updateMuscles(*Q,*QDot,updateKin);
 
-    // Get the Jacobian matrix and get the forces of each muscle
-
+    // Compute the reaction of the forces on the bodies as a single product with the muscle length jacobian
     const biorbd::utils::Matrix& jaco(musclesLengthJacobian());
+    biorbd::rigidbody::GeneralizedTorque tau(static_cast<unsigned int>(jaco.cols()));
+    tau.noalias() = -jaco.transpose() * F;
+    return tau;
+}
 
-    // Compute the reaction of the forces on the bodies
-    return biorbd::rigidbody::GeneralizedTorque( -jaco.transpose() * F );
+biorbd::utils::Matrix biorbd::muscles::Muscles::muscularJointTorqueActivationJacobian(
+        const std::vector<std::shared_ptr<biorbd::muscles::StateDynamics>> &emg,
+        bool updateKin,
+        const biorbd::rigidbody::GeneralizedCoordinates* Q,
+        const biorbd::rigidbody::GeneralizedCoordinates* QDot)
+{
+    // Update the muscular position
+    if (updateKin)
+        updateMuscles(*Q,*QDot,updateKin);
+
+    // Derivative of the force of each muscle with respect to its own activation
+    const std::vector<biorbd::muscles::Muscle*>& muscles(allMuscles());
+    biorbd::utils::Vector dFda(static_cast<unsigned int>(muscles.size()));
+    for (unsigned int i=0; i<muscles.size(); ++i){
+        muscles[i]->force(*emg[i]);
+        dFda(i) = muscles[i]->forceActivationDerivative(*emg[i]);
+    }
+
+    // The torque is linear in the forces
+    return -musclesLengthJacobian().transpose() * dFda.asDiagonal();
 }
 
 std::vector<std::vector<std::shared_ptr<biorbd::muscles::Force>>> biorbd::muscles::Muscles::musclesForces(
@@ -142,10 +219,9 @@ std::vector<std::vector<std::shared_ptr<biorbd::muscles::Force>>> biorbd::muscle
     // Output variable
     std::vector<std::vector<std::shared_ptr<biorbd::muscles::Force>>> forces; // All the muscles/two pointers per muscleTous les muscles (origine/insertion)
 
-    unsigned int cmpMus(0);
-    for (unsigned int i=0; i<m_mus->size(); ++i) // muscle group
-        for (unsigned int j=0; j<(*m_mus)[i].nbMuscles(); ++j)
-            forces.push_back((*m_mus)[i].muscle(j).force(*emg[cmpMus++]));
+    const std::vector<biorbd::muscles::Muscle*>& muscles(allMuscles());
+    for (unsigned int i=0; i<muscles.size(); ++i)
+        forces.push_back(muscles[i]->force(*emg[i]));
 
     // The forces
     return forces;
@@ -155,22 +231,15 @@ unsigned int biorbd::muscles::Muscles::nbMuscleGroups() const {
     return static_cast<unsigned int>(m_mus->size());
 }
 
-biorbd::utils::Matrix biorbd::muscles::Muscles::musclesLengthJacobian()
+const biorbd::utils::Matrix& biorbd::muscles::Muscles::musclesLengthJacobian()
 {
-    // Assuming that this is also a Joints type (via BiorbdModel)
-    const biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
-
-    biorbd::utils::Matrix tp(nbMuscleTotal(), model.nbDof());
-    unsigned int cmpMus(0);
-    for (unsigned int i=0; i<nbMuscleGroups(); ++i)
-        for (unsigned int j=0; j<((*m_mus)[i]).nbMuscles(); ++j)
-            tp.block(cmpMus++,0,1,model.nbDof()) = ((*m_mus)[i]).muscle(j).position().jacobianLength();
-
-    return tp;
-
+    // The rows are written by each muscle when its geometry is updated
+    allMuscles();
+    setMusclesLengthJacobianDimension();
+    return *m_musclesLengthJacobian;
 }
 
-biorbd::utils::Matrix biorbd::muscles::Muscles::musclesLengthJacobian(
+const biorbd::utils::Matrix& biorbd::muscles::Muscles::musclesLengthJacobian(
         const biorbd::rigidbody::GeneralizedCoordinates &Q)
 {
     // Update the muscular position
@@ -178,6 +247,18 @@ biorbd::utils::Matrix biorbd::muscles::Muscles::musclesLengthJacobian(
     return musclesLengthJacobian();
 }
 
+void biorbd::muscles::Muscles::setMusclesLengthJacobianDimension()
+{
+    // Assuming that this is also a Joints type (via BiorbdModel)
+    const biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
+
+    // Only reallocate if the number of dof changed, the rows being sized when the muscles are indexed.
+    // The columns are the ones of the jacobian of the muscle points, which the geometries then only check
+    if (static_cast<unsigned int>(m_musclesLengthJacobian->cols()) != model.dof_count){
+        m_musclesLengthJacobian->resize(m_musclesLengthJacobian->rows(), model.dof_count);
+        m_musclesLengthJacobian->setZero();
+    }
+}
 
 unsigned int biorbd::muscles::Muscles::nbMuscleTotal() const{
     unsigned int total(0);
@@ -189,66 +270,63 @@ unsigned int biorbd::muscles::Muscles::nbMuscleTotal() const{
 void biorbd::muscles::Muscles::updateMuscles(
         const biorbd::rigidbody::GeneralizedCoordinates& Q,
         const biorbd::rigidbody::GeneralizedCoordinates& QDot,
-        bool updateKin)
+        bool updateKin,
+        unsigned int nbThreads)
 {
     // Assuming that this is also a Joints type (via BiorbdModel)
     biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
 
-    // Update all the muscles
-    int updateKinTP;
+    // The kinematics is updated once, the muscles then only read it
     if (updateKin)
-        updateKinTP = 2;
-    else
-        updateKinTP = 0;
-
-    for (auto group : *m_mus) // muscle group
-        for (unsigned int j=0; j<group.nbMuscles(); ++j){
-            group.muscle(j).updateOrientations(model, Q, QDot, updateKinTP);
-            updateKinTP=1;
-        }
+        model.UpdateKinematicsCustom(&Q, &QDot, nullptr);
+
+    // Update all the muscles, the shared length jacobian being sized before the workers write their rows in it
+    const std::vector<biorbd::muscles::Muscle*>& muscles(allMuscles());
+    setMusclesLengthJacobianDimension();
+    biorbd::utils::ThreadDispatcher(nbThreads).run(static_cast<unsigned int>(muscles.size()),
+                                             [&](unsigned int, unsigned int first, unsigned int last){
+        for (unsigned int i=first; i<last; ++i)
+            muscles[i]->updateOrientations(model, Q, QDot, 1);
+    });
 }
 void biorbd::muscles::Muscles::updateMuscles(
         const biorbd::rigidbody::GeneralizedCoordinates& Q,
-        bool updateKin)
+        bool updateKin,
+        unsigned int nbThreads)
 {
     // Assuming that this is also a Joints type (via BiorbdModel)
     biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
 
-    // Update all the muscles
-    int updateKinTP;
+    // The kinematics is updated once, the muscles then only read it
     if (updateKin)
-        updateKinTP = 2;
-    else
-        updateKinTP = 0;
-
-    // Update all the muscles
-    for (auto group : *m_mus) // muscle group
-        for (unsigned int j=0; j<group.nbMuscles(); ++j){
-            group.muscle(j).updateOrientations(model, Q,updateKinTP);
-            updateKinTP=1;
-        }
+        model.UpdateKinematicsCustom(&Q, nullptr, nullptr);
+
+    // Update all the muscles, the shared length jacobian being sized before the workers write their rows in it
+    const std::vector<biorbd::muscles::Muscle*>& muscles(allMuscles());
+    setMusclesLengthJacobianDimension();
+    biorbd::utils::ThreadDispatcher(nbThreads).run(static_cast<unsigned int>(muscles.size()),
+                                             [&](unsigned int, unsigned int first, unsigned int last){
+        for (unsigned int i=first; i<last; ++i)
+            muscles[i]->updateOrientations(model, Q, 1);
+    });
 }
 void biorbd::muscles::Muscles::updateMuscles(
         std::vector<std::vector<biorbd::utils::Vector3d>>& musclePointsInGlobal,
         std::vector<biorbd::utils::Matrix> &jacoPointsInGlobal,
         const biorbd::rigidbody::GeneralizedCoordinates& QDot)
 {
-    unsigned int cmpMuscle = 0;
-    for (auto group : *m_mus) // muscle  group
-        for (unsigned int j=0; j<group.nbMuscles(); ++j){
-            group.muscle(j).updateOrientations(musclePointsInGlobal[cmpMuscle], jacoPointsInGlobal[cmpMuscle], QDot);
-            ++cmpMuscle;
-        }
+    const std::vector<biorbd::muscles::Muscle*>& muscles(allMuscles());
+    setMusclesLengthJacobianDimension();
+    for (unsigned int i=0; i<muscles.size(); ++i)
+        muscles[i]->updateOrientations(musclePointsInGlobal[i], jacoPointsInGlobal[i], QDot);
 }
 void biorbd::muscles::Muscles::updateMuscles(
         std::vector<std::vector<biorbd::utils::Vector3d>>& musclePointsInGlobal,
         std::vector<biorbd::utils::Matrix> &jacoPointsInGlobal)
 {
     // Updater all the muscles
-    unsigned int cmpMuscle = 0;
-    for (auto group : *m_mus) // muscle group
-        for (unsigned int j=0; j<group.nbMuscles(); ++j){
-            group.muscle(j).updateOrientations(musclePointsInGlobal[cmpMuscle], jacoPointsInGlobal[cmpMuscle]);
-            ++cmpMuscle;
-        }
+    const std::vector<biorbd::muscles::Muscle*>& muscles(allMuscles());
+    setMusclesLengthJacobianDimension();
+    for (unsigned int i=0; i<muscles.size(); ++i)
+        muscles[i]->updateOrientations(musclePointsInGlobal[i], jacoPointsInGlobal[i]);
 }
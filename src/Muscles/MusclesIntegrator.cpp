@@ -0,0 +1,138 @@
+#define BIORBD_API_EXPORTS
+#include "Muscles/MusclesIntegrator.h"
+
+#include <Eigen/Dense>
+#include <rbdl/Dynamics.h>
+
+#include "BiorbdModel.h"
+#include "Utils/Error.h"
+#include "RigidBody/GeneralizedCoordinates.h"
+#include "RigidBody/GeneralizedTorque.h"
+#include "Muscles/Muscle.h"
+#include "Muscles/MuscleGroup.h"
+#include "Muscles/StateDynamics.h"
+#include "Muscles/FatigueModel.h"
+#include "Muscles/FatigueDynamicState.h"
+
+biorbd::muscles::MusclesIntegrator::MusclesIntegrator(
+        biorbd::Model &model) :
+    biorbd::rigidbody::Integrator(model),
+    m_musculoskeletalModel(&model),
+    m_workspace(std::make_shared<biorbd::Model>(model)),
+    m_states(std::make_shared<std::vector<std::shared_ptr<biorbd::muscles::StateDynamics>>>())
+{
+    for (unsigned int i=0; i<model.nbMuscleTotal(); ++i)
+        m_states->push_back(std::make_shared<biorbd::muscles::StateDynamics>());
+    m_workspace->detachWorkspace();
+}
+
+biorbd::muscles::MusclesIntegrator::~MusclesIntegrator()
+{
+
+}
+
+biorbd::muscles::MusclesIntegrator biorbd::muscles::MusclesIntegrator::DeepCopy() const
+{
+    biorbd::muscles::MusclesIntegrator copy(*m_musculoskeletalModel);
+    copy.DeepCopy(*this);
+    return copy;
+}
+
+void biorbd::muscles::MusclesIntegrator::DeepCopy(
+        const biorbd::muscles::MusclesIntegrator &other)
+{
+    biorbd::rigidbody::Integrator::DeepCopy(other);
+    m_musculoskeletalModel = other.m_musculoskeletalModel;
+    m_workspace = std::make_shared<biorbd::Model>(*other.m_musculoskeletalModel);
+    m_workspace->detachWorkspace();
+    m_states->resize(other.m_states->size());
+    for (unsigned int i=0; i<other.m_states->size(); ++i)
+        (*m_states)[i] = std::make_shared<biorbd::muscles::StateDynamics>((*other.m_states)[i]->DeepCopy());
+}
+
+unsigned int biorbd::muscles::MusclesIntegrator::nbStates() const
+{
+    return biorbd::rigidbody::Integrator::nbStates()
+            + m_musculoskeletalModel->nbMuscleTotal() + nbFatigueStates();
+}
+
+unsigned int biorbd::muscles::MusclesIntegrator::nbFatigueStates() const
+{
+    unsigned int nbFatigue(0);
+    for (unsigned int i=0; i<m_musculoskeletalModel->nbMuscleGroups(); ++i){
+        const biorbd::muscles::MuscleGroup& group(m_musculoskeletalModel->muscleGroup(i));
+        for (unsigned int j=0; j<group.nbMuscles(); ++j)
+            if (hasFatigueStates(group.muscle(j)))
+                nbFatigue += 3;
+    }
+    return nbFatigue;
+}
+
+void biorbd::muscles::MusclesIntegrator::operator() (
+        const state_type &x,
+        state_type &dxdt,
+        double ){
+    biorbd::Model& model(*m_workspace);
+    biorbd::utils::Error::check(static_cast<size_t>(m_u->size()) == m_states->size(),
+                                "The effectors of the muscles integrator must be the excitation of each muscle");
+
+    *m_Q = Eigen::Map<const Eigen::VectorXd>(x.data(), *m_nQ);
+    *m_Qdot = Eigen::Map<const Eigen::VectorXd>(x.data() + *m_nQ, *m_nQdot);
+
+    // Activation dynamics, the fatigue states being stored after all the activations
+    unsigned int idxActivation(*m_nQ + *m_nQdot);
+    unsigned int idxFatigue(idxActivation + static_cast<unsigned int>(m_states->size()));
+    unsigned int cmpMus(0);
+    for (unsigned int i=0; i<model.nbMuscleGroups(); ++i){
+        biorbd::muscles::MuscleGroup& group(model.muscleGroup(i));
+        for (unsigned int j=0; j<group.nbMuscles(); ++j){
+            biorbd::muscles::Muscle& muscle(group.muscle(j));
+            biorbd::muscles::StateDynamics& state(*(*m_states)[cmpMus]);
+            state.setExcitation((*m_u)(cmpMus));
+            state.setActivation(x[idxActivation + cmpMus]);
+            dxdt[idxActivation + cmpMus] = muscle.activationDot(state, true);
+
+            // The fatigue state is set into the muscle of the workspace so the force accounts for it
+            if (hasFatigueStates(muscle)){
+                biorbd::muscles::FatigueModel& fatigue(dynamic_cast<biorbd::muscles::FatigueModel&>(muscle));
+                fatigue.setFatigueState(x[idxFatigue], x[idxFatigue+1], x[idxFatigue+2]);
+                fatigue.computeTimeDerivativeState(state);
+                const biorbd::muscles::FatigueDynamicState& fatigueState(
+                            static_cast<const biorbd::muscles::FatigueDynamicState&>(fatigue.fatigueState()));
+                dxdt[idxFatigue] = fatigueState.activeFibersDot();
+                dxdt[idxFatigue+1] = fatigueState.fatiguedFibersDot();
+                dxdt[idxFatigue+2] = fatigueState.restingFibersDot();
+                idxFatigue += 3;
+            }
+            ++cmpMus;
+        }
+    }
+
+    // Skeletal dynamics driven by the muscles
+    const biorbd::rigidbody::GeneralizedTorque& tau(
+                model.muscularJointTorque(*m_states, true, m_Q.get(), m_Qdot.get()));
+    m_Qddot->setZero();
+    RigidBodyDynamics::ForwardDynamics (model, *m_Q, *m_Qdot, tau, *m_Qddot);
+    model.invalidateKinematicsCache();
+
+    coordinatesDerivative(dxdt);
+    Eigen::Map<Eigen::VectorXd>(dxdt.data() + *m_nQ, *m_nQdot) = *m_Qddot;
+}
+
+void biorbd::muscles::MusclesIntegrator::prepareBuffers()
+{
+    biorbd::rigidbody::Integrator::prepareBuffers();
+
+    // The workspace is taken again so it follows the current parameters of the model
+    m_workspace = std::make_shared<biorbd::Model>(*m_musculoskeletalModel);
+    m_workspace->detachWorkspace();
+}
+
+bool biorbd::muscles::MusclesIntegrator::hasFatigueStates(
+        const biorbd::muscles::Muscle &muscle)
+{
+    if (muscle.type() != biorbd::muscles::MUSCLE_TYPE::HILL_THELEN_FATIGABLE)
+        return false;
+    return dynamic_cast<const biorbd::muscles::FatigueModel&>(muscle).fatigueState().getType()
+            == biorbd::muscles::STATE_FATIGUE_TYPE::DYNAMIC_XIA;
+}
@@ -5,6 +5,7 @@
 #include "BiorbdModel.h"
 #include "Utils/Error.h"
 #include "Utils/Vector.h"
+#include "Utils/ThreadDispatcher.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/GeneralizedTorque.h"
 #include "Muscles/StateDynamics.h"
@@ -20,6 +21,7 @@ biorbd::muscles::StaticOptimization::StaticOptimization(biorbd::Model &model) :
     m_pNormFactor(std::make_shared<unsigned int>()),
     m_verbose(std::make_shared<int>()),
     m_staticOptimProblem(std::make_shared<std::vector<Ipopt::SmartPtr<Ipopt::TNLP>>>()),
+    m_workspaces(std::make_shared<std::vector<biorbd::Model>>()),
     m_alreadyRun(std::make_shared<bool>(false))
 {
 
@@ -43,6 +45,7 @@ biorbd::muscles::StaticOptimization::StaticOptimization(
     m_pNormFactor(std::make_shared<unsigned int>(pNormFactor)),
     m_verbose(std::make_shared<int>(verbose)),
     m_staticOptimProblem(std::make_shared<std::vector<Ipopt::SmartPtr<Ipopt::TNLP>>>()),
+    m_workspaces(std::make_shared<std::vector<biorbd::Model>>()),
     m_alreadyRun(std::make_shared<bool>(false))
 {
     m_allQ->push_back(Q);
@@ -77,6 +80,7 @@ biorbd::muscles::StaticOptimization::StaticOptimization(
     m_pNormFactor(std::make_shared<unsigned int>(pNormFactor)),
     m_verbose(std::make_shared<int>(verbose)),
     m_staticOptimProblem(std::make_shared<std::vector<Ipopt::SmartPtr<Ipopt::TNLP>>>()),
+    m_workspaces(std::make_shared<std::vector<biorbd::Model>>()),
     m_alreadyRun(std::make_shared<bool>(false))
 {
     m_allQ->push_back(Q);
@@ -111,6 +115,7 @@ biorbd::muscles::StaticOptimization::StaticOptimization(
     m_pNormFactor(std::make_shared<unsigned int>(pNormFactor)),
     m_verbose(std::make_shared<int>(verbose)),
     m_staticOptimProblem(std::make_shared<std::vector<Ipopt::SmartPtr<Ipopt::TNLP>>>()),
+    m_workspaces(std::make_shared<std::vector<biorbd::Model>>()),
     m_alreadyRun(std::make_shared<bool>(false))
 {
     if (initialActivationGuess.size() == 0){
@@ -140,6 +145,7 @@ biorbd::muscles::StaticOptimization::StaticOptimization(
     m_pNormFactor(std::make_shared<unsigned int>(pNormFactor)),
     m_verbose(std::make_shared<int>(verbose)),
     m_staticOptimProblem(std::make_shared<std::vector<Ipopt::SmartPtr<Ipopt::TNLP>>>()),
+    m_workspaces(std::make_shared<std::vector<biorbd::Model>>()),
     m_alreadyRun(std::make_shared<bool>(false))
 {
     *m_initialActivationGuess = biorbd::utils::Vector(m_model.nbMuscleTotal());
@@ -170,48 +176,80 @@ biorbd::muscles::StaticOptimization biorbd::muscles::StaticOptimization::DeepCop
     *copy.m_initialActivationGuess = *m_initialActivationGuess;
     *copy.m_pNormFactor = *m_pNormFactor;
     *copy.m_verbose = *m_verbose;
-    *copy.m_staticOptimProblem = *m_staticOptimProblem;
-    *copy.m_alreadyRun = *m_alreadyRun;
+    // The problems refer to the workspaces of this optimization, which are rebuilt at each run,
+    // so the copy has to be run on its own workspaces
     return copy;
 }
 
 void biorbd::muscles::StaticOptimization::run(
-        bool useLinearizedState)
+        bool useLinearizedState,
+        unsigned int nbThreads,
+        bool isLinearSolverThreadSafe)
 {
-    // Setup the Ipopt problem
-    Ipopt::SmartPtr<Ipopt::IpoptApplication> app = IpoptApplicationFactory();
-    app->Options()->SetNumericValue("tol", 1e-7);
-    app->Options()->SetStringValue("mu_strategy", "adaptive");
-    //app->Options()->SetStringValue("output_file", "ipopt.out");
-    app->Options()->SetStringValue("hessian_approximation", "limited-memory");
-    app->Options()->SetStringValue("derivative_test", "first-order");
-    app->Options()->SetIntegerValue("max_iter", 10000);
-
-    Ipopt::ApplicationReturnStatus status;
-    status = app->Initialize();
-    biorbd::utils::Error::check(status == Ipopt::Solve_Succeeded, "Ipopt initialization failed");
-
-    for (unsigned int i=0; i<m_allQ->size(); ++i){
-        if (useLinearizedState)
-            m_staticOptimProblem->push_back(
-                        new biorbd::muscles::StaticOptimizationIpoptLinearized(
-                            m_model, (*m_allQ)[i], (*m_allQdot)[i], (*m_allTorqueTarget)[i], *m_initialActivationGuess,
-                            *m_useResidualTorque, *m_pNormFactor, *m_verbose
-                            )
-                        );
-        else
-            m_staticOptimProblem->push_back(
-                        new biorbd::muscles::StaticOptimizationIpopt(
-                            m_model, (*m_allQ)[i], (*m_allQdot)[i], (*m_allTorqueTarget)[i], *m_initialActivationGuess,
-                            *m_useResidualTorque, *m_pNormFactor, *m_verbose
-                            )
-                        );
-        // Optimize!
-        status = app->OptimizeTNLP((*m_staticOptimProblem)[i]);
-
-        // Take the solution of the previous optimization as the solution for the next optimization
-        *m_initialActivationGuess = static_cast<biorbd::muscles::StaticOptimizationIpopt*>(Ipopt::GetRawPtr((*m_staticOptimProblem)[i]))->finalSolution();
+    // Only a thread safe linear solver can factorize from many threads at once. The others (MUMPS
+    // by default) have global state, so their solves would be done one at a time and the workspaces
+    // would only add the cost of copying the model
+    if (!isLinearSolverThreadSafe && nbThreads != 1){
+        biorbd::utils::Error::warning(false, "The linear solver of Ipopt is not declared thread safe, the static optimization is run on one thread");
+        nbThreads = 1;
     }
+
+    unsigned int nbFrames(static_cast<unsigned int>(m_allQ->size()));
+    biorbd::utils::ThreadDispatcher dispatcher(nbThreads);
+    unsigned int nbChunks(dispatcher.nbChunks(nbFrames));
+
+    // Every chunk but the first one works on its own workspace of the model.
+    // The vector must not reallocate as the workspaces refer to themselves
+    m_workspaces->clear();
+    m_workspaces->reserve(nbChunks);
+    for (unsigned int i=1; i<nbChunks; ++i){
+        m_workspaces->push_back(m_model);
+        m_workspaces->back().detachWorkspace();
+    }
+    m_staticOptimProblem->clear();
+    m_staticOptimProblem->resize(nbFrames);
+
+    dispatcher.run(nbFrames, [&](unsigned int chunk, unsigned int first, unsigned int last){
+        biorbd::Model& model(chunk == 0 ? m_model : (*m_workspaces)[chunk-1]);
+
+        // Setup the Ipopt problem
+        Ipopt::SmartPtr<Ipopt::IpoptApplication> app = IpoptApplicationFactory();
+        app->Options()->SetNumericValue("tol", 1e-7);
+        app->Options()->SetStringValue("mu_strategy", "adaptive");
+        //app->Options()->SetStringValue("output_file", "ipopt.out");
+        app->Options()->SetStringValue("hessian_approximation", "limited-memory");
+        app->Options()->SetStringValue("derivative_test", "first-order");
+        app->Options()->SetIntegerValue("max_iter", 10000);
+
+        Ipopt::ApplicationReturnStatus status;
+        status = app->Initialize();
+        biorbd::utils::Error::check(status == Ipopt::Solve_Succeeded, "Ipopt initialization failed");
+
+        biorbd::utils::Vector activationGuess(*m_initialActivationGuess);
+        for (unsigned int i=first; i<last; ++i){
+            if (useLinearizedState)
+                (*m_staticOptimProblem)[i] =
+                            new biorbd::muscles::StaticOptimizationIpoptLinearized(
+                                model, (*m_allQ)[i], (*m_allQdot)[i], (*m_allTorqueTarget)[i], activationGuess,
+                                *m_useResidualTorque, *m_pNormFactor, *m_verbose
+                                );
+            else
+                (*m_staticOptimProblem)[i] =
+                            new biorbd::muscles::StaticOptimizationIpopt(
+                                model, (*m_allQ)[i], (*m_allQdot)[i], (*m_allTorqueTarget)[i], activationGuess,
+                                *m_useResidualTorque, *m_pNormFactor, *m_verbose
+                                );
+            // Optimize!
+            status = app->OptimizeTNLP((*m_staticOptimProblem)[i]);
+
+            // Take the solution of the previous optimization as the solution for the next optimization
+            activationGuess = static_cast<biorbd::muscles::StaticOptimizationIpopt*>(Ipopt::GetRawPtr((*m_staticOptimProblem)[i]))->finalSolution();
+        }
+    });
+
+    // Keep the last solution as the guess for a subsequent run
+    if (nbFrames != 0)
+        *m_initialActivationGuess = static_cast<biorbd::muscles::StaticOptimizationIpopt*>(Ipopt::GetRawPtr((*m_staticOptimProblem)[nbFrames-1]))->finalSolution();
     *m_alreadyRun = true;
 }
 
@@ -20,7 +20,7 @@ biorbd::muscles::StaticOptimizationIpopt::StaticOptimizationIpopt(
         bool useResidual,
         unsigned int pNormFactor,
         int verbose,
-        double eps) :
+        double) :
     m_model(model),
     m_nbQ(std::make_shared<unsigned int>(model.nbQ())),
     m_nbQdot(std::make_shared<unsigned int>(model.nbQdot())),
@@ -28,7 +28,6 @@ biorbd::muscles::StaticOptimizationIpopt::StaticOptimizationIpopt(
     m_nbDof(std::make_shared<unsigned int>(model.nbDof())),
     m_nbTorque(std::make_shared<unsigned int>(model.nbGeneralizedTorque())),
     m_nbTorqueResidual(std::make_shared<unsigned int>(*m_nbQ)),
-    m_eps(std::make_shared<double>(eps)),
     m_activations(std::make_shared<biorbd::utils::Vector>(activationInit)),
     m_Q(std::make_shared<biorbd::rigidbody::GeneralizedCoordinates>(Q)),
     m_Qdot(std::make_shared<biorbd::rigidbody::GeneralizedCoordinates>(Qdot)),
@@ -41,9 +40,8 @@ biorbd::muscles::StaticOptimizationIpopt::StaticOptimizationIpopt(
     m_finalSolution(std::make_shared<biorbd::utils::Vector>(biorbd::utils::Vector(*m_nbMus))),
     m_finalResidual(std::make_shared<biorbd::utils::Vector>(biorbd::utils::Vector(*m_nbQ)))
 {
-    if (*m_eps < 1e-12){
-        biorbd::utils::Error::raise("epsilon for partial derivates approximation is too small ! \nLimit for epsilon is 1e-12");
-    }
+    for (unsigned int i = 0; i < *m_nbMus; ++i)
+        (*m_states)[i] = std::make_shared<biorbd::muscles::StateDynamics>(0, (*m_activations)[i]);
     m_model.updateMuscles(*m_Q, *m_Qdot, true);
     if (!useResidual){
         m_torqueResidual->setZero();
@@ -234,24 +232,15 @@ bool biorbd::muscles::StaticOptimizationIpopt::eval_jac_g(
     } else {
         if (new_x)
             dispatch(x);
-        const biorbd::rigidbody::GeneralizedTorque& GeneralizedTorqueMusc(m_model.muscularJointTorque(*m_states, false, m_Q.get(), m_Qdot.get()));
+        // The torque is linear in the muscle forces, so the jacobian is computed analytically
+        const biorbd::utils::Matrix& jacobianMusc(m_model.muscularJointTorqueActivationJacobian(*m_states, false, m_Q.get(), m_Qdot.get()));
         unsigned int k(0);
         for( unsigned int j = 0; j < *m_nbMus; ++j ){
-            std::vector<std::shared_ptr<biorbd::muscles::StateDynamics>> stateEpsilon;
-            for (unsigned int i = 0; i < *m_nbMus; ++i){
-                unsigned int delta(0);
-                if (i == j)
-                    delta = 1;
-                stateEpsilon.push_back(std::make_shared<biorbd::muscles::StateDynamics>(biorbd::muscles::StateDynamics(0, (*m_activations)[i]+delta* *m_eps)));
-            }
-            const biorbd::rigidbody::GeneralizedTorque& GeneralizedTorqueCalculEpsilon(m_model.muscularJointTorque(stateEpsilon, false, m_Q.get(), m_Qdot.get()));
             for( unsigned int i = 0; i < static_cast<unsigned int>(m); i++ ){
-                values[k++] = (GeneralizedTorqueCalculEpsilon[i]-GeneralizedTorqueMusc[i])/ *m_eps;
+                values[k++] = jacobianMusc(i, j);
                 if (*m_verbose >= 3){
                     std::cout << std::setprecision (20) << std::endl;
                     std::cout << "values[" << k-1 << "]: " << values[k-1] << std::endl;
-                    std::cout << "GeneralizedTorqueCalculEpsilon[" << i << "]: " << GeneralizedTorqueCalculEpsilon[i] << std::endl;
-                    std::cout << "GeneralizedTorqueMusc[" << i << "]: " << GeneralizedTorqueMusc[i] << std::endl;
                 }
 
             }
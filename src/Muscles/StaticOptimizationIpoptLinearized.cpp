@@ -26,29 +26,8 @@ biorbd::muscles::StaticOptimizationIpoptLinearized::StaticOptimizationIpoptLinea
 
 void biorbd::muscles::StaticOptimizationIpoptLinearized::prepareJacobian()
 {
-    m_model.updateMuscles(*m_Q, *m_Qdot, true);
-    std::vector<std::shared_ptr<biorbd::muscles::StateDynamics>> state_zero;
-    for (unsigned int i = 0; i<*m_nbMus; ++i){
-        state_zero.push_back(std::make_shared<biorbd::muscles::StateDynamics>(biorbd::muscles::StateDynamics(0, 0)));
-    }
-    const biorbd::rigidbody::GeneralizedTorque& GeneralizedTorque_zero(m_model.muscularJointTorque(state_zero, false, m_Q.get(), m_Qdot.get()));
-    for (unsigned int i = 0; i<*m_nbMus; ++i){
-        std::vector<std::shared_ptr<biorbd::muscles::StateDynamics>> state;
-        for (unsigned int j = 0; j<*m_nbMus; ++j){
-            unsigned int delta;
-            if (j == i){
-                delta = 1;
-            }
-            else {
-                delta = 0;
-            }
-            state.push_back(std::make_shared<biorbd::muscles::StateDynamics>(biorbd::muscles::StateDynamics(0, delta*1)));
-        }
-        const biorbd::rigidbody::GeneralizedTorque& GeneralizedTorque(m_model.muscularJointTorque(state, true, m_Q.get(), m_Qdot.get()));
-        for (unsigned int j = 0; j<*m_nbTorque; ++j){
-            (*m_jacobian)(j, i) = GeneralizedTorque(j)-GeneralizedTorque_zero(j);
-        }
-    }
+    // Linearize the muscular joint torque around the initial activations
+    *m_jacobian = m_model.muscularJointTorqueActivationJacobian(*m_states, true, m_Q.get(), m_Qdot.get());
 }
 
 biorbd::muscles::StaticOptimizationIpoptLinearized::~StaticOptimizationIpoptLinearized()
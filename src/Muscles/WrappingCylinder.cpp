@@ -11,6 +11,7 @@ biorbd::muscles::WrappingCylinder::WrappingCylinder() :
     m_length(std::make_shared<double>(0)),
     m_isCylinderPositiveSign(std::make_shared<bool>(true)),
     m_RTtoParent(std::make_shared<biorbd::utils::RotoTrans>()),
+    m_parentIdx(std::make_shared<int>(-1)),
     m_p1Wrap(std::make_shared<biorbd::utils::Vector3d>()),
     m_p2Wrap(std::make_shared<biorbd::utils::Vector3d>()),
     m_lengthAroundWrap(std::make_shared<double>(0))
@@ -28,6 +29,7 @@ biorbd::muscles::WrappingCylinder::WrappingCylinder(
     m_length(std::make_shared<double>(length)),
     m_isCylinderPositiveSign(std::make_shared<bool>(isCylinderPositiveSign)),
     m_RTtoParent(std::make_shared<biorbd::utils::RotoTrans>(rt)),
+    m_parentIdx(std::make_shared<int>(-1)),
     m_p1Wrap(std::make_shared<biorbd::utils::Vector3d>()),
     m_p2Wrap(std::make_shared<biorbd::utils::Vector3d>()),
     m_lengthAroundWrap(std::make_shared<double>(0))
@@ -47,6 +49,7 @@ biorbd::muscles::WrappingCylinder::WrappingCylinder(
     m_length(std::make_shared<double>(length)),
     m_isCylinderPositiveSign(std::make_shared<bool>(isCylinderPositiveSign)),
     m_RTtoParent(std::make_shared<biorbd::utils::RotoTrans>(rt)),
+    m_parentIdx(std::make_shared<int>(-1)),
     m_p1Wrap(std::make_shared<biorbd::utils::Vector3d>()),
     m_p2Wrap(std::make_shared<biorbd::utils::Vector3d>()),
     m_lengthAroundWrap(std::make_shared<double>(0))
@@ -68,6 +71,7 @@ void biorbd::muscles::WrappingCylinder::DeepCopy(const biorbd::muscles::Wrapping
     *m_length = *other.m_length;
     *m_isCylinderPositiveSign = *other.m_isCylinderPositiveSign;
     *m_RTtoParent = *other.m_RTtoParent;
+    *m_parentIdx = *other.m_parentIdx;
     *m_p1Wrap = other.m_p1Wrap->DeepCopy();
     *m_p2Wrap = other.m_p2Wrap->DeepCopy();
     *m_lengthAroundWrap = *other.m_lengthAroundWrap;
@@ -112,8 +116,8 @@ void biorbd::muscles::WrappingCylinder::wrapPoints(
     p2 = *tanPoints.m_p2;
 
     // Store the values for a futur call
-    m_p1Wrap = tanPoints.m_p1;
-    m_p2Wrap = tanPoints.m_p2;
+    *m_p1Wrap = *tanPoints.m_p1;
+    *m_p2Wrap = *tanPoints.m_p2;
     if (length != nullptr) // If it is not nullptr
         *m_lengthAroundWrap = *length;
 }
@@ -149,8 +153,12 @@ const biorbd::utils::RotoTrans& biorbd::muscles::WrappingCylinder::RT(
     if (updateKin)
         model.UpdateKinematicsCustom(&Q);
 
+    // The parent is looked up by name only once
+    if (*m_parentIdx < 0)
+        *m_parentIdx = model.GetBodyBiorbdId(*m_parentName);
+
     // Get the RotoTrans matrix of the cylinder in space
-    *m_RT = model.globalJCS(*m_parentName) * *m_RTtoParent;
+    *m_RT = model.globalJCS(static_cast<unsigned int>(*m_parentIdx)) * *m_RTtoParent;
     return *m_RT;
 }
 
@@ -202,45 +202,70 @@ std::vector<biorbd::utils::Matrix> biorbd::rigidbody::IMUs::TechnicalIMUJacobian
 }
 
 
+void biorbd::rigidbody::IMUs::IMUJacobian(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        biorbd::utils::Matrix &jacobian,
+        bool updateKin)
+{
+    IMUJacobianOfOneFrame(Q, false, jacobian, updateKin);
+}
+
+void biorbd::rigidbody::IMUs::TechnicalIMUJacobian(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        biorbd::utils::Matrix &jacobian,
+        bool updateKin)
+{
+    IMUJacobianOfOneFrame(Q, true, jacobian, updateKin);
+}
+
 // Protected function
 std::vector<biorbd::utils::Matrix> biorbd::rigidbody::IMUs::IMUJacobian(
         const biorbd::rigidbody::GeneralizedCoordinates &Q,
         bool updateKin,
         bool lookForTechnical)
 {
-    // Assuming that this is also a Joints type (via BiorbdModel)
-    biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
+    biorbd::utils::Matrix jacobian;
+    IMUJacobianOfOneFrame(Q, lookForTechnical, jacobian, updateKin);
 
+    // Split the jacobian IMU by IMU
     std::vector<biorbd::utils::Matrix> G;
+    for (unsigned int i=0; i<jacobian.rows()/9; ++i)
+        G.push_back(jacobian.block(i*9, 0, 9, jacobian.cols()));
+    return G;
+}
 
-    bool first(true);
-    for (unsigned int idx=0; idx<nbIMUs(); ++idx){
-        // Actual marker
-        biorbd::rigidbody::IMU node = IMU(idx);
-        if (lookForTechnical && !node.isTechnical())
-            continue;
+void biorbd::rigidbody::IMUs::IMUJacobianOfOneFrame(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        bool lookForTechnical,
+        biorbd::utils::Matrix &jacobian,
+        bool updateKin)
+{
+    // Assuming that this is also a Joints type (via BiorbdModel)
+    biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
 
-        unsigned int id = model.GetBodyId(node.parent().c_str());
-        biorbd::utils::Matrix G_tp(biorbd::utils::Matrix::Zero(9,model.dof_count));
+    unsigned int nIMUs(lookForTechnical ? nbTechIMUs() : nbIMUs());
+    if (static_cast<unsigned int>(jacobian.rows()) != 9*nIMUs || jacobian.cols() != model.dof_count)
+        jacobian.resize(9*nIMUs, model.dof_count);
+    jacobian.setZero();
 
-        // Calculate the Jacobian of this Tag
-        if (first)
-            model.CalcMatRotJacobian(Q, id, node.rot(), G_tp, updateKin);
-        else
-            model.CalcMatRotJacobian(Q, id, node.rot(), G_tp, false); // False for speed
+    if (updateKin)
+        model.UpdateKinematicsCustom(&Q, nullptr, nullptr);
 
-        G.push_back(G_tp);
-        first = false;
-    }
+    unsigned int row(0);
+    for (const auto& imu : *m_IMUs){
+        if (lookForTechnical && !imu.isTechnical())
+            continue;
 
-    return G;
+        model.rotationJacobianInGlobal(model.GetBodyId(imu.parent().c_str()), imu.rot(), jacobian, row);
+        row += 9;
+    }
 }
 
 unsigned int biorbd::rigidbody::IMUs::nbTechIMUs()
 {
     unsigned int nbTech = 0;
     if (nbTech == 0) // If the function has never been called before
-        for (biorbd::rigidbody::IMU imu : *m_IMUs)
+        for (const auto& imu : *m_IMUs)
             if (imu.isTechnical())
                 ++nbTech;
 
@@ -251,7 +276,7 @@ unsigned int biorbd::rigidbody::IMUs::nbAnatIMUs()
 {
     unsigned int nbAnat = 0;
     if (nbAnat == 0) // If the function has never been called before
-        for (biorbd::rigidbody::IMU imu : *m_IMUs)
+        for (const auto& imu : *m_IMUs)
             if (imu.isAnatomical())
                 ++nbAnat;
 
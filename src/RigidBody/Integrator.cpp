@@ -2,11 +2,16 @@
 #include "RigidBody/Integrator.h"
 
 #include <Eigen/Dense>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <boost/ref.hpp>
 #include <boost/numeric/odeint.hpp>
 #include <rbdl/Dynamics.h>
 
 #include "Utils/Error.h"
 #include "Utils/String.h"
+#include "Utils/Matrix.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/Joints.h"
 
@@ -15,7 +20,14 @@ biorbd::rigidbody::Integrator::Integrator(biorbd::rigidbody::Joints &model) :
     m_model(&model),
     m_x_vec(std::make_shared<std::vector<state_type>>()),
     m_times(std::make_shared<std::vector<double>>()),
-    m_u(std::make_shared<biorbd::utils::Vector>()) {
+    m_u(std::make_shared<biorbd::utils::Vector>()),
+    m_storageDecimation(std::make_shared<unsigned int>(1)),
+    m_stepper(std::make_shared<biorbd::rigidbody::INTEGRATOR_STEPPER>(biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_4)),
+    m_absTolerance(std::make_shared<double>(1e-6)),
+    m_relTolerance(std::make_shared<double>(1e-6)),
+    m_Q(std::make_shared<biorbd::rigidbody::GeneralizedCoordinates>()),
+    m_Qdot(std::make_shared<biorbd::rigidbody::GeneralizedCoordinates>()),
+    m_Qddot(std::make_shared<biorbd::rigidbody::GeneralizedCoordinates>()) {
 
 }
 
@@ -42,6 +54,45 @@ void biorbd::rigidbody::Integrator::DeepCopy(const biorbd::rigidbody::Integrator
     for (unsigned int i=0; i<other.m_times->size(); ++i)
         (*m_times)[i] = (*other.m_times)[i];
     *m_u = *other.m_u;
+    *m_storageDecimation = *other.m_storageDecimation;
+    *m_stepper = *other.m_stepper;
+    *m_absTolerance = *other.m_absTolerance;
+    *m_relTolerance = *other.m_relTolerance;
+    *m_Q = *other.m_Q;
+    *m_Qdot = *other.m_Qdot;
+    *m_Qddot = *other.m_Qddot;
+}
+
+void biorbd::rigidbody::Integrator::setStepper(
+        biorbd::rigidbody::INTEGRATOR_STEPPER stepper,
+        double absTolerance,
+        double relTolerance)
+{
+    biorbd::utils::Error::check(absTolerance > 0 && relTolerance > 0,
+                                "Tolerances of the integrator must be positive");
+    *m_stepper = stepper;
+    *m_absTolerance = absTolerance;
+    *m_relTolerance = relTolerance;
+}
+
+biorbd::rigidbody::INTEGRATOR_STEPPER biorbd::rigidbody::Integrator::stepper() const
+{
+    return *m_stepper;
+}
+
+double biorbd::rigidbody::Integrator::absTolerance() const
+{
+    return *m_absTolerance;
+}
+
+double biorbd::rigidbody::Integrator::relTolerance() const
+{
+    return *m_relTolerance;
+}
+
+unsigned int biorbd::rigidbody::Integrator::nbStates() const
+{
+    return m_model->nbQ() + m_model->nbQdot();
 }
 
 void biorbd::rigidbody::Integrator::operator() (
@@ -50,34 +101,25 @@ void biorbd::rigidbody::Integrator::operator() (
         double ){
 
     // Équation différentielle : x/xdot => xdot/xddot
-    biorbd::rigidbody::GeneralizedCoordinates Q(*m_model);
-    biorbd::rigidbody::GeneralizedCoordinates QDot(*m_model);
-    biorbd::rigidbody::GeneralizedCoordinates QDDot(*m_model);
-    QDDot.setZero();
-    for (unsigned int i=0; i<*m_nQ; i++){
-        Q(i) = x[i];
-    }
-    for (unsigned int i=0; i<*m_nQdot; i++){
-        QDot(i) = x[i+*m_nQ];
-    }
+    // The state is mapped into the buffers prepared by integrate() so nothing is allocated
+    *m_Q = Eigen::Map<const Eigen::VectorXd>(x.data(), *m_nQ);
+    *m_Qdot = Eigen::Map<const Eigen::VectorXd>(x.data() + *m_nQ, *m_nQdot);
+    m_Qddot->setZero();
 
-    RigidBodyDynamics::ForwardDynamics (*m_model, Q, QDot, *m_u, QDDot);
+    RigidBodyDynamics::ForwardDynamics (*m_model, *m_Q, *m_Qdot, *m_u, *m_Qddot);
+    m_model->invalidateKinematicsCache();
 
     // Faire sortir xdot/xddot
-    for (unsigned int i=0; i<*m_nQ; i++){
-        dxdt[i] = QDot[i];
-    }
-    for (unsigned int i=0; i<*m_nQdot; i++){
-        dxdt[i + *m_nQ] = QDDot[i];
-    }
+    coordinatesDerivative(dxdt);
+    Eigen::Map<Eigen::VectorXd>(dxdt.data() + *m_nQ, *m_nQdot) = *m_Qddot;
 
 }
 
 void biorbd::rigidbody::Integrator::showAll(){
     std::cout << "Test:" << std::endl;
-    for (unsigned int i=0; i <= *m_steps; i++){
+    for (unsigned int i=0; i < m_times->size(); i++){
         std::cout << (*m_times)[i];
-        for (unsigned int j = 0; j < *m_nQ + *m_nQdot; j++)
+        for (unsigned int j = 0; j < nbStates(); j++)
             std::cout << " " << (*m_x_vec)[i][j];
         std::cout << std::endl;
     }
@@ -85,14 +127,14 @@ void biorbd::rigidbody::Integrator::showAll(){
 
 unsigned int biorbd::rigidbody::Integrator::steps() const
 {
-    return *m_steps+1;
+    return static_cast<unsigned int>(m_times->size());
 }
 
 biorbd::utils::Vector biorbd::rigidbody::Integrator::getX(
         unsigned int idx){
-    biorbd::utils::Vector out(*m_nQ + *m_nQdot);
-    biorbd::utils::Error::check(idx <= *m_steps, "Trying to get Q outside range");
-    for (unsigned int i=0; i<*m_nQ + *m_nQdot; i++){
+    biorbd::utils::Vector out(nbStates());
+    biorbd::utils::Error::check(idx < steps(), "Trying to get Q outside range");
+    for (unsigned int i=0; i<nbStates(); i++){
         out(i) = (*m_x_vec)[idx][i];
         }
     return out;
@@ -108,33 +150,240 @@ void biorbd::rigidbody::Integrator::integrate(
         const biorbd::utils::Vector &u,
         double t0,
         double tend,
-        double timeStep){
-    // These variable can't be computer a construct time because of
-    // interaction calls with biorbd::rigidbody::Joints
-    m_nQ = std::make_shared<unsigned int>(m_model->nbQ());
-    m_nQdot = std::make_shared<unsigned int>(m_model->nbQdot());
+        double timeStep,
+        unsigned int storageDecimation){
+    prepareBuffers();
+
+    // Forget the previous integration
+    *m_storageDecimation = storageDecimation;
+    m_x_vec->clear();
+    m_times->clear();
 
     // Assume constant torque over the whole integration
     *m_u = u;
 
     // Remplissage de la variable par les positions et vitesse
-    state_type x(*m_nQ + *m_nQdot);
-    for (unsigned int i=0; i<*m_nQ + *m_nQdot; i++)
+    biorbd::utils::Error::check(Q_Qdot.size() == nbStates(),
+                                "Initial state of the integration has the wrong dimension");
+    state_type x(nbStates());
+    for (unsigned int i=0; i<nbStates(); i++)
         x[i] = Q_Qdot(i);
 
     launchIntegrate(x, t0, tend, timeStep);
 }
 
+// Integrate an interval with a controlled stepper. The derivative must be the one at the start of
+// the interval, and the step size is carried over to the next interval
+template<class ControlledStepper>
+static void integrateControlledInterval(
+        ControlledStepper& stepper,
+        biorbd::rigidbody::Integrator& system,
+        state_type& x,
+        state_type& dxdt,
+        double t,
+        double tend,
+        double& dt,
+        bool isFsal)
+{
+    namespace odeint = boost::numeric::odeint;
+    unsigned int nbFails(0);
+    while (tend - t > std::numeric_limits<double>::epsilon() * std::max(1.0, std::abs(tend))){
+        // The last step is shortened to end on the interval, without shrinking the step of the next one
+        bool isShortened(t + dt > tend);
+        double dtTry(isShortened ? tend - t : dt);
+        if (stepper.try_step(boost::ref(system), x, dxdt, t, dtTry) == odeint::success){
+            nbFails = 0;
+            if (!isShortened)
+                dt = dtTry;
+            if (!isFsal) // The FSAL steppers already updated the derivative
+                system(x, dxdt, t);
+        }
+        else {
+            biorbd::utils::Error::check(++nbFails < 500, "The adaptive stepper could not reach the required tolerance");
+            dt = dtTry;
+        }
+    }
+}
+
+void biorbd::rigidbody::Integrator::integrate(
+        const biorbd::utils::Matrix &allU,
+        unsigned int firstU,
+        unsigned int nbIntervals,
+        double timeStep,
+        biorbd::utils::Matrix &allStates,
+        unsigned int firstState)
+{
+    namespace odeint = boost::numeric::odeint;
+    prepareBuffers();
+    unsigned int n(nbStates());
+    biorbd::utils::Error::check(allStates.rows() == n && allStates.cols() >= firstState + nbIntervals + 1,
+                                "States of the integration have the wrong dimension");
+    biorbd::utils::Error::check(allU.cols() >= firstU + nbIntervals,
+                                "Effectors of the integration have the wrong dimension");
+
+    // The state is kept from one interval to another
+    state_type x(n);
+    state_type dxdt(n);
+    Eigen::Map<Eigen::VectorXd>(x.data(), n) = allStates.col(firstState);
+
+    if (*m_stepper == biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_4){
+        odeint::runge_kutta4< state_type > stepper;
+        for (unsigned int i=0; i<nbIntervals; ++i){
+            *m_u = allU.col(firstU + i);
+            stepper.do_step(boost::ref(*this), x, i*timeStep, timeStep);
+            allStates.col(firstState + i + 1) = Eigen::Map<const Eigen::VectorXd>(x.data(), n);
+        }
+    }
+    else if (*m_stepper == biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_DOPRI5){
+        auto stepper(odeint::make_controlled(*m_absTolerance, *m_relTolerance, odeint::runge_kutta_dopri5< state_type >()));
+        double dt(timeStep);
+        for (unsigned int i=0; i<nbIntervals; ++i){
+            // The effectors changed, so the derivative at the start of the interval is computed again
+            *m_u = allU.col(firstU + i);
+            (*this)(x, dxdt, i*timeStep);
+            integrateControlledInterval(stepper, *this, x, dxdt, i*timeStep, (i+1)*timeStep, dt, true);
+            allStates.col(firstState + i + 1) = Eigen::Map<const Eigen::VectorXd>(x.data(), n);
+        }
+    }
+    else if (*m_stepper == biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_CASH_KARP54){
+        auto stepper(odeint::make_controlled(*m_absTolerance, *m_relTolerance, odeint::runge_kutta_cash_karp54< state_type >()));
+        double dt(timeStep);
+        for (unsigned int i=0; i<nbIntervals; ++i){
+            *m_u = allU.col(firstU + i);
+            (*this)(x, dxdt, i*timeStep);
+            integrateControlledInterval(stepper, *this, x, dxdt, i*timeStep, (i+1)*timeStep, dt, false);
+            allStates.col(firstState + i + 1) = Eigen::Map<const Eigen::VectorXd>(x.data(), n);
+        }
+    }
+    else if (*m_stepper == biorbd::rigidbody::INTEGRATOR_STEPPER::SYMPLECTIC_EULER){
+        unsigned int nQ(*m_nQ);
+        for (unsigned int i=0; i<nbIntervals; ++i){
+            *m_u = allU.col(firstU + i);
+            (*this)(x, dxdt, i*timeStep);
+            for (unsigned int j=nQ; j<n; ++j)
+                x[j] += timeStep * dxdt[j];
+            integrateCoordinates(x, timeStep);
+            allStates.col(firstState + i + 1) = Eigen::Map<const Eigen::VectorXd>(x.data(), n);
+        }
+    }
+    else
+        biorbd::utils::Error::raise(biorbd::utils::String("Stepper ") + INTEGRATOR_STEPPER_toStr(*m_stepper) + " is not implemented");
+}
+
+void biorbd::rigidbody::Integrator::prepareBuffers()
+{
+    // These variable can't be computer a construct time because of
+    // interaction calls with biorbd::rigidbody::Joints
+    m_nQ = std::make_shared<unsigned int>(m_model->nbQ());
+    m_nQdot = std::make_shared<unsigned int>(m_model->nbQdot());
+
+    // Prepare the buffers of the right-hand side function
+    m_Q->resize(*m_nQ);
+    m_Qdot->resize(*m_nQdot);
+    m_Qddot->resize(*m_nQdot);
+}
+
+void biorbd::rigidbody::Integrator::coordinatesDerivative(
+        state_type &dxdt)
+{
+    if (*m_nQ == *m_nQdot)
+        Eigen::Map<Eigen::VectorXd>(dxdt.data(), *m_nQ) = *m_Qdot;
+    else
+        Eigen::Map<Eigen::VectorXd>(dxdt.data(), *m_nQ) = m_model->computeQdot(*m_Q, *m_Qdot);
+}
+
+void biorbd::rigidbody::Integrator::integrateCoordinates(
+        state_type &x,
+        double timeStep)
+{
+    unsigned int nQ(*m_nQ);
+    if (nQ == *m_nQdot){
+        for (unsigned int i=0; i<nQ; ++i)
+            x[i] += timeStep * x[nQ + i];
+        return;
+    }
+
+    // The quaternions do not move with their velocities, which must be mapped to the rate of their components
+    *m_Q = Eigen::Map<const Eigen::VectorXd>(x.data(), nQ);
+    *m_Qdot = Eigen::Map<const Eigen::VectorXd>(x.data() + nQ, *m_nQdot);
+    Eigen::Map<Eigen::VectorXd>(x.data(), nQ) += timeStep * m_model->computeQdot(*m_Q, *m_Qdot);
+}
+
 void biorbd::rigidbody::Integrator::launchIntegrate(
         state_type& x,
         double t0,
         double tend,
         double timeStep)
 {
-    // Choix de l'algorithme et intégration
-    boost::numeric::odeint::runge_kutta4< state_type > stepper;
-    *m_steps = static_cast<unsigned int>(
-                boost::numeric::odeint::integrate_const(
-                    stepper, *this, x, t0, tend, timeStep,
-                    push_back_state_and_time( *m_x_vec , *m_times )));
+    namespace odeint = boost::numeric::odeint;
+
+    // Choix de l'algorithme et intégration. The integrator is passed by
+    // reference so the right-hand side of the derived integrators is used
+    push_back_state_and_time observer(*m_x_vec, *m_times, *m_storageDecimation);
+    double tFinal;
+    if (*m_stepper == biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_4){
+        odeint::runge_kutta4< state_type > stepper;
+        *m_steps = static_cast<unsigned int>(
+                    odeint::integrate_const(stepper, boost::ref(*this), x, t0, tend, timeStep, observer));
+        tFinal = t0 + *m_steps * timeStep;
+    }
+    else if (*m_stepper == biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_DOPRI5){
+        *m_steps = static_cast<unsigned int>(
+                    odeint::integrate_adaptive(
+                        odeint::make_controlled(*m_absTolerance, *m_relTolerance, odeint::runge_kutta_dopri5< state_type >()),
+                        boost::ref(*this), x, t0, tend, timeStep, observer));
+        tFinal = tend;
+    }
+    else if (*m_stepper == biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_CASH_KARP54){
+        *m_steps = static_cast<unsigned int>(
+                    odeint::integrate_adaptive(
+                        odeint::make_controlled(*m_absTolerance, *m_relTolerance, odeint::runge_kutta_cash_karp54< state_type >()),
+                        boost::ref(*this), x, t0, tend, timeStep, observer));
+        tFinal = tend;
+    }
+    else if (*m_stepper == biorbd::rigidbody::INTEGRATOR_STEPPER::SYMPLECTIC_EULER){
+        *m_steps = integrateSymplecticEuler(x, t0, tend, timeStep);
+        tFinal = t0 + *m_steps * timeStep;
+    }
+    else {
+        biorbd::utils::Error::raise(biorbd::utils::String("Stepper ") + INTEGRATOR_STEPPER_toStr(*m_stepper) + " is not implemented");
+        return;
+    }
+
+    // Make sure the final state is stored
+    if (*m_storageDecimation == 0 || *m_steps % *m_storageDecimation != 0){
+        m_x_vec->push_back(x);
+        m_times->push_back(tFinal);
+    }
+}
+
+unsigned int biorbd::rigidbody::Integrator::integrateSymplecticEuler(
+        state_type& x,
+        double t0,
+        double tend,
+        double timeStep)
+{
+    // odeint's symplectic steppers need accelerations that do not depend on
+    // the velocities, which is not the case of the forward dynamics
+    push_back_state_and_time observer(*m_x_vec, *m_times, *m_storageDecimation);
+    state_type dxdt(x.size());
+    unsigned int nQ(*m_nQ);
+    unsigned int step(0);
+    double t(t0);
+
+    // Same stopping criterion as integrate_const
+    while (t + timeStep - tend <= std::numeric_limits<double>::epsilon()){
+        observer(x, t);
+        (*this)(x, dxdt, t);
+
+        // Velocities (and additional states) first, then the coordinates from the new velocities
+        for (unsigned int i=nQ; i<x.size(); ++i)
+            x[i] += timeStep * dxdt[i];
+        integrateCoordinates(x, timeStep);
+
+        ++step;
+        t = t0 + step * timeStep;
+    }
+    observer(x, t);
+    return step;
 }
@@ -11,6 +11,7 @@
 #include "Utils/Error.h"
 #include "Utils/RotoTrans.h"
 #include "Utils/Rotation.h"
+#include "Utils/ThreadDispatcher.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/GeneralizedTorque.h"
 #include "RigidBody/Integrator.h"
@@ -32,8 +33,17 @@ biorbd::rigidbody::Joints::Joints() :
     m_nRotAQuat(std::make_shared<unsigned int>(0)),
     m_isRootActuated(std::make_shared<bool>(true)),
     m_hasExternalForces(std::make_shared<bool>(false)),
+    m_mergeDofs(std::make_shared<bool>(false)),
     m_isKinematicsComputed(std::make_shared<bool>(false)),
-    m_totalMass(std::make_shared<double>(0))
+    m_totalMass(std::make_shared<double>(0)),
+    m_subtreeCoM(std::make_shared<biorbd::utils::Matrix>()),
+    m_contactPointJacobian(std::make_shared<biorbd::utils::Matrix>()),
+    m_massMatrixFactor(std::make_shared<biorbd::utils::Matrix>()),
+    m_useKinematicsCache(std::make_shared<bool>(false)),
+    m_kinematicsCache(std::make_shared<std::vector<biorbd::rigidbody::GeneralizedCoordinates>>(3)),
+    m_isKinematicsCacheValid(std::make_shared<std::vector<bool>>(3, false)),
+    m_nbKinematicsCacheHits(std::make_shared<unsigned int>(0)),
+    m_nbKinematicsCacheMisses(std::make_shared<unsigned int>(0))
 {
     m_integrator = std::make_shared<biorbd::rigidbody::Integrator>(*this);
     this->gravity = RigidBodyDynamics::Math::Vector3d (0, 0, -9.81);  // Redéfinition de la gravité pour qu'elle soit en z
@@ -51,8 +61,17 @@ biorbd::rigidbody::Joints::Joints(const biorbd::rigidbody::Joints &other) :
     m_nRotAQuat(other.m_nRotAQuat),
     m_isRootActuated(other.m_isRootActuated),
     m_hasExternalForces(other.m_hasExternalForces),
+    m_mergeDofs(other.m_mergeDofs),
     m_isKinematicsComputed(other.m_isKinematicsComputed),
-    m_totalMass(other.m_totalMass)
+    m_totalMass(other.m_totalMass),
+    m_subtreeCoM(other.m_subtreeCoM),
+    m_contactPointJacobian(other.m_contactPointJacobian),
+    m_massMatrixFactor(other.m_massMatrixFactor),
+    m_useKinematicsCache(other.m_useKinematicsCache),
+    m_kinematicsCache(other.m_kinematicsCache),
+    m_isKinematicsCacheValid(other.m_isKinematicsCacheValid),
+    m_nbKinematicsCacheHits(other.m_nbKinematicsCacheHits),
+    m_nbKinematicsCacheMisses(other.m_nbKinematicsCacheMisses)
 {
 
 }
@@ -84,8 +103,67 @@ void biorbd::rigidbody::Joints::DeepCopy(const biorbd::rigidbody::Joints &other)
     *m_nRotAQuat = *other.m_nRotAQuat;
     *m_isRootActuated = *other.m_isRootActuated;
     *m_hasExternalForces = *other.m_hasExternalForces;
+    *m_mergeDofs = *other.m_mergeDofs;
     *m_isKinematicsComputed = *other.m_isKinematicsComputed;
     *m_totalMass = *other.m_totalMass;
+    *m_subtreeCoM = *other.m_subtreeCoM;
+    *m_contactPointJacobian = *other.m_contactPointJacobian;
+    *m_massMatrixFactor = *other.m_massMatrixFactor;
+    *m_useKinematicsCache = *other.m_useKinematicsCache;
+    *m_kinematicsCache = *other.m_kinematicsCache;
+    *m_isKinematicsCacheValid = *other.m_isKinematicsCacheValid;
+    *m_nbKinematicsCacheHits = *other.m_nbKinematicsCacheHits;
+    *m_nbKinematicsCacheMisses = *other.m_nbKinematicsCacheMisses;
+}
+
+void biorbd::rigidbody::Joints::detachWorkspace()
+{
+    // The RBDL cache (X_base, v, a, ...) was already copied by value by the copy
+    // constructor, only the shared states that are written during the queries remain
+    std::shared_ptr<biorbd::rigidbody::Integrator> integrator(m_integrator);
+    m_integrator = std::make_shared<biorbd::rigidbody::Integrator>(*this);
+    m_integrator->setStepper(integrator->stepper(), integrator->absTolerance(), integrator->relTolerance());
+    m_isKinematicsComputed = std::make_shared<bool>(false);
+    m_subtreeCoM = std::make_shared<biorbd::utils::Matrix>();
+    m_contactPointJacobian = std::make_shared<biorbd::utils::Matrix>();
+    m_massMatrixFactor = std::make_shared<biorbd::utils::Matrix>();
+    m_useKinematicsCache = std::make_shared<bool>(*m_useKinematicsCache);
+    m_kinematicsCache = std::make_shared<std::vector<biorbd::rigidbody::GeneralizedCoordinates>>(*m_kinematicsCache);
+    m_isKinematicsCacheValid = std::make_shared<std::vector<bool>>(*m_isKinematicsCacheValid);
+    m_nbKinematicsCacheHits = std::make_shared<unsigned int>(0);
+    m_nbKinematicsCacheMisses = std::make_shared<unsigned int>(0);
+}
+
+void biorbd::rigidbody::Joints::forEachFrame(
+        const biorbd::utils::Matrix &allQ,
+        const std::function<void(biorbd::rigidbody::Joints&, const RigidBodyDynamics::Math::VectorNd&, unsigned int)>& f,
+        unsigned int nbThreads)
+{
+    biorbd::utils::Error::check(allQ.rows() == nbQ(), "Number of rows of generalized coordinates must be equal to the number of Q");
+    unsigned int nbFrames(static_cast<unsigned int>(allQ.cols()));
+    biorbd::utils::ThreadDispatcher dispatcher(nbThreads);
+
+    // The first chunk is computed by this model, every other one by its own workspace
+    std::vector<biorbd::rigidbody::Joints> workspaces;
+    unsigned int nbChunks(dispatcher.nbChunks(nbFrames));
+    if (nbChunks > 1){
+        workspaces.reserve(nbChunks-1);
+        for (unsigned int i=1; i<nbChunks; ++i){
+            workspaces.push_back(*this);
+            workspaces.back().detachWorkspace();
+        }
+    }
+
+    dispatcher.run(nbFrames, [&](unsigned int chunk, unsigned int first, unsigned int last){
+        biorbd::rigidbody::Joints& model(chunk == 0 ? *this : workspaces[chunk-1]);
+        RigidBodyDynamics::Math::VectorNd Q(allQ.rows());
+        for (unsigned int i=first; i<last; ++i){
+            Q = allQ.col(i);
+            RigidBodyDynamics::UpdateKinematicsCustom(model, &Q, nullptr, nullptr);
+            model.invalidateKinematicsCache();
+            f(model, Q, i);
+        }
+    });
 }
 
 unsigned int biorbd::rigidbody::Joints::nbGeneralizedTorque() const {
@@ -133,6 +211,12 @@ void biorbd::rigidbody::Joints::setIsRootActuated(bool isActuated) {
 bool biorbd::rigidbody::Joints::isRootActuated() const {
     return *m_isRootActuated;
 }
+void biorbd::rigidbody::Joints::setMergeDofs(bool mergeDofs) {
+    *m_mergeDofs = mergeDofs;
+}
+bool biorbd::rigidbody::Joints::mergeDofs() const {
+    return *m_mergeDofs;
+}
 void biorbd::rigidbody::Joints::setHasExternalForces(bool hasExternalForces) {
     *m_hasExternalForces = hasExternalForces;
 }
@@ -146,17 +230,26 @@ double biorbd::rigidbody::Joints::mass() const {
 
 
 
+void biorbd::rigidbody::Joints::setIntegrationStepper(
+        biorbd::rigidbody::INTEGRATOR_STEPPER stepper,
+        double absTolerance,
+        double relTolerance)
+{
+    m_integrator->setStepper(stepper, absTolerance, relTolerance);
+}
+
 void biorbd::rigidbody::Joints::integrateKinematics(
         const biorbd::rigidbody::GeneralizedCoordinates& Q,
         const biorbd::rigidbody::GeneralizedCoordinates& QDot,
         const biorbd::rigidbody::GeneralizedTorque& torque,
         double t0,
         double tend,
-        double timeStep)
+        double timeStep,
+        unsigned int storageDecimation)
 {
     biorbd::utils::Vector v(static_cast<unsigned int>(Q.rows()+QDot.rows()));
     v << Q,QDot;
-    m_integrator->integrate(v, torque, t0, tend, timeStep); // vecteur, t0, tend, pas, effecteurs
+    m_integrator->integrate(v, torque, t0, tend, timeStep, storageDecimation); // vecteur, t0, tend, pas, effecteurs
     *m_isKinematicsComputed = true;
 }
 void biorbd::rigidbody::Joints::getIntegratedKinematics(
@@ -178,6 +271,41 @@ unsigned int biorbd::rigidbody::Joints::nbInterationStep() const
     return m_integrator->steps();
 }
 
+void biorbd::rigidbody::Joints::integrateKinematics(
+        const biorbd::utils::Matrix &allQ_Qdot,
+        const biorbd::utils::Matrix &allTorque,
+        double timeStep,
+        biorbd::utils::Matrix &allStates,
+        unsigned int nbThreads)
+{
+    unsigned int nbStates(nbQ() + nbQdot());
+    biorbd::utils::Error::check(allQ_Qdot.rows() == nbStates, "Number of rows of initial states must be equal to the number of Q and Qdot");
+    biorbd::utils::Error::check(allTorque.rows() == nbQdot(), "Number of rows of torques must be equal to the number of Qdot");
+    unsigned int nbSimulations(static_cast<unsigned int>(allQ_Qdot.cols()));
+    biorbd::utils::Error::check(nbSimulations != 0 && allTorque.cols() % nbSimulations == 0,
+                                "Number of columns of torques must be a multiple of the number of simulations");
+    unsigned int nbSteps(static_cast<unsigned int>(allTorque.cols()) / nbSimulations);
+    if (allStates.rows() != nbStates || allStates.cols() != (nbSteps+1)*nbSimulations)
+        allStates.resize(nbStates, (nbSteps+1)*nbSimulations);
+
+    // Every thread has its own workspace so the integration of this model is kept
+    biorbd::utils::ThreadDispatcher dispatcher(nbThreads);
+    unsigned int nbWorkspaces(dispatcher.nbChunks(nbSimulations));
+    std::vector<biorbd::rigidbody::Joints> workspaces;
+    workspaces.reserve(nbWorkspaces);
+    for (unsigned int i=0; i<nbWorkspaces; ++i){
+        workspaces.push_back(*this);
+        workspaces.back().detachWorkspace();
+    }
+
+    // Each simulation is integrated at once, its states being written directly in the output
+    dispatcher.runDynamic(nbSimulations, [&](unsigned int thread, unsigned int simulation){
+        unsigned int first(simulation * (nbSteps+1));
+        allStates.col(first) = allQ_Qdot.col(simulation);
+        workspaces[thread].m_integrator->integrate(allTorque, simulation * nbSteps, nbSteps, timeStep, allStates, first);
+    });
+}
+
 
 unsigned int biorbd::rigidbody::Joints::AddSegment(
         const biorbd::utils::String &segmentName, // Name of the segment
@@ -259,7 +387,7 @@ std::vector<RigidBodyDynamics::Math::SpatialVector> biorbd::rigidbody::Joints::d
     sv_out.push_back(sv_zero); // The first one is associated with the universe
 
     // Dispatch the forces
-    for (auto segment : *m_segments){
+    for (const auto& segment : *m_segments){
         unsigned int nbDof = segment.nbDof();
         if (nbDof != 0){ // Do not add anything if the nbDoF is zero
             // For each segment
@@ -299,6 +427,26 @@ std::vector<biorbd::utils::RotoTrans> biorbd::rigidbody::Joints::allGlobalJCS()
     return out;
 }
 
+void biorbd::rigidbody::Joints::allGlobalJCS(
+        const biorbd::utils::Matrix &allQ,
+        biorbd::utils::Matrix &allJCS,
+        unsigned int nbThreads)
+{
+    unsigned int nbSeg(nbSegment());
+    if (allJCS.rows() != 4*nbSeg || allJCS.cols() != 4*allQ.cols())
+        allJCS.resize(4*nbSeg, 4*allQ.cols());
+
+    forEachFrame(allQ, [&](biorbd::rigidbody::Joints& model, const RigidBodyDynamics::Math::VectorNd&, unsigned int frame){
+        for (unsigned int i=0; i<nbSeg; ++i){
+            const RigidBodyDynamics::Math::SpatialTransform& rt(
+                        model.CalcBodyWorldTransformation((*m_segments)[i].id()));
+            allJCS.block<3, 3>(4*i, 4*frame) = rt.E;
+            allJCS.block<3, 1>(4*i, 4*frame+3) = rt.r;
+            allJCS.block<1, 4>(4*i+3, 4*frame) << 0, 0, 0, 1;
+        }
+    }, nbThreads);
+}
+
 biorbd::utils::RotoTrans biorbd::rigidbody::Joints::globalJCS(
         const biorbd::rigidbody::GeneralizedCoordinates &Q,
         const biorbd::utils::String &name)
@@ -498,21 +646,8 @@ biorbd::utils::Vector3d biorbd::rigidbody::Joints::CoM(
         bool updateKin)
 {
     // Return the position of the center of mass from the generalized coordinates
-
-    // Ensure that the model is in the right configuration
-    if (updateKin)
-        UpdateKinematicsCustom(&Q, nullptr, nullptr);
-
-    // For each segment, find the CoM (CoM = sum(segment_mass * pos_com_seg) / total mass)
-    const std::vector<biorbd::rigidbody::NodeSegment>& com_segment(CoMbySegment(Q,true));
-    biorbd::utils::Vector3d com(0, 0, 0);
-    for (unsigned int i=0; i<com_segment.size(); ++i)
-        com += (*m_segments)[i].characteristics().mMass * com_segment[i];
-
-    // Divide by total mass
-    com = com/this->mass();
-
-    // Return the CoM
+    biorbd::utils::Vector3d com;
+    CoMKinematics(Q, nullptr, nullptr, com, nullptr, nullptr, nullptr, updateKin);
     return com;
 }
 
@@ -530,68 +665,143 @@ biorbd::utils::Vector3d biorbd::rigidbody::Joints::CoMdot(
         const biorbd::rigidbody::GeneralizedCoordinates &Qdot)
 {
     // Return the velocity of the center of mass from the generalized coordinates
-
-    // Ensure the model is in the right configuration
-    UpdateKinematicsCustom(&Q, &Qdot, nullptr);
-
-    // For each segment, find the CoM
-    biorbd::utils::Vector3d com_dot(0,0,0);
-
-    // CoMdot = sum(mass_seg * Jacobian * qdot)/mass totale
-    biorbd::utils::Matrix Jac(biorbd::utils::Matrix(3,this->dof_count));
-    for (auto segment : *m_segments){
-        Jac.setZero();
-        RigidBodyDynamics::CalcPointJacobian(*this, Q, this->GetBodyId(segment.name().c_str()), segment.characteristics().mCenterOfMass, Jac, false); // False for speed
-        com_dot += ((Jac*Qdot) * segment.characteristics().mMass);
-    }
-    // Divide by total mass
-    com_dot = com_dot/this->mass();
-
-    // Return the velocity of CoM
+    biorbd::utils::Vector3d com, com_dot;
+    CoMKinematics(Q, &Qdot, nullptr, com, &com_dot);
     return com_dot;
 }
+
 biorbd::utils::Vector3d biorbd::rigidbody::Joints::CoMddot(
         const biorbd::rigidbody::GeneralizedCoordinates &Q,
         const biorbd::rigidbody::GeneralizedCoordinates &Qdot,
         const biorbd::rigidbody::GeneralizedCoordinates &Qddot)
 {
-    double mass;
-    RigidBodyDynamics::Math::Vector3d com, com_ddot;
-    RigidBodyDynamics::Utils::CalcCenterOfMass(
-                *this, Q, Qdot, &Qddot, mass, com, nullptr, &com_ddot,
-                nullptr, nullptr, true);
-
-
-    // Return the acceleration of CoM
+    // Return the acceleration of the center of mass
+    biorbd::utils::Vector3d com, com_ddot;
+    CoMKinematics(Q, &Qdot, &Qddot, com, nullptr, &com_ddot);
     return com_ddot;
 }
 
 biorbd::utils::Matrix biorbd::rigidbody::Joints::CoMJacobian(const biorbd::rigidbody::GeneralizedCoordinates &Q)
 {
-    // Return the position of the center of mass from the generalized coordinates
-
-    // Ensure that the model is in the right configuration
-    UpdateKinematicsCustom(&Q, nullptr, nullptr);
+    // Return the Jacobian of the center of mass
+    biorbd::utils::Vector3d com;
+    biorbd::utils::Matrix jacobian;
+    CoMKinematics(Q, nullptr, nullptr, com, nullptr, nullptr, &jacobian);
+    return jacobian;
+}
 
-   // Total jacobian
-    biorbd::utils::Matrix JacTotal(biorbd::utils::Matrix::Zero(3,this->dof_count));
+void biorbd::rigidbody::Joints::CoMKinematics(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        const biorbd::rigidbody::GeneralizedCoordinates *Qdot,
+        const biorbd::rigidbody::GeneralizedCoordinates *Qddot,
+        biorbd::utils::Vector3d &com,
+        biorbd::utils::Vector3d *comDot,
+        biorbd::utils::Vector3d *comDdot,
+        biorbd::utils::Matrix *jacobian,
+        bool updateKin)
+{
+    if (updateKin)
+        UpdateKinematicsCustom(&Q, Qdot, Qddot);
 
-    // CoMdot = sum(mass_seg * Jacobian * qdot)/mass total
-    biorbd::utils::Matrix Jac(biorbd::utils::Matrix::Zero(3,this->dof_count));
-    for (auto segment : *m_segments){
-        Jac.setZero();
-        RigidBodyDynamics::CalcPointJacobian(*this, Q, this->GetBodyId(segment.name().c_str()), segment.characteristics().mCenterOfMass, Jac, false); // False for speed
-        JacTotal += segment.characteristics().mMass*Jac;
+    unsigned int nbBodies(static_cast<unsigned int>(this->mBodies.size()));
+    if (jacobian){
+        if (m_subtreeCoM->cols() != nbBodies)
+            m_subtreeCoM->resize(4, nbBodies);
+        m_subtreeCoM->setZero();
     }
+    com.setZero();
+    if (comDot)
+        comDot->setZero();
+    if (comDdot)
+        comDdot->setZero();
+
+    // Mass weighted position, velocity and acceleration of each segment, from the cached body kinematics
+    for (const auto& segment : *m_segments){
+        const biorbd::rigidbody::SegmentCharacteristics& characteristics(segment.characteristics());
+        double mass(characteristics.mMass);
+        if (mass == 0.0)
+            continue;
+
+        // Express the center of mass in the movable body it is attached to
+        unsigned int id(segment.id());
+        RigidBodyDynamics::Math::Vector3d c(characteristics.mCenterOfMass);
+        if (this->IsFixedBodyId(id)) {
+            const RigidBodyDynamics::FixedBody& fixedBody(this->mFixedBodies[id - this->fixed_body_discriminator]);
+            c = fixedBody.mParentTransform.E.transpose() * c + fixedBody.mParentTransform.r;
+            id = fixedBody.mMovableParent;
+        }
+        const RigidBodyDynamics::Math::SpatialTransform& X(this->X_base[id]);
+        RigidBodyDynamics::Math::Vector3d position(X.E.transpose() * c + X.r);
+        com += mass * position;
+
+        if (comDot || comDdot){
+            RigidBodyDynamics::Math::Vector3d omega(this->v[id].head<3>());
+            RigidBodyDynamics::Math::Vector3d velocity(this->v[id].tail<3>() + omega.cross(c));
+            if (comDot)
+                *comDot += mass * (X.E.transpose() * velocity);
+            if (comDdot)
+                *comDdot += mass * (X.E.transpose() * (
+                        this->a[id].tail<3>()
+                        + this->a[id].head<3>().cross(c)
+                        + omega.cross(velocity)));
+        }
+        if (jacobian){
+            m_subtreeCoM->block<3, 1>(0, id) += mass * position;
+            (*m_subtreeCoM)(3, id) += mass;
+        }
+    }
+    com /= mass();
+    if (comDot)
+        *comDot /= mass();
+    if (comDdot)
+        *comDdot /= mass();
+
+    if (!jacobian)
+        return;
+
+    // Mass and mass weighted position of the subtree of each body, children being after their parent
+    for (unsigned int i=nbBodies-1; i>0; --i)
+        m_subtreeCoM->col(this->lambda[i]) += m_subtreeCoM->col(i);
+
+    // A unit velocity of a joint moves its whole subtree: J_j = (M_sub * v_O + omega x h_sub) / M
+    if (jacobian->rows() != 3 || jacobian->cols() != this->dof_count)
+        jacobian->resize(3, this->dof_count);
+    jacobian->setZero();
+    for (unsigned int i=1; i<nbBodies; ++i){
+        double subtreeMass((*m_subtreeCoM)(3, i));
+        if (subtreeMass == 0.0)
+            continue;
+        RigidBodyDynamics::Math::Vector3d h(m_subtreeCoM->block<3, 1>(0, i));
+        const RigidBodyDynamics::Joint& joint(this->mJoints[i]);
+        RigidBodyDynamics::Math::Vector3d omega, velocity;
+        for (unsigned int k=0; k<joint.mDoFCount; ++k){
+            jointMotionInGlobal(i, k, omega, velocity);
+            jacobian->col(joint.q_index + k) = (subtreeMass * velocity + omega.cross(h)) / mass();
+        }
+    }
+}
 
-    // Divide by total mass
-    JacTotal /= this->mass();
+void biorbd::rigidbody::Joints::jointMotionInGlobal(
+        unsigned int bodyId,
+        unsigned int dof,
+        RigidBodyDynamics::Math::Vector3d &omega,
+        RigidBodyDynamics::Math::Vector3d &velocity) const
+{
+    const RigidBodyDynamics::Joint& joint(this->mJoints[bodyId]);
+    RigidBodyDynamics::Math::SpatialVector S;
+    if (joint.mJointType == RigidBodyDynamics::JointTypeCustom)
+        S = this->mCustomJoints[joint.custom_joint_index]->S.col(dof);
+    else if (joint.mDoFCount == 1)
+        S = this->S[bodyId];
+    else
+        S = this->multdof3_S[bodyId].col(dof);
 
-    // Return the Jacobian of CoM
-    return JacTotal;
+    // Move the motion subspace of the joint from the body frame to the origin of the global frame
+    const RigidBodyDynamics::Math::SpatialTransform& X(this->X_base[bodyId]);
+    omega = X.E.transpose() * S.head<3>();
+    velocity = X.E.transpose() * S.tail<3>() + X.r.cross(omega);
 }
 
-
 std::vector<biorbd::rigidbody::NodeSegment> biorbd::rigidbody::Joints::CoMbySegment(
         const biorbd::rigidbody::GeneralizedCoordinates &Q,
         bool updateKin)
@@ -606,14 +816,71 @@ std::vector<biorbd::rigidbody::NodeSegment> biorbd::rigidbody::Joints::CoMbySegm
 }
 
 
+void biorbd::rigidbody::Joints::CoMbySegment(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        Eigen::Matrix3Xd &CoM,
+        bool updateKin)
+{
+    unsigned int nbSeg(nbSegment());
+    if (static_cast<unsigned int>(CoM.cols()) != nbSeg)
+        CoM.resize(3, nbSeg);
+
+    if (updateKin)
+        UpdateKinematicsCustom(&Q, nullptr, nullptr);
+
+    for (unsigned int i=0; i<nbSeg; ++i)
+        CoM.col(i) = RigidBodyDynamics::CalcBodyToBaseCoordinates(
+                    *this, Q, (*m_segments)[i].id(), (*m_segments)[i].characteristics().mCenterOfMass, false);
+}
+
+
 biorbd::utils::Vector3d biorbd::rigidbody::Joints::CoMbySegment(
         const biorbd::rigidbody::GeneralizedCoordinates &Q,
         const unsigned int idx,
         bool updateKin)
 { // Position of the center of mass of segment i
     biorbd::utils::Error::check(idx < m_segments->size(), "Choosen segment doesn't exist");
+    if (updateKin)
+        UpdateKinematicsCustom(&Q, nullptr, nullptr);
     return RigidBodyDynamics::CalcBodyToBaseCoordinates(
-                *this, Q, (*m_segments)[idx].id(), (*m_segments)[idx].characteristics().mCenterOfMass, updateKin);
+                *this, Q, (*m_segments)[idx].id(), (*m_segments)[idx].characteristics().mCenterOfMass, false);
+}
+
+void biorbd::rigidbody::Joints::CoM(
+        const biorbd::utils::Matrix &allQ,
+        biorbd::utils::Matrix &allCoM,
+        unsigned int nbThreads)
+{
+    if (allCoM.rows() != 3 || allCoM.cols() != allQ.cols())
+        allCoM.resize(3, allQ.cols());
+
+    unsigned int nbSeg(nbSegment());
+    double totalMass(mass());
+    forEachFrame(allQ, [&](biorbd::rigidbody::Joints& model, const RigidBodyDynamics::Math::VectorNd& Q, unsigned int frame){
+        RigidBodyDynamics::Math::Vector3d com(0, 0, 0);
+        for (unsigned int i=0; i<nbSeg; ++i){
+            const biorbd::rigidbody::SegmentCharacteristics& characteristics((*m_segments)[i].characteristics());
+            com += characteristics.mMass * RigidBodyDynamics::CalcBodyToBaseCoordinates(
+                        model, Q, (*m_segments)[i].id(), characteristics.mCenterOfMass, false);
+        }
+        allCoM.col(frame) = com / totalMass;
+    }, nbThreads);
+}
+
+void biorbd::rigidbody::Joints::CoMbySegmentAllFrames(
+        const biorbd::utils::Matrix &allQ,
+        biorbd::utils::Matrix &allCoM,
+        unsigned int nbThreads)
+{
+    unsigned int nbSeg(nbSegment());
+    if (allCoM.rows() != 3*nbSeg || allCoM.cols() != allQ.cols())
+        allCoM.resize(3*nbSeg, allQ.cols());
+
+    forEachFrame(allQ, [&](biorbd::rigidbody::Joints& model, const RigidBodyDynamics::Math::VectorNd& Q, unsigned int frame){
+        for (unsigned int i=0; i<nbSeg; ++i)
+            allCoM.block<3, 1>(3*i, frame) = RigidBodyDynamics::CalcBodyToBaseCoordinates(
+                        model, Q, (*m_segments)[i].id(), (*m_segments)[i].characteristics().mCenterOfMass, false);
+    }, nbThreads);
 }
 
 
@@ -639,7 +906,9 @@ biorbd::utils::Vector3d biorbd::rigidbody::Joints::CoMdotBySegment(
         bool updateKin)
 { // Position of the center of mass of segment i
     biorbd::utils::Error::check(idx < m_segments->size(), "Choosen segment doesn't exist");
-    return CalcPointVelocity(*this, Q, Qdot, (*m_segments)[idx].id(),(*m_segments)[idx].characteristics().mCenterOfMass,updateKin);
+    if (updateKin)
+        UpdateKinematicsCustom(&Q, &Qdot, nullptr);
+    return CalcPointVelocity(*this, Q, Qdot, (*m_segments)[idx].id(),(*m_segments)[idx].characteristics().mCenterOfMass,false);
 }
 
 
@@ -667,7 +936,9 @@ biorbd::utils::Vector3d biorbd::rigidbody::Joints::CoMddotBySegment(
         bool updateKin)
 { // Position of the center of mass of segment i
     biorbd::utils::Error::check(idx < m_segments->size(), "Choosen segment doesn't exist");
-    return RigidBodyDynamics::CalcPointAcceleration(*this, Q, Qdot, Qddot, (*m_segments)[idx].id(),(*m_segments)[idx].characteristics().mCenterOfMass,updateKin);
+    if (updateKin)
+        UpdateKinematicsCustom(&Q, &Qdot, &Qddot);
+    return RigidBodyDynamics::CalcPointAcceleration(*this, Q, Qdot, Qddot, (*m_segments)[idx].id(),(*m_segments)[idx].characteristics().mCenterOfMass,false);
 }
 
 std::vector<std::vector<biorbd::utils::Vector3d>> biorbd::rigidbody::Joints::meshPoints(
@@ -706,22 +977,36 @@ std::vector<biorbd::utils::Matrix>
 biorbd::rigidbody::Joints::meshPointsInMatrix(
         const biorbd::rigidbody::GeneralizedCoordinates &Q,
         bool updateKin)
+{
+    std::vector<biorbd::utils::Matrix> all_points;
+    meshPointsInMatrix(Q, all_points, updateKin);
+    return all_points;
+}
+
+void biorbd::rigidbody::Joints::meshPointsInMatrix(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        std::vector<biorbd::utils::Matrix> &points,
+        bool updateKin,
+        unsigned int nbThreads)
 {
     if (updateKin)
         UpdateKinematicsCustom (&Q, nullptr, nullptr);
     const std::vector<biorbd::utils::RotoTrans>& RT(allGlobalJCS());
 
-    std::vector<biorbd::utils::Matrix> all_points;
-    for (unsigned int i=0; i<m_segments->size(); ++i) {
-        biorbd::utils::Matrix mat(3, mesh(i).nbVertex());
-        for (unsigned int j=0; j<mesh(i).nbVertex(); ++j){
-            biorbd::utils::Vector3d tp (mesh(i).point(j));
-            tp.applyRT(RT[i]);
-            mat.block(0, j, 3, 1) = tp;
-        }
-        all_points.push_back(mat);
+    // The vertices are gathered before dispatching so the threads only read them
+    unsigned int nbSeg(nbSegment());
+    points.resize(nbSeg);
+    for (unsigned int i=0; i<nbSeg; ++i){
+        const biorbd::utils::Matrix& vertex(mesh(i).pointsInMatrix());
+        if (points[i].rows() != 3 || points[i].cols() != vertex.cols())
+            points[i].resize(3, vertex.cols());
     }
-    return all_points;
+
+    // The meshes can be of very different sizes, so the segments are handed to the threads as they become available
+    biorbd::utils::ThreadDispatcher(nbThreads).runDynamic(nbSeg, [&](unsigned int, unsigned int i){
+        points[i].noalias() = RT[i].block<3, 3>(0, 0) * mesh(i).pointsInMatrix();
+        points[i].colwise() += RT[i].block<3, 1>(0, 3);
+    });
 }
 std::vector<biorbd::utils::Vector3d> biorbd::rigidbody::Joints::meshPoints(
         const std::vector<biorbd::utils::RotoTrans> &RT,
@@ -769,11 +1054,13 @@ biorbd::utils::Vector3d biorbd::rigidbody::Joints::CalcAngularMomentum (
 {
     RigidBodyDynamics::Math::Vector3d com,  angular_momentum;
     double mass;
-    
+    if (updateKin)
+        UpdateKinematicsCustom(&Q, &Qdot, nullptr);
+
     // Calculate the angular momentum with the function of the position of the center of mass
     RigidBodyDynamics::Utils::CalcCenterOfMass(
                 *this, Q, Qdot, nullptr, mass, com, nullptr, nullptr,
-                &angular_momentum, nullptr, updateKin);
+                &angular_momentum, nullptr, false);
     return angular_momentum;
 }
 biorbd::utils::Vector3d biorbd::rigidbody::Joints::CalcAngularMomentum (
@@ -785,11 +1072,13 @@ biorbd::utils::Vector3d biorbd::rigidbody::Joints::CalcAngularMomentum (
     // Definition of the variables
     RigidBodyDynamics::Math::Vector3d com,  angular_momentum;
     double mass;
+    if (updateKin)
+        UpdateKinematicsCustom(&Q, &Qdot, &Qddot);
 
     // Calculate the angular momentum with the function of the position of the center of mass
     RigidBodyDynamics::Utils::CalcCenterOfMass(
                 *this, Q, Qdot, &Qddot, mass, com, nullptr, nullptr,
-                &angular_momentum, nullptr, updateKin);
+                &angular_momentum, nullptr, false);
 
     return angular_momentum;
 }
@@ -866,117 +1155,27 @@ void biorbd::rigidbody::Joints::ForwardDynamicsContactsLagrangian (
         const RigidBodyDynamics::Math::VectorNd &QDot,
         const RigidBodyDynamics::Math::VectorNd &torque,
         RigidBodyDynamics::ConstraintSet &CS,
-        RigidBodyDynamics::Math::VectorNd &QDDot
-     ) {
-
-   // Compute C
-   CS.QDDot_0.setZero();
-   RigidBodyDynamics::InverseDynamics (*this, Q, QDot, CS.QDDot_0, CS.C);
-
-   // Compute H
-   CS.H = RigidBodyDynamics::Math::MatrixNd::Zero(this->dof_count, this->dof_count);
-   RigidBodyDynamics::CompositeRigidBodyAlgorithm (*this, Q, CS.H, false);
-
-   // Compute G
-   unsigned int i,j;
-
-   // variables to check whether we need to recompute G
-   unsigned int prev_body_id = 0;
-   RigidBodyDynamics::Math::Vector3d prev_body_point = RigidBodyDynamics::Math::Vector3d::Zero();
-   RigidBodyDynamics::Math::MatrixNd Gi (RigidBodyDynamics::Math::MatrixNd::Zero(3, this->dof_count));
-
-   for (i = 0; i < CS.size(); i++) {
-     // Only alow contact normals along the coordinate axes
-//     unsigned int axis_index = 0;
-
-     // only compute the matrix Gi if actually needed
-     if (prev_body_id != CS.body[i] || prev_body_point != CS.point[i]) {
-        RigidBodyDynamics::CalcPointJacobian (*this, Q, CS.body[i], CS.point[i], Gi, false);
-       prev_body_id = CS.body[i];
-       prev_body_point = CS.point[i];
-     }
-
-     for (j = 0; j < this->dof_count; j++) {
-       RigidBodyDynamics::Math::Vector3d gaxis (Gi(0,j), Gi(1,j), Gi(2,j));
-       CS.G(i,j) = gaxis.transpose() * CS.normal[i];
- //      CS.G(i,j) = Gi(axis_index, j);
-     }
-  }
-
-   // Compute gamma
-   prev_body_id = 0;
-   prev_body_point = RigidBodyDynamics::Math::Vector3d::Zero();
-   RigidBodyDynamics::Math::Vector3d gamma_i = RigidBodyDynamics::Math::Vector3d::Zero();
-
-   // update Kinematics just once
-   UpdateKinematics (*this, Q, QDot, CS.QDDot_0);
-
-   for (i = 0; i < CS.size(); i++) {
-     // Only alow contact normals along the coordinate axes
-     unsigned int axis_index = 0;
-
-     if (CS.normal[i] == RigidBodyDynamics::Math::Vector3d(1., 0., 0.))
-       axis_index = 0;
-    else if (CS.normal[i] == RigidBodyDynamics::Math::Vector3d(0., 1., 0.))
-       axis_index = 1;
-    else if (CS.normal[i] == RigidBodyDynamics::Math::Vector3d(0., 0., 1.))
-       axis_index = 2;
-    else
-       biorbd::utils::Error::raise("Invalid contact normal axis!");
-
-        // only compute point accelerations when necessary
-     if (prev_body_id != CS.body[i] || prev_body_point != CS.point[i]) {
-       gamma_i = CalcPointAcceleration (*this, Q, QDot, CS.QDDot_0, CS.body[i], CS.point[i], false);
-       prev_body_id = CS.body[i];
-       prev_body_point = CS.point[i];
-     }
-
-    // we also substract ContactData[i].acceleration such that the contact
-    // point will have the desired acceleration
-     CS.gamma[i] = gamma_i[axis_index] - CS.acceleration[i];
-   }
-
-   // Build the system
-   CS.A.setZero();
-  CS.b.setZero();
-  CS.x.setZero();
-
-   // Build the system: Copy H
-  for (i = 0; i < this->dof_count; i++) {
-     for (j = 0; j < this->dof_count; j++) {
-       CS.A(i,j) = CS.H(i,j);
-     }
-  }
-
-   // Build the system: Copy G, and G^T
-   for (i = 0; i < CS.size(); i++) {
-     for (j = 0; j < this->dof_count; j++) {
-       CS.A(i + this->dof_count, j) = CS.G (i,j);
-       CS.A(j, i + this->dof_count) = CS.G (i,j);
-     }
-   }
-
-   // Build the system: Copy -C + \GeneralizedTorque
-   for (i = 0; i < this->dof_count; i++) {
-    CS.b[i] = -CS.C[i] + torque[i];
-   }
-
-   // Build the system: Copy -gamma
-   for (i = 0; i < CS.size(); i++) {
-     CS.b[i + this->dof_count] = - CS.gamma[i];
-   }
-
-//   std::cout << "A = " << std::endl << CS.A << std::endl;
-   //std::cout << "b = " << std::endl << CS.b << std::endl;
-
-  switch (CS.linear_solver) {
+        RigidBodyDynamics::Math::VectorNd &QDDot)
+{
+    computeContactsSystem(Q, QDot, CS);
+    unsigned int nbContacts(static_cast<unsigned int>(CS.size()));
+
+    // Build the system [H G^T; G 0] [QDDot; lambda] = [-C + torque; -gamma]
+    CS.A.topLeftCorner(this->dof_count, this->dof_count) = CS.H;
+    CS.A.bottomLeftCorner(nbContacts, this->dof_count) = CS.G;
+    CS.A.topRightCorner(this->dof_count, nbContacts) = CS.G.transpose();
+    CS.A.bottomRightCorner(nbContacts, nbContacts).setZero();
+    CS.b.head(this->dof_count) = torque - CS.C;
+    CS.b.tail(nbContacts) = -CS.gamma;
+
+    switch (CS.linear_solver) {
     case (RigidBodyDynamics::Math::LinearSolverPartialPivLU) :
-     CS.x = CS.A.partialPivLu().solve(CS.b);
-      break;
-  case (RigidBodyDynamics::Math::LinearSolverColPivHouseholderQR) :
-       CS.x = CS.A.colPivHouseholderQr().solve(CS.b);
-       break;
-     default:
+        CS.x = CS.A.partialPivLu().solve(CS.b);
+        break;
+    case (RigidBodyDynamics::Math::LinearSolverColPivHouseholderQR) :
+        CS.x = CS.A.colPivHouseholderQr().solve(CS.b);
+        break;
+    default:
 #ifdef RBDL_ENABLE_LOGGING
         LOG << "Error: Invalid linear solver: " << CS.linear_solver << std::endl;
 #endif
@@ -984,19 +1183,106 @@ void biorbd::rigidbody::Joints::ForwardDynamicsContactsLagrangian (
 #ifdef _WIN32
         break;
 #endif
-   }
+    }
 
-   //std::cout << "x = " << std::endl << CS.x << std::endl;
+    // Copy back QDDot and the contact forces
+    QDDot = CS.x.head(this->dof_count);
+    CS.force = -CS.x.tail(nbContacts);
+}
+
+void biorbd::rigidbody::Joints::ForwardDynamicsContactsRangeSpace (
+        const RigidBodyDynamics::Math::VectorNd &Q,
+        const RigidBodyDynamics::Math::VectorNd &QDot,
+        const RigidBodyDynamics::Math::VectorNd &torque,
+        RigidBodyDynamics::ConstraintSet &CS,
+        RigidBodyDynamics::Math::VectorNd &QDDot)
+{
+    computeContactsSystem(Q, QDot, CS);
+    unsigned int nbContacts(static_cast<unsigned int>(CS.size()));
+    if (CS.Y.rows() != this->dof_count || CS.Y.cols() != nbContacts)
+        CS.Y.resize(this->dof_count, nbContacts);
+    if (CS.K.rows() != nbContacts || CS.K.cols() != nbContacts)
+        CS.K.resize(nbContacts, nbContacts);
+    CS.a.resize(nbContacts);
+    CS.QDDot_t.resize(this->dof_count);
+
+    // H = L L^T, factorized in place in a buffer of the model so CS.H is left as the mass matrix
+    biorbd::utils::Matrix& L(*m_massMatrixFactor);
+    L = CS.H;
+    Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> H_llt(L);
+    biorbd::utils::Error::check(H_llt.info() == Eigen::Success, "The mass matrix is not positive definite");
+
+    // Y = L^-1 G^T and QDDot_t = L^-1 (-C + torque)
+    CS.Y = CS.G.transpose();
+    H_llt.matrixL().solveInPlace(CS.Y);
+    CS.QDDot_t = torque - CS.C;
+    H_llt.matrixL().solveInPlace(CS.QDDot_t);
+
+    // Schur complement of the contacts: (G H^-1 G^T) lambda = G H^-1 (-C + torque) + gamma
+    CS.K.noalias() = CS.Y.transpose() * CS.Y;
+    CS.a = CS.gamma;
+    CS.a.noalias() += CS.Y.transpose() * CS.QDDot_t;
+    Eigen::LDLT<Eigen::Ref<RigidBodyDynamics::Math::MatrixNd>> K_ldlt(CS.K);
+    CS.force = K_ldlt.solve(CS.a);
+
+    // QDDot = H^-1 (-C + torque - G^T lambda)
+    CS.QDDot_t.noalias() -= CS.Y * CS.force;
+    H_llt.matrixU().solveInPlace(CS.QDDot_t);
+    QDDot = CS.QDDot_t;
+    CS.force *= -1;
+}
+
+void biorbd::rigidbody::Joints::computeContactsSystem(
+        const RigidBodyDynamics::Math::VectorNd &Q,
+        const RigidBodyDynamics::Math::VectorNd &QDot,
+        RigidBodyDynamics::ConstraintSet &CS)
+{
+    // Compute C
+    CS.QDDot_0.setZero();
+    RigidBodyDynamics::InverseDynamics (*this, Q, QDot, CS.QDDot_0, CS.C);
+
+    // Compute H, in the buffer prepared when the constraint set was bound
+    CS.H.setZero();
+    RigidBodyDynamics::CompositeRigidBodyAlgorithm (*this, Q, CS.H, false);
+
+    // Compute G and gamma, with the kinematics updated just once
+    RigidBodyDynamics::UpdateKinematics (*this, Q, QDot, CS.QDDot_0);
+    invalidateKinematicsCache();
+    unsigned int prev_body_id = 0;
+    RigidBodyDynamics::Math::Vector3d prev_body_point = RigidBodyDynamics::Math::Vector3d::Zero();
+    biorbd::utils::Matrix& Gi(*m_contactPointJacobian);
+    if (Gi.rows() != 3 || Gi.cols() != this->dof_count)
+        Gi.resize(3, this->dof_count);
+    RigidBodyDynamics::Math::Vector3d gamma_i = RigidBodyDynamics::Math::Vector3d::Zero();
+    for (unsigned int i = 0; i < CS.size(); i++) {
+        // Only alow contact normals along the coordinate axes
+        unsigned int axis_index = 0;
+        if (CS.normal[i] == RigidBodyDynamics::Math::Vector3d(1., 0., 0.))
+            axis_index = 0;
+        else if (CS.normal[i] == RigidBodyDynamics::Math::Vector3d(0., 1., 0.))
+            axis_index = 1;
+        else if (CS.normal[i] == RigidBodyDynamics::Math::Vector3d(0., 0., 1.))
+            axis_index = 2;
+        else
+            biorbd::utils::Error::raise("Invalid contact normal axis!");
+
+        // Only compute the matrix Gi and the point acceleration if actually needed
+        if (i == 0 || prev_body_id != CS.body[i] || prev_body_point != CS.point[i]) {
+            // RBDL only fills the columns of the joints that move the point
+            Gi.setZero();
+            RigidBodyDynamics::CalcPointJacobian (*this, Q, CS.body[i], CS.point[i], Gi, false);
+            gamma_i = RigidBodyDynamics::CalcPointAcceleration (*this, Q, QDot, CS.QDDot_0, CS.body[i], CS.point[i], false);
+            prev_body_id = CS.body[i];
+            prev_body_point = CS.point[i];
+        }
 
-   // Copy back QDDot
-for (i = 0; i < this->dof_count; i++)
-     QDDot[i] = CS.x[i];
+        // The normal being an axis, the row of G is the corresponding row of Gi
+        CS.G.row(i) = Gi.row(axis_index);
 
-  // Copy back contact forces
-  for (i = 0; i < CS.size(); i++) {
-     CS.force[i] = -CS.x[this->dof_count + i];
-   }
- }
+        // We also substract the desired acceleration of the contact point
+        CS.gamma[i] = gamma_i[axis_index] - CS.acceleration[i];
+    }
+}
 
 unsigned int biorbd::rigidbody::Joints::nbQuat() const{
     return *m_nRotAQuat;
@@ -1079,7 +1365,67 @@ void biorbd::rigidbody::Joints::UpdateKinematicsCustom(
         const biorbd::rigidbody::GeneralizedCoordinates *Qdot,
         const biorbd::rigidbody::GeneralizedCoordinates *Qddot)
 {
+    if (!*m_useKinematicsCache || !Q){
+        RigidBodyDynamics::UpdateKinematicsCustom(*this, Q, Qdot, Qddot);
+        invalidateKinematicsCache();
+        return;
+    }
+
+    // Skip the update if every requested state is already reflected by the kinematics
+    const biorbd::rigidbody::GeneralizedCoordinates* states[3] = {Q, Qdot, Qddot};
+    bool isUpToDate(true);
+    for (unsigned int i=0; i<3; ++i)
+        if (states[i] && !((*m_isKinematicsCacheValid)[i]
+                           && (*m_kinematicsCache)[i].size() == states[i]->size()
+                           && (*m_kinematicsCache)[i] == *states[i])){
+            isUpToDate = false;
+            break;
+        }
+    if (isUpToDate){
+        ++*m_nbKinematicsCacheHits;
+        return;
+    }
+
+    ++*m_nbKinematicsCacheMisses;
     RigidBodyDynamics::UpdateKinematicsCustom(*this, Q, Qdot, Qddot);
+    for (unsigned int i=0; i<3; ++i){
+        (*m_isKinematicsCacheValid)[i] = states[i] != nullptr;
+        if (states[i])
+            (*m_kinematicsCache)[i] = *states[i];
+    }
+}
+
+void biorbd::rigidbody::Joints::setUseKinematicsCache(bool useCache)
+{
+    *m_useKinematicsCache = useCache;
+    invalidateKinematicsCache();
+}
+
+bool biorbd::rigidbody::Joints::useKinematicsCache() const
+{
+    return *m_useKinematicsCache;
+}
+
+void biorbd::rigidbody::Joints::invalidateKinematicsCache()
+{
+    for (unsigned int i=0; i<3; ++i)
+        (*m_isKinematicsCacheValid)[i] = false;
+}
+
+unsigned int biorbd::rigidbody::Joints::nbKinematicsCacheHits() const
+{
+    return *m_nbKinematicsCacheHits;
+}
+
+unsigned int biorbd::rigidbody::Joints::nbKinematicsCacheMisses() const
+{
+    return *m_nbKinematicsCacheMisses;
+}
+
+void biorbd::rigidbody::Joints::resetKinematicsCacheCounters()
+{
+    *m_nbKinematicsCacheHits = 0;
+    *m_nbKinematicsCacheMisses = 0;
 }
 
 void biorbd::rigidbody::Joints::CalcMatRotJacobian(
@@ -1096,48 +1442,38 @@ void biorbd::rigidbody::Joints::CalcMatRotJacobian(
     // update the Kinematics if necessary
     if (updateKin) {
         RigidBodyDynamics::UpdateKinematicsCustom (*this, &Q, nullptr, nullptr);
+        invalidateKinematicsCache();
     }
 
     assert (G.rows() == 9 && G.cols() == this->qdot_size );
+    rotationJacobianInGlobal(segmentIdx, rotation, G, 0);
+}
 
-    std::vector<biorbd::utils::Vector3d> axes;
-    axes.push_back(biorbd::utils::Vector3d(1,0,0));
-    axes.push_back(biorbd::utils::Vector3d(0,1,0));
-    axes.push_back(biorbd::utils::Vector3d(0,0,1));
-    for (unsigned int iAxes=0; iAxes<3; ++iAxes){
-        RigidBodyDynamics::Math::Matrix3d bodyMatRot (
-                    RigidBodyDynamics::CalcBodyWorldOrientation (*this, Q, segmentIdx, false).transpose());
-        RigidBodyDynamics::Math::SpatialTransform point_trans(
-                    RigidBodyDynamics::Math::SpatialTransform (
-                        RigidBodyDynamics::Math::Matrix3d::Identity(), bodyMatRot * rotation * *(axes.begin()+iAxes)));
-
-
-        unsigned int reference_body_id = segmentIdx;
-
-        if (this->IsFixedBodyId(segmentIdx)) {
-            unsigned int fbody_id = segmentIdx - this->fixed_body_discriminator;
-            reference_body_id = this->mFixedBodies[fbody_id].mMovableParent;
-        }
-
-        unsigned int j = reference_body_id;
-
-        // e[j] is set to 1 if joint j contributes to the jacobian that we are
-        // computing. For all other joints the column will be zero.
-        while (j != 0) {
-            unsigned int q_index = this->mJoints[j].q_index;
-            // If it's not a DoF in translation (3 4 5 in this->S)
-            if (this->S[j](3)!=1.0 && this->S[j](4)!=1.0 && this->S[j](5)!=1.0)
-            {
-                RigidBodyDynamics::Math::SpatialTransform X_base = this->X_base[j];
-                X_base.r << 0,0,0; // Remove all concept of translation (only keep the rotation matrix)
-
-                if (this->mJoints[j].mDoFCount == 3) {
-                    G.block(iAxes*3, q_index, 3, 3) = ((point_trans * X_base.inverse()).toMatrix() * this->multdof3_S[j]).block(3,0,3,3);
-                } else {
-                    G.block(iAxes*3,q_index, 3, 1) = point_trans.apply(X_base.inverse().apply(this->S[j])).block(3,0,3,1);
-                }
-            }
-            j = this->lambda[j]; // Pass to parent segment
+void biorbd::rigidbody::Joints::rotationJacobianInGlobal(
+        unsigned int bodyId,
+        const RigidBodyDynamics::Math::Matrix3d &rotation,
+        RigidBodyDynamics::Math::MatrixNd &G,
+        unsigned int firstRow) const
+{
+    // Orientation of the rotation matrix in the global reference frame
+    RigidBodyDynamics::Math::Matrix3d globalRotation;
+    if (bodyId >= this->fixed_body_discriminator) {
+        const RigidBodyDynamics::FixedBody& fixedBody(this->mFixedBodies[bodyId - this->fixed_body_discriminator]);
+        bodyId = fixedBody.mMovableParent;
+        globalRotation = this->X_base[bodyId].E.transpose() * fixedBody.mParentTransform.E.transpose() * rotation;
+    }
+    else
+        globalRotation = this->X_base[bodyId].E.transpose() * rotation;
+
+    // A degree of freedom turning the body at omega changes each column c of the rotation matrix by omega x c,
+    // so the angular velocity of each joint of the chain gives the derivative of the 9 elements at once
+    RigidBodyDynamics::Math::Vector3d omega, velocity;
+    for (unsigned int j=bodyId; j!=0; j=this->lambda[j]){
+        const RigidBodyDynamics::Joint& joint(this->mJoints[j]);
+        for (unsigned int k=0; k<joint.mDoFCount; ++k){
+            jointMotionInGlobal(j, k, omega, velocity);
+            for (unsigned int axis=0; axis<3; ++axis)
+                G.block<3, 1>(firstRow + 3*axis, joint.q_index + k) = omega.cross(globalRotation.col(axis));
         }
     }
 }
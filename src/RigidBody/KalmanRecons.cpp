@@ -2,6 +2,7 @@
 #include "RigidBody/KalmanRecons.h"
 
 #include "BiorbdModel.h"
+#include "Utils/Error.h"
 #include "Utils/Matrix.h"
 #include "Utils/Vector.h"
 #include "RigidBody/GeneralizedCoordinates.h"
@@ -15,7 +16,16 @@ biorbd::rigidbody::KalmanRecons::KalmanRecons() :
     m_A(std::make_shared<biorbd::utils::Matrix>()),
     m_Q(std::make_shared<biorbd::utils::Matrix>()),
     m_R(std::make_shared<biorbd::utils::Matrix>()),
-    m_Pp(std::make_shared<biorbd::utils::Matrix>())
+    m_Pp(std::make_shared<biorbd::utils::Matrix>()),
+    m_xkm(std::make_shared<biorbd::utils::Vector>()),
+    m_Pkm(std::make_shared<biorbd::utils::Matrix>()),
+    m_APp(std::make_shared<biorbd::utils::Matrix>()),
+    m_Hvisible(std::make_shared<biorbd::utils::Matrix>()),
+    m_HPkm(std::make_shared<biorbd::utils::Matrix>()),
+    m_S(std::make_shared<biorbd::utils::Matrix>()),
+    m_innovation(std::make_shared<biorbd::utils::Vector>()),
+    m_isOccluded(std::make_shared<std::vector<bool>>()),
+    m_visibleMeasures(std::make_shared<std::vector<unsigned int>>())
 {
 
 }
@@ -31,7 +41,16 @@ biorbd::rigidbody::KalmanRecons::KalmanRecons(biorbd::Model &model,
     m_A(std::make_shared<biorbd::utils::Matrix>()),
     m_Q(std::make_shared<biorbd::utils::Matrix>()),
     m_R(std::make_shared<biorbd::utils::Matrix>()),
-    m_Pp(std::make_shared<biorbd::utils::Matrix>())
+    m_Pp(std::make_shared<biorbd::utils::Matrix>()),
+    m_xkm(std::make_shared<biorbd::utils::Vector>()),
+    m_Pkm(std::make_shared<biorbd::utils::Matrix>()),
+    m_APp(std::make_shared<biorbd::utils::Matrix>()),
+    m_Hvisible(std::make_shared<biorbd::utils::Matrix>()),
+    m_HPkm(std::make_shared<biorbd::utils::Matrix>()),
+    m_S(std::make_shared<biorbd::utils::Matrix>()),
+    m_innovation(std::make_shared<biorbd::utils::Vector>()),
+    m_isOccluded(std::make_shared<std::vector<bool>>()),
+    m_visibleMeasures(std::make_shared<std::vector<unsigned int>>())
 {
 
 }
@@ -52,37 +71,108 @@ void biorbd::rigidbody::KalmanRecons::DeepCopy(const biorbd::rigidbody::KalmanRe
     *m_Q = *other.m_Q;
     *m_R = *other.m_R;
     *m_Pp = *other.m_Pp;
+    *m_xkm = *other.m_xkm;
+    *m_Pkm = *other.m_Pkm;
+    *m_APp = *other.m_APp;
+    *m_Hvisible = *other.m_Hvisible;
+    *m_HPkm = *other.m_HPkm;
+    *m_S = *other.m_S;
+    *m_innovation = *other.m_innovation;
+    *m_isOccluded = *other.m_isOccluded;
+    *m_visibleMeasures = *other.m_visibleMeasures;
+}
+
+void biorbd::rigidbody::KalmanRecons::predictState()
+{
+    unsigned int n(*m_nbDof);
+    if (static_cast<unsigned int>(m_xkm->rows()) != 3*n)
+        m_xkm->resize(3*n);
+
+    // xkm = A * xp, A being block upper triangular with blocks a(i, j) * I and identities on its diagonal
+    for (unsigned int i=0; i<3; ++i){
+        m_xkm->segment(i*n, n) = m_xp->segment(i*n, n);
+        for (unsigned int k=i+1; k<3; ++k)
+            m_xkm->segment(i*n, n) += (*m_A)(i*n, k*n) * m_xp->segment(k*n, n);
+    }
 }
 
 void biorbd::rigidbody::KalmanRecons::iteration(
-        biorbd::utils::Vector measure,
+        const biorbd::utils::Vector &measure,
         const biorbd::utils::Vector &projectedMeasure,
         const biorbd::utils::Matrix &Hessian,
         const std::vector<unsigned int> &occlusion){
-    // Prediction
-    const biorbd::utils::Vector& xkm(*m_A * *m_xp);
-    const biorbd::utils::Matrix& Pkm(*m_A * *m_Pp * m_A->transpose() + *m_Q);
+    unsigned int n(*m_nbDof);
 
-    // Correction
-    biorbd::utils::Matrix InvTp( (Hessian * Pkm * Hessian.transpose() + *m_R).inverse() );
-    manageOcclusionDuringIteration(InvTp, measure, occlusion);
-    const biorbd::utils::Matrix& K(Pkm*Hessian.transpose() * InvTp); // Gain
+    // Prediction
+    predictState();
 
-    *m_xp = xkm+K*(measure-projectedMeasure); // New estimated state
-    const Eigen::MatrixXd& temp(biorbd::utils::Matrix::Identity(3* *m_nbDof, 3* *m_nbDof) - K*Hessian);
-    *m_Pp =  temp * Pkm * temp.transpose() + K* *m_R*K.transpose();
+    // Pkm = A * Pp * A^T + Q, with the same block structure for Q
+    if (static_cast<unsigned int>(m_Pkm->rows()) != 3*n){
+        m_Pkm->resize(3*n, 3*n);
+        m_APp->resize(3*n, 3*n);
+    }
+    for (unsigned int i=0; i<3; ++i)
+        for (unsigned int l=0; l<3; ++l){
+            m_APp->block(i*n, l*n, n, n) = m_Pp->block(i*n, l*n, n, n);
+            for (unsigned int k=i+1; k<3; ++k)
+                m_APp->block(i*n, l*n, n, n) += (*m_A)(i*n, k*n) * m_Pp->block(k*n, l*n, n, n);
+        }
+    for (unsigned int i=0; i<3; ++i)
+        for (unsigned int j=0; j<3; ++j){
+            m_Pkm->block(i*n, j*n, n, n) = m_APp->block(i*n, j*n, n, n);
+            for (unsigned int l=j+1; l<3; ++l)
+                m_Pkm->block(i*n, j*n, n, n) += (*m_A)(j*n, l*n) * m_APp->block(i*n, l*n, n, n);
+            m_Pkm->block(i*n, j*n, n, n).diagonal().array() += (*m_Q)(i*n, j*n);
+        }
+
+    // Keep the visible measurements only
+    unsigned int nbPerSensor(nbMeasurementsPerSensor());
+    m_isOccluded->assign(*m_nMeasure, false);
+    for (unsigned int i=0; i<occlusion.size(); ++i)
+        for (unsigned int j=occlusion[i]*nbPerSensor; j<(occlusion[i]+1)*nbPerSensor; ++j)
+            (*m_isOccluded)[j] = true;
+    m_visibleMeasures->clear();
+    for (unsigned int j=0; j<*m_nMeasure; ++j)
+        if (!(*m_isOccluded)[j])
+            m_visibleMeasures->push_back(j);
+    unsigned int m(static_cast<unsigned int>(m_visibleMeasures->size()));
+
+    if (static_cast<unsigned int>(m_Hvisible->rows()) != m || static_cast<unsigned int>(m_Hvisible->cols()) != n){
+        m_Hvisible->resize(m, n);
+        m_HPkm->resize(m, 3*n);
+        m_S->resize(m, m);
+        m_innovation->resize(m);
+    }
+    for (unsigned int k=0; k<m; ++k){
+        unsigned int j((*m_visibleMeasures)[k]);
+        m_Hvisible->row(k) = Hessian.block(j, 0, 1, n);
+        (*m_innovation)(k) = measure(j) - projectedMeasure(j);
+    }
 
+    // Correction, H being only a function of the generalized coordinates: H * Pkm = Hq * Pkm(Q rows)
+    m_HPkm->noalias() = *m_Hvisible * m_Pkm->topRows(n);
+    m_S->noalias() = m_HPkm->leftCols(n) * m_Hvisible->transpose();
+    for (unsigned int k=0; k<m; ++k)
+        for (unsigned int l=0; l<m; ++l)
+            (*m_S)(k, l) += (*m_R)((*m_visibleMeasures)[k], (*m_visibleMeasures)[l]);
+
+    // With S = L * L^T, the gain K = (H * Pkm)^T * S^-1 is never formed:
+    // xp = xkm + (L^-1 * H * Pkm)^T * (L^-1 * innovation) and Pp = Pkm - (L^-1 * H * Pkm)^T * (L^-1 * H * Pkm)
+    Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> S_llt(*m_S);
+    biorbd::utils::Error::check(S_llt.info() == Eigen::Success, "The innovation covariance of the Kalman filter is not positive definite");
+    S_llt.matrixL().solveInPlace(*m_HPkm);
+    S_llt.matrixL().solveInPlace(*m_innovation);
+
+    *m_xp = *m_xkm;
+    m_xp->noalias() += m_HPkm->transpose() * *m_innovation;
+    m_Pkm->selfadjointView<Eigen::Lower>().rankUpdate(m_HPkm->transpose(), -1.0);
+    m_Pp->triangularView<Eigen::Lower>() = *m_Pkm;
+    m_Pp->triangularView<Eigen::StrictlyUpper>() = m_Pkm->transpose();
 }
 
-void biorbd::rigidbody::KalmanRecons::manageOcclusionDuringIteration(
-        biorbd::utils::Matrix &InvTp,
-        biorbd::utils::Vector &measure,
-        const std::vector<unsigned int> &occlusion){
-    for (unsigned int i = 0; i < occlusion.size(); ++i)
-         for (unsigned int j=occlusion[i]; j< occlusion[i]+1; ++j){
-             InvTp(j,j) = 0; // Artifact due to the fact that m_R has a value at (j:j+2,j:j+2)
-             measure(j) = 0;
-         }
+unsigned int biorbd::rigidbody::KalmanRecons::nbMeasurementsPerSensor() const
+{
+    return 1;
 }
 
 void biorbd::rigidbody::KalmanRecons::getState(
@@ -217,10 +307,16 @@ biorbd::utils::Matrix biorbd::rigidbody::KalmanRecons::initCovariance(const unsi
 biorbd::rigidbody::KalmanRecons::KalmanParam::KalmanParam(
         double frequency,
         double noiseFactor,
-        double errorFactor):
+        double errorFactor,
+        unsigned int initMaxIterations,
+        double initTolerance,
+        unsigned int initFilterIterations):
     m_acquisitionFrequency(frequency),
     m_noiseFactor(noiseFactor),
-    m_errorFactor(errorFactor){}
+    m_errorFactor(errorFactor),
+    m_initMaxIterations(initMaxIterations),
+    m_initTolerance(initTolerance),
+    m_initFilterIterations(initFilterIterations){}
 
 double biorbd::rigidbody::KalmanRecons::KalmanParam::acquisitionFrequency() const{
     return m_acquisitionFrequency;
@@ -235,3 +331,18 @@ double biorbd::rigidbody::KalmanRecons::KalmanParam::errorFactor() const
 {
     return m_errorFactor;
 }
+
+unsigned int biorbd::rigidbody::KalmanRecons::KalmanParam::initMaxIterations() const
+{
+    return m_initMaxIterations;
+}
+
+double biorbd::rigidbody::KalmanRecons::KalmanParam::initTolerance() const
+{
+    return m_initTolerance;
+}
+
+unsigned int biorbd::rigidbody::KalmanRecons::KalmanParam::initFilterIterations() const
+{
+    return m_initFilterIterations;
+}
@@ -13,7 +13,10 @@
 biorbd::rigidbody::KalmanReconsIMU::KalmanReconsIMU() :
     biorbd::rigidbody::KalmanRecons(),
     m_PpInitial(std::make_shared<biorbd::utils::Matrix>()),
-    m_firstIteration(std::make_shared<bool>(true))
+    m_firstIteration(std::make_shared<bool>(true)),
+    m_IMUJacobian(std::make_shared<biorbd::utils::Matrix>()),
+    m_H(std::make_shared<biorbd::utils::Matrix>()),
+    m_zest(std::make_shared<biorbd::utils::Vector>())
 {
 
 }
@@ -23,7 +26,10 @@ biorbd::rigidbody::KalmanReconsIMU::KalmanReconsIMU(
         biorbd::rigidbody::KalmanRecons::KalmanParam params) :
     biorbd::rigidbody::KalmanRecons(model, model.nbTechIMUs()*9, params),
     m_PpInitial(std::make_shared<biorbd::utils::Matrix>()),
-    m_firstIteration(std::make_shared<bool>(true))
+    m_firstIteration(std::make_shared<bool>(true)),
+    m_IMUJacobian(std::make_shared<biorbd::utils::Matrix>()),
+    m_H(std::make_shared<biorbd::utils::Matrix>()),
+    m_zest(std::make_shared<biorbd::utils::Vector>())
 {
     // Initialize the filter
     initialize();
@@ -41,6 +47,9 @@ void biorbd::rigidbody::KalmanReconsIMU::DeepCopy(const biorbd::rigidbody::Kalma
     biorbd::rigidbody::KalmanRecons::DeepCopy(other);
     *m_PpInitial = *other.m_PpInitial;
     *m_firstIteration = *other.m_firstIteration;
+    *m_IMUJacobian = *other.m_IMUJacobian;
+    *m_H = *other.m_H;
+    *m_zest = *other.m_zest;
 }
 
 void biorbd::rigidbody::KalmanReconsIMU::initialize()
@@ -51,16 +60,9 @@ void biorbd::rigidbody::KalmanReconsIMU::initialize()
     *m_PpInitial = *m_Pp;
 }
 
-void biorbd::rigidbody::KalmanReconsIMU::manageOcclusionDuringIteration(
-        biorbd::utils::Matrix &InvTp,
-        biorbd::utils::Vector &measure,
-        const std::vector<unsigned int> &occlusion)
+unsigned int biorbd::rigidbody::KalmanReconsIMU::nbMeasurementsPerSensor() const
 {
-    for (unsigned int i = 0; i < occlusion.size(); ++i)
-         for (unsigned int j=occlusion[i] * 9; j< occlusion[i] * 9+9; ++j){
-             InvTp(j,j) = 0; // Artefact due to the fact that m_R has a value at (j:j+2,j:j+2)
-             measure[j] = 0;
-         }
+    return 9;
 }
 
 bool biorbd::rigidbody::KalmanReconsIMU::first()
@@ -107,34 +109,42 @@ void biorbd::rigidbody::KalmanReconsIMU::reconstructFrame(
     }
 
     // Projected state
-    const biorbd::utils::Vector& xkm(*m_A * *m_xp);
-    biorbd::rigidbody::GeneralizedCoordinates Q_tp(xkm.topRows(*m_nbDof));
+    predictState();
+    const biorbd::rigidbody::GeneralizedCoordinates& Q_tp(m_xkm->topRows(*m_nbDof));
     model.UpdateKinematicsCustom (&Q_tp, nullptr, nullptr);
 
-    // Projected markers
+    // Projected IMU and their jacobian, the jacobian in a buffer kept from one frame to another
     const std::vector<biorbd::rigidbody::IMU>& zest_tp = model.technicalIMU(Q_tp, false);
-    // Jacobian
-    const std::vector<biorbd::utils::Matrix>& J_tp = model.TechnicalIMUJacobian(Q_tp, false);
+    model.TechnicalIMUJacobian(Q_tp, *m_IMUJacobian, false);
+
     // Create only one matrix for zest and Jacobian
-    biorbd::utils::Matrix H(biorbd::utils::Matrix::Zero(*m_nMeasure, *m_nbDof*3)); // 3*nCentrales => X,Y,Z ; 3*nbDof => Q, Qdot, Qddot
-    biorbd::utils::Vector zest(biorbd::utils::Vector::Zero(*m_nMeasure));
+    // 9*nIMU => the rotation matrices ; 3*nbDof => Q, Qdot, Qddot (the columns of Qdot and Qddot remain zero)
+    if (static_cast<unsigned int>(m_H->rows()) != *m_nMeasure || static_cast<unsigned int>(m_H->cols()) != *m_nbDof*3){
+        m_H->resize(*m_nMeasure, *m_nbDof*3);
+        m_H->setZero();
+    }
+    if (static_cast<unsigned int>(m_zest->rows()) != *m_nMeasure)
+        m_zest->resize(*m_nMeasure);
     std::vector<unsigned int> occlusionIdx;
     for (unsigned int i=0; i<*m_nMeasure/9; ++i){
         double sum = 0;
         for (unsigned int j = 0; j < 9; ++j) // Calculate the norm for the 9 components
             sum += IMUobs(i*9+j)*IMUobs(i*9+j);
         if (sum != 0.0 && sum == sum){ // If there is an IMU (no zero or NaN)
-            H.block(i*9,0,9,*m_nbDof) = J_tp[i];
+            m_H->block(i*9,0,9,*m_nbDof) = m_IMUJacobian->block(i*9,0,9,*m_nbDof);
             const biorbd::utils::Rotation& rot = zest_tp[i].rot();
             for (unsigned int j = 0; j < 3; ++j)
-                zest.block(i*9+j*3, 0, 3, 1) = rot.block(0, j, 3, 1);
+                m_zest->block(i*9+j*3, 0, 3, 1) = rot.block(0, j, 3, 1);
         }
-        else
+        else {
+            m_H->block(i*9,0,9,*m_nbDof).setZero();
+            m_zest->block(i*9, 0, 9, 1).setZero();
             occlusionIdx.push_back(i);
+        }
     }
 
     // Make the filter
-    iteration(IMUobs, zest, H, occlusionIdx);
+    iteration(IMUobs, *m_zest, *m_H, occlusionIdx);
 
     getState(Q, Qdot, Qddot);
 }
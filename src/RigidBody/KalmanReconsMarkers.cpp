@@ -1,18 +1,24 @@
 #define BIORBD_API_EXPORTS
 #include "RigidBody/KalmanReconsMarkers.h"
 
+#include <chrono>
 #include <rbdl/Model.h>
 #include <rbdl/Kinematics.h>
 #include "BiorbdModel.h"
 #include "Utils/Error.h"
 #include "Utils/Matrix.h"
+#include "Utils/ThreadDispatcher.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/NodeSegment.h"
 
 biorbd::rigidbody::KalmanReconsMarkers::KalmanReconsMarkers() :
     biorbd::rigidbody::KalmanRecons(),
-    m_PpInitial(std::make_shared<biorbd::utils::Matrix>()),
-    m_firstIteration(std::make_shared<bool>(true))
+    m_firstIteration(std::make_shared<bool>(true)),
+    m_nbInitializationIterations(std::make_shared<unsigned int>(0)),
+    m_projectedMarkers(std::make_shared<Eigen::Matrix3Xd>()),
+    m_markersJacobian(std::make_shared<biorbd::utils::Matrix>()),
+    m_H(std::make_shared<biorbd::utils::Matrix>()),
+    m_zest(std::make_shared<biorbd::utils::Vector>())
 {
 
 }
@@ -21,8 +27,12 @@ biorbd::rigidbody::KalmanReconsMarkers::KalmanReconsMarkers(
         biorbd::Model &model,
         biorbd::rigidbody::KalmanRecons::KalmanParam params) :
     biorbd::rigidbody::KalmanRecons(model, model.nbTechnicalMarkers()*3, params),
-    m_PpInitial(std::make_shared<biorbd::utils::Matrix>()),
-    m_firstIteration(std::make_shared<bool>(true))
+    m_firstIteration(std::make_shared<bool>(true)),
+    m_nbInitializationIterations(std::make_shared<unsigned int>(0)),
+    m_projectedMarkers(std::make_shared<Eigen::Matrix3Xd>()),
+    m_markersJacobian(std::make_shared<biorbd::utils::Matrix>()),
+    m_H(std::make_shared<biorbd::utils::Matrix>()),
+    m_zest(std::make_shared<biorbd::utils::Vector>())
 {
 
     // Initialize the filter
@@ -40,27 +50,80 @@ biorbd::rigidbody::KalmanReconsMarkers biorbd::rigidbody::KalmanReconsMarkers::D
 void biorbd::rigidbody::KalmanReconsMarkers::DeepCopy(const biorbd::rigidbody::KalmanReconsMarkers &other)
 {
     biorbd::rigidbody::KalmanRecons::DeepCopy(other);
-    *m_PpInitial = *other.m_PpInitial;
     *m_firstIteration = *other.m_firstIteration;
+    *m_nbInitializationIterations = *other.m_nbInitializationIterations;
+    *m_projectedMarkers = *other.m_projectedMarkers;
+    *m_markersJacobian = *other.m_markersJacobian;
+    *m_H = *other.m_H;
+    *m_zest = *other.m_zest;
 }
 
 void biorbd::rigidbody::KalmanReconsMarkers::initialize(){
     biorbd::rigidbody::KalmanRecons::initialize();
+}
 
-    // Keep in mind the initial m_Pp
-    m_PpInitial = m_Pp;
+unsigned int biorbd::rigidbody::KalmanReconsMarkers::nbMeasurementsPerSensor() const
+{
+    return 3;
 }
 
-void biorbd::rigidbody::KalmanReconsMarkers::manageOcclusionDuringIteration(
-        biorbd::utils::Matrix &InvTp,
-        utils::Vector &measure,
-        const std::vector<unsigned int> &occlusion)
+void biorbd::rigidbody::KalmanReconsMarkers::reconstructTrials(
+        biorbd::Model &model,
+        const std::vector<biorbd::utils::Matrix> &trials,
+        std::vector<biorbd::utils::Matrix> &allQ,
+        std::vector<biorbd::utils::Matrix> &allQdot,
+        std::vector<biorbd::utils::Matrix> &allQddot,
+        std::vector<double> &durations,
+        biorbd::rigidbody::KalmanRecons::KalmanParam params,
+        bool removeAxes,
+        unsigned int nbThreads)
 {
-    for (unsigned int i = 0; i < occlusion.size(); ++i)
-         for (unsigned int j=occlusion[i] * 3; j< occlusion[i] * 3+3; ++j){
-             InvTp(j,j) = 0; // Artefact due to the fact that m_R has a value at (j:j+2,j:j+2)
-             measure[j] = 0;
-         }
+    unsigned int nbTrials(static_cast<unsigned int>(trials.size()));
+    for (unsigned int i=0; i<nbTrials; ++i)
+        biorbd::utils::Error::check(trials[i].rows() == 3*model.nbTechnicalMarkers(),
+                                    "Number of rows of each trial must be 3 times the number of technical markers");
+    allQ.resize(nbTrials);
+    allQdot.resize(nbTrials);
+    allQddot.resize(nbTrials);
+    durations.resize(nbTrials);
+
+    // Every thread has its own workspace, the calling thread included so the kinematics of the model is kept
+    biorbd::utils::ThreadDispatcher dispatcher(nbThreads);
+    unsigned int nbWorkspaces(dispatcher.nbChunks(nbTrials));
+    std::vector<biorbd::Model> workspaces;
+    workspaces.reserve(nbWorkspaces);
+    for (unsigned int i=0; i<nbWorkspaces; ++i){
+        workspaces.push_back(model);
+        workspaces.back().detachWorkspace();
+    }
+    std::vector<biorbd::utils::Vector> Tobs(nbWorkspaces, biorbd::utils::Vector(3*model.nbTechnicalMarkers()));
+    std::vector<biorbd::rigidbody::GeneralizedCoordinates> Q(nbWorkspaces, biorbd::rigidbody::GeneralizedCoordinates(model));
+    std::vector<biorbd::rigidbody::GeneralizedCoordinates> Qdot(nbWorkspaces, biorbd::rigidbody::GeneralizedCoordinates(model));
+    std::vector<biorbd::rigidbody::GeneralizedCoordinates> Qddot(nbWorkspaces, biorbd::rigidbody::GeneralizedCoordinates(model));
+
+    dispatcher.runDynamic(nbTrials, [&](unsigned int thread, unsigned int trial){
+        std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+
+        biorbd::Model& workspace(workspaces[thread]);
+        unsigned int nbFrames(static_cast<unsigned int>(trials[trial].cols()));
+        if (allQ[trial].rows() != workspace.nbQ() || allQ[trial].cols() != nbFrames)
+            allQ[trial].resize(workspace.nbQ(), nbFrames);
+        if (allQdot[trial].rows() != workspace.nbQdot() || allQdot[trial].cols() != nbFrames)
+            allQdot[trial].resize(workspace.nbQdot(), nbFrames);
+        if (allQddot[trial].rows() != workspace.nbQddot() || allQddot[trial].cols() != nbFrames)
+            allQddot[trial].resize(workspace.nbQddot(), nbFrames);
+
+        biorbd::rigidbody::KalmanReconsMarkers kalman(workspace, params);
+        for (unsigned int i=0; i<nbFrames; ++i){
+            Tobs[thread] = trials[trial].col(i);
+            kalman.reconstructFrame(workspace, Tobs[thread], &Q[thread], &Qdot[thread], &Qddot[thread], removeAxes);
+            allQ[trial].col(i) = Q[thread];
+            allQdot[trial].col(i) = Qdot[thread];
+            allQddot[trial].col(i) = Qddot[thread];
+        }
+
+        durations[trial] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    });
 }
 
 bool biorbd::rigidbody::KalmanReconsMarkers::first()
@@ -68,6 +131,24 @@ bool biorbd::rigidbody::KalmanReconsMarkers::first()
     return *m_firstIteration;
 }
 
+unsigned int biorbd::rigidbody::KalmanReconsMarkers::nbInitializationIterations() const
+{
+    return *m_nbInitializationIterations;
+}
+
+void biorbd::rigidbody::KalmanReconsMarkers::fitFirstFrame(
+        biorbd::Model &model,
+        const biorbd::utils::Vector &Tobs,
+        bool removeAxes)
+{
+    biorbd::rigidbody::GeneralizedCoordinates Q(m_xp->topRows(*m_nbDof));
+    double residual;
+    *m_nbInitializationIterations = model.inverseKinematics(
+                Tobs, Q, residual, biorbd::rigidbody::Markers::InverseKinematicsParam(
+                    m_params->initMaxIterations(), m_params->initTolerance(), removeAxes));
+    m_xp->topRows(*m_nbDof) = Q;
+}
+
 void biorbd::rigidbody::KalmanReconsMarkers::reconstructFrame(
         biorbd::Model &model,
         const biorbd::rigidbody::Markers &Tobs,
@@ -111,47 +192,47 @@ void biorbd::rigidbody::KalmanReconsMarkers::reconstructFrame(
     // An iteration of the Kalman filter
     if (*m_firstIteration){
         *m_firstIteration = false;
-        biorbd::utils::Vector TobsTP(Tobs);
-        TobsTP.block(3*model.nbTechnicalMarkers(0), 0, 3*model.nbTechnicalMarkers()-3*model.nbTechnicalMarkers(0), 1) =
-                Eigen::VectorXd::Zero(3*model.nbTechnicalMarkers()-3*model.nbTechnicalMarkers(0)); // Only keep the markers of the root
-        for (unsigned int j = 0; j < 2; ++j){ // Do the root and then the rest of the body
-            if (j != 0)
-                TobsTP = Tobs; // Re-take all the markers
-
-            for (unsigned int i=0; i<50; ++i){
-                // The first time, call in a recursive manner to get a descent initial position
-                reconstructFrame(model, TobsTP, nullptr, nullptr, nullptr);
-
-                // Reset Pp to initial (we are not interested in the velocity to get to the initial position)
-                m_Pp = m_PpInitial;
-                m_xp->block(*m_nbDof, 0, *m_nbDof*2, 1) = Eigen::VectorXd::Zero(*m_nbDof*2); // Set velocity and acceleration to zero
-            }
+
+        // Fit the position on the markers, then let the filter settle its covariance on this frame
+        fitFirstFrame(model, Tobs, removeAxes);
+        m_xp->bottomRows(*m_nbDof*2).setZero();
+        for (unsigned int i=0; i<m_params->initFilterIterations(); ++i){
+            reconstructFrame(model, Tobs, nullptr, nullptr, nullptr, removeAxes);
+            m_xp->bottomRows(*m_nbDof*2).setZero(); // We are not interested in the velocity to get to the initial position
         }
     }
 
     // Projected state
-    const biorbd::utils::Vector& xkm(*m_A * *m_xp);
-    const biorbd::rigidbody::GeneralizedCoordinates& Q_tp(xkm.topRows(*m_nbDof));
+    predictState();
+    const biorbd::rigidbody::GeneralizedCoordinates& Q_tp(m_xkm->topRows(*m_nbDof));
     model.UpdateKinematicsCustom (&Q_tp, nullptr, nullptr);
 
-    // Projected markers
-    const std::vector<biorbd::rigidbody::NodeSegment>& zest_tp(model.technicalMarkers(Q_tp, removeAxes, false));
-    // Jacobian
-   const  std::vector<biorbd::utils::Matrix>& J_tp(model.technicalMarkersJacobian(Q_tp, removeAxes, false));
+    // Projected markers and their jacobian, in buffers kept from one frame to another
+    model.technicalMarkers(Q_tp, *m_projectedMarkers, removeAxes, false);
+    model.technicalMarkersJacobian(Q_tp, *m_markersJacobian, removeAxes, false);
+
     // Create only one matrix for zest and Jacobian
-    biorbd::utils::Matrix H(biorbd::utils::Matrix::Zero(*m_nMeasure, *m_nbDof*3)); // 3*nMarkers => X,Y,Z ; 3*nbDof => Q, Qdot, Qddot
-    biorbd::utils::Vector zest(biorbd::utils::Vector::Zero(*m_nMeasure));
+    // 3*nMarkers => X,Y,Z ; 3*nbDof => Q, Qdot, Qddot (the columns of Qdot and Qddot remain zero)
+    if (static_cast<unsigned int>(m_H->rows()) != *m_nMeasure || static_cast<unsigned int>(m_H->cols()) != *m_nbDof*3){
+        m_H->resize(*m_nMeasure, *m_nbDof*3);
+        m_H->setZero();
+    }
+    if (static_cast<unsigned int>(m_zest->rows()) != *m_nMeasure)
+        m_zest->resize(*m_nMeasure);
     std::vector<unsigned int> occlusionIdx;
     for (unsigned int i=0; i<*m_nMeasure/3; ++i) // Divided by 3 because we are integrate once xyz
         if (Tobs(i*3)*Tobs(i*3) + Tobs(i*3+1)*Tobs(i*3+1) + Tobs(i*3+2)*Tobs(i*3+2) != 0.0){ // If there is a marker
-            H.block(i*3,0,3,*m_nbDof) = J_tp[i];
-            zest.block(i*3, 0, 3, 1) = zest_tp[i];
+            m_H->block(i*3,0,3,*m_nbDof) = m_markersJacobian->block(i*3,0,3,*m_nbDof);
+            m_zest->block(i*3, 0, 3, 1) = m_projectedMarkers->col(i);
         }
-        else
+        else {
+            m_H->block(i*3,0,3,*m_nbDof).setZero();
+            m_zest->block(i*3, 0, 3, 1).setZero();
             occlusionIdx.push_back(i);
+        }
 
     // Filter
-    iteration(Tobs, zest, H, occlusionIdx);
+    iteration(Tobs, *m_zest, *m_H, occlusionIdx);
 
     getState(Q, Qdot, Qddot);
 }
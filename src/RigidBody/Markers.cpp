@@ -1,10 +1,15 @@
 #define BIORBD_API_EXPORTS
 #include "RigidBody/Markers.h"
 
+#include <algorithm>
+#include <cmath>
 #include <rbdl/Model.h>
 #include <rbdl/Kinematics.h>
+#include "Utils/Error.h"
 #include "Utils/String.h"
 #include "Utils/Matrix.h"
+#include "Utils/ThreadDispatcher.h"
+#include "Utils/Vector.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/Joints.h"
 #include "RigidBody/NodeSegment.h"
@@ -83,11 +88,13 @@ biorbd::rigidbody::NodeSegment biorbd::rigidbody::Markers::marker(
     // Assuming that this is also a joint type (via BiorbdModel)
     biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
 
-    unsigned int id = model.GetBodyId(n.parent().c_str());
+    unsigned int id = parentBodyId(n);
+    if (updateKin)
+        model.UpdateKinematicsCustom(&Q, nullptr, nullptr);
     if (removeAxis)
-        return biorbd::rigidbody::NodeSegment(RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, id, n.removeAxes(), updateKin));
+        return biorbd::rigidbody::NodeSegment(RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, id, n.removeAxes(), false));
     else
-        return biorbd::rigidbody::NodeSegment(RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, id, n, updateKin));
+        return biorbd::rigidbody::NodeSegment(RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, id, n, false));
 }
 
 // Get a marker
@@ -101,12 +108,14 @@ biorbd::rigidbody::NodeSegment biorbd::rigidbody::Markers::marker(
     biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
 
     const biorbd::rigidbody::NodeSegment& node(marker(idx));
-    unsigned int id = model.GetBodyId(node.parent().c_str());
+    unsigned int id = parentBodyId(node);
 
     // Retrieve the position of the marker in the local reference
     const biorbd::rigidbody::NodeSegment& pos = marker(idx, removeAxis);
 
-    return biorbd::rigidbody::NodeSegment(RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, id, pos, updateKin));
+    if (updateKin)
+        model.UpdateKinematicsCustom(&Q, nullptr, nullptr);
+    return biorbd::rigidbody::NodeSegment(RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, id, pos, false));
 }
 // Get a marker
 biorbd::rigidbody::NodeSegment biorbd::rigidbody::Markers::marker(
@@ -135,6 +144,27 @@ std::vector<biorbd::rigidbody::NodeSegment> biorbd::rigidbody::Markers::markers(
 
     return pos;
 }
+// Get all the markers for a whole trial
+void biorbd::rigidbody::Markers::markersAllFrames(
+        const biorbd::utils::Matrix &allQ,
+        biorbd::utils::Matrix &allMarkers,
+        bool removeAxis,
+        unsigned int nbThreads)
+{
+    std::vector<unsigned int> idx(nbMarkers());
+    for (unsigned int i=0; i<nbMarkers(); ++i)
+        idx[i] = i;
+    markersOfAllFrames(allQ, idx, allMarkers, removeAxis, nbThreads);
+}
+// Get all the markers without creating a node for each of them
+void biorbd::rigidbody::Markers::markers(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        Eigen::Matrix3Xd &markers,
+        bool removeAxis,
+        bool updateKin)
+{
+    markersOfOneFrame(Q, false, markers, removeAxis, updateKin);
+}
 // Get all the markers in the local reference
 std::vector<biorbd::rigidbody::NodeSegment> biorbd::rigidbody::Markers::markers(bool removeAxis)
 {
@@ -157,13 +187,15 @@ biorbd::rigidbody::NodeSegment biorbd::rigidbody::Markers::markerVelocity(
     biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
 
     const biorbd::rigidbody::NodeSegment& node(marker(idx));
-    unsigned int id(model.GetBodyId(node.parent().c_str()));
+    unsigned int id(parentBodyId(node));
 
     // Retrieve the position of the marker in the local reference 
     const biorbd::rigidbody::NodeSegment& pos(marker(idx, removeAxis));
 
     // Calculate the velocity of the point
-    return biorbd::rigidbody::NodeSegment(RigidBodyDynamics::CalcPointVelocity(model, Q, Qdot, id, pos, updateKin));
+    if (updateKin)
+        model.UpdateKinematicsCustom(&Q, &Qdot, nullptr);
+    return biorbd::rigidbody::NodeSegment(RigidBodyDynamics::CalcPointVelocity(model, Q, Qdot, id, pos, false));
 }
 
 // Get the makers'velocities
@@ -207,6 +239,28 @@ std::vector<biorbd::rigidbody::NodeSegment> biorbd::rigidbody::Markers::technica
             pos.push_back(marker(i, removeAxis));// Forward kinematics
     return pos;
 }
+// Get the technical markers without creating a node for each of them
+void biorbd::rigidbody::Markers::technicalMarkers(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        Eigen::Matrix3Xd &markers,
+        bool removeAxis,
+        bool updateKin)
+{
+    markersOfOneFrame(Q, true, markers, removeAxis, updateKin);
+}
+// Get the technical markers for a whole trial
+void biorbd::rigidbody::Markers::technicalMarkersAllFrames(
+        const biorbd::utils::Matrix &allQ,
+        biorbd::utils::Matrix &allMarkers,
+        bool removeAxis,
+        unsigned int nbThreads)
+{
+    std::vector<unsigned int> idx;
+    for (unsigned int i=0; i<nbMarkers(); ++i)
+        if ( marker(i).isTechnical() )
+            idx.push_back(i);
+    markersOfAllFrames(allQ, idx, allMarkers, removeAxis, nbThreads);
+}
 // Get the anatomical markers
 std::vector<biorbd::rigidbody::NodeSegment> biorbd::rigidbody::Markers::anatomicalMarkers(
         const biorbd::rigidbody::GeneralizedCoordinates &Q,
@@ -310,7 +364,9 @@ biorbd::utils::Matrix biorbd::rigidbody::Markers::markersJacobian(
 
     // Calculate the Jacobien of this Tag
     unsigned int id = model.GetBodyId(parentName.c_str());
-    RigidBodyDynamics::CalcPointJacobian(model, Q, id, p, G, updateKin);
+    if (updateKin)
+        model.UpdateKinematicsCustom(&Q, nullptr, nullptr);
+    RigidBodyDynamics::CalcPointJacobian(model, Q, id, p, G, false);
 
     return G;
 }
@@ -321,26 +377,103 @@ bool biorbd::rigidbody::Markers::inverseKinematics(
         biorbd::rigidbody::GeneralizedCoordinates &Q,
         bool removeAxes)
 {
-    // Find the technical markers only (body_point)
-    std::vector<biorbd::rigidbody::NodeSegment> body_point(
-                technicalMarkers(removeAxes));
-    std::vector<RigidBodyDynamics::Math::Vector3d> body_pointEigen;
-    for (unsigned int i=0; i<body_point.size(); ++i)
-        body_pointEigen.push_back(body_point[i]);
+    // Assuming that this is also a joint type (via BiorbdModel)
+    biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
+    biorbd::utils::Error::check(markers.size() == nbTechnicalMarkers(),
+                                "Number of markers must be equal to the number of technical markers");
+
+    biorbd::utils::Vector T(static_cast<unsigned int>(3*markers.size()));
+    for (unsigned int i=0; i<markers.size(); ++i)
+        T.block(i*3, 0, 3, 1) = markers[i];
+
+    biorbd::rigidbody::Markers::InverseKinematicsParam params(100, 1e-10, removeAxes);
+    std::vector<unsigned int> bodyId;
+    biorbd::utils::Matrix local;
+    technicalMarkersInMovableBodies(bodyId, local, params.removeAxis());
 
-    std::vector<RigidBodyDynamics::Math::Vector3d> markersInRbdl;
-    for (unsigned int i = 0; i<markers.size(); ++i)
-        markersInRbdl.push_back(markers[i]);
+    double residual;
+    bool isConverged;
+    biorbd::utils::Matrix jacobian;
+    biorbd::utils::Vector error;
+    Q = Qinit;
+    inverseKinematicsOfOneFrame(model, bodyId, local, T, params, Q, residual, isConverged, jacobian, error);
+    return isConverged;
+}
+
+unsigned int biorbd::rigidbody::Markers::inverseKinematics(
+        const biorbd::utils::Vector &markers,
+        biorbd::rigidbody::GeneralizedCoordinates &Q,
+        double &residual,
+        const biorbd::rigidbody::Markers::InverseKinematicsParam &params)
+{
+    // Assuming that this is also a joint type (via BiorbdModel)
+    biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
+    biorbd::utils::Error::check(static_cast<unsigned int>(markers.rows()) == 3*nbTechnicalMarkers(),
+                                "Number of markers must be equal to the number of technical markers");
 
-    // Associate the body number to each technical marker (body_id)
-    std::vector<unsigned int> body_id;
-    for (unsigned int i=0; i<body_point.size(); ++i)
-        body_id.push_back( static_cast<unsigned int>((*(body_point.begin()+i)).parentId()) );
+    std::vector<unsigned int> bodyId;
+    biorbd::utils::Matrix local;
+    technicalMarkersInMovableBodies(bodyId, local, params.removeAxis());
 
-    // Call the base function
-    return RigidBodyDynamics::InverseKinematics(
-                dynamic_cast<biorbd::rigidbody::Joints &>(*this),
-                Qinit, body_id, body_pointEigen, markersInRbdl, Q);
+    bool isConverged;
+    biorbd::utils::Matrix jacobian;
+    biorbd::utils::Vector error;
+    return inverseKinematicsOfOneFrame(model, bodyId, local, markers, params, Q, residual, isConverged, jacobian, error);
+}
+
+void biorbd::rigidbody::Markers::inverseKinematics(
+        const biorbd::utils::Matrix &allMarkers,
+        const biorbd::rigidbody::GeneralizedCoordinates &Qinit,
+        biorbd::utils::Matrix &allQ,
+        std::vector<double> &residuals,
+        std::vector<unsigned int> &nbIterations,
+        const biorbd::rigidbody::Markers::InverseKinematicsParam &params,
+        unsigned int nbThreads)
+{
+    // Assuming that this is also a joint type (via BiorbdModel)
+    biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
+    biorbd::utils::Error::check(static_cast<unsigned int>(allMarkers.rows()) == 3*nbTechnicalMarkers(),
+                                "Number of rows of the markers must be 3 times the number of technical markers");
+    biorbd::utils::Error::check(Qinit.rows() == model.nbQ(), "Number of rows of generalized coordinates must be equal to the number of Q");
+    unsigned int nbFrames(static_cast<unsigned int>(allMarkers.cols()));
+
+    // Resolve the parent and the local position of the markers once for the whole trial
+    std::vector<unsigned int> bodyId;
+    biorbd::utils::Matrix local;
+    technicalMarkersInMovableBodies(bodyId, local, params.removeAxis());
+
+    if (allQ.rows() != Qinit.rows() || allQ.cols() != nbFrames)
+        allQ.resize(Qinit.rows(), nbFrames);
+    residuals.resize(nbFrames);
+    nbIterations.resize(nbFrames);
+
+    // The first chunk is computed by this model, every other one by its own workspace
+    biorbd::utils::ThreadDispatcher dispatcher(nbThreads);
+    unsigned int nbChunks(dispatcher.nbChunks(nbFrames));
+    std::vector<biorbd::rigidbody::Joints> workspaces;
+    if (nbChunks > 1){
+        workspaces.reserve(nbChunks-1);
+        for (unsigned int i=1; i<nbChunks; ++i){
+            workspaces.push_back(model);
+            workspaces.back().detachWorkspace();
+        }
+    }
+
+    dispatcher.run(nbFrames, [&](unsigned int chunk, unsigned int first, unsigned int last){
+        biorbd::rigidbody::Joints& workspace(chunk == 0 ? model : workspaces[chunk-1]);
+        biorbd::rigidbody::GeneralizedCoordinates Q(Qinit);
+        biorbd::utils::Vector markers(static_cast<unsigned int>(allMarkers.rows()));
+        bool isConverged;
+        biorbd::utils::Matrix jacobian;
+        biorbd::utils::Vector error;
+        for (unsigned int i=first; i<last; ++i){
+            // Each frame starts from the solution of the previous one
+            markers = allMarkers.col(i);
+            nbIterations[i] = inverseKinematicsOfOneFrame(
+                        workspace, bodyId, local, markers, params, Q, residuals[i], isConverged, jacobian, error);
+            allQ.col(i) = Q;
+        }
+    });
 }
 
 // Get the Jacobian of the technical markers
@@ -362,15 +495,14 @@ std::vector<biorbd::utils::Matrix> biorbd::rigidbody::Markers::markersJacobian(
         if (lookForTechnical && !node.isTechnical())
             continue;
 
-        unsigned int id = model.GetBodyId(node.parent().c_str());
+        unsigned int id = parentBodyId(node);
         const biorbd::utils::Vector3d& pos(marker(idx, removeAxis));
         biorbd::utils::Matrix G_tp(biorbd::utils::Matrix::Zero(3,model.nbQ()));
 
         // Calculate the Jacobian of this Tag
-        if (idx2==0)
-            RigidBodyDynamics::CalcPointJacobian(model, Q, id, pos, G_tp, updateKin);
-        else
-            RigidBodyDynamics::CalcPointJacobian(model, Q, id, pos, G_tp, false); // False for speed
+        if (idx2==0 && updateKin)
+            model.UpdateKinematicsCustom(&Q, nullptr, nullptr);
+        RigidBodyDynamics::CalcPointJacobian(model, Q, id, pos, G_tp, false); // False for speed
 
         G.push_back(G_tp);
         ++idx2;
@@ -379,11 +511,364 @@ std::vector<biorbd::utils::Matrix> biorbd::rigidbody::Markers::markersJacobian(
     return G;
 }
 
+void biorbd::rigidbody::Markers::markersJacobian(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        biorbd::utils::Matrix &jacobian,
+        bool removeAxis,
+        bool updateKin)
+{
+    markersJacobianOfOneFrame(Q, false, jacobian, removeAxis, updateKin);
+}
+
+void biorbd::rigidbody::Markers::technicalMarkersJacobian(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        biorbd::utils::Matrix &jacobian,
+        bool removeAxis,
+        bool updateKin)
+{
+    markersJacobianOfOneFrame(Q, true, jacobian, removeAxis, updateKin);
+}
+
+std::vector<std::vector<unsigned int>> biorbd::rigidbody::Markers::markersJacobianSparsity()
+{
+    return markersJacobianSparsity(false);
+}
+
+std::vector<std::vector<unsigned int>> biorbd::rigidbody::Markers::technicalMarkersJacobianSparsity()
+{
+    return markersJacobianSparsity(true);
+}
+
+// Express a point of a body in the movable body it is attached to, the fixed bodies being merged by RBDL in their parent
+static unsigned int movableBodyOfPoint(
+        biorbd::rigidbody::Joints &model,
+        unsigned int bodyId,
+        RigidBodyDynamics::Math::Vector3d &pos)
+{
+    if (!model.IsFixedBodyId(bodyId))
+        return bodyId;
+    const RigidBodyDynamics::FixedBody& fixedBody(model.mFixedBodies[bodyId - model.fixed_body_discriminator]);
+    pos = fixedBody.mParentTransform.E.transpose() * pos + fixedBody.mParentTransform.r;
+    return fixedBody.mMovableParent;
+}
+
+// Fill the 3 rows of the jacobian of a point of a movable body, assuming the kinematics is already updated.
+// Only the joints between the root and the body move the point, so the other columns are left untouched
+static void pointJacobianInMovableBody(
+        biorbd::rigidbody::Joints &model,
+        unsigned int bodyId,
+        const RigidBodyDynamics::Math::Vector3d &local,
+        unsigned int row,
+        biorbd::utils::Matrix &jacobian)
+{
+    RigidBodyDynamics::Math::Vector3d omega, velocity;
+    RigidBodyDynamics::Math::Vector3d pos(model.X_base[bodyId].E.transpose() * local + model.X_base[bodyId].r);
+    for (unsigned int j=bodyId; j!=0; j=model.lambda[j]){
+        const RigidBodyDynamics::Joint& joint(model.mJoints[j]);
+        for (unsigned int k=0; k<joint.mDoFCount; ++k){
+            model.jointMotionInGlobal(j, k, omega, velocity);
+            jacobian.block<3, 1>(row, joint.q_index + k) = velocity + omega.cross(pos);
+        }
+    }
+}
+
+void biorbd::rigidbody::Markers::markersJacobianOfOneFrame(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        bool lookForTechnical,
+        biorbd::utils::Matrix &jacobian,
+        bool removeAxis,
+        bool updateKin)
+{
+    // Assuming that this is also a joint type (via BiorbdModel)
+    biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
+
+    unsigned int nMarkers(lookForTechnical ? nbTechnicalMarkers() : nbMarkers());
+    if (static_cast<unsigned int>(jacobian.rows()) != 3*nMarkers || jacobian.cols() != model.dof_count)
+        jacobian.resize(3*nMarkers, model.dof_count);
+    jacobian.setZero();
+
+    if (updateKin)
+        model.UpdateKinematicsCustom(&Q, nullptr, nullptr);
+
+    unsigned int row(0);
+    RigidBodyDynamics::Math::Vector3d pos;
+    for (unsigned int i=0; i<nbMarkers(); ++i){
+        const biorbd::rigidbody::NodeSegment& node(marker(i));
+        if (lookForTechnical && !node.isTechnical())
+            continue;
+
+        pos = node;
+        if (removeAxis)
+            for (unsigned int j=0; j<3; ++j)
+                if (node.isAxisRemoved(j))
+                    pos(j) = 0;
+        unsigned int id(movableBodyOfPoint(model, parentBodyId(node), pos));
+        pointJacobianInMovableBody(model, id, pos, row, jacobian);
+        row += 3;
+    }
+}
+
+std::vector<std::vector<unsigned int>> biorbd::rigidbody::Markers::markersJacobianSparsity(
+        bool lookForTechnical)
+{
+    // Assuming that this is also a joint type (via BiorbdModel)
+    biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
+
+    std::vector<std::vector<unsigned int>> columns;
+    for (unsigned int i=0; i<nbMarkers(); ++i){
+        const biorbd::rigidbody::NodeSegment& node(marker(i));
+        if (lookForTechnical && !node.isTechnical())
+            continue;
+
+        RigidBodyDynamics::Math::Vector3d pos(node);
+        unsigned int id(movableBodyOfPoint(model, parentBodyId(node), pos));
+
+        std::vector<unsigned int> markerColumns;
+        for (unsigned int j=id; j!=0; j=model.lambda[j])
+            for (unsigned int k=0; k<model.mJoints[j].mDoFCount; ++k)
+                markerColumns.push_back(model.mJoints[j].q_index + k);
+        std::sort(markerColumns.begin(), markerColumns.end());
+        columns.push_back(markerColumns);
+    }
+    return columns;
+}
+
+unsigned int biorbd::rigidbody::Markers::parentBodyId(
+        const biorbd::rigidbody::NodeSegment &node)
+{
+    if (node.parentId() >= 0)
+        return static_cast<unsigned int>(node.parentId());
+
+    // Assuming that this is also a joint type (via BiorbdModel)
+    biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
+    return model.GetBodyId(node.parent().c_str());
+}
+
+void biorbd::rigidbody::Markers::technicalMarkersInMovableBodies(
+        std::vector<unsigned int> &bodyId,
+        biorbd::utils::Matrix &local,
+        bool removeAxis)
+{
+    // Assuming that this is also a joint type (via BiorbdModel)
+    biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
+
+    unsigned int nMarkers(nbTechnicalMarkers());
+    bodyId.resize(nMarkers);
+    if (local.rows() != 3 || static_cast<unsigned int>(local.cols()) != nMarkers)
+        local.resize(3, nMarkers);
+
+    unsigned int col(0);
+    RigidBodyDynamics::Math::Vector3d pos;
+    for (unsigned int i=0; i<nbMarkers(); ++i){
+        const biorbd::rigidbody::NodeSegment& node(marker(i));
+        if (!node.isTechnical())
+            continue;
+
+        pos = node;
+        if (removeAxis)
+            for (unsigned int j=0; j<3; ++j)
+                if (node.isAxisRemoved(j))
+                    pos(j) = 0;
+
+        bodyId[col] = movableBodyOfPoint(model, parentBodyId(node), pos);
+        local.col(col) = pos;
+        ++col;
+    }
+}
+
+unsigned int biorbd::rigidbody::Markers::inverseKinematicsOfOneFrame(
+        biorbd::rigidbody::Joints &model,
+        const std::vector<unsigned int> &bodyId,
+        const biorbd::utils::Matrix &local,
+        const biorbd::utils::Vector &markers,
+        const biorbd::rigidbody::Markers::InverseKinematicsParam &params,
+        biorbd::rigidbody::GeneralizedCoordinates &Q,
+        double &residual,
+        bool &isConverged,
+        biorbd::utils::Matrix &jacobian,
+        biorbd::utils::Vector &error)
+{
+    unsigned int nMarkers(static_cast<unsigned int>(bodyId.size()));
+    unsigned int nDof(model.dof_count);
+    const std::vector<double>& weights(params.weights());
+    const std::vector<double>& lowerBounds(params.lowerBounds());
+    const std::vector<double>& upperBounds(params.upperBounds());
+    // The steps are taken in the space of the DoFs, which is only the one of Q without quaternions
+    biorbd::utils::Error::check(model.nbQ() == model.nbDof(),
+                                "Inverse kinematics is not implemented for models with quaternions (nbQ != nbDof)");
+    biorbd::utils::Error::check(weights.empty() || weights.size() == nMarkers,
+                                "Number of weights must be equal to the number of technical markers");
+    biorbd::utils::Error::check(lowerBounds.empty() || lowerBounds.size() == static_cast<unsigned int>(Q.size()),
+                                "Number of bounds must be equal to the number of generalized coordinates");
+
+    // The occluded markers are not weighted, the others by the square root of their weight so the squares are weighted
+    std::vector<double> sqrtWeights(nMarkers);
+    unsigned int nbVisible(0);
+    for (unsigned int i=0; i<nMarkers; ++i){
+        bool isVisible(markers.block(i*3, 0, 3, 1).squaredNorm() != 0.0);
+        sqrtWeights[i] = isVisible ? std::sqrt(weights.empty() ? 1.0 : weights[i]) : 0.0;
+        if (isVisible)
+            ++nbVisible;
+    }
+
+    if (static_cast<unsigned int>(jacobian.rows()) != 3*nMarkers || static_cast<unsigned int>(jacobian.cols()) != nDof)
+        jacobian.resize(3*nMarkers, nDof);
+    if (static_cast<unsigned int>(error.rows()) != 3*nMarkers)
+        error.resize(3*nMarkers);
+
+    auto project = [&](biorbd::rigidbody::GeneralizedCoordinates& Qbounded){
+        if (!lowerBounds.empty())
+            for (unsigned int i=0; i<lowerBounds.size(); ++i)
+                Qbounded[i] = std::min(std::max(Qbounded[i], lowerBounds[i]), upperBounds[i]);
+    };
+
+    // Weighted squared norm of the distances between the markers and the model, the distance of the visible markers being kept
+    double distance(0);
+    auto computeError = [&](const biorbd::rigidbody::GeneralizedCoordinates& Qcurrent){
+        model.UpdateKinematicsCustom(&Qcurrent, nullptr, nullptr);
+        distance = 0;
+        for (unsigned int i=0; i<nMarkers; ++i){
+            if (sqrtWeights[i] == 0.0){
+                error.block<3, 1>(i*3, 0).setZero();
+                continue;
+            }
+            error.block<3, 1>(i*3, 0) = markers.block<3, 1>(i*3, 0) - RigidBodyDynamics::CalcBodyToBaseCoordinates(
+                        model, Qcurrent, bodyId[i], local.col(i), false);
+            distance += error.block<3, 1>(i*3, 0).squaredNorm();
+            error.block<3, 1>(i*3, 0) *= sqrtWeights[i];
+        }
+        return error.squaredNorm();
+    };
+
+    project(Q);
+    biorbd::rigidbody::GeneralizedCoordinates Qtrial(Q);
+    Eigen::MatrixXd JtJ(nDof, nDof);
+    Eigen::MatrixXd damped(nDof, nDof);
+    Eigen::VectorXd gradient(nDof);
+    Eigen::VectorXd step(nDof);
+    double cost(computeError(Q));
+    double distanceAtQ(distance);
+    double lambda(1e-3);
+    unsigned int nbIterations(0);
+    isConverged = false;
+    while (nbIterations < params.maxIterations()){
+        // The kinematics is already updated at Q by the computation of the error
+        jacobian.setZero();
+        for (unsigned int i=0; i<nMarkers; ++i){
+            if (sqrtWeights[i] == 0.0)
+                continue;
+            pointJacobianInMovableBody(model, bodyId[i], local.col(i), i*3, jacobian);
+            jacobian.middleRows<3>(i*3) *= sqrtWeights[i];
+        }
+        JtJ.noalias() = jacobian.transpose() * jacobian;
+        gradient.noalias() = jacobian.transpose() * error;
+        if (gradient.norm() < params.tolerance()){
+            isConverged = true;
+            break;
+        }
+
+        // Increase the damping until the step decreases the error
+        bool isAccepted(false);
+        while (!isAccepted && lambda < 1e10){
+            damped = JtJ;
+            for (unsigned int i=0; i<nDof; ++i)
+                damped(i, i) += lambda * (JtJ(i, i) + 1.0); // The +1 keeps the DoFs seen by no marker in place
+            Qtrial = Q + damped.ldlt().solve(gradient);
+            project(Qtrial);
+            double trialCost(computeError(Qtrial));
+            if (trialCost < cost){
+                isAccepted = true;
+                step = Qtrial - Q;
+                Q = Qtrial;
+                cost = trialCost;
+                distanceAtQ = distance;
+                lambda /= 10;
+            } else
+                lambda *= 10;
+        }
+        if (!isAccepted) // Stalled, no damping decreases the error
+            break;
+        ++nbIterations;
+        if (step.norm() < params.tolerance()){
+            isConverged = true;
+            break;
+        }
+    }
+
+    // The error may have been last computed at a rejected step, put the kinematics back at the solution
+    model.UpdateKinematicsCustom(&Q, nullptr, nullptr);
+    residual = nbVisible == 0 ? 0 : std::sqrt(distanceAtQ / nbVisible);
+    return nbIterations;
+}
+
+void biorbd::rigidbody::Markers::markersOfOneFrame(
+        const biorbd::rigidbody::GeneralizedCoordinates &Q,
+        bool lookForTechnical,
+        Eigen::Matrix3Xd &markers,
+        bool removeAxis,
+        bool updateKin)
+{
+    // Assuming that this is also a joint type (via BiorbdModel)
+    biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
+
+    unsigned int nMarkers(lookForTechnical ? nbTechnicalMarkers() : nbMarkers());
+    if (static_cast<unsigned int>(markers.cols()) != nMarkers)
+        markers.resize(3, nMarkers);
+
+    if (updateKin)
+        model.UpdateKinematicsCustom(&Q, nullptr, nullptr);
+
+    unsigned int col(0);
+    RigidBodyDynamics::Math::Vector3d pos;
+    for (unsigned int i=0; i<nbMarkers(); ++i){
+        const biorbd::rigidbody::NodeSegment& node(marker(i));
+        if (lookForTechnical && !node.isTechnical())
+            continue;
+
+        // Work on plain vectors so no node is created for the result
+        pos = node;
+        if (removeAxis)
+            for (unsigned int j=0; j<3; ++j)
+                if (node.isAxisRemoved(j))
+                    pos(j) = 0;
+        markers.col(col) = RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, parentBodyId(node), pos, false);
+        ++col;
+    }
+}
+
+void biorbd::rigidbody::Markers::markersOfAllFrames(
+        const biorbd::utils::Matrix &allQ,
+        const std::vector<unsigned int>& idx,
+        biorbd::utils::Matrix &allMarkers,
+        bool removeAxis,
+        unsigned int nbThreads)
+{
+    // Assuming that this is also a joint type (via BiorbdModel)
+    biorbd::rigidbody::Joints &model = dynamic_cast<biorbd::rigidbody::Joints &>(*this);
+
+    // Resolve the parent and the local position of the markers once for the whole trial
+    std::vector<unsigned int> bodyId(idx.size());
+    std::vector<RigidBodyDynamics::Math::Vector3d> local(idx.size());
+    for (unsigned int i=0; i<idx.size(); ++i){
+        bodyId[i] = parentBodyId(marker(idx[i]));
+        local[i] = marker(idx[i], removeAxis);
+    }
+
+    if (static_cast<unsigned int>(allMarkers.rows()) != 3*idx.size() || allMarkers.cols() != allQ.cols())
+        allMarkers.resize(3*idx.size(), allQ.cols());
+
+    model.forEachFrame(allQ, [&](biorbd::rigidbody::Joints& workspace, const RigidBodyDynamics::Math::VectorNd& Q, unsigned int frame){
+        for (unsigned int i=0; i<idx.size(); ++i)
+            allMarkers.block<3, 1>(3*i, frame) = RigidBodyDynamics::CalcBodyToBaseCoordinates(
+                        workspace, Q, bodyId[i], local[i], false);
+    }, nbThreads);
+}
+
 unsigned int biorbd::rigidbody::Markers::nbTechnicalMarkers()
 {
     unsigned int nTechMarkers = 0;
     if (nTechMarkers == 0) // If the function has never been called before
-        for (auto mark : *m_marks)
+        for (const auto& mark : *m_marks)
             if (mark.isTechnical())
                 ++nTechMarkers;
 
@@ -401,7 +886,7 @@ unsigned int biorbd::rigidbody::Markers::nbTechnicalMarkers(unsigned int idxSegm
     const biorbd::utils::String& name(model.segment(idxSegment).name());
 
     if (nTechMarkers == 0) // If the function has never been called before
-        for (auto mark : *m_marks)
+        for (const auto& mark : *m_marks)
             if (mark.isTechnical() && !mark.parent().compare(name))
                 ++nTechMarkers;
 
@@ -413,7 +898,7 @@ unsigned int biorbd::rigidbody::Markers::nbAnatomicalMarkers()
 {
     unsigned int nAnatMarkers = 0;
     if (nAnatMarkers == 0) // If the function has never been called before
-        for (auto mark : *m_marks)
+        for (const auto& mark : *m_marks)
             if (mark.isAnatomical())
                 ++nAnatMarkers;
 
@@ -448,3 +933,63 @@ std::vector<biorbd::utils::String> biorbd::rigidbody::Markers::anatomicalMarkerN
 
     return names;
 }
+
+biorbd::rigidbody::Markers::InverseKinematicsParam::InverseKinematicsParam(
+        unsigned int maxIterations,
+        double tolerance,
+        bool removeAxis) :
+    m_maxIterations(maxIterations),
+    m_tolerance(tolerance),
+    m_removeAxis(removeAxis)
+{
+
+}
+
+void biorbd::rigidbody::Markers::InverseKinematicsParam::setWeights(
+        const std::vector<double> &weights)
+{
+    m_weights = weights;
+}
+
+void biorbd::rigidbody::Markers::InverseKinematicsParam::setBounds(
+        const std::vector<double> &lowerBounds,
+        const std::vector<double> &upperBounds)
+{
+    biorbd::utils::Error::check(lowerBounds.size() == upperBounds.size(),
+                                "Lower and upper bounds must have the same size");
+    for (unsigned int i=0; i<lowerBounds.size(); ++i)
+        biorbd::utils::Error::check(lowerBounds[i] <= upperBounds[i],
+                                    "Lower bounds must be smaller than upper bounds");
+    m_lowerBounds = lowerBounds;
+    m_upperBounds = upperBounds;
+}
+
+unsigned int biorbd::rigidbody::Markers::InverseKinematicsParam::maxIterations() const
+{
+    return m_maxIterations;
+}
+
+double biorbd::rigidbody::Markers::InverseKinematicsParam::tolerance() const
+{
+    return m_tolerance;
+}
+
+bool biorbd::rigidbody::Markers::InverseKinematicsParam::removeAxis() const
+{
+    return m_removeAxis;
+}
+
+const std::vector<double> &biorbd::rigidbody::Markers::InverseKinematicsParam::weights() const
+{
+    return m_weights;
+}
+
+const std::vector<double> &biorbd::rigidbody::Markers::InverseKinematicsParam::lowerBounds() const
+{
+    return m_lowerBounds;
+}
+
+const std::vector<double> &biorbd::rigidbody::Markers::InverseKinematicsParam::upperBounds() const
+{
+    return m_upperBounds;
+}
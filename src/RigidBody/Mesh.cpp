@@ -2,11 +2,13 @@
 #include "RigidBody/Mesh.h"
 
 #include "Utils/Path.h"
+#include "Utils/Matrix.h"
 #include "Utils/Vector3d.h"
 #include "RigidBody/MeshFace.h"
 
 biorbd::rigidbody::Mesh::Mesh() :
     m_vertex(std::make_shared<std::vector<biorbd::utils::Vector3d>>()),
+    m_vertexInMatrix(std::make_shared<biorbd::utils::Matrix>()),
     m_faces(std::make_shared<std::vector<biorbd::rigidbody::MeshFace>>()),
     m_pathFile(std::make_shared<biorbd::utils::Path>())
 {
@@ -15,6 +17,7 @@ biorbd::rigidbody::Mesh::Mesh() :
 
 biorbd::rigidbody::Mesh::Mesh(const std::vector<biorbd::utils::Vector3d> &other) :
     m_vertex(std::make_shared<std::vector<biorbd::utils::Vector3d>>(other)),
+    m_vertexInMatrix(std::make_shared<biorbd::utils::Matrix>()),
     m_faces(std::make_shared<std::vector<biorbd::rigidbody::MeshFace>>()),
     m_pathFile(std::make_shared<biorbd::utils::Path>())
 {
@@ -24,6 +27,7 @@ biorbd::rigidbody::Mesh::Mesh(const std::vector<biorbd::utils::Vector3d> &other)
 biorbd::rigidbody::Mesh::Mesh(const std::vector<biorbd::utils::Vector3d> &vertex,
         const std::vector<biorbd::rigidbody::MeshFace> & faces) :
     m_vertex(std::make_shared<std::vector<biorbd::utils::Vector3d>>(vertex)),
+    m_vertexInMatrix(std::make_shared<biorbd::utils::Matrix>()),
     m_faces(std::make_shared<std::vector<biorbd::rigidbody::MeshFace>>(faces)),
     m_pathFile(std::make_shared<biorbd::utils::Path>())
 {
@@ -42,6 +46,7 @@ void biorbd::rigidbody::Mesh::DeepCopy(const biorbd::rigidbody::Mesh &other)
     m_vertex->resize(other.m_vertex->size());
     for (unsigned int i=0; i<other.m_vertex->size(); ++i)
         (*m_vertex)[i] = (*other.m_vertex)[i].DeepCopy();
+    *m_vertexInMatrix = *other.m_vertexInMatrix;
     m_faces->resize(other.m_faces->size());
     for (unsigned int i=0; i<other.m_faces->size(); ++i)
         (*m_faces)[i] = (*other.m_faces)[i].DeepCopy();
@@ -61,6 +66,17 @@ unsigned int biorbd::rigidbody::Mesh::nbVertex() const
     return static_cast<unsigned int>(m_vertex->size());
 }
 
+const biorbd::utils::Matrix &biorbd::rigidbody::Mesh::pointsInMatrix() const
+{
+    // Points can only be added, so a matrix of the right size is up to date
+    if (m_vertexInMatrix->rows() != 3 || static_cast<unsigned int>(m_vertexInMatrix->cols()) != nbVertex()){
+        m_vertexInMatrix->resize(3, nbVertex());
+        for (unsigned int i=0; i<nbVertex(); ++i)
+            m_vertexInMatrix->col(i) = (*m_vertex)[i];
+    }
+    return *m_vertexInMatrix;
+}
+
 unsigned int biorbd::rigidbody::Mesh::nbFaces()
 {
     return static_cast<unsigned int>(m_faces->size());
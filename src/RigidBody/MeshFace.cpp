@@ -26,6 +26,11 @@ int &biorbd::rigidbody::MeshFace::operator()(int idx)
     return (*m_face)[idx];
 }
 
+int biorbd::rigidbody::MeshFace::operator()(int idx) const
+{
+    return (*m_face)[idx];
+}
+
 biorbd::utils::Vector3d biorbd::rigidbody::MeshFace::faceAsDouble()
 {
     return biorbd::utils::Vector3d(static_cast<double>(m_face->x()),
@@ -170,10 +170,7 @@ void biorbd::rigidbody::Segment::setType()
 }
 
 unsigned int biorbd::rigidbody::Segment::id() const{
-    if (*m_nbDof!=0)
-        return (*m_idxDof)[*m_nbDof-1];
-    else
-        return (*m_idxDof)[*m_nbDof];
+    return m_idxDof->back();
 }
 
 int biorbd::rigidbody::Segment::platformIdx() const{
@@ -334,20 +331,14 @@ void biorbd::rigidbody::Segment::fillSequence(){
 void biorbd::rigidbody::Segment::setDofCharacteristicsOnLastBody(){
     m_dofCharacteristics->clear();
 
-    if (*m_nbDof!=0){
-        m_dofCharacteristics->resize(*m_nbDof);
-        for (unsigned int i=0; i<*m_nbDof-1; i++)
-            (*m_dofCharacteristics)[i] = biorbd::rigidbody::SegmentCharacteristics();
-
-        (*m_dofCharacteristics)[*m_nbDof-1] = *m_characteristics;
-    }
-    else{
-        m_dofCharacteristics->resize(1);
-        (*m_dofCharacteristics)[0] = *m_characteristics;
-    }
+    // There is one body per RBDL joint (see setJointAxis)
+    m_dofCharacteristics->resize(m_dof->size());
+    for (unsigned int i=0; i<m_dof->size()-1; i++)
+        (*m_dofCharacteristics)[i] = biorbd::rigidbody::SegmentCharacteristics();
+    m_dofCharacteristics->back() = *m_characteristics;
 }
 
-void biorbd::rigidbody::Segment::setJointAxis(){
+void biorbd::rigidbody::Segment::setJointAxis(bool mergeDofs){
         // Definition of the rotation axis
     RigidBodyDynamics::Math::Vector3d axis[3];
     axis[0]  = RigidBodyDynamics::Math::Vector3d(1,0,0); // axe x
@@ -357,48 +348,59 @@ void biorbd::rigidbody::Segment::setJointAxis(){
     // Declaration of DoFs in translation
     m_dof->clear();
     if (*m_nbDof != 0){
-        m_dof->resize(*m_nbDof);
-        for (unsigned int i=0; i<*m_nbDofTrans; i++)
-            (*m_dof)[i] = RigidBodyDynamics::Joint(RigidBodyDynamics::JointTypePrismatic, axis[(*m_dofPosition)[i]]);
+        if (mergeDofs && *m_nbDofTrans == 3
+                && (*m_dofPosition)[0] == 0 && (*m_dofPosition)[1] == 1 && (*m_dofPosition)[2] == 2)
+            m_dof->push_back(RigidBodyDynamics::Joint(RigidBodyDynamics::JointTypeTranslationXYZ));
+        else
+            for (unsigned int i=0; i<*m_nbDofTrans; i++)
+                m_dof->push_back(RigidBodyDynamics::Joint(RigidBodyDynamics::JointTypePrismatic, axis[(*m_dofPosition)[i]]));
 
         // Declaration of the DoFs in rotation
         if (*m_isQuaternion)
-            (*m_dof)[*m_nbDofTrans] = RigidBodyDynamics::Joint(RigidBodyDynamics::JointTypeSpherical); // Put a DoF in spherical
+            m_dof->push_back(RigidBodyDynamics::Joint(RigidBodyDynamics::JointTypeSpherical)); // Put a DoF in spherical
+        else if (mergeDofs && *m_nbDofRot == 3 && cardanJointType() != RigidBodyDynamics::JointTypeUndefined)
+            m_dof->push_back(RigidBodyDynamics::Joint(cardanJointType())); // The whole sequence in a single joint
         else
             for (unsigned int i=*m_nbDofTrans; i<*m_nbDofRot+*m_nbDofTrans; i++)
-                (*m_dof)[i] = RigidBodyDynamics::Joint(RigidBodyDynamics::JointTypeRevolute, axis[(*m_dofPosition)[i]]); // Put the rotation axis in the right order
-    }
-    else{
-        m_dof->resize(1);
-        (*m_dof)[0] = RigidBodyDynamics::Joint(RigidBodyDynamics::JointTypeFixed); // A random axe, p
+                m_dof->push_back(RigidBodyDynamics::Joint(RigidBodyDynamics::JointTypeRevolute, axis[(*m_dofPosition)[i]])); // Put the rotation axis in the right order
     }
+    else
+        m_dof->push_back(RigidBodyDynamics::Joint(RigidBodyDynamics::JointTypeFixed)); // A random axe, p
+}
+
+RigidBodyDynamics::JointType biorbd::rigidbody::Segment::cardanJointType() const{
+    // The RBDL Euler joints are equivalent to chaining revolute joints in the same order
+    const std::vector<unsigned int>& seq(*m_sequenceRot);
+    if (seq[0] == 0 && seq[1] == 1 && seq[2] == 2)
+        return RigidBodyDynamics::JointTypeEulerXYZ;
+    else if (seq[0] == 2 && seq[1] == 1 && seq[2] == 0)
+        return RigidBodyDynamics::JointTypeEulerZYX;
+    else if (seq[0] == 1 && seq[1] == 0 && seq[2] == 2)
+        return RigidBodyDynamics::JointTypeEulerYXZ;
+    else
+        return RigidBodyDynamics::JointTypeUndefined;
 }
 
 void biorbd::rigidbody::Segment::setJoints(biorbd::rigidbody::Joints& model){
+    setJointAxis(model.mergeDofs()); // Choose the axis order in relation to the selected sequence
     setDofCharacteristicsOnLastBody(); // Apply the segment caracteristics only to the last segment
-    setJointAxis(); // Choose the axis order in relation to the selected sequence
 
 
     RigidBodyDynamics::Math::SpatialTransform zero (RigidBodyDynamics::Math::Matrix3dIdentity, RigidBodyDynamics::Math::Vector3d(0,0,0));
     // Create the articulations (intra segment)
     m_idxDof->clear();
-
-    if (*m_nbDof==0)
-        m_idxDof->resize(1);
-    else
-        m_idxDof->resize(*m_nbDof);
+    m_idxDof->resize(m_dof->size());
 
     unsigned int parent_id(model.GetBodyId(parent().c_str()));
     if (parent_id == std::numeric_limits<unsigned int>::max())
         parent_id = 0;
-    if (*m_nbDof==0)
-        (*m_idxDof)[0] = model.AddBody(parent_id, *m_cor, (*m_dof)[0], (*m_dofCharacteristics)[0], name());
-    else if (*m_nbDof == 1)
+    unsigned int nbBodies(static_cast<unsigned int>(m_dof->size()));
+    if (nbBodies == 1)
         (*m_idxDof)[0] = model.AddBody(parent_id, *m_cor, (*m_dof)[0], (*m_dofCharacteristics)[0], name());
     else{
         (*m_idxDof)[0] = model.AddBody(parent_id, *m_cor, (*m_dof)[0], (*m_dofCharacteristics)[0]);
-        for (unsigned int i=1; i<*m_nbDof; i++)
-            if (i!=*m_nbDof-1)
+        for (unsigned int i=1; i<nbBodies; i++)
+            if (i!=nbBodies-1)
                 (*m_idxDof)[i] = model.AddBody((*m_idxDof)[i-1], zero, (*m_dof)[i], (*m_dofCharacteristics)[i]);
             else
                 (*m_idxDof)[i] = model.AddBody((*m_idxDof)[i-1], zero, (*m_dof)[i], (*m_dofCharacteristics)[i], name());
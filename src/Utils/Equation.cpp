@@ -1,23 +1,13 @@
 #define BIORBD_API_EXPORTS
 #include "Utils/Equation.h"
 
-#include <boost/lexical_cast.hpp>
+#include <cctype>
+#include <cstdlib>
+#include <cmath>
+#include <clocale>
+#include <algorithm>
 #include "Utils/Error.h"
 
-std::vector<biorbd::utils::Equation> biorbd::utils::Equation::prepareMathSymbols(){
-    // Classify in the order of priority of the operations
-    std::vector<biorbd::utils::Equation> symbols;
-    symbols.push_back("(");
-    symbols.push_back(")");
-    symbols.push_back("e");
-    symbols.push_back("/");
-    symbols.push_back("*");
-    symbols.push_back("+");
-    symbols.push_back("-");
-
-    return symbols;
-}
-
 biorbd::utils::Equation::Equation() :
     biorbd::utils::String("")
 {
@@ -42,217 +32,217 @@ biorbd::utils::Equation::Equation(const std::basic_string<char> &c) :
 
 }
 
-std::vector<biorbd::utils::Equation> biorbd::utils::Equation::splitIntoEquation(
-        biorbd::utils::Equation wholeEq,
-        const std::map<biorbd::utils::Equation, double>& variables)
+bool biorbd::utils::Equation::isNumber(
+        double &value) const
 {
-    // output variable
-    std::vector<biorbd::utils::Equation> eq;
-
-    // Replace the variables by a number
-    replaceVar(wholeEq, variables);
-
-    // Declaration of the arithmetic markers
-    const std::vector<biorbd::utils::Equation>& symbols(prepareMathSymbols());
+    if (empty() || std::isspace(static_cast<unsigned char>((*this)[0])))
+        return false;
 
-    // All along the string
-    while (1){
-        int firstIdx(static_cast<int>(wholeEq.size())+1);// Assign an index too big
-        unsigned int toStop(0); // Set stop at 0
-        // Go through each symbol to see if it's in the equation
-        for (unsigned int i=0; i<symbols.size(); ++i){
-            int idx = static_cast<int>(wholeEq.find(symbols[i]));
-            if (idx < 0){ // If not, write it down
-                ++toStop;
-                continue;
-            }
-            if (idx < firstIdx && idx != -1) // If yes, look if it's before another symbol
-                firstIdx = idx;
-        }
-        if (toStop == symbols.size()){ // If no symbols left, exit the while loop
-            eq.push_back(wholeEq);
-            break;
-        }
-        if (wholeEq.size() == 1){
-            eq.push_back(wholeEq(0));
-            break;
-        }
-        if (firstIdx+1 == static_cast<int>(wholeEq.size())){
-            eq.push_back(wholeEq.substr(0,static_cast<unsigned int>(firstIdx)));
-            eq.push_back(wholeEq(static_cast<unsigned int>(firstIdx)));
-            break;
-        }
-        else if (firstIdx == 0){
-            if (!wholeEq(0).compare("-")){
-                // If the equation starts with "-"
-                std::vector<biorbd::utils::Equation> tp(splitIntoEquation(wholeEq.substr(1), variables));
-                if (eq.size() != 0 && !eq[eq.size()-1].compare("e") ){
-                    // special case of scientific notation (1e-x)
-                    eq.push_back(wholeEq(0));
-                    wholeEq = wholeEq.substr(1);
-                } else if (!tp[0].compare("(")) {
-                    // Resolve now the parenthese to apply the minus after
-                    size_t idx = wholeEq.find_first_of(")");
-                    biorbd::utils::Equation newWholeEq(wholeEq.substr(2, idx-2));
-                    double res(-1*evaluateEquation(splitIntoEquation(newWholeEq, variables)));
-                    wholeEq = std::to_string(res) + wholeEq.substr(idx+1);
-                } else {
-                    tp[0] = "-" + tp[0];
-                    eq.insert(eq.end(), tp.begin(), tp.end());
-                    return eq;
-                }
-            }
-            else if (!wholeEq(0).compare("+")){
-                // If the equation starts with +
-                std::vector<biorbd::utils::Equation> tp(splitIntoEquation(wholeEq.substr(1), variables));
-                if (eq.size() != 0) // If there's nothing before, it's false in all cases 1ex
-                    eq.push_back("+");
-                eq.insert(eq.end(), tp.begin(), tp.end());
-                return eq;
-            }
-            else{
-                eq.push_back(wholeEq(0));
-                wholeEq = wholeEq.substr(1);
-            }
-        }
-        else{
-            eq.push_back(wholeEq.substr(0,static_cast<unsigned int>(firstIdx))); // Take everything before symbol
-            eq.push_back(wholeEq(static_cast<unsigned int>(firstIdx))); // Get the symbol
-            wholeEq = wholeEq.substr(static_cast<unsigned int>(firstIdx)+1); // Keep everything after the symbol and restart
-        }
+    // The number must take the whole equation (1e-2 is a number, 1-2 is not)
+    const char* end(readNumber(c_str(), value));
+    return end != c_str() && end == c_str() + size();
+}
 
+const char* biorbd::utils::Equation::readNumber(
+        const char* start,
+        double &value)
+{
+    // Find the end of the number by hand, so strtod cannot read more than a decimal number
+    const char* p(start);
+    if (*p == '+' || *p == '-')
+        ++p;
+    const char* mantissa(p);
+    unsigned int nbDigits(0);
+    for (; std::isdigit(static_cast<unsigned char>(*p)); ++p)
+        ++nbDigits;
+    if (*p == '.')
+        for (++p; std::isdigit(static_cast<unsigned char>(*p)); ++p)
+            ++nbDigits;
+    if (nbDigits == 0)
+        return start;
+    if (*p == 'e' || *p == 'E'){
+        const char* exponent(p + 1);
+        if (*exponent == '+' || *exponent == '-')
+            ++exponent;
+        if (std::isdigit(static_cast<unsigned char>(*exponent)))
+            for (p = exponent; std::isdigit(static_cast<unsigned char>(*p)); ++p);
     }
 
-    // Replace constant with numbers
-    replaceCste(eq);
-
-    // Return the equation
-    return eq;
+    // strtod expects the decimal separator of the current locale, so the dot is swapped for it
+    std::string number(start, p);
+    char separator(*std::localeconv()->decimal_point);
+    if (separator != '.')
+        std::replace(number.begin() + (mantissa - start), number.end(), '.', separator);
+    char* end;
+    value = std::strtod(number.c_str(), &end);
+    return start + (end - number.c_str());
 }
 
-void biorbd::utils::Equation::replaceCste(
-        std::vector<biorbd::utils::Equation> &eq)
+void biorbd::utils::Equation::compile(
+        std::vector<biorbd::utils::Equation::Operation> &operations,
+        std::vector<biorbd::utils::Equation> &variableNames) const
 {
-    for (unsigned int i=0; i<eq.size(); ++i)
-        if (!eq[i].tolower().compare("pi"))
-            eq[i] = boost::lexical_cast< std::string>(M_PI);
+    operations.clear();
+    variableNames.clear();
+
+    size_t pos(0);
+    compileExpression(pos, 0, operations, variableNames);
+    if (pos != size())
+        raiseParsingError();
 }
 
-void biorbd::utils::Equation::replaceVar(
-        biorbd::utils::Equation &eq,
-        const std::map<biorbd::utils::Equation, double>& variables)
+void biorbd::utils::Equation::compileExpression(
+        size_t &pos,
+        unsigned int minPrecedence,
+        std::vector<biorbd::utils::Equation::Operation> &operations,
+        std::vector<biorbd::utils::Equation> &variableNames) const
 {
-    for (auto var : variables)
-        while (eq.find(var.first) != std::string::npos){
-            size_t pos(eq.find(var.first));
-            size_t length(var.first.length());
-            eq = eq.substr(0, pos) + "(" +
-                    std::to_string(var.second) + ")" +
-                    eq.substr(pos + length);
+    compileOperand(pos, operations, variableNames);
+
+    // Precedence climbing: an operator takes everything on its right that binds more tightly than itself
+    while (pos < size()){
+        biorbd::utils::Equation::Operation operation{};
+        unsigned int precedence;
+        switch ((*this)[pos]){
+        case '+': operation.type = biorbd::utils::Equation::Operation::ADD; precedence = 0; break;
+        case '-': operation.type = biorbd::utils::Equation::Operation::SUBTRACT; precedence = 0; break;
+        case '*': operation.type = biorbd::utils::Equation::Operation::MULTIPLY; precedence = 1; break;
+        case '/': operation.type = biorbd::utils::Equation::Operation::DIVIDE; precedence = 1; break;
+        default: return; // End of this expression (a closing parenthese or an error dealt with by the caller)
         }
-}
+        if (precedence < minPrecedence)
+            return;
 
+        ++pos;
+        compileExpression(pos, precedence + 1, operations, variableNames);
+        operations.push_back(operation);
+    }
+}
 
-double biorbd::utils::Equation::evaluateEquation(
-        std::vector<biorbd::utils::Equation> wholeEq)
+void biorbd::utils::Equation::compileOperand(
+        size_t &pos,
+        std::vector<biorbd::utils::Equation::Operation> &operations,
+        std::vector<biorbd::utils::Equation> &variableNames) const
 {
-    return evaluateEquation(wholeEq,0);
+    if (pos >= size())
+        raiseParsingError();
+
+    biorbd::utils::Equation::Operation operation{};
+    char c((*this)[pos]);
+    if (c == '-' || c == '+'){
+        // Sign of the operand
+        ++pos;
+        compileOperand(pos, operations, variableNames);
+        if (c == '-'){
+            operation.type = biorbd::utils::Equation::Operation::NEGATE;
+            operations.push_back(operation);
+        }
+    }
+    else if (c == '('){
+        ++pos;
+        compileExpression(pos, 0, operations, variableNames);
+        biorbd::utils::Error::check(pos < size() && (*this)[pos] == ')', "You must close brackets!");
+        ++pos;
+    }
+    else if (std::isdigit(static_cast<unsigned char>(c)) || c == '.'){
+        const char* start(c_str() + pos);
+        operation.type = biorbd::utils::Equation::Operation::VALUE;
+        const char* end(readNumber(start, operation.value));
+        if (end == start)
+            raiseParsingError();
+        pos += static_cast<size_t>(end - start);
+        operations.push_back(operation);
+    }
+    else if (std::isalpha(static_cast<unsigned char>(c)) || c == '$' || c == '_'){
+        size_t first(pos);
+        ++pos;
+        while (pos < size() && (std::isalnum(static_cast<unsigned char>((*this)[pos])) || (*this)[pos] == '_'))
+            ++pos;
+        biorbd::utils::Equation name(substr(first, pos - first));
+
+        if (!name.tolower().compare("pi")){
+            operation.type = biorbd::utils::Equation::Operation::VALUE;
+            operation.value = M_PI;
+        }
+        else {
+            // The value of the variables is only known at evaluation, the same name is stored once
+            operation.type = biorbd::utils::Equation::Operation::VARIABLE;
+            operation.variable = 0;
+            while (operation.variable < variableNames.size() && variableNames[operation.variable].compare(name))
+                ++operation.variable;
+            if (operation.variable == variableNames.size())
+                variableNames.push_back(name);
+        }
+        operations.push_back(operation);
+    }
+    else
+        raiseParsingError();
 }
 
-double biorbd::utils::Equation::evaluateEquation(
-        std::vector<biorbd::utils::Equation> eq,
-        unsigned int math)
+void biorbd::utils::Equation::raiseParsingError() const
 {
-    // If everything was done
-    if (eq.size() == 1)
-        return boost::lexical_cast<double>(eq[0]);
-
-    // Declaration of the arithmetic markers
-    const std::vector<biorbd::utils::Equation>& symbols(prepareMathSymbols());
-    std::vector<biorbd::utils::Equation> eq2;
-    bool continuer(true);
-
-    for (unsigned int j=0; j<eq.size(); ++j){
-        if (!eq[j].compare(symbols[math]) && continuer){
-            if (j==0 && (!symbols[math].compare("+") || !symbols[math].compare("-"))){
-                // Crush the previous value
-                if (!symbols[math].compare("+"))
-                    eq2[j-1] = boost::lexical_cast<std::string>(0.0 + boost::lexical_cast<double>(eq[j+1]));
-                else if (!symbols[math].compare("-"))
-                    eq2[j-1] = boost::lexical_cast<std::string>(0.0 - boost::lexical_cast<double>(eq[j+1]));
-            }
-            else{
-                // Crush the previous value
-                if (!symbols[math].compare("(")){
-                    std::vector<biorbd::utils::Equation> eq_tp;
-                    bool foundIdx(false);
-                    int cmpValues(0);
-                    unsigned int cmpOpen(0);
-                    for (unsigned int k=j+1; k<eq.size();++k){
-                        if (!eq[k].compare("("))
-                            cmpOpen++;
-                        else if (!eq[k].compare(")")){
-                            if (cmpOpen == 0){
-                                foundIdx = true;
-                                break;
-                            }
-                            else
-                                cmpOpen--;
-                        }
-
-                        eq_tp.push_back(eq[k]);
-                        ++cmpValues;
-                    }
-                    biorbd::utils::Error::check(foundIdx, "You must close brackets!");
-
-                    eq2.push_back(boost::lexical_cast<std::string>(boost::lexical_cast<std::string>(evaluateEquation(eq_tp))));
-                    j+=static_cast<unsigned int>(cmpValues);
-                }
-                else if (!symbols[math].compare("/"))
-                    eq2[j-1] = boost::lexical_cast<std::string>(boost::lexical_cast<double>(eq[j-1]) / boost::lexical_cast<double>(eq[j+1]));
-                else if (!symbols[math].compare("*"))
-                    eq2[j-1] = boost::lexical_cast<std::string>(boost::lexical_cast<double>(eq[j-1]) * boost::lexical_cast<double>(eq[j+1]));
-                else if (!symbols[math].compare("+"))
-                    eq2[j-1] = boost::lexical_cast<std::string>(boost::lexical_cast<double>(eq[j-1]) + boost::lexical_cast<double>(eq[j+1]));
-                else if (!symbols[math].compare("-"))
-                    eq2[j-1] = boost::lexical_cast<std::string>(boost::lexical_cast<double>(eq[j-1]) - boost::lexical_cast<double>(eq[j+1]));
-                else if (!symbols[math].compare("e")){
-                    if (!eq[j+1].compare("-")){
-                        eq2[j-1] = boost::lexical_cast<std::string>(boost::lexical_cast<double>(eq[j-1]) * pow(10,-1*boost::lexical_cast<double>(eq[j+2])));
-                        ++j;
-                    }
-                    else if (!eq[j+1].compare("+")){
-                        eq2[j-1] = boost::lexical_cast<std::string>(boost::lexical_cast<double>(eq[j-1]) * pow(10,boost::lexical_cast<double>(eq[j+2])));
-                        ++j;
-                    }
-                    else
-                        eq2[j-1] = boost::lexical_cast<std::string>(boost::lexical_cast<double>(eq[j-1]) * pow(10,boost::lexical_cast<double>(eq[j+1])));
-
-                }
-            }
+    biorbd::utils::Error::raise("The following expression cannot be parsed properly: \"" + *this + "\"");
+}
 
-            j+=2;
-            continuer = false;
+double biorbd::utils::Equation::evaluate(
+        const std::vector<biorbd::utils::Equation::Operation> &operations,
+        const std::vector<biorbd::utils::Equation> &variableNames,
+        const std::map<biorbd::utils::Equation, double> &variables)
+{
+    // The operations are in reverse polish order, so the values are stacked until an operator uses them
+    std::vector<double> stack;
+    stack.reserve(operations.size());
+    for (const auto& operation : operations){
+        switch (operation.type){
+        case biorbd::utils::Equation::Operation::VALUE:
+            stack.push_back(operation.value);
+            break;
+        case biorbd::utils::Equation::Operation::VARIABLE: {
+            auto variable(variables.find(variableNames[operation.variable]));
+            biorbd::utils::Error::check(variable != variables.end(),
+                                        "The variable " + variableNames[operation.variable] + " is not defined");
+            stack.push_back(variable->second);
+            break;
+        }
+        case biorbd::utils::Equation::Operation::NEGATE:
+            stack.back() = -stack.back();
+            break;
+        default: {
+            double right(stack.back());
+            stack.pop_back();
+            double& left(stack.back());
+            if (operation.type == biorbd::utils::Equation::Operation::ADD)
+                left += right;
+            else if (operation.type == biorbd::utils::Equation::Operation::SUBTRACT)
+                left -= right;
+            else if (operation.type == biorbd::utils::Equation::Operation::MULTIPLY)
+                left *= right;
+            else
+                left /= right;
+        }
         }
-        if (j<eq.size())
-            eq2.push_back(eq[j]);
     }
-
-    if (continuer)
-        return evaluateEquation(eq2, ++math);
-    else
-        return evaluateEquation(eq2, math);
+    return stack.back();
 }
 
 double biorbd::utils::Equation::evaluateEquation(
-        biorbd::utils::Equation wholeEq,
+        const biorbd::utils::Equation& wholeEq,
         const std::map<biorbd::utils::Equation, double>& variables)
 {
-    return evaluateEquation(splitIntoEquation(wholeEq, variables));
+    // Most of the values are plain numbers, which do not need to be compiled
+    double value;
+    if (wholeEq.isNumber(value))
+        return value;
+
+    std::vector<biorbd::utils::Equation::Operation> operations;
+    std::vector<biorbd::utils::Equation> variableNames;
+    wholeEq.compile(operations, variableNames);
+    return evaluate(operations, variableNames, variables);
 }
+
 double biorbd::utils::Equation::evaluateEquation(
-        biorbd::utils::Equation wholeEq)
+        const biorbd::utils::Equation& wholeEq)
 {
     std::map<biorbd::utils::Equation, double> dumb;
-    return evaluateEquation(splitIntoEquation(wholeEq, dumb));
+    return evaluateEquation(wholeEq, dumb);
 }
@@ -123,11 +123,7 @@ bool biorbd::utils::IfStream::read(
     biorbd::utils::Equation tp;
     bool out(read(tp));
     // Manage in case of an equation
-    try {
-        result = biorbd::utils::Equation::evaluateEquation(tp, variables);
-    } catch (boost::bad_lexical_cast) {
-        biorbd::utils::Error::raise("The following expression cannot be parsed properly: \"" + tp + "\"");
-    }
+    result = biorbd::utils::Equation::evaluateEquation(tp, variables);
     return out;
 }
 bool biorbd::utils::IfStream::read(
@@ -6,6 +6,7 @@
 biorbd::utils::Node::Node() :
     m_name(std::make_shared<biorbd::utils::String>("")),
     m_parentName(std::make_shared<biorbd::utils::String>("")),
+    m_parentVersion(std::make_shared<unsigned int>(0)),
     m_typeOfNode(std::make_shared<biorbd::utils::NODE_TYPE>(biorbd::utils::NODE_TYPE::NO_NODE_TYPE))
 {
 
@@ -17,12 +18,14 @@ biorbd::utils::Node::Node(
     // Shallow copy
     m_name = other.m_name;
     m_parentName = other.m_parentName;
+    m_parentVersion = other.m_parentVersion;
     m_typeOfNode = other.m_typeOfNode;
 }
 
 biorbd::utils::Node::Node(const biorbd::utils::String &name) :
     m_name(std::make_shared<biorbd::utils::String>(name)),
     m_parentName(std::make_shared<biorbd::utils::String>("")),
+    m_parentVersion(std::make_shared<unsigned int>(0)),
     m_typeOfNode(std::make_shared<biorbd::utils::NODE_TYPE>(biorbd::utils::NODE_TYPE::NO_NODE_TYPE))
 {
 
@@ -33,6 +36,7 @@ biorbd::utils::Node::Node(
         const biorbd::utils::String &parentName) :
     m_name(std::make_shared<biorbd::utils::String>(name)),
     m_parentName(std::make_shared<biorbd::utils::String>(parentName)),
+    m_parentVersion(std::make_shared<unsigned int>(0)),
     m_typeOfNode(std::make_shared<biorbd::utils::NODE_TYPE>(biorbd::utils::NODE_TYPE::NO_NODE_TYPE))
 {
 
@@ -48,6 +52,7 @@ void biorbd::utils::Node::DeepCopy(
 {
     *m_name = *other.m_name;
     *m_parentName = *other.m_parentName;
+    ++*m_parentVersion;
     *m_typeOfNode = *other.m_typeOfNode;
 }
 
@@ -70,6 +75,12 @@ void biorbd::utils::Node::setParent(
         const biorbd::utils::String &name)
 {
     *m_parentName = name;
+    ++*m_parentVersion;
+}
+
+unsigned int biorbd::utils::Node::parentVersion() const
+{
+    return *m_parentVersion;
 }
 
 biorbd::utils::NODE_TYPE biorbd::utils::Node::typeOfNode() const
@@ -0,0 +1,128 @@
+#define BIORBD_API_EXPORTS
+#include "Utils/ThreadDispatcher.h"
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <exception>
+
+namespace {
+// Join the threads that are still running when leaving the scope
+class JoinThreads
+{
+public:
+    JoinThreads(std::vector<std::thread>& threads) :
+        m_threads(threads)
+    {
+
+    }
+
+    ~JoinThreads()
+    {
+        join();
+    }
+
+    void join()
+    {
+        for (auto& thread : m_threads)
+            if (thread.joinable())
+                thread.join();
+    }
+
+protected:
+    std::vector<std::thread>& m_threads;
+};
+}
+
+biorbd::utils::ThreadDispatcher::ThreadDispatcher(unsigned int nbThreads) :
+    m_nbThreads(1)
+{
+    setNbThreads(nbThreads);
+}
+
+void biorbd::utils::ThreadDispatcher::setNbThreads(unsigned int nbThreads)
+{
+    if (nbThreads == 0)
+        nbThreads = std::thread::hardware_concurrency();
+    m_nbThreads = nbThreads == 0 ? 1 : nbThreads; // hardware_concurrency can't always tell
+}
+
+unsigned int biorbd::utils::ThreadDispatcher::nbThreads() const
+{
+    return m_nbThreads;
+}
+
+unsigned int biorbd::utils::ThreadDispatcher::nbChunks(unsigned int nbTasks) const
+{
+    if (nbTasks == 0)
+        return 0;
+    return nbTasks < m_nbThreads ? nbTasks : m_nbThreads;
+}
+
+void biorbd::utils::ThreadDispatcher::run(
+        unsigned int nbTasks,
+        const std::function<void(unsigned int, unsigned int, unsigned int)>& task) const
+{
+    unsigned int nChunks(nbChunks(nbTasks));
+    if (nChunks == 0)
+        return;
+
+    // Contiguous chunks, the first ones taking the remainder
+    std::vector<unsigned int> first(nChunks+1);
+    unsigned int chunkSize(nbTasks / nChunks);
+    unsigned int remainder(nbTasks % nChunks);
+    first[0] = 0;
+    for (unsigned int i=0; i<nChunks; ++i)
+        first[i+1] = first[i] + chunkSize + (i < remainder ? 1 : 0);
+
+    dispatch(nChunks, [&](unsigned int chunk){
+        task(chunk, first[chunk], first[chunk+1]);
+    });
+}
+
+void biorbd::utils::ThreadDispatcher::runDynamic(
+        unsigned int nbTasks,
+        const std::function<void(unsigned int, unsigned int)>& task) const
+{
+    unsigned int nThreads(nbChunks(nbTasks));
+    if (nThreads == 0)
+        return;
+
+    // Each thread takes the next task as soon as it is done with the previous one
+    std::atomic<unsigned int> next(0);
+    dispatch(nThreads, [&](unsigned int thread){
+        for (unsigned int i = next++; i < nbTasks; i = next++)
+            task(thread, i);
+    });
+}
+
+void biorbd::utils::ThreadDispatcher::dispatch(
+        unsigned int nThreads,
+        const std::function<void(unsigned int)>& job) const
+{
+    std::vector<std::exception_ptr> errors(nThreads);
+    std::vector<std::thread> threads;
+    // If a thread fails to launch, the ones already launched are joined before the error goes up
+    JoinThreads joinThreads(threads);
+    threads.reserve(nThreads-1);
+    for (unsigned int i=1; i<nThreads; ++i)
+        threads.push_back(std::thread([&, i](){
+            try {
+                job(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }));
+
+    // The calling thread takes care of the first job
+    try {
+        job(0);
+    } catch (...) {
+        errors[0] = std::current_exception();
+    }
+    joinThreads.join();
+
+    for (auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+}
@@ -0,0 +1,191 @@
+#define BIORBD_API_EXPORTS
+#include "ViconMarkerReader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include "Utils/Error.h"
+#include "Utils/String.h"
+#include "Utils/Equation.h"
+#include "Utils/Path.h"
+#include "Utils/Matrix.h"
+
+biorbd::ViconMarkerReader::ViconMarkerReader(
+        const biorbd::utils::Path &path) :
+    biorbd::ViconMarkerReader(path, std::vector<biorbd::utils::String>())
+{
+
+}
+
+biorbd::ViconMarkerReader::ViconMarkerReader(
+        const biorbd::utils::Path &path,
+        const std::vector<biorbd::utils::String> &markOrder) :
+    m_file(std::make_shared<std::ifstream>()),
+    m_line(std::make_shared<std::string>()),
+    m_markersInFile(std::make_shared<std::vector<biorbd::utils::String>>()),
+    m_rowOfField(std::make_shared<std::vector<int>>()),
+    m_nbMarkers(std::make_shared<unsigned int>(0)),
+    m_framePositions(std::make_shared<std::vector<std::streampos>>()),
+    m_firstFramePosition(std::make_shared<std::streampos>()),
+    m_currentFrame(std::make_shared<unsigned int>(0))
+{
+    biorbd::utils::Error::check(path.isFileExist(), path.absolutePath() + " could not be loaded");
+#ifdef _WIN32
+    m_file->open(biorbd::utils::Path::toWindowsFormat(
+                     path.absolutePath()).c_str(), std::ios::in | std::ios::binary);
+#else
+    m_file->open(path.absolutePath().c_str(), std::ios::in | std::ios::binary);
+#endif
+    readHeader(markOrder);
+}
+
+const std::vector<biorbd::utils::String> &biorbd::ViconMarkerReader::markersInFile() const
+{
+    return *m_markersInFile;
+}
+
+unsigned int biorbd::ViconMarkerReader::nbMarkers() const
+{
+    return *m_nbMarkers;
+}
+
+unsigned int biorbd::ViconMarkerReader::nbFrames()
+{
+    if (m_framePositions->empty()){
+        // Index the position of every frame, followed by the end of the file
+        m_file->clear();
+        m_file->seekg(*m_firstFramePosition);
+        while (true){
+            m_framePositions->push_back(m_file->tellg());
+            if (!readLine())
+                break;
+        }
+
+        // Come back to where the reading was
+        m_file->clear();
+        m_file->seekg((*m_framePositions)[std::min(*m_currentFrame, static_cast<unsigned int>(m_framePositions->size()-1))]);
+    }
+    return static_cast<unsigned int>(m_framePositions->size()) - 1;
+}
+
+unsigned int biorbd::ViconMarkerReader::currentFrame() const
+{
+    return *m_currentFrame;
+}
+
+void biorbd::ViconMarkerReader::seekFrame(
+        unsigned int frame)
+{
+    biorbd::utils::Error::check(frame <= nbFrames(), "The frame asked is greater than the number of frames");
+    m_file->clear();
+    m_file->seekg((*m_framePositions)[frame]);
+    *m_currentFrame = frame;
+}
+
+unsigned int biorbd::ViconMarkerReader::readFrames(
+        biorbd::utils::Matrix &frames,
+        unsigned int nbFramesToRead)
+{
+    if (static_cast<unsigned int>(frames.rows()) != 3*nbMarkers() || static_cast<unsigned int>(frames.cols()) != nbFramesToRead)
+        frames.resize(3*nbMarkers(), nbFramesToRead);
+
+    unsigned int nbRead(0);
+    while (nbRead < nbFramesToRead && readLine()){
+        parseLine(frames, nbRead);
+        ++nbRead;
+    }
+    *m_currentFrame += nbRead;
+    return nbRead;
+}
+
+void biorbd::ViconMarkerReader::forEachBlock(
+        unsigned int blockSize,
+        const std::function<void (const biorbd::utils::Matrix &, unsigned int, unsigned int)> &f)
+{
+    biorbd::utils::Matrix frames(3*nbMarkers(), blockSize);
+    while (true){
+        unsigned int firstFrame(currentFrame());
+        unsigned int nbRead(readFrames(frames, blockSize));
+        if (nbRead == 0)
+            break;
+        f(frames, firstFrame, nbRead);
+    }
+}
+
+void biorbd::ViconMarkerReader::readHeader(
+        const std::vector<biorbd::utils::String> &markOrder)
+{
+    // The header is made of the "Trajectories" tag, the acquisition frequency, the names of the
+    // markers, the name of the columns and the units
+    readLine();
+    readLine();
+    biorbd::utils::Error::check(readLine(), "The marker file has no header");
+
+    // The name of a marker is on the column of its x coordinate, after the name of the subject
+    std::vector<unsigned int> fieldOfMarker;
+    unsigned int field(0);
+    size_t start(0);
+    while (start <= m_line->size()){
+        size_t end(m_line->find(',', start));
+        if (end == std::string::npos)
+            end = m_line->size();
+        biorbd::utils::String name(m_line->substr(start, end - start));
+        size_t colon(name.find_last_of(':'));
+        if (colon != std::string::npos)
+            name = name.substr(colon + 1);
+        if (name.find_first_not_of(" \t") != std::string::npos){
+            m_markersInFile->push_back(name);
+            fieldOfMarker.push_back(field);
+        }
+        start = end + 1;
+        ++field;
+    }
+    readLine();
+    readLine();
+    *m_firstFramePosition = m_file->tellg();
+
+    // Dispatch the fields of the markers asked on the rows of a frame
+    const std::vector<biorbd::utils::String>& markers(markOrder.empty() ? *m_markersInFile : markOrder);
+    *m_nbMarkers = static_cast<unsigned int>(markers.size());
+    for (unsigned int i=0; i<markers.size(); ++i)
+        for (unsigned int j=0; j<m_markersInFile->size(); ++j)
+            if (!markers[i].compare((*m_markersInFile)[j])){
+                if (m_rowOfField->size() < fieldOfMarker[j] + 3)
+                    m_rowOfField->resize(fieldOfMarker[j] + 3, -1);
+                for (unsigned int k=0; k<3; ++k)
+                    (*m_rowOfField)[fieldOfMarker[j] + k] = static_cast<int>(3*i + k);
+                break;
+            }
+}
+
+bool biorbd::ViconMarkerReader::readLine()
+{
+    while (std::getline(*m_file, *m_line)){
+        if (!m_line->empty() && (*m_line)[m_line->size()-1] == '\r')
+            m_line->resize(m_line->size()-1);
+        if (m_line->find_first_not_of(" \t") != std::string::npos)
+            return true;
+    }
+    return false;
+}
+
+void biorbd::ViconMarkerReader::parseLine(
+        biorbd::utils::Matrix &frames,
+        unsigned int col) const
+{
+    // Occluded markers have empty fields, which are left to zero
+    frames.col(col).setZero();
+    const std::vector<int>& rowOfField(*m_rowOfField);
+    const char* p(m_line->c_str());
+    for (unsigned int field=0; field<rowOfField.size(); ++field){
+        if (rowOfField[field] >= 0 && *p != ',' && *p != '\0'){
+            double value;
+            if (biorbd::utils::Equation::readNumber(p, value) != p)
+                frames(rowOfField[field], col) = value / 1000; // Put back to meters
+        }
+        p = std::strchr(p, ',');
+        if (!p)
+            break;
+        ++p;
+    }
+}
@@ -1,17 +1,27 @@
 #include <iostream>
+#include <clocale>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <rbdl/Dynamics.h>
 
 #include "BiorbdModel.h"
 #include "biorbd/ModelWriter.h"
+#include "ModelReader.h"
+#include "ViconMarkerReader.h"
 #include "biorbdConfig.h"
 #include "Utils/String.h"
+#include "Utils/Matrix.h"
+#include "Utils/Path.h"
+#include "Utils/Vector3d.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/GeneralizedTorque.h"
+#include "RigidBody/Mesh.h"
+#include "RigidBody/MeshFace.h"
 
 static double requiredPrecision(1e-10);
 
 static std::string modelPathWithMeshFile("models/simpleWithMeshFile.bioMod");
+static std::string meshPath("models/meshFiles/cube.bioMesh");
 #ifdef MODULE_ACTUATORS
 static std::string modelPathForGeneralTesting("models/pyomecaman_withActuators.bioMod");
 #else // MODULE_ACTUATORS
@@ -51,6 +61,44 @@ TEST(MeshFile, FileIoObj) {
     biorbd::Model model(modelPathWithObj);
 }
 
+TEST(MeshFile, cache) {
+    biorbd::rigidbody::Mesh expected(biorbd::Reader::readMeshFileBiorbdSegments(meshPath));
+
+    // Write the cache of a copy of the mesh file and read it back
+    biorbd::utils::String copyPath("temporary.bioMesh");
+    {
+        std::ifstream source(meshPath, std::ios::binary);
+        std::ofstream copy(copyPath, std::ios::binary);
+        copy << source.rdbuf();
+    }
+    EXPECT_TRUE(biorbd::Reader::writeMeshFileCache(copyPath, expected));
+    biorbd::rigidbody::Mesh mesh;
+    EXPECT_TRUE(biorbd::Reader::readMeshFileCache(copyPath, mesh));
+    EXPECT_EQ(mesh.nbVertex(), expected.nbVertex());
+    EXPECT_EQ(mesh.faces().size(), expected.faces().size());
+    for (unsigned int i=0; i<mesh.nbVertex(); ++i)
+        for (unsigned int j=0; j<3; ++j)
+            EXPECT_EQ(mesh.point(i)(j), expected.point(i)(j));
+    for (unsigned int i=0; i<mesh.faces().size(); ++i){
+        biorbd::rigidbody::MeshFace face(mesh.face(i));
+        biorbd::rigidbody::MeshFace expectedFace(expected.face(i));
+        for (int j=0; j<3; ++j)
+            EXPECT_EQ(face(j), expectedFace(j));
+    }
+    EXPECT_EQ(biorbd::Reader::readMeshFile(copyPath).nbVertex(), expected.nbVertex());
+
+    // The cache is not used anymore when the mesh file changes
+    {
+        std::ofstream copy(copyPath, std::ios::app);
+        copy << std::endl;
+    }
+    EXPECT_FALSE(biorbd::Reader::readMeshFileCache(copyPath, mesh));
+    EXPECT_EQ(biorbd::Reader::readMeshFile(copyPath).nbVertex(), expected.nbVertex());
+
+    remove(copyPath.c_str());
+    remove((copyPath + ".bioMeshCache").c_str());
+}
+
 #ifdef MODULE_VTP_FILES_READER
 TEST(MeshFile, FileIoVtp) {
     EXPECT_NO_THROW(biorbd::Model model(modelPathWithVtp));
@@ -58,6 +106,112 @@ TEST(MeshFile, FileIoVtp) {
 }
 #endif
 
+TEST(ViconMarkerFile, streaming) {
+    // Write a small marker file where the marker B is occluded on the second frame
+    biorbd::utils::String path("temporary.csv");
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "Trajectories\r\n"
+             << "100\r\n"
+             << ",,Subject:A,,,Subject:B,,\r\n"
+             << "Frame,Sub Frame,X,Y,Z,X,Y,Z\r\n"
+             << ",,mm,mm,mm,mm,mm,mm\r\n";
+        for (unsigned int i=0; i<7; ++i){
+            file << i+1 << ",0," << i << "," << 10*i << "," << 100*i << ",";
+            if (i == 1)
+                file << ",,";
+            else
+                file << -1.0*i << "," << -10.0*i << "," << -100.0*i;
+            file << "\r\n";
+        }
+    }
+
+    std::vector<biorbd::utils::String> markOrder;
+    markOrder.push_back("B");
+    markOrder.push_back("A");
+    biorbd::ViconMarkerReader reader(path, markOrder);
+    EXPECT_EQ(reader.markersInFile().size(), 2);
+    EXPECT_STREQ(reader.markersInFile()[0].c_str(), "A");
+    EXPECT_STREQ(reader.markersInFile()[1].c_str(), "B");
+    EXPECT_EQ(reader.nbMarkers(), 2);
+    EXPECT_EQ(reader.nbFrames(), 7);
+
+    // Read by blocks of 3 frames
+    unsigned int nbBlocks(0);
+    unsigned int nbFramesRead(0);
+    reader.forEachBlock(3, [&](const biorbd::utils::Matrix& frames,
+                        unsigned int firstFrame, unsigned int nbRead){
+        EXPECT_EQ(firstFrame, 3*nbBlocks);
+        EXPECT_EQ(frames.rows(), 6);
+        for (unsigned int i=0; i<nbRead; ++i){
+            double t(firstFrame + i);
+            double sign(firstFrame + i == 1 ? 0 : -1);
+            EXPECT_NEAR(frames(0, i), sign*t/1000, requiredPrecision);
+            EXPECT_NEAR(frames(2, i), sign*t/10, requiredPrecision);
+            EXPECT_NEAR(frames(3, i), t/1000, requiredPrecision);
+            EXPECT_NEAR(frames(5, i), t/10, requiredPrecision);
+        }
+        nbFramesRead += nbRead;
+        ++nbBlocks;
+    });
+    EXPECT_EQ(nbBlocks, 3);
+    EXPECT_EQ(nbFramesRead, 7);
+
+    // Random access
+    biorbd::utils::Matrix frames;
+    reader.seekFrame(5);
+    EXPECT_EQ(reader.readFrames(frames, 4), 2);
+    EXPECT_NEAR(frames(4, 0), 0.05, requiredPrecision);
+    EXPECT_NEAR(frames(4, 1), 0.06, requiredPrecision);
+    EXPECT_EQ(reader.currentFrame(), 7);
+
+    // The whole file
+    std::vector<std::vector<biorbd::utils::Vector3d>> data(
+                biorbd::Reader::readViconMarkerFile(path));
+    EXPECT_EQ(data.size(), 7);
+    EXPECT_EQ(data[3].size(), 2);
+    EXPECT_NEAR(data[3][0](1), 0.03, requiredPrecision);
+    EXPECT_NEAR(data[3][1](2), -0.3, requiredPrecision);
+    EXPECT_NEAR(data[1][1](0), 0, requiredPrecision);
+
+    // Some of the frames
+    data = biorbd::Reader::readViconMarkerFile(path, markOrder, 3);
+    EXPECT_EQ(data.size(), 3);
+    EXPECT_NEAR(data[1][1](0), 0.003, requiredPrecision);
+    EXPECT_NEAR(data[2][1](0), 0.006, requiredPrecision);
+
+    remove(path.c_str());
+}
+
+TEST(ViconMarkerFile, localeIndependent) {
+    // The files keep their dot even where the locale uses a comma, which is also the separator of the fields
+    biorbd::utils::String path("temporaryLocale.csv");
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "Trajectories\r\n"
+             << "100\r\n"
+             << ",,Subject:A,,\r\n"
+             << "Frame,Sub Frame,X,Y,Z\r\n"
+             << ",,mm,mm,mm\r\n"
+             << "1,0,1.5,-2.25,3.125e1\r\n";
+    }
+    std::string previousLocale(std::setlocale(LC_NUMERIC, nullptr));
+    const char* locales[] = {"fr_FR.UTF-8", "de_DE.UTF-8", "fr_FR", "de_DE", "French", "German"};
+    for (const char* locale : locales)
+        if (std::setlocale(LC_NUMERIC, locale))
+            break;
+
+    biorbd::ViconMarkerReader reader(path);
+    biorbd::utils::Matrix frames;
+    EXPECT_EQ(reader.readFrames(frames, 1), 1);
+    EXPECT_NEAR(frames(0, 0), 0.0015, requiredPrecision);
+    EXPECT_NEAR(frames(1, 0), -0.00225, requiredPrecision);
+    EXPECT_NEAR(frames(2, 0), 0.03125, requiredPrecision);
+
+    std::setlocale(LC_NUMERIC, previousLocale.c_str());
+    remove(path.c_str());
+}
+
 TEST(Integrate, freefall) {
     biorbd::Model model(modelFreeFall);
     biorbd::rigidbody::GeneralizedCoordinates
@@ -85,3 +239,126 @@ TEST(Integrate, freefall) {
         }
     }
 }
+
+TEST(Integrate, freefallDecimated) {
+    biorbd::Model model(modelFreeFall);
+    biorbd::rigidbody::GeneralizedCoordinates
+            Q(model), Qdot(model),
+            QIntegrated(model), QdotIntegrated(model);
+    biorbd::rigidbody::GeneralizedTorque Tau(model.nbQ());
+    Q.setZero();
+    Qdot.setZero();
+    Tau.setZero();
+
+    // One step every 7 plus the final one
+    model.integrateKinematics(Q, Qdot, Tau, 0, 1, 0.01, 7);
+    EXPECT_EQ(model.nbInterationStep(), 16);
+
+    // Only the final step
+    model.integrateKinematics(Q, Qdot, Tau, 0, 1, 0.01, 0);
+    EXPECT_EQ(model.nbInterationStep(), 1);
+    model.getIntegratedKinematics(0, QIntegrated, QdotIntegrated);
+    EXPECT_NEAR(QIntegrated(1), -4.905, requiredPrecision);
+    EXPECT_NEAR(QdotIntegrated(1), -9.81, requiredPrecision);
+}
+
+TEST(Integrate, freefallSteppers) {
+    biorbd::Model model(modelFreeFall);
+    biorbd::rigidbody::GeneralizedCoordinates
+            Q(model), Qdot(model),
+            QIntegrated(model), QdotIntegrated(model);
+    biorbd::rigidbody::GeneralizedTorque Tau(model.nbQ());
+    Q.setZero();
+    Qdot.setZero();
+    Tau.setZero();
+
+    // The trajectory is a polynomial, so the adaptive steppers need fewer steps
+    std::vector<biorbd::rigidbody::INTEGRATOR_STEPPER> adaptiveSteppers;
+    adaptiveSteppers.push_back(biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_DOPRI5);
+    adaptiveSteppers.push_back(biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_CASH_KARP54);
+    for (auto stepper : adaptiveSteppers){
+        model.setIntegrationStepper(stepper);
+        model.integrateKinematics(Q, Qdot, Tau, 0, 1, 0.01);
+        EXPECT_LT(model.nbInterationStep(), 101);
+        model.getIntegratedKinematics(model.nbInterationStep()-1,
+                                      QIntegrated, QdotIntegrated);
+        EXPECT_NEAR(QIntegrated(1), -4.905, 1e-6);
+        EXPECT_NEAR(QdotIntegrated(1), -9.81, 1e-6);
+    }
+
+    // The velocity is exact while the position drifts of g*dt*t/2
+    model.setIntegrationStepper(biorbd::rigidbody::INTEGRATOR_STEPPER::SYMPLECTIC_EULER);
+    model.integrateKinematics(Q, Qdot, Tau, 0, 1, 0.01);
+    EXPECT_EQ(model.nbInterationStep(), 101);
+    model.getIntegratedKinematics(model.nbInterationStep()-1,
+                                  QIntegrated, QdotIntegrated);
+    EXPECT_NEAR(QIntegrated(1), -4.95405, requiredPrecision);
+    EXPECT_NEAR(QdotIntegrated(1), -9.81, requiredPrecision);
+}
+
+TEST(Integrate, freefallBatch) {
+    biorbd::Model model(modelFreeFall);
+    unsigned int nbSimulations(5);
+    unsigned int nbSteps(100);
+    unsigned int nbStates(model.nbQ() + model.nbQdot());
+
+    // Each simulation starts with a different vertical velocity
+    biorbd::utils::Matrix allQ_Qdot(nbStates, nbSimulations);
+    allQ_Qdot.setZero();
+    for (unsigned int i=0; i<nbSimulations; ++i)
+        allQ_Qdot(model.nbQ() + 1, i) = i;
+    biorbd::utils::Matrix allTorque(model.nbQdot(), nbSteps*nbSimulations);
+    allTorque.setZero();
+
+    biorbd::utils::Matrix allStates;
+    model.integrateKinematics(allQ_Qdot, allTorque, 0.01, allStates, 3);
+    EXPECT_EQ(allStates.rows(), nbStates);
+    EXPECT_EQ(allStates.cols(), (nbSteps+1)*nbSimulations);
+    for (unsigned int i=0; i<nbSimulations; ++i){
+        unsigned int last((i+1)*(nbSteps+1) - 1);
+        EXPECT_NEAR(allStates(1, i*(nbSteps+1)), 0, requiredPrecision);
+        EXPECT_NEAR(allStates(1, last), i - 4.905, requiredPrecision);
+        EXPECT_NEAR(allStates(model.nbQ() + 1, last), i - 9.81, requiredPrecision);
+    }
+}
+
+TEST(Integrate, batchAgainstSingleIntegration) {
+    biorbd::Model model(modelFreeFall);
+    unsigned int nbSteps(100);
+    unsigned int nbStates(model.nbQ() + model.nbQdot());
+    biorbd::rigidbody::GeneralizedCoordinates
+            Q(model), Qdot(model),
+            QIntegrated(model), QdotIntegrated(model);
+    biorbd::rigidbody::GeneralizedTorque Tau(model.nbQ());
+    for (unsigned int i=0; i<model.nbQ(); ++i){
+        Q(i) = 0.1*i;
+        Qdot(i) = -0.05*i;
+        Tau(i) = 0.5 - 0.1*i;
+    }
+
+    // With a constant torque, the intervals of the batch join into the whole horizon
+    biorbd::utils::Matrix allQ_Qdot(nbStates, 1);
+    allQ_Qdot << Q, Qdot;
+    biorbd::utils::Matrix allTorque(model.nbQdot(), nbSteps);
+    for (unsigned int i=0; i<nbSteps; ++i)
+        allTorque.col(i) = Tau;
+
+    std::vector<std::pair<biorbd::rigidbody::INTEGRATOR_STEPPER, double>> steppers;
+    steppers.push_back(std::make_pair(biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_4, requiredPrecision));
+    steppers.push_back(std::make_pair(biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_DOPRI5, 1e-6));
+    steppers.push_back(std::make_pair(biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_CASH_KARP54, 1e-6));
+    for (auto stepper : steppers){
+        // The adaptive steppers do not take the same steps in both, so they must be accurate enough
+        model.setIntegrationStepper(stepper.first, 1e-10, 1e-10);
+        biorbd::utils::Matrix allStates;
+        model.integrateKinematics(allQ_Qdot, allTorque, 0.01, allStates, 1);
+
+        model.integrateKinematics(Q, Qdot, Tau, 0, 1, 0.01);
+        model.getIntegratedKinematics(model.nbInterationStep()-1,
+                                      QIntegrated, QdotIntegrated);
+        for (unsigned int i=0; i<model.nbQ(); ++i){
+            EXPECT_NEAR(allStates(i, nbSteps), QIntegrated(i), stepper.second);
+            EXPECT_NEAR(allStates(model.nbQ() + i, nbSteps), QdotIntegrated(i), stepper.second);
+        }
+    }
+}
@@ -1,10 +1,15 @@
 #include <iostream>
+#include <thread>
 #include <gtest/gtest.h>
 
 #include <rbdl/Dynamics.h>
 #include "BiorbdModel.h"
 #include "biorbdConfig.h"
 #include "Utils/Matrix.h"
+#include "Utils/String.h"
+#include "Utils/RotoTrans.h"
+#include "Utils/Vector3d.h"
+#include "Utils/ThreadDispatcher.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/GeneralizedTorque.h"
 #ifdef MODULE_MUSCLES
@@ -74,6 +79,59 @@ TEST(MuscleForce, torqueFromMuscles)
 
 }
 
+TEST(MuscleForce, torqueActivationJacobian)
+{
+    biorbd::Model model(modelPathForMuscleForce);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model), QDot(model);
+    Q.setOnes()/10;
+    QDot.setOnes()/10;
+    std::vector<std::shared_ptr<biorbd::muscles::StateDynamics>> states;
+    for (unsigned int i=0; i<model.nbMuscleTotal(); ++i)
+        states.push_back(std::make_shared<biorbd::muscles::StateDynamics>(0, 0.2));
+
+    biorbd::utils::Matrix jacobian(model.muscularJointTorqueActivationJacobian(states, true, &Q, &QDot));
+    EXPECT_EQ(jacobian.rows(), model.nbDof());
+    EXPECT_EQ(jacobian.cols(), model.nbMuscleTotal());
+
+    // Compare with finite differences
+    double eps(1e-7);
+    biorbd::rigidbody::GeneralizedTorque Tau(model.muscularJointTorque(states, false));
+    for (unsigned int j=0; j<model.nbMuscleTotal(); ++j){
+        std::vector<std::shared_ptr<biorbd::muscles::StateDynamics>> statesEps;
+        for (unsigned int i=0; i<model.nbMuscleTotal(); ++i)
+            statesEps.push_back(std::make_shared<biorbd::muscles::StateDynamics>(0, 0.2 + (i == j ? eps : 0)));
+        biorbd::rigidbody::GeneralizedTorque TauEps(model.muscularJointTorque(statesEps, false));
+        for (unsigned int i=0; i<model.nbDof(); ++i)
+            EXPECT_NEAR(jacobian(i, j), (TauEps[i] - Tau[i])/eps, 1e-4);
+    }
+}
+
+TEST(MuscleForce, integrateActivations)
+{
+    biorbd::Model model(modelPathForMuscleForce);
+    biorbd::muscles::MusclesIntegrator integrator(model);
+    EXPECT_EQ(integrator.nbFatigueStates(), 0);
+    EXPECT_EQ(integrator.nbStates(), model.nbQ() + model.nbQdot() + model.nbMuscleTotal());
+
+    // Relaxed muscles starting from an half activation
+    biorbd::utils::Vector x0(integrator.nbStates());
+    x0.setZero();
+    for (unsigned int i=0; i<model.nbMuscleTotal(); ++i)
+        x0(model.nbQ() + model.nbQdot() + i) = 0.5;
+    biorbd::utils::Vector excitations(model.nbMuscleTotal());
+    excitations.setZero();
+
+    integrator.setStepper(biorbd::rigidbody::INTEGRATOR_STEPPER::RUNGE_KUTTA_DOPRI5);
+    integrator.integrate(x0, excitations, 0, 0.05, 0.001);
+    biorbd::utils::Vector xEnd(integrator.getX(integrator.steps()-1));
+    EXPECT_NEAR(integrator.time(integrator.steps()-1), 0.05, requiredPrecision);
+    for (unsigned int i=0; i<model.nbMuscleTotal(); ++i)
+        EXPECT_LT(xEnd(model.nbQ() + model.nbQdot() + i), 0.5);
+
+    // The integration is performed on a workspace, so the muscles of the model were never updated
+    EXPECT_THROW(model.muscleGroup(0).muscle(0).position().jacobian(), std::runtime_error);
+}
+
 TEST(MuscleJacobian, jacobian){
     biorbd::Model model(modelPathForMuscleJacobian);
     biorbd::rigidbody::GeneralizedCoordinates Q(model);
@@ -134,6 +192,15 @@ TEST(MuscleJacobian, jacobian){
     for (unsigned int i=0; i<jaco.rows(); ++i)
         for (unsigned int j=0; j<jaco.cols(); ++j)
             EXPECT_NEAR(jaco(i, j), jacoRef(i, j), requiredPrecision);
+
+    // The points of the path, as nodes and in a matrix
+    std::vector<biorbd::utils::Vector3d> points(muscle.musclesPointsInGlobal());
+    const Eigen::Matrix3Xd& pointsInMatrix(muscle.musclesPointsInGlobalInMatrix());
+    ASSERT_EQ(points.size(), static_cast<size_t>(pointsInMatrix.cols()));
+    EXPECT_STREQ(points[0].name().c_str(), muscle.position().originInLocal().name().c_str());
+    for (unsigned int i=0; i<points.size(); ++i)
+        for (unsigned int j=0; j<3; ++j)
+            EXPECT_NEAR(points[i][j], pointsInMatrix(j, i), requiredPrecision);
 }
 TEST(MuscleJacobian, jacobianLength){
     biorbd::Model model(modelPathForMuscleJacobian);
@@ -171,7 +238,288 @@ TEST(MuscleJacobian, jacobianLength){
         for (unsigned int i=0; i<jaco.rows(); ++i)
             for (unsigned int j=0; j<jaco.cols(); ++j)
                 EXPECT_NEAR(jaco(i, j), jacoRef(i, j), requiredPrecision);
+
+    // The jacobian is kept by the model and follows each update of the muscles
+    const biorbd::utils::Matrix& jacoInModel(model.musclesLengthJacobian());
+    EXPECT_EQ(&jacoInModel, &model.musclesLengthJacobian(Q));
+    unsigned int cmpMuscle(0);
+    for (unsigned int i=0; i<model.nbMuscleGroups(); ++i)
+        for (unsigned int j=0; j<model.muscleGroup(i).nbMuscles(); ++j){
+            const biorbd::utils::Matrix& jacoMuscle(model.muscleGroup(i).muscle(j).position().jacobianLength());
+            for (unsigned int k=0; k<model.nbQ(); ++k)
+                EXPECT_EQ(jacoInModel(cmpMuscle, k), jacoMuscle(0, k));
+            ++cmpMuscle;
+        }
+    Q = Q.setOnes()/10;
+    model.updateMuscles(Q, true);
+    EXPECT_NEAR(jacoInModel(0, 0), 0.037620360527045288, requiredPrecision);
+}
+
+TEST(MuscleJacobian, jacobianLengthBeforeUpdate){
+    biorbd::Model model(modelPathForMuscleJacobian);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model), QDot(model);
+    Q = Q.setOnes()/10;
+    QDot.setZero();
+    biorbd::utils::Vector F(model.nbMuscleTotal());
+    F.setOnes();
+
+    // No muscle was updated yet, so they have no length jacobian
+    EXPECT_EQ(model.musclesLengthJacobian().norm(), 0);
+    EXPECT_EQ(model.muscularJointTorque(F, false, &Q, &QDot).norm(), 0);
+
+    // A muscle updated on its own is seen by the length jacobian of the model
+    model.updateMuscles(Q, true);
+    biorbd::utils::Matrix jacoRef(model.musclesLengthJacobian());
+    Q.setZero();
+    model.updateMuscles(Q, true);
+    Q = Q.setOnes()/10;
+    model.muscle(muscleForMuscleJacobian).updateOrientations(model, Q, 2);
+    const biorbd::utils::Matrix& jaco(model.musclesLengthJacobian());
+    for (unsigned int j=0; j<model.nbQ(); ++j)
+        EXPECT_NEAR(jaco(muscleForMuscleJacobian, j), jacoRef(muscleForMuscleJacobian, j), requiredPrecision);
+}
+
+TEST(MuscleJacobian, updateInParallel){
+    biorbd::Model model(modelPathForMuscleJacobian);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model), QDot(model);
+    Q = Q.setOnes()/10;
+    QDot = QDot.setOnes();
+
+    // The muscles are addressed in the order of their group
+    unsigned int cmpMuscle(0);
+    for (unsigned int i=0; i<model.nbMuscleGroups(); ++i)
+        for (unsigned int j=0; j<model.muscleGroup(i).nbMuscles(); ++j)
+            EXPECT_EQ(&model.muscle(cmpMuscle++), &model.muscleGroup(i).muscle(j));
+    EXPECT_EQ(cmpMuscle, model.nbMuscleTotal());
+
+    model.updateMuscles(Q, QDot, true);
+    biorbd::utils::Matrix jacoRef(model.musclesLengthJacobian());
+    std::vector<double> lengthRef, velocityRef;
+    for (unsigned int i=0; i<model.nbMuscleTotal(); ++i){
+        lengthRef.push_back(model.muscle(i).position().length());
+        velocityRef.push_back(model.muscle(i).position().velocity());
+    }
+
+    Q.setZero();
+    model.updateMuscles(Q, true);
+    Q = Q.setOnes()/10;
+    model.updateMuscles(Q, QDot, true, 2);
+    const biorbd::utils::Matrix& jaco(model.musclesLengthJacobian());
+    for (unsigned int i=0; i<model.nbMuscleTotal(); ++i){
+        EXPECT_NEAR(model.muscle(i).position().length(), lengthRef[i], requiredPrecision);
+        EXPECT_NEAR(model.muscle(i).position().velocity(), velocityRef[i], requiredPrecision);
+        for (unsigned int j=0; j<model.nbQ(); ++j)
+            EXPECT_NEAR(jaco(i, j), jacoRef(i, j), requiredPrecision);
+    }
+}
+
+TEST(MuscleJacobian, updateInParallelFirst){
+    biorbd::Model modelRef(modelPathForMuscleJacobian);
+    biorbd::rigidbody::GeneralizedCoordinates Q(modelRef), QDot(modelRef);
+    Q = Q.setOnes()/10;
+    QDot = QDot.setOnes();
+    modelRef.updateMuscles(Q, QDot, true);
+    biorbd::utils::Matrix jacoRef(modelRef.musclesLengthJacobian());
+
+    // The threaded update is the very first one, so it is the one sizing the jacobian of all the muscles
+    for (unsigned int nbThreads : {2, 4}){
+        biorbd::Model model(modelPathForMuscleJacobian);
+        model.updateMuscles(Q, QDot, true, nbThreads);
+        const biorbd::utils::Matrix& jaco(model.musclesLengthJacobian());
+        EXPECT_EQ(jaco.rows(), jacoRef.rows());
+        EXPECT_EQ(jaco.cols(), jacoRef.cols());
+        for (unsigned int i=0; i<model.nbMuscleTotal(); ++i){
+            EXPECT_NEAR(model.muscle(i).position().length(), modelRef.muscle(i).position().length(), requiredPrecision);
+            EXPECT_NEAR(model.muscle(i).position().velocity(), modelRef.muscle(i).position().velocity(), requiredPrecision);
+            for (unsigned int j=0; j<model.nbQ(); ++j)
+                EXPECT_NEAR(jaco(i, j), jacoRef(i, j), requiredPrecision);
+        }
+
+        biorbd::Model modelNoVelocity(modelPathForMuscleJacobian);
+        modelNoVelocity.updateMuscles(Q, true, nbThreads);
+        const biorbd::utils::Matrix& jacoNoVelocity(modelNoVelocity.musclesLengthJacobian());
+        for (unsigned int i=0; i<modelNoVelocity.nbMuscleTotal(); ++i)
+            for (unsigned int j=0; j<modelNoVelocity.nbQ(); ++j)
+                EXPECT_NEAR(jacoNoVelocity(i, j), jacoRef(i, j), requiredPrecision);
+    }
+}
+
+TEST(MuscleJacobian, deepCopy){
+    biorbd::Model modelRef(modelPathForMuscleJacobian);
+    biorbd::rigidbody::GeneralizedCoordinates Q0(modelRef), Q1(modelRef);
+    Q0 = Q0.setOnes()/10;
+    Q1 = Q1.setOnes();
+    modelRef.updateMuscles(Q0, true);
+    biorbd::utils::Matrix jacoRef0(modelRef.musclesLengthJacobian());
+    modelRef.updateMuscles(Q1, true);
+    biorbd::utils::Matrix jacoRef1(modelRef.musclesLengthJacobian());
+    EXPECT_GT((jacoRef1 - jacoRef0).norm(), 1e-3);
+
+    // The muscles of the copy are its own, so each model writes its length jacobian in its own matrix
+    biorbd::Model model(modelPathForMuscleJacobian);
+    model.updateMuscles(Q0, true);
+    biorbd::Model copy(modelPathForMuscleJacobian);
+    copy.biorbd::muscles::Muscles::DeepCopy(model);
+    for (unsigned int i=0; i<model.nbMuscleTotal(); ++i){
+        EXPECT_NE(&copy.muscle(i), &model.muscle(i));
+        EXPECT_STREQ(copy.muscle(i).name().c_str(), model.muscle(i).name().c_str());
+    }
+
+    copy.updateMuscles(Q1, true);
+    EXPECT_NEAR((model.musclesLengthJacobian() - jacoRef0).norm(), 0, requiredPrecision);
+    EXPECT_NEAR((copy.musclesLengthJacobian() - jacoRef1).norm(), 0, requiredPrecision);
+
+    model.updateMuscles(Q1, true);
+    copy.updateMuscles(Q0, true);
+    EXPECT_NEAR((model.musclesLengthJacobian() - jacoRef1).norm(), 0, requiredPrecision);
+    EXPECT_NEAR((copy.musclesLengthJacobian() - jacoRef0).norm(), 0, requiredPrecision);
+}
+
+TEST(MuscleJacobian, deepCopyUpdateInParallel){
+    biorbd::Model modelRef(modelPathForMuscleJacobian);
+    biorbd::rigidbody::GeneralizedCoordinates Q0(modelRef), Q1(modelRef);
+    Q0 = Q0.setOnes()/10;
+    Q1 = Q1.setOnes();
+    modelRef.updateMuscles(Q0, true);
+    biorbd::utils::Matrix jacoRef0(modelRef.musclesLengthJacobian());
+    modelRef.updateMuscles(Q1, true);
+    biorbd::utils::Matrix jacoRef1(modelRef.musclesLengthJacobian());
+
+    // The flat index of the muscles of each model addresses its own muscles, so the threads of
+    // one model never write in the matrix of the other, even when both are updated at once
+    biorbd::Model model(modelPathForMuscleJacobian);
+    biorbd::Model copy(modelPathForMuscleJacobian);
+    copy.biorbd::muscles::Muscles::DeepCopy(model);
+    for (unsigned int k=0; k<10; ++k){
+        std::thread other([&](){ copy.updateMuscles(Q1, true, 2); });
+        model.updateMuscles(Q0, true, 2);
+        other.join();
+        EXPECT_NEAR((model.musclesLengthJacobian() - jacoRef0).norm(), 0, requiredPrecision);
+        EXPECT_NEAR((copy.musclesLengthJacobian() - jacoRef1).norm(), 0, requiredPrecision);
+    }
+}
+
+TEST(MuscleWrapping, parallelWorkspaces){
+    biorbd::Model model(modelPathForMuscleJacobian);
+
+    // Wrap the BRA muscle around a cylinder at the elbow
+    biorbd::utils::RotoTrans rt;
+    rt.block(0, 3, 3, 1) << 0.0061, -0.2904, -0.0123;
+    biorbd::muscles::WrappingCylinder cylinder(rt, 0.02, 0.1, true, biorbd::utils::String("elbow"), biorbd::utils::String("r_humerus"));
+    unsigned int idxMuscle(5);
+    model.muscleGroup(1).muscle(2).addPathObject(cylinder);
+    EXPECT_EQ(&model.muscle(idxMuscle), &model.muscleGroup(1).muscle(2));
+    EXPECT_EQ(model.muscle(idxMuscle).pathModifier().nbWraps(), 1);
+
+    unsigned int nbFrames(40);
+    std::vector<biorbd::rigidbody::GeneralizedCoordinates> Q(nbFrames, biorbd::rigidbody::GeneralizedCoordinates(model));
+    std::vector<double> lengthRef(nbFrames);
+    std::vector<biorbd::utils::Vector> jacoRef(nbFrames);
+    for (unsigned int i=0; i<nbFrames; ++i){
+        for (unsigned int j=0; j<model.nbQ(); ++j)
+            Q[i][j] = 0.05*i + 0.3*j;
+        model.updateMuscles(Q[i], true);
+        lengthRef[i] = model.muscle(idxMuscle).position().length();
+        jacoRef[i] = model.musclesLengthJacobian().row(idxMuscle).transpose();
+    }
+
+    // The wrapping objects must belong to each workspace, so the threads do not overwrite each other's wrap
+    biorbd::utils::ThreadDispatcher dispatcher(4);
+    std::vector<biorbd::Model> workspaces;
+    for (unsigned int i=0; i<dispatcher.nbChunks(nbFrames); ++i){
+        workspaces.push_back(model);
+        workspaces.back().detachWorkspace();
+    }
+    EXPECT_NE(&workspaces[0].muscle(idxMuscle).pathModifier().object(0),
+              &model.muscle(idxMuscle).pathModifier().object(0));
+    for (unsigned int repeat=0; repeat<5; ++repeat){
+        std::vector<double> length(nbFrames);
+        std::vector<biorbd::utils::Vector> jaco(nbFrames);
+        dispatcher.runDynamic(nbFrames, [&](unsigned int thread, unsigned int frame){
+            workspaces[thread].updateMuscles(Q[frame], true);
+            length[frame] = workspaces[thread].muscle(idxMuscle).position().length();
+            jaco[frame] = workspaces[thread].musclesLengthJacobian().row(idxMuscle).transpose();
+        });
+        for (unsigned int i=0; i<nbFrames; ++i){
+            EXPECT_NEAR(length[i], lengthRef[i], requiredPrecision);
+            for (unsigned int j=0; j<model.nbQ(); ++j)
+                EXPECT_NEAR(jaco[i][j], jacoRef[i][j], requiredPrecision);
+        }
+    }
+}
+
+TEST(MuscleViaPoint, parentChanged){
+    biorbd::rigidbody::GeneralizedCoordinates Q;
+    unsigned int idxMuscle(5);
+
+    // The via point is shared with the muscle, so moving it to the forearm moves the path
+    biorbd::Model model(modelPathForMuscleJacobian);
+    Q = biorbd::rigidbody::GeneralizedCoordinates(model).setOnes()/10;
+    biorbd::muscles::ViaPoint via(0.0061, -0.2904, -0.0123, biorbd::utils::String("via"), biorbd::utils::String("r_humerus"));
+    model.muscleGroup(1).muscle(2).addPathObject(via);
+    model.updateMuscles(Q, true);
+    double lengthOnHumerus(model.muscle(idxMuscle).position().length());
+    via.setParent("r_ulna_radius_hand");
+    model.updateMuscles(Q, true);
+    double lengthOnForearm(model.muscle(idxMuscle).position().length());
+    EXPECT_GT(std::abs(lengthOnForearm - lengthOnHumerus), 1e-6);
+
+    // Same as a via point that was always on the forearm
+    biorbd::Model modelRef(modelPathForMuscleJacobian);
+    biorbd::muscles::ViaPoint viaRef(0.0061, -0.2904, -0.0123, biorbd::utils::String("via"), biorbd::utils::String("r_ulna_radius_hand"));
+    modelRef.muscleGroup(1).muscle(2).addPathObject(viaRef);
+    modelRef.updateMuscles(Q, true);
+    EXPECT_NEAR(lengthOnForearm, modelRef.muscle(idxMuscle).position().length(), requiredPrecision);
+}
+
+TEST(MuscleGeometry, originParentChanged){
+    unsigned int idxMuscle(5);
+
+    // A copy of the origin shares its parent, so moving it to the forearm moves the origin of the muscle
+    biorbd::Model model(modelPathForMuscleJacobian);
+    biorbd::rigidbody::GeneralizedCoordinates Q(biorbd::rigidbody::GeneralizedCoordinates(model).setOnes()/10);
+    model.updateMuscles(Q, true);
+    double lengthOnHumerus(model.muscle(idxMuscle).position().length());
+    biorbd::utils::Vector3d origin(model.muscle(idxMuscle).position().originInLocal());
+    origin.setParent("r_ulna_radius_hand");
+    model.updateMuscles(Q, true);
+    EXPECT_GT(std::abs(model.muscle(idxMuscle).position().length() - lengthOnHumerus), 1e-6);
+}
+
+#ifndef SKIP_STATIC_OPTIM
+TEST(StaticOptimization, multiThreaded){
+    biorbd::Model model(modelPathForMuscleForce);
+    unsigned int nbFrames(4);
+
+    // The targets are the torques of known activations, so each frame has a solution
+    std::vector<biorbd::rigidbody::GeneralizedCoordinates> allQ, allQdot;
+    std::vector<biorbd::rigidbody::GeneralizedTorque> allTau;
+    for (unsigned int i=0; i<nbFrames; ++i){
+        biorbd::rigidbody::GeneralizedCoordinates Q(model), Qdot(model);
+        Q.setConstant(0.1 + 0.05*i);
+        Qdot.setZero();
+        std::vector<std::shared_ptr<biorbd::muscles::StateDynamics>> states;
+        for (unsigned int j=0; j<model.nbMuscleTotal(); ++j)
+            states.push_back(std::make_shared<biorbd::muscles::StateDynamics>(0, 0.2 + 0.05*i));
+        allQ.push_back(Q);
+        allQdot.push_back(Qdot);
+        allTau.push_back(model.muscularJointTorque(states, true, &Q, &Qdot));
+    }
+
+    biorbd::muscles::StaticOptimization sequential(model, allQ, allQdot, allTau);
+    sequential.run(false);
+    std::vector<biorbd::utils::Vector> solutionRef(sequential.finalSolution());
+
+    // The default linear solver is not thread safe, so the frames are solved in order as for the sequential run
+    biorbd::muscles::StaticOptimization fallback(model, allQ, allQdot, allTau);
+    fallback.run(false, 2);
+    std::vector<biorbd::utils::Vector> solution(fallback.finalSolution());
+    ASSERT_EQ(solution.size(), nbFrames);
+    for (unsigned int i=0; i<nbFrames; ++i)
+        for (unsigned int j=0; j<model.nbMuscleTotal(); ++j)
+            EXPECT_NEAR(solution[i][j], solutionRef[i][j], requiredPrecision);
 }
+#endif
 
 static std::string modelPathForXiaDerivativeTest("models/arm26.bioMod");
 static unsigned int muscleGroupForXiaDerivativeTest(0);
@@ -1,11 +1,17 @@
 #include <iostream>
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <rbdl/rbdl_math.h>
 #include <rbdl/Dynamics.h>
+#include <rbdl/rbdl_utils.h>
 
 #include "BiorbdModel.h"
+#include "ModelReader.h"
 #include "biorbdConfig.h"
 #include "Utils/String.h"
+#include "Utils/Matrix.h"
+#include "Utils/RotoTrans.h"
+#include "Utils/Rotation.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/GeneralizedTorque.h"
 #include "RigidBody/Mesh.h"
@@ -30,6 +36,7 @@ static std::string modelPathMeshEqualsMarker("models/meshsEqualMarkers.bioMod");
 static std::string modelPathForLoopConstraintTesting("models/loopConstrainedModel.bioMod");
 static std::string modelNoRoot("models/pyomecaman_freeFall.bioMod");
 static std::string modelPathForImuTesting("models/pyomecaman_withIMUs.bioMod");
+static std::string modelPathWithCardanSequences("models/cardanSequences.bioMod");
 
 TEST(DegreesOfFreedom, count)
 {
@@ -84,6 +91,139 @@ TEST(CoM, kinematics)
         EXPECT_NEAR(comDdot[i], expectedComDdot[i], requiredPrecision);
 }
 
+TEST(CoM, singlePass)
+{
+    biorbd::Model model(modelPathForGeneralTesting);
+    biorbd::rigidbody::GeneralizedCoordinates
+            Q(model), Qdot(model), Qddot(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i){
+        Q[i] = QtestPyomecaman[i];
+        Qdot[i] = QtestPyomecaman[i]*10;
+        Qddot[i] = QtestPyomecaman[i]*100;
+    }
+
+    biorbd::utils::Vector3d com, comDot, comDdot;
+    biorbd::utils::Matrix jacobian;
+    model.CoMKinematics(Q, &Qdot, &Qddot, com, &comDot, &comDdot, &jacobian);
+    EXPECT_EQ(jacobian.rows(), 3);
+    EXPECT_EQ(jacobian.cols(), model.nbDof());
+
+    // The reference is computed by RBDL, which bypasses the kinematics cache of the model
+    double mass;
+    RigidBodyDynamics::Math::Vector3d expectedCom, expectedComDot, expectedComDdot;
+    RigidBodyDynamics::Utils::CalcCenterOfMass(
+                model, Q, Qdot, &Qddot, mass, expectedCom, &expectedComDot, &expectedComDdot,
+                nullptr, nullptr, true);
+    model.invalidateKinematicsCache();
+    for (unsigned int i=0; i<3; ++i){
+        EXPECT_NEAR(com[i], expectedCom[i], requiredPrecision);
+        EXPECT_NEAR(comDot[i], expectedComDot[i], requiredPrecision);
+        EXPECT_NEAR(comDdot[i], expectedComDdot[i], requiredPrecision);
+    }
+
+    // The jacobian is the derivative of the center of mass over Q, and gives its velocity from Qdot
+    double h(1e-6);
+    biorbd::rigidbody::GeneralizedCoordinates Qh(Q);
+    for (unsigned int j=0; j<model.nbQ(); ++j){
+        Qh[j] = Q[j] + h;
+        biorbd::utils::Vector3d comPlus(model.CoM(Qh));
+        Qh[j] = Q[j] - h;
+        biorbd::utils::Vector3d comMinus(model.CoM(Qh));
+        Qh[j] = Q[j];
+        for (unsigned int i=0; i<3; ++i)
+            EXPECT_NEAR(jacobian(i, j), (comPlus[i] - comMinus[i])/(2*h), 1e-6);
+    }
+    biorbd::utils::Vector3d comDotFromJacobian(jacobian * Qdot);
+    for (unsigned int i=0; i<3; ++i)
+        EXPECT_NEAR(comDotFromJacobian[i], expectedComDot[i], requiredPrecision);
+}
+
+TEST(CoM, allFrames)
+{
+    biorbd::Model model(modelPathForGeneralTesting);
+    unsigned int nbFrames(7);
+    biorbd::utils::Matrix allQ(model.nbQ(), nbFrames);
+    for (unsigned int j=0; j<nbFrames; ++j)
+        for (unsigned int i=0; i<model.nbQ(); ++i)
+            allQ(i, j) = QtestPyomecaman[i] + 0.1*j*(i+1);
+
+    biorbd::utils::Matrix allCoM;
+    model.CoM(allQ, allCoM, 3);
+    EXPECT_EQ(allCoM.rows(), 3);
+    EXPECT_EQ(allCoM.cols(), nbFrames);
+
+    // Each frame is the one of its own Q, the first one being the known center of mass
+    biorbd::utils::Vector3d expectedCom(
+                -0.0034679564024098523, 0.15680579877453169, 0.07808112642459612);
+    for (unsigned int i=0; i<3; ++i)
+        EXPECT_NEAR(allCoM(i, 0), expectedCom[i], requiredPrecision);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model);
+    for (unsigned int j=0; j<nbFrames; ++j){
+        Q = allQ.col(j);
+        biorbd::utils::Vector3d com(model.CoM(Q));
+        for (unsigned int i=0; i<3; ++i)
+            EXPECT_NEAR(allCoM(i, j), com[i], requiredPrecision);
+    }
+
+    // The center of mass of each segment stacked in a column per frame
+    biorbd::utils::Matrix allCoMbySegment;
+    model.CoMbySegmentAllFrames(allQ, allCoMbySegment, 3);
+    EXPECT_EQ(allCoMbySegment.rows(), 3*model.nbSegment());
+    EXPECT_EQ(allCoMbySegment.cols(), nbFrames);
+    Eigen::Matrix3Xd comBySegment;
+    for (unsigned int j=0; j<nbFrames; ++j){
+        Q = allQ.col(j);
+        model.CoMbySegment(Q, comBySegment);
+        for (unsigned int k=0; k<model.nbSegment(); ++k)
+            for (unsigned int i=0; i<3; ++i)
+                EXPECT_NEAR(allCoMbySegment(3*k+i, j), comBySegment(i, k), requiredPrecision);
+    }
+}
+
+TEST(CoM, bySegmentInMatrix)
+{
+    biorbd::Model model(modelPathForGeneralTesting);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i)
+        Q[i] = QtestPyomecaman[i];
+
+    std::vector<biorbd::rigidbody::NodeSegment> comBySegment(model.CoMbySegment(Q));
+    Eigen::Matrix3Xd comInMatrix;
+    model.CoMbySegment(Q, comInMatrix);
+    EXPECT_EQ(comInMatrix.cols(), model.nbSegment());
+    for (unsigned int i=0; i<model.nbSegment(); ++i)
+        for (unsigned int j=0; j<3; ++j)
+            EXPECT_NEAR(comInMatrix(j, i), comBySegment[i][j], requiredPrecision);
+}
+
+TEST(CoM, workspace)
+{
+    biorbd::Model model(modelPathForGeneralTesting);
+    biorbd::Model workspace(model);
+    workspace.detachWorkspace();
+    EXPECT_EQ(workspace.nbSegment(), model.nbSegment());
+
+    biorbd::rigidbody::GeneralizedCoordinates Q(model), Qzero(model);
+    Qzero.setZero();
+    for (unsigned int i=0; i<model.nbQ(); ++i)
+        Q[i] = QtestPyomecaman[i];
+
+    biorbd::utils::Vector3d expectedCom(
+                -0.0034679564024098523, 0.15680579877453169, 0.07808112642459612);
+    biorbd::utils::Vector3d com(model.CoM(Q));
+    biorbd::utils::Vector3d comWorkspace(workspace.CoM(Qzero));
+
+    // The kinematics of the workspace must not be shared with the model
+    biorbd::utils::Vector3d comNoUpdate(model.CoM(Q, false));
+    for (unsigned int i=0; i<3; ++i){
+        EXPECT_NEAR(com[i], expectedCom[i], requiredPrecision);
+        EXPECT_NEAR(comNoUpdate[i], expectedCom[i], requiredPrecision);
+    }
+    biorbd::utils::Vector3d comWorkspaceNoUpdate(workspace.CoM(Qzero, false));
+    for (unsigned int i=0; i<3; ++i)
+        EXPECT_NEAR(comWorkspaceNoUpdate[i], comWorkspace[i], requiredPrecision);
+}
+
 TEST(Segment, copy)
 {
     biorbd::Model model(modelPathForGeneralTesting);
@@ -147,6 +287,217 @@ TEST(Markers, allPositions)
         for (unsigned int j=0; j<3; ++j)
             EXPECT_NEAR(markers[i][j], expectedMarkers[i][j], requiredPrecision);
 }
+TEST(Markers, allPositionsAllFrames)
+{
+    biorbd::Model model(modelPathMeshEqualsMarker);
+    unsigned int nbFrames(5);
+    biorbd::utils::Matrix allQ(model.nbQ(), nbFrames);
+    for (unsigned int j=0; j<nbFrames; ++j)
+        for (unsigned int i=0; i<model.nbQ(); ++i)
+            allQ(i, j) = QtestEqualsMarker[i] + 0.1*j*(i+1);
+
+    // Split the frames on two threads, the second chunk being computed by a workspace
+    biorbd::utils::Matrix allMarkers;
+    model.markersAllFrames(allQ, allMarkers, true, 2);
+    EXPECT_EQ(allMarkers.rows(), 3*model.nbMarkers());
+    EXPECT_EQ(allMarkers.cols(), nbFrames);
+
+    // Each frame is the one of its own Q, the first one being the known markers
+    for (unsigned int i=0; i<model.nbMarkers(); ++i)
+        for (unsigned int k=0; k<3; ++k)
+            EXPECT_NEAR(allMarkers(3*i+k, 0), expectedMarkers[i][k], requiredPrecision);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model);
+    Eigen::Matrix3Xd markers;
+    for (unsigned int j=0; j<nbFrames; ++j){
+        Q = allQ.col(j);
+        model.markers(Q, markers);
+        for (unsigned int i=0; i<model.nbMarkers(); ++i)
+            for (unsigned int k=0; k<3; ++k)
+                EXPECT_NEAR(allMarkers(3*i+k, j), markers(k, i), requiredPrecision);
+    }
+}
+TEST(Markers, allPositionsInMatrix)
+{
+    biorbd::Model model(modelPathMeshEqualsMarker);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i)
+        Q[i] = QtestEqualsMarker[i];
+
+    Eigen::Matrix3Xd markers;
+    model.markers(Q, markers);
+    EXPECT_EQ(markers.rows(), 3);
+    EXPECT_EQ(markers.cols(), model.nbMarkers());
+    for (unsigned int i=0; i<model.nbMarkers(); ++i)
+        for (unsigned int j=0; j<3; ++j)
+            EXPECT_NEAR(markers(j, i), expectedMarkers[i][j], requiredPrecision);
+
+    std::vector<biorbd::rigidbody::NodeSegment> technical(model.technicalMarkers(Q));
+    model.technicalMarkers(Q, markers, true, false);
+    EXPECT_EQ(markers.cols(), technical.size());
+    for (unsigned int i=0; i<technical.size(); ++i)
+        for (unsigned int j=0; j<3; ++j)
+            EXPECT_NEAR(markers(j, i), technical[i][j], requiredPrecision);
+}
+TEST(Markers, jacobianInMatrix)
+{
+    biorbd::Model model(modelPathForGeneralTesting);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i)
+        Q[i] = QtestPyomecaman[i];
+
+    std::vector<biorbd::utils::Matrix> expected(model.technicalMarkersJacobian(Q));
+    std::vector<std::vector<unsigned int>> sparsity(model.technicalMarkersJacobianSparsity());
+    biorbd::utils::Matrix jacobian;
+    model.technicalMarkersJacobian(Q, jacobian);
+    EXPECT_EQ(jacobian.rows(), 3*model.nbTechnicalMarkers());
+    EXPECT_EQ(jacobian.cols(), model.nbQdot());
+    EXPECT_EQ(sparsity.size(), model.nbTechnicalMarkers());
+    for (unsigned int i=0; i<expected.size(); ++i){
+        std::vector<bool> isFilled(model.nbQdot(), false);
+        for (unsigned int j : sparsity[i])
+            isFilled[j] = true;
+        for (unsigned int j=0; j<model.nbQdot(); ++j)
+            for (unsigned int k=0; k<3; ++k){
+                EXPECT_NEAR(jacobian(3*i+k, j), expected[i](k, j), requiredPrecision);
+                if (!isFilled[j])
+                    EXPECT_EQ(jacobian(3*i+k, j), 0.0);
+            }
+    }
+
+    model.markersJacobian(Q, jacobian);
+    EXPECT_EQ(jacobian.rows(), 3*model.nbMarkers());
+    EXPECT_EQ(model.markersJacobianSparsity().size(), model.nbMarkers());
+}
+TEST(IMU, jacobianInMatrix)
+{
+    biorbd::Model model(modelPathForImuTesting);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model);
+    Q.setOnes();
+    Q *= 0.2;
+
+    biorbd::utils::Matrix jacobian;
+    model.TechnicalIMUJacobian(Q, jacobian);
+    EXPECT_EQ(jacobian.rows(), 9*model.nbTechIMUs());
+    EXPECT_EQ(jacobian.cols(), model.nbQdot());
+
+    // Compare with the split jacobian and with the finite differences of the rotation matrices
+    std::vector<biorbd::utils::Matrix> split(model.TechnicalIMUJacobian(Q));
+    std::vector<biorbd::rigidbody::IMU> imus(model.technicalIMU(Q));
+    EXPECT_EQ(split.size(), model.nbTechIMUs());
+    double h(1e-7);
+    for (unsigned int j=0; j<model.nbQdot(); ++j){
+        biorbd::rigidbody::GeneralizedCoordinates Qh(Q);
+        Qh[j] += h;
+        std::vector<biorbd::rigidbody::IMU> imush(model.technicalIMU(Qh));
+        for (unsigned int i=0; i<imus.size(); ++i)
+            for (unsigned int col=0; col<3; ++col)
+                for (unsigned int row=0; row<3; ++row){
+                    EXPECT_NEAR(jacobian(9*i+3*col+row, j), split[i](3*col+row, j), requiredPrecision);
+                    EXPECT_NEAR(jacobian(9*i+3*col+row, j),
+                                (imush[i].rot()(row, col) - imus[i].rot()(row, col))/h, 1e-5);
+                }
+    }
+
+    model.IMUJacobian(Q, jacobian);
+    EXPECT_EQ(jacobian.rows(), 9*model.nbIMUs());
+}
+TEST(Markers, inverseKinematics)
+{
+    biorbd::Model model(modelPathForGeneralTesting);
+    biorbd::rigidbody::GeneralizedCoordinates Qref(model);
+    Qref = Qref.setOnes()*0.2;
+    Eigen::Matrix3Xd markers;
+    model.technicalMarkers(Qref, markers);
+    biorbd::utils::Vector T(Eigen::Map<Eigen::VectorXd>(markers.data(), markers.size()));
+
+    // From the zero position
+    biorbd::rigidbody::GeneralizedCoordinates Q(model);
+    Q.setZero();
+    double residual;
+    unsigned int nbIterations(model.inverseKinematics(T, Q, residual));
+    EXPECT_GT(nbIterations, 0);
+    EXPECT_LT(nbIterations, 100);
+    EXPECT_NEAR(residual, 0, 1e-8);
+    for (unsigned int i=0; i<model.nbQ(); ++i)
+        EXPECT_NEAR(Q[i], Qref[i], 1e-6);
+
+    // The legacy interface reports the convergence, not the number of iterations
+    std::vector<biorbd::rigidbody::NodeSegment> nodes;
+    for (unsigned int i=0; i<model.nbTechnicalMarkers(); ++i)
+        nodes.push_back(biorbd::rigidbody::NodeSegment(markers(0, i), markers(1, i), markers(2, i)));
+    biorbd::rigidbody::GeneralizedCoordinates Qinit(model), Qlegacy(model);
+    Qinit.setZero();
+    EXPECT_TRUE(model.inverseKinematics(nodes, Qinit, Qlegacy));
+    for (unsigned int i=0; i<model.nbQ(); ++i)
+        EXPECT_NEAR(Qlegacy[i], Qref[i], 1e-6);
+    EXPECT_TRUE(model.inverseKinematics(nodes, Qlegacy, Qlegacy));
+
+    // Warm started from the solution, with an occluded marker
+    T.block(0, 0, 3, 1).setZero();
+    EXPECT_EQ(model.inverseKinematics(T, Q, residual), 0);
+    EXPECT_NEAR(residual, 0, 1e-8);
+
+    // Bounded
+    biorbd::rigidbody::Markers::InverseKinematicsParam params;
+    std::vector<double> lower(model.nbQ(), -10), upper(model.nbQ(), 10);
+    upper[0] = 0.1;
+    params.setBounds(lower, upper);
+    Q.setZero();
+    model.inverseKinematics(T, Q, residual, params);
+    EXPECT_LE(Q[0], 0.1);
+    EXPECT_GT(residual, 1e-4);
+
+    // An outlier on a marker of the pelvis, which has other markers, only pulls the solution if it is weighted
+    biorbd::utils::Vector Toutlier(Eigen::Map<Eigen::VectorXd>(markers.data(), markers.size()));
+    Toutlier(0) += 0.5;
+    std::vector<double> weights(model.nbTechnicalMarkers(), 1);
+    biorbd::rigidbody::Markers::InverseKinematicsParam paramsOutlier;
+    Q.setZero();
+    model.inverseKinematics(Toutlier, Q, residual, paramsOutlier);
+    EXPECT_GT((Q - Qref).norm(), 1e-3);
+
+    weights[0] = 1e-8;
+    paramsOutlier.setWeights(weights);
+    Q.setZero();
+    model.inverseKinematics(Toutlier, Q, residual, paramsOutlier);
+    for (unsigned int i=0; i<model.nbQ(); ++i)
+        EXPECT_NEAR(Q[i], Qref[i], 1e-5);
+
+    // A whole trial split on two threads
+    unsigned int nbFrames(3);
+    biorbd::utils::Matrix allQref(model.nbQ(), nbFrames);
+    for (unsigned int i=0; i<nbFrames; ++i)
+        allQref.col(i) = Qref.setOnes() * (0.2 + 0.01*i);
+    biorbd::utils::Matrix allMarkers, allQ;
+    model.technicalMarkersAllFrames(allQref, allMarkers);
+    std::vector<double> residuals;
+    std::vector<unsigned int> allNbIterations;
+    Q.setZero();
+    model.inverseKinematics(allMarkers, Q, allQ, residuals, allNbIterations,
+                            biorbd::rigidbody::Markers::InverseKinematicsParam(), 2);
+    EXPECT_EQ(residuals.size(), nbFrames);
+    EXPECT_EQ(allNbIterations.size(), nbFrames);
+    for (unsigned int i=0; i<nbFrames; ++i){
+        EXPECT_NEAR(residuals[i], 0, 1e-8);
+        for (unsigned int j=0; j<model.nbQ(); ++j)
+            EXPECT_NEAR(allQ(j, i), allQref(j, i), 1e-6);
+    }
+}
+
+TEST(Markers, inverseKinematicsWithQuaternion)
+{
+    // The steps of the inverse kinematics are in the space of the DoFs, which is not the one of Q with quaternions
+    biorbd::Model model("models/simple_quat.bioMod");
+    EXPECT_NE(model.nbQ(), model.nbDof());
+    biorbd::rigidbody::GeneralizedCoordinates Q(model);
+    Q.setZero();
+    Q[model.nbQ()-1] = 1;
+    biorbd::utils::Vector T(3*model.nbTechnicalMarkers());
+    T.setZero();
+    double residual;
+    EXPECT_THROW(model.inverseKinematics(T, Q, residual), std::runtime_error);
+}
+
 TEST(Markers, individualPositions)
 {
     biorbd::Model model(modelPathMeshEqualsMarker);
@@ -211,6 +562,28 @@ TEST(Mesh, position)
     }
 }
 
+TEST(Mesh, positionInMatrix)
+{
+    biorbd::Model model(modelPathMeshEqualsMarker);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model);
+    Q.setOnes();
+    std::vector<std::vector<biorbd::utils::Vector3d>> expected(model.meshPoints(Q));
+
+    std::vector<biorbd::utils::Matrix> mesh;
+    for (unsigned int nbThreads : {1, 2}){
+        model.meshPointsInMatrix(Q, mesh, true, nbThreads);
+        EXPECT_EQ(mesh.size(), model.nbSegment());
+        for (unsigned int i=0; i<mesh.size(); ++i){
+            EXPECT_EQ(mesh[i].rows(), 3);
+            EXPECT_EQ(mesh[i].cols(), model.mesh(i).nbVertex());
+            EXPECT_EQ(model.mesh(i).pointsInMatrix().cols(), model.mesh(i).nbVertex());
+            for (unsigned int j=0; j<mesh[i].cols(); ++j)
+                for (unsigned int xyz=0; xyz<3; ++xyz)
+                    EXPECT_NEAR(mesh[i](xyz, j), expected[i][j][xyz], requiredPrecision);
+        }
+    }
+}
+
 TEST(Dynamics, Forward)
 {
     biorbd::Model model(modelPathForGeneralTesting);
@@ -269,6 +642,137 @@ TEST(Dynamics, ForwardAccelerationConstraint){
         EXPECT_NEAR(cs.force[i], forces_expected[i], requiredPrecision);
 }
 
+TEST(Dynamics, ForwardAccelerationConstraintRangeSpace){
+    biorbd::Model model(modelPathForGeneralTesting);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model), QDot(model), QDDot_constrained(model), QDDot_expected(model);
+    biorbd::rigidbody::GeneralizedTorque Tau(model);
+    Q.setOnes()/10;
+    QDot.setOnes()/10;
+    Tau.setOnes()/10;
+
+    // Must agree with the full KKT system
+    biorbd::rigidbody::Contacts& cs(model.getConstraints());
+    model.ForwardDynamicsContactsLagrangian(Q, QDot, Tau, cs, QDDot_expected);
+    Eigen::VectorXd forces_expected(cs.force);
+    RigidBodyDynamics::Math::MatrixNd H_expected(RigidBodyDynamics::Math::MatrixNd::Zero(model.nbQddot(), model.nbQddot()));
+    RigidBodyDynamics::CompositeRigidBodyAlgorithm(model, Q, H_expected, true);
+    model.invalidateKinematicsCache();
+
+    // Twice, to make sure the reused buffers do not leak from one call to the other
+    for (unsigned int k=0; k<2; ++k){
+        QDDot_constrained.setZero();
+        model.ForwardDynamicsContactsRangeSpace(Q, QDot, Tau, cs, QDDot_constrained);
+        for (unsigned int i = 0; i<model.nbQddot(); ++i)
+            EXPECT_NEAR(QDDot_constrained[i], QDDot_expected[i], requiredPrecision);
+        for (unsigned int i=0; i<cs.force.size(); ++i)
+            EXPECT_NEAR(cs.force[i], forces_expected[i], requiredPrecision);
+
+        // The mass matrix of the constraint set is not overwritten by its factorization
+        for (unsigned int i = 0; i<model.nbQddot(); ++i)
+            for (unsigned int j = 0; j<model.nbQddot(); ++j)
+                EXPECT_NEAR(cs.H(i, j), H_expected(i, j), requiredPrecision);
+    }
+}
+
+TEST(Dynamics, ForwardMergedDofs)
+{
+    biorbd::Model model(modelPathWithCardanSequences);
+    biorbd::Model modelMerged;
+    modelMerged.setMergeDofs(true);
+    biorbd::Reader::readModelFile(modelPathWithCardanSequences, &modelMerged);
+
+    // The xyz translations, zyx, yxz and xyz rotations are merged, but not the xzy rotations
+    EXPECT_EQ(modelMerged.nbQ(), model.nbQ());
+    EXPECT_EQ(model.mBodies.size(), 16);
+    EXPECT_EQ(modelMerged.mBodies.size(), 8);
+
+    biorbd::rigidbody::GeneralizedCoordinates Q(model), QDot(model), QDDot(model), QDDotMerged(model);
+    biorbd::rigidbody::GeneralizedTorque Tau(model);
+    for (unsigned int i = 0; i<model.nbQ(); ++i){
+        Q[i] = 0.1 * (i+1);
+        QDot[i] = -0.2 * (i+1);
+        Tau[i] = 0.5 * i;
+    }
+
+    std::vector<biorbd::rigidbody::NodeSegment> markers(model.markers(Q));
+    std::vector<biorbd::rigidbody::NodeSegment> markersMerged(modelMerged.markers(Q));
+    for (unsigned int i = 0; i<markers.size(); ++i)
+        for (unsigned int j = 0; j<3; ++j)
+            EXPECT_NEAR(markersMerged[i][j], markers[i][j], requiredPrecision);
+
+    RigidBodyDynamics::ForwardDynamics(model, Q, QDot, Tau, QDDot);
+    RigidBodyDynamics::ForwardDynamics(modelMerged, Q, QDot, Tau, QDDotMerged);
+    for (unsigned int i = 0; i<model.nbQddot(); ++i)
+        EXPECT_NEAR(QDDotMerged[i], QDDot[i], 1e-8);
+}
+
+TEST(Kinematics, cache)
+{
+    biorbd::Model model(modelPathForGeneralTesting);
+    biorbd::Model modelCached(modelPathForGeneralTesting);
+    modelCached.setUseKinematicsCache(true);
+    biorbd::rigidbody::GeneralizedCoordinates Q(model), Q2(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i){
+        Q[i] = QtestPyomecaman[i];
+        Q2[i] = -QtestPyomecaman[i];
+    }
+
+    // The first query updates the kinematics, the following ones on the same Q don't
+    modelCached.markers(Q);
+    biorbd::utils::RotoTrans jcs(modelCached.globalJCS(Q, 1));
+    biorbd::utils::Vector3d com(modelCached.CoM(Q));
+    EXPECT_EQ(modelCached.nbKinematicsCacheMisses(), 1);
+    EXPECT_EQ(modelCached.nbKinematicsCacheHits(), 2);
+
+    modelCached.markers(Q2);
+    std::vector<biorbd::rigidbody::NodeSegment> markersCached(modelCached.markers(Q));
+    EXPECT_EQ(modelCached.nbKinematicsCacheMisses(), 3);
+    EXPECT_EQ(modelCached.nbKinematicsCacheHits(), 2);
+
+    std::vector<biorbd::rigidbody::NodeSegment> markers(model.markers(Q));
+    biorbd::utils::RotoTrans jcsExpected(model.globalJCS(Q, 1));
+    biorbd::utils::Vector3d comExpected(model.CoM(Q));
+    for (unsigned int i=0; i<markers.size(); ++i)
+        for (unsigned int j=0; j<3; ++j)
+            EXPECT_NEAR(markersCached[i][j], markers[i][j], requiredPrecision);
+    for (unsigned int i=0; i<4; ++i)
+        for (unsigned int j=0; j<4; ++j)
+            EXPECT_NEAR(jcs(i, j), jcsExpected(i, j), requiredPrecision);
+    for (unsigned int i=0; i<3; ++i)
+        EXPECT_NEAR(com[i], comExpected[i], requiredPrecision);
+
+    // Calling RBDL directly requires to invalidate the cache
+    biorbd::rigidbody::GeneralizedCoordinates QDot(model), QDDot(model);
+    biorbd::rigidbody::GeneralizedTorque Tau(model);
+    QDot.setZero();
+    Tau.setZero();
+    RigidBodyDynamics::ForwardDynamics(modelCached, Q2, QDot, Tau, QDDot);
+    modelCached.invalidateKinematicsCache();
+    markersCached = modelCached.markers(Q);
+    EXPECT_EQ(modelCached.nbKinematicsCacheMisses(), 4);
+    for (unsigned int i=0; i<markers.size(); ++i)
+        for (unsigned int j=0; j<3; ++j)
+            EXPECT_NEAR(markersCached[i][j], markers[i][j], requiredPrecision);
+
+    // The queries that update the kinematics themselves must keep the cache in sync
+    for (unsigned int i=0; i<model.nbQdot(); ++i)
+        QDot[i] = 0.1*i;
+    biorbd::utils::Vector3d angularMomentum(modelCached.angularMomentum(Q2, QDot));
+    biorbd::utils::Vector3d angularMomentumExpected(model.angularMomentum(Q2, QDot));
+    for (unsigned int i=0; i<3; ++i)
+        EXPECT_NEAR(angularMomentum[i], angularMomentumExpected[i], requiredPrecision);
+    markersCached = modelCached.markers(Q);
+    for (unsigned int i=0; i<markers.size(); ++i)
+        for (unsigned int j=0; j<3; ++j)
+            EXPECT_NEAR(markersCached[i][j], markers[i][j], requiredPrecision);
+
+    modelCached.CoMbySegment(Q2, static_cast<unsigned int>(0));
+    markersCached = modelCached.markers(Q);
+    for (unsigned int i=0; i<markers.size(); ++i)
+        for (unsigned int j=0; j<3; ++j)
+            EXPECT_NEAR(markersCached[i][j], markers[i][j], requiredPrecision);
+}
+
 TEST(Kinematics, computeQdot)
 {
     biorbd::Model m("models/simple_quat.bioMod");
@@ -318,7 +822,7 @@ TEST(Kalman, markers)
     biorbd::rigidbody::GeneralizedCoordinates Q(model), Qdot(model), Qddot(model);
     kalman.reconstructFrame(model, targetMarkers, &Q, &Qdot, &Qddot);
 
-    // Compare results (since the initialization of the filter is done 50X, it is expected to have converged)
+    // Compare results (since the first frame is fitted, it is expected to have converged)
     for (unsigned int i=0; i<model.nbQ(); ++i){
         EXPECT_NEAR(Q[i], Qref[i], 1e-6);
         EXPECT_NEAR(Qdot[i], 0, 1e-6);
@@ -349,6 +853,178 @@ TEST(Kalman, markers)
 }
 #endif
 
+// Gives access to the iteration of the filter, so it can be compared with the dense equations
+class KalmanReconsMarkersIteration : public biorbd::rigidbody::KalmanReconsMarkers
+{
+public:
+    KalmanReconsMarkersIteration(
+            biorbd::Model &model,
+            biorbd::rigidbody::KalmanRecons::KalmanParam params) :
+        biorbd::rigidbody::KalmanReconsMarkers(model, params) {}
+
+    void filter(
+            const biorbd::utils::Vector &measure,
+            const biorbd::utils::Vector &projectedMeasure,
+            const biorbd::utils::Matrix &Hessian,
+            const std::vector<unsigned int> &occlusion){
+        iteration(measure, projectedMeasure, Hessian, occlusion);
+    }
+    const biorbd::utils::Vector& state() const { return *m_xp; }
+    const biorbd::utils::Matrix& covariance() const { return *m_Pp; }
+    const biorbd::utils::Matrix& evolution() const { return *m_A; }
+    const biorbd::utils::Matrix& processNoise() const { return *m_Q; }
+    const biorbd::utils::Matrix& measurementNoise() const { return *m_R; }
+};
+
+TEST(Kalman, iterationAgainstDense)
+{
+    biorbd::Model model(modelPathForGeneralTesting);
+    KalmanReconsMarkersIteration kalman(model, biorbd::rigidbody::KalmanRecons::KalmanParam(100, 1e-3, 1e-2));
+    unsigned int n(model.nbQ());
+    unsigned int nbMeasures(3*model.nbTechnicalMarkers());
+
+    // The markers are linearized around a reference, the hessian only having the columns of Q
+    biorbd::rigidbody::GeneralizedCoordinates Qref(model), Q(model);
+    Qref = Qref.setOnes()*0.2;
+    Eigen::Matrix3Xd markers;
+    biorbd::utils::Matrix jacobian;
+    model.technicalMarkers(Qref, markers);
+    biorbd::utils::Vector markersRef(Eigen::Map<Eigen::VectorXd>(markers.data(), markers.size()));
+    model.technicalMarkersJacobian(Qref, jacobian);
+    biorbd::utils::Matrix H(biorbd::utils::Matrix::Zero(nbMeasures, 3*n));
+    H.leftCols(n) = jacobian;
+
+    const biorbd::utils::Matrix& A(kalman.evolution());
+    biorbd::utils::Vector x(kalman.state());
+    biorbd::utils::Matrix P(kalman.covariance());
+    for (unsigned int frame=0; frame<10; ++frame){
+        // Some frames have occluded markers, whose 3 measurements are removed together
+        std::vector<unsigned int> occlusion;
+        if (frame == 3 || frame == 4)
+            occlusion.push_back(0);
+        if (frame == 6){
+            occlusion.push_back(1);
+            occlusion.push_back(4);
+        }
+        std::vector<unsigned int> visible;
+        for (unsigned int j=0; j<nbMeasures; ++j)
+            if (std::find(occlusion.begin(), occlusion.end(), j/3) == occlusion.end())
+                visible.push_back(j);
+
+        Q.setConstant(0.2 + 0.01*frame);
+        model.technicalMarkers(Q, markers);
+        biorbd::utils::Vector measure(Eigen::Map<Eigen::VectorXd>(markers.data(), markers.size()));
+
+        // Dense prediction and gain
+        biorbd::utils::Vector xkm(A * x);
+        biorbd::utils::Matrix Pkm(A * P * A.transpose() + kalman.processNoise());
+        biorbd::utils::Vector projected(markersRef + jacobian * (xkm.head(n) - Qref));
+        biorbd::utils::Matrix Hvisible(visible.size(), 3*n), R(visible.size(), visible.size());
+        biorbd::utils::Vector innovation(visible.size());
+        for (unsigned int k=0; k<visible.size(); ++k){
+            Hvisible.row(k) = H.row(visible[k]);
+            innovation(k) = measure(visible[k]) - projected(visible[k]);
+            for (unsigned int l=0; l<visible.size(); ++l)
+                R(k, l) = kalman.measurementNoise()(visible[k], visible[l]);
+        }
+        biorbd::utils::Matrix S(Hvisible * Pkm * Hvisible.transpose() + R);
+        biorbd::utils::Matrix K(Pkm * Hvisible.transpose() * S.inverse());
+        x = xkm + K * innovation;
+        P = (biorbd::utils::Matrix::Identity(3*n, 3*n) - K * Hvisible) * Pkm;
+
+        kalman.filter(measure, projected, H, occlusion);
+        for (unsigned int i=0; i<3*n; ++i)
+            EXPECT_NEAR(kalman.state()(i), x(i), 1e-8*(1 + std::abs(x(i))));
+        EXPECT_LT((kalman.covariance() - P).norm(), 1e-8*P.norm());
+    }
+}
+
+TEST(Kalman, markersInitialization)
+{
+    biorbd::Model model(modelPathForGeneralTesting);
+    biorbd::rigidbody::GeneralizedCoordinates Qref(model);
+    Qref = Qref.setOnes()*0.2;
+    std::vector<biorbd::rigidbody::NodeSegment> targetMarkers(model.markers(Qref));
+    biorbd::rigidbody::GeneralizedCoordinates Q(model), Qdot(model), Qddot(model);
+
+    // From the zero position, the fit needs some iterations to converge
+    {
+        biorbd::rigidbody::KalmanReconsMarkers kalman(model);
+        EXPECT_EQ(kalman.nbInitializationIterations(), 0);
+        kalman.reconstructFrame(model, targetMarkers, &Q, &Qdot, &Qddot);
+        EXPECT_GT(kalman.nbInitializationIterations(), 0);
+        EXPECT_LE(kalman.nbInitializationIterations(), 50);
+        for (unsigned int i=0; i<model.nbQ(); ++i)
+            EXPECT_NEAR(Q[i], Qref[i], 1e-6);
+    }
+
+    // Starting from the solution, there is nothing left to fit
+    {
+        biorbd::rigidbody::KalmanReconsMarkers kalman(model);
+        kalman.setInitState(&Qref);
+        kalman.reconstructFrame(model, targetMarkers, &Q, &Qdot, &Qddot);
+        EXPECT_EQ(kalman.nbInitializationIterations(), 0);
+        for (unsigned int i=0; i<model.nbQ(); ++i)
+            EXPECT_NEAR(Q[i], Qref[i], 1e-6);
+    }
+
+    // The number of iterations can be bounded
+    {
+        biorbd::rigidbody::KalmanReconsMarkers kalman(
+                    model, biorbd::rigidbody::KalmanRecons::KalmanParam(100, 1e-10, 1e-5, 2, 1e-10, 0));
+        kalman.reconstructFrame(model, targetMarkers, &Q, &Qdot, &Qddot);
+        EXPECT_LE(kalman.nbInitializationIterations(), 2);
+    }
+}
+
+#ifndef SKIP_LONG_TESTS
+TEST(Kalman, markersTrials)
+{
+    biorbd::Model model(modelPathForGeneralTesting);
+
+    // Two trials of different lengths
+    std::vector<biorbd::utils::Matrix> trials(2);
+    std::vector<unsigned int> nbFrames = {3, 2};
+    biorbd::rigidbody::GeneralizedCoordinates Qref(model);
+    Eigen::Matrix3Xd markers;
+    for (unsigned int i=0; i<trials.size(); ++i){
+        trials[i].resize(3*model.nbTechnicalMarkers(), nbFrames[i]);
+        for (unsigned int j=0; j<nbFrames[i]; ++j){
+            Qref = Qref.setOnes() * (0.1*(i+1) + 0.01*j);
+            model.technicalMarkers(Qref, markers);
+            trials[i].col(j) = Eigen::Map<Eigen::VectorXd>(markers.data(), markers.size());
+        }
+    }
+
+    std::vector<biorbd::utils::Matrix> allQ, allQdot, allQddot;
+    std::vector<double> durations;
+    biorbd::rigidbody::KalmanReconsMarkers::reconstructTrials(
+                model, trials, allQ, allQdot, allQddot, durations,
+                biorbd::rigidbody::KalmanRecons::KalmanParam(), true, 2);
+    EXPECT_EQ(allQ.size(), trials.size());
+    EXPECT_EQ(durations.size(), trials.size());
+
+    // Each trial must be reconstructed as if it was on its own
+    biorbd::rigidbody::GeneralizedCoordinates Q(model), Qdot(model), Qddot(model);
+    biorbd::utils::Vector Tobs;
+    for (unsigned int i=0; i<trials.size(); ++i){
+        EXPECT_EQ(allQ[i].rows(), model.nbQ());
+        EXPECT_EQ(allQ[i].cols(), nbFrames[i]);
+        EXPECT_GE(durations[i], 0);
+        biorbd::rigidbody::KalmanReconsMarkers kalman(model);
+        for (unsigned int j=0; j<nbFrames[i]; ++j){
+            Tobs = trials[i].col(j);
+            kalman.reconstructFrame(model, Tobs, &Q, &Qdot, &Qddot);
+            for (unsigned int k=0; k<model.nbQ(); ++k){
+                EXPECT_NEAR(allQ[i](k, j), Q[k], requiredPrecision);
+                EXPECT_NEAR(allQdot[i](k, j), Qdot[k], requiredPrecision);
+                EXPECT_NEAR(allQddot[i](k, j), Qddot[k], requiredPrecision);
+            }
+        }
+    }
+}
+#endif
+
 #ifndef SKIP_LONG_TESTS
 TEST(Kalman, imu)
 {
@@ -363,7 +1039,7 @@ TEST(Kalman, imu)
     biorbd::rigidbody::GeneralizedCoordinates Q(model), Qdot(model), Qddot(model);
     kalman.reconstructFrame(model, targetImus, &Q, &Qdot, &Qddot);
 
-    // Compare results (since the initialization of the filter is done 50X, it is expected to have converged)
+    // Compare results (since the initialization of the filter is done 300X, it is expected to have converged)
     for (unsigned int i=0; i<model.nbQ(); ++i){
         if (i < 2){
             // Translations are not reconstructed from IMU
@@ -1,9 +1,11 @@
 #include <iostream>
+#include <clocale>
 #include <gtest/gtest.h>
 #include <rbdl/Dynamics.h>
 
 #include "BiorbdModel.h"
 #include "Utils/String.h"
+#include "Utils/Equation.h"
 #include "Utils/Path.h"
 #include "Utils/Matrix.h"
 #include "Utils/Vector3d.h"
@@ -474,6 +476,57 @@ TEST(ModelReading, equations)
         EXPECT_DOUBLE_EQ(node.x(), node.y());
 }
 
+TEST(Equation, compiled)
+{
+    // An equation is compiled once and can then be evaluated for other values of its variables
+    biorbd::utils::Equation eq("2*($a-$b)/-4+$a*pi");
+    std::vector<biorbd::utils::Equation::Operation> operations;
+    std::vector<biorbd::utils::Equation> variableNames;
+    eq.compile(operations, variableNames);
+    EXPECT_EQ(variableNames.size(), 2);
+
+    std::map<biorbd::utils::Equation, double> variables;
+    for (double a : {0.0, 1.5, -3.0}){
+        variables["$a"] = a;
+        variables["$b"] = 2*a + 1;
+        double expected(2*(a-(2*a+1))/-4+a*M_PI);
+        EXPECT_DOUBLE_EQ(biorbd::utils::Equation::evaluate(operations, variableNames, variables), expected);
+        EXPECT_DOUBLE_EQ(biorbd::utils::Equation::evaluateEquation(eq, variables), expected);
+    }
+
+    double value;
+    EXPECT_TRUE(biorbd::utils::Equation("-1.5e-3").isNumber(value));
+    EXPECT_DOUBLE_EQ(value, -1.5e-3);
+    EXPECT_FALSE(biorbd::utils::Equation("1-5e-3").isNumber(value));
+
+    EXPECT_THROW(biorbd::utils::Equation::evaluateEquation("2*(1+"), std::runtime_error);
+    EXPECT_THROW(biorbd::utils::Equation::evaluateEquation("2*$c"), std::runtime_error);
+}
+
+TEST(Equation, localeIndependent)
+{
+    // The numbers of the files keep their dot even where the locale uses a comma
+    std::string previousLocale(std::setlocale(LC_NUMERIC, nullptr));
+    const char* locales[] = {"fr_FR.UTF-8", "de_DE.UTF-8", "fr_FR", "de_DE", "French", "German"};
+    for (const char* locale : locales)
+        if (std::setlocale(LC_NUMERIC, locale))
+            break;
+
+    double value;
+    EXPECT_TRUE(biorbd::utils::Equation("-1.5e-3").isNumber(value));
+    EXPECT_DOUBLE_EQ(value, -1.5e-3);
+    EXPECT_FALSE(biorbd::utils::Equation("1,5").isNumber(value));
+    EXPECT_DOUBLE_EQ(biorbd::utils::Equation::evaluateEquation("0.25*(2.5+.5)"), 0.75);
+
+    const char* number("12.5,3");
+    EXPECT_EQ(biorbd::utils::Equation::readNumber(number, value), number + 4);
+    EXPECT_DOUBLE_EQ(value, 12.5);
+    const char* notANumber("e3");
+    EXPECT_EQ(biorbd::utils::Equation::readNumber(notANumber, value), notANumber);
+
+    std::setlocale(LC_NUMERIC, previousLocale.c_str());
+}
+
 TEST(Quaternion, creation)
 {
     {